@@ -30,10 +30,12 @@ typedef struct AbstractSampleIterator
 
 typedef struct AbstractMultiSeriesSampleIterator
 {
-    ChunkResult (*GetNext)(struct AbstractMultiSeriesSampleIterator *iter, Sample *sample);
+    // Returns the number of samples at the next timestamp, their values in values (one per
+    // series at most), and 0 at the end
+    size_t (*GetNextRun)(struct AbstractMultiSeriesSampleIterator *iter,
+                         timestamp_t *timestamp,
+                         double *values);
     void (*Close)(struct AbstractMultiSeriesSampleIterator *iter);
-
-    struct AbstractSampleIterator **input; // array of iterators
 } AbstractMultiSeriesSampleIterator;
 
 typedef struct AbstractMultiSeriesAggDupSampleIterator
@@ -0,0 +1,385 @@
+/*
+ * Copyright (c) 2006-Present, Redis Ltd.
+ * All rights reserved.
+ *
+ * Licensed under your choice of (a) the Redis Source Available License 2.0
+ * (RSALv2); or (b) the Server Side Public License v1 (SSPLv1); or (c) the
+ * GNU Affero General Public License v3 (AGPLv3).
+ */
+#include "async_compaction.h"
+
+#include "config.h"
+#include "consts.h"
+#include "module.h"
+#include "notify.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <time.h>
+#include "rmutil/alloc.h"
+
+#define COMPACTION_QUEUE_INITIAL_CAPACITY 16
+#define ASYNC_COMPACTION_INTERVAL_MS 10
+// Max time the worker holds the GIL at once
+#define ASYNC_COMPACTION_LOCK_BUDGET_US 1000
+
+static CompactionQueueApplyFunc applyFunc = NULL;
+
+// Non-empty queues. Only touched while holding the GIL; the count is additionally read by the
+// worker without the GIL to skip idle ticks, hence the atomic accesses.
+static CompactionQueue **pendingQueues = NULL;
+static size_t pendingQueuesCount = 0;
+static size_t pendingQueuesCapacity = 0;
+
+static bool workerStarted = false;
+
+// The user who writes the samples enqueued now: resolved once per write command, see
+// AsyncCompaction_BeginWrite, or the writer of the queue being applied
+typedef struct WriterState
+{
+    bool active;
+    bool resolved;
+    bool owned;                  // userName is freed by AsyncCompaction_EndWrite
+    RedisModuleString *userName; // NULL when no user applies
+} WriterState;
+
+static WriterState writer = { 0 };
+
+void AsyncCompaction_Init(CompactionQueueApplyFunc apply) {
+    applyFunc = apply;
+}
+
+static void registryAdd(CompactionQueue *queue) {
+    if (pendingQueuesCount == pendingQueuesCapacity) {
+        pendingQueuesCapacity = pendingQueuesCapacity ? pendingQueuesCapacity * 2 : 64;
+        pendingQueues = realloc(pendingQueues, pendingQueuesCapacity * sizeof(*pendingQueues));
+    }
+    queue->registryPos = pendingQueuesCount;
+    pendingQueues[pendingQueuesCount] = queue;
+    __atomic_store_n(&pendingQueuesCount, pendingQueuesCount + 1, __ATOMIC_RELAXED);
+}
+
+static void registryRemove(CompactionQueue *queue) {
+    const size_t last = pendingQueuesCount - 1;
+    if (queue->registryPos != last) {
+        pendingQueues[queue->registryPos] = pendingQueues[last];
+        pendingQueues[queue->registryPos]->registryPos = queue->registryPos;
+    }
+    __atomic_store_n(&pendingQueuesCount, last, __ATOMIC_RELAXED);
+}
+
+// Applies pending queues until none is left, or until deadline (us, 0 for none) passed. Returns
+// true when queues are left.
+static bool flushPending(RedisModuleCtx *ctx, uint64_t deadline) {
+    const int originalDb = RedisModule_GetSelectedDb(ctx);
+    // Flushing a source may enqueue samples on its destinations (chained rules), so keep going
+    // until nothing is left. Each pass strictly moves samples down the rule chains, which are
+    // acyclic, so this terminates.
+    while (pendingQueuesCount > 0) {
+        if (deadline && RedisModule_MonotonicMicroseconds() >= deadline) {
+            break;
+        }
+        CompactionQueue *queue = pendingQueues[pendingQueuesCount - 1];
+        RedisModule_SelectDb(ctx, queue->dbId);
+        AsyncCompaction_FlushSeries(ctx, queue->series);
+    }
+    if (originalDb != RedisModule_GetSelectedDb(ctx)) {
+        RedisModule_SelectDb(ctx, originalDb);
+    }
+    return pendingQueuesCount > 0;
+}
+
+static void *AsyncCompaction_WorkerMain(void *arg) {
+    RedisModuleCtx *ctx = RedisModule_GetThreadSafeContext(NULL);
+    const struct timespec interval = { .tv_sec = 0,
+                                       .tv_nsec = ASYNC_COMPACTION_INTERVAL_MS * 1000000L };
+
+    bool more = false;
+    while (true) {
+        if (more) {
+            // let the main thread run before the next slice
+            sched_yield();
+        } else {
+            nanosleep(&interval, NULL);
+        }
+        if (__atomic_load_n(&pendingQueuesCount, __ATOMIC_RELAXED) == 0) {
+            more = false;
+            continue;
+        }
+        RedisModule_ThreadSafeContextLock(ctx);
+        // one notification per destination for the whole slice
+        Notify_BeginBatch();
+        more = flushPending(ctx,
+                            RedisModule_MonotonicMicroseconds() + ASYNC_COMPACTION_LOCK_BUDGET_US);
+        Notify_EndBatch(ctx);
+        RedisModule_ThreadSafeContextUnlock(ctx);
+    }
+
+    return NULL;
+}
+
+static void startWorkerIfNeeded(void) {
+    if (workerStarted) {
+        return;
+    }
+
+    pthread_attr_t attr;
+    pthread_t thread;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&thread, &attr, AsyncCompaction_WorkerMain, NULL) == 0) {
+        workerStarted = true;
+    } else {
+        RedisModule_Log(rts_staticCtx,
+                        "warning",
+                        "Failed to start the async compaction worker, compactions will run "
+                        "when the pending lag limit is reached");
+    }
+    pthread_attr_destroy(&attr);
+}
+
+// The user the samples are written by: the context's user when the samples are applied on behalf
+// of their writer (chained rules), else the client's. NULL when no user applies.
+static RedisModuleString *writerName(RedisModuleCtx *ctx) {
+    RedisModuleString *userName = NULL;
+    const RedisModuleUser *user = NULL;
+    if (API_USER_CONTEXT_SUPPORTED) {
+        user = RedisModule_GetContextUser(ctx);
+    }
+    if (user) {
+        userName = RedisModule_GetUserUsername(ctx, (RedisModuleUser *)user);
+    } else {
+        userName = RedisModule_GetCurrentUserName(ctx);
+    }
+    if (!userName) {
+        return NULL;
+    }
+    RedisModuleString *copy = RedisModule_CreateStringFromString(NULL, userName);
+    RedisModule_FreeString(ctx, userName);
+    return copy;
+}
+
+void AsyncCompaction_BeginWrite(void) {
+    writer = (WriterState){ .active = true };
+}
+
+void AsyncCompaction_EndWrite(void) {
+    if (writer.owned && writer.userName) {
+        RedisModule_FreeString(NULL, writer.userName);
+    }
+    writer = (WriterState){ 0 };
+}
+
+// Returns the writer of the sample being enqueued, retained for the caller
+static RedisModuleString *currentWriter(RedisModuleCtx *ctx) {
+    if (!writer.active) {
+        // a write outside of a command, resolved for every sample
+        return writerName(ctx);
+    }
+    if (!writer.resolved) {
+        writer.userName = writerName(ctx);
+        writer.resolved = true;
+        writer.owned = true;
+    }
+    if (writer.userName) {
+        RedisModule_RetainString(NULL, writer.userName);
+    }
+    return writer.userName;
+}
+
+// Whether the samples of userName may join the queue. A queue takes the string of the writer of
+// the command once they matched, so that the next samples of the command compare the pointers.
+static bool sameUser(CompactionQueue *queue, RedisModuleString *userName) {
+    if (queue->userName == userName) {
+        return true;
+    }
+    if (!queue->userName || !userName ||
+        RedisModule_StringCompare(queue->userName, userName) != 0) {
+        return false;
+    }
+    RedisModule_FreeString(NULL, queue->userName);
+    RedisModule_RetainString(NULL, userName);
+    queue->userName = userName;
+    return true;
+}
+
+bool AsyncCompaction_Enqueue(RedisModuleCtx *ctx,
+                             Series *series,
+                             timestamp_t timestamp,
+                             double value) {
+    CompactionQueue *queue = series->compactionQueue;
+    if (queue == NULL) {
+        queue = calloc(1, sizeof(*queue));
+        queue->series = series;
+        series->compactionQueue = queue;
+    }
+
+    RedisModuleString *userName = currentWriter(ctx);
+    if (queue->count > 0 && !sameUser(queue, userName)) {
+        // a queue is applied with the ACLs of a single user
+        AsyncCompaction_FlushSeries(ctx, series);
+    }
+
+    if (queue->count >= (size_t)TSGlobalConfig.compactionMaxLag) {
+        if (userName) {
+            RedisModule_FreeString(NULL, userName);
+        }
+        return false;
+    }
+
+    if (queue->count == queue->capacity) {
+        queue->capacity = queue->capacity ? queue->capacity * 2 : COMPACTION_QUEUE_INITIAL_CAPACITY;
+        queue->samples = realloc(queue->samples, queue->capacity * sizeof(Sample));
+    }
+
+    if (queue->count == 0) {
+        queue->dbId = RedisModule_GetSelectedDb(ctx);
+        queue->userName = userName;
+        registryAdd(queue);
+        startWorkerIfNeeded();
+    } else if (userName) {
+        RedisModule_FreeString(NULL, userName);
+    }
+
+    queue->samples[queue->count++] = (Sample){ .timestamp = timestamp, .value = value };
+    return true;
+}
+
+// Applies samples with the ACLs of the user who wrote them. The flush may run on behalf of
+// another client, whose user is restored afterwards.
+static void applyAsWriter(RedisModuleCtx *ctx,
+                          Series *series,
+                          const Sample *samples,
+                          size_t count,
+                          RedisModuleString *userName) {
+    // the samples the rules write to chained destinations come from the same writer
+    const WriterState outerWriter = writer;
+    writer = (WriterState){ .active = true, .resolved = true, .userName = userName };
+
+    if (!userName || !API_USER_CONTEXT_SUPPORTED) {
+        applyFunc(ctx, series, samples, count, false);
+    } else {
+        RedisModuleUser *user = RedisModule_GetModuleUserFromUserName(userName);
+        // a deleted user can't write the destinations anymore
+        if (user) {
+            const RedisModuleUser *ctxUser = RedisModule_GetContextUser(ctx);
+            RedisModule_SetContextUser(ctx, user);
+            applyFunc(ctx, series, samples, count, true);
+            RedisModule_SetContextUser(ctx, ctxUser);
+            RedisModule_FreeModuleUser(user);
+        }
+    }
+
+    writer = outerWriter;
+}
+
+void AsyncCompaction_FlushSeries(RedisModuleCtx *ctx, Series *series) {
+    CompactionQueue *queue = series->compactionQueue;
+    if (queue == NULL || queue->count == 0) {
+        return;
+    }
+
+    // Detach the batch first: applying it may add samples to other queues (chained rules).
+    const size_t count = queue->count;
+    RedisModuleString *userName = queue->userName;
+    queue->count = 0;
+    queue->userName = NULL;
+    registryRemove(queue);
+
+    applyAsWriter(ctx, series, queue->samples, count, userName);
+    if (userName) {
+        RedisModule_FreeString(NULL, userName);
+    }
+
+    // Give back memory after a burst, keep a small buffer for the steady state.
+    if (queue->count == 0 && queue->capacity > COMPACTION_QUEUE_INITIAL_CAPACITY * 64) {
+        free(queue->samples);
+        queue->samples = NULL;
+        queue->capacity = 0;
+    }
+}
+
+void AsyncCompaction_FlushAll(RedisModuleCtx *ctx) {
+    if (pendingQueuesCount == 0) {
+        return;
+    }
+
+    flushPending(ctx, 0);
+}
+
+void AsyncCompaction_Unlink(Series *series) {
+    CompactionQueue *queue = series->compactionQueue;
+    if (queue == NULL || queue->count == 0 || queue->unlinked) {
+        return;
+    }
+    registryRemove(queue);
+    queue->unlinked = true;
+}
+
+void AsyncCompaction_Relink(Series *series, int dbId) {
+    CompactionQueue *queue = series->compactionQueue;
+    if (queue == NULL) {
+        return;
+    }
+    queue->dbId = dbId;
+    if (queue->unlinked) {
+        queue->unlinked = false;
+        registryAdd(queue);
+    }
+}
+
+void AsyncCompaction_SwapDb(int first, int second) {
+    for (size_t i = 0; i < pendingQueuesCount; i++) {
+        CompactionQueue *queue = pendingQueues[i];
+        if (queue->dbId == first) {
+            queue->dbId = second;
+        } else if (queue->dbId == second) {
+            queue->dbId = first;
+        }
+    }
+}
+
+static void dropPending(CompactionQueue *queue) {
+    if (!queue->unlinked) {
+        registryRemove(queue);
+    }
+    queue->unlinked = false;
+    queue->count = 0;
+    if (queue->userName) {
+        RedisModule_FreeString(NULL, queue->userName);
+        queue->userName = NULL;
+    }
+}
+
+void AsyncCompaction_DropDb(int dbId) {
+    for (size_t i = pendingQueuesCount; i > 0; i--) {
+        CompactionQueue *queue = pendingQueues[i - 1];
+        if (dbId == -1 || queue->dbId == dbId) {
+            dropPending(queue);
+        }
+    }
+}
+
+void AsyncCompaction_Discard(Series *series) {
+    CompactionQueue *queue = series->compactionQueue;
+    if (queue == NULL) {
+        return;
+    }
+
+    if (queue->count > 0) {
+        dropPending(queue);
+    }
+    free(queue->samples);
+    free(queue);
+    series->compactionQueue = NULL;
+}
+
+size_t AsyncCompaction_MemUsage(const Series *series) {
+    const CompactionQueue *queue = series->compactionQueue;
+    if (queue == NULL) {
+        return 0;
+    }
+
+    return sizeof(*queue) + queue->capacity * sizeof(Sample);
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2006-Present, Redis Ltd.
+ * All rights reserved.
+ *
+ * Licensed under your choice of (a) the Redis Source Available License 2.0
+ * (RSALv2); or (b) the Server Side Public License v1 (SSPLv1); or (c) the
+ * GNU Affero General Public License v3 (AGPLv3).
+ */
+#ifndef ASYNC_COMPACTION_H
+#define ASYNC_COMPACTION_H
+
+#include "generic_chunk.h"
+#include "tsdb.h"
+
+#include "RedisModulesSDK/redismodule.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Opt-in (ts-compaction-async) deferral of compaction rules out of the write path.
+ *
+ * When enabled, a sample appended to a series that has rules is only recorded in the series'
+ * pending queue. A module worker thread periodically takes the GIL and replays the pending queues
+ * through the series' rules in batches, so the cost of closing buckets and writing the
+ * destination series is paid once per batch instead of once per TS.ADD. The rules' contexts and
+ * the destinations live in the keyspace, so the worker replays the queues under the GIL, but
+ * releases it whenever it held it for ASYNC_COMPACTION_LOCK_BUDGET_US.
+ *
+ * The samples are replayed as they would have been on the write path: with the ACLs of the user
+ * who wrote them, resolved once per write command, and in the db the series is in, which follows
+ * MOVE and SWAPDB. The keyspace can't be written while a key is deleted, so the pending samples of
+ * a deleted series are dropped with it.
+ *
+ * All queue accesses (enqueue on the write path, drain in the worker) happen while holding the
+ * GIL, so the queues themselves need no locking.
+ */
+typedef struct CompactionQueue
+{
+    Series *series;     // owning series (updated on defrag)
+    Sample *samples;    // pending samples, in arrival order
+    size_t count;       // number of pending samples
+    size_t capacity;    // allocated slots in samples
+    int dbId;           // db the series is in, moved along with it
+    RedisModuleString *userName; // user who wrote the pending samples, NULL when none applies
+    bool unlinked;               // the key was unlinked, out of the global list until relinked
+    size_t registryPos;          // position in the global list of non-empty queues
+} CompactionQueue;
+
+// Replays pending samples of a series through its compaction rules, checking the ACLs of the
+// context's user when checkAcls. Provided by module.c.
+typedef void (*CompactionQueueApplyFunc)(RedisModuleCtx *ctx,
+                                         Series *series,
+                                         const Sample *samples,
+                                         size_t count,
+                                         bool checkAcls);
+
+void AsyncCompaction_Init(CompactionQueueApplyFunc apply);
+
+// Bracket a write command, whose writer is resolved once for all the samples it enqueues
+void AsyncCompaction_BeginWrite(void);
+void AsyncCompaction_EndWrite(void);
+
+// Queues a sample for the series' rules. Returns false when the series already reached
+// ts-compaction-async-max-lag pending samples; the caller should then drain it inline.
+bool AsyncCompaction_Enqueue(RedisModuleCtx *ctx,
+                             Series *series,
+                             timestamp_t timestamp,
+                             double value);
+
+// Applies the pending samples of a single series. ctx must have the series' db selected.
+void AsyncCompaction_FlushSeries(RedisModuleCtx *ctx, Series *series);
+
+// Applies the pending samples of every series. Used before persistence.
+void AsyncCompaction_FlushAll(RedisModuleCtx *ctx);
+
+// Holds back the pending samples of a series whose key is unlinked. A renamed or moved series is
+// relinked in its new db, a deleted one discards them when it is freed.
+void AsyncCompaction_Unlink(Series *series);
+void AsyncCompaction_Relink(Series *series, int dbId);
+
+void AsyncCompaction_SwapDb(int first, int second);
+
+// Drops the pending samples of the series of a db being flushed, every db for -1. Their
+// destinations are flushed with them.
+void AsyncCompaction_DropDb(int dbId);
+
+// Frees the queue of a series that is being freed, possibly by a lazyfree thread, and drops its
+// pending samples.
+void AsyncCompaction_Discard(Series *series);
+
+static inline bool AsyncCompaction_HasPending(const Series *series) {
+    return series->compactionQueue != NULL && series->compactionQueue->count > 0;
+}
+
+static inline size_t AsyncCompaction_Lag(const Series *series) {
+    return series->compactionQueue ? series->compactionQueue->count : 0;
+}
+
+size_t AsyncCompaction_MemUsage(const Series *series);
+
+#endif // ASYNC_COMPACTION_H
@@ -0,0 +1,317 @@
+/*
+ * Copyright (c) 2006-Present, Redis Ltd.
+ * All rights reserved.
+ *
+ * Licensed under your choice of (a) the Redis Source Available License 2.0
+ * (RSALv2); or (b) the Server Side Public License v1 (SSPLv1); or (c) the
+ * GNU Affero General Public License v3 (AGPLv3).
+ */
+#include "backfill.h"
+
+#include "consts.h"
+#include "enriched_chunk.h"
+#include "module.h"
+#include "query_language.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "rmutil/alloc.h"
+
+// Number of source samples aggregated while holding the GIL, rounded up to a bucket boundary
+#define BACKFILL_SLICE_SAMPLES 16384
+// Pause between slices so that clients get the GIL back
+#define BACKFILL_YIELD_US 1000
+// Finished jobs are kept for TS.BACKFILLSTATUS until this many accumulate
+#define BACKFILL_MAX_FINISHED_JOBS 64
+
+static BackfillWriteFunc writeFunc = NULL;
+
+// All jobs, in creation order. Only touched while holding the GIL.
+static BackfillJob **jobs = NULL;
+static size_t jobsCount = 0;
+static size_t jobsCapacity = 0;
+
+// Guarded by the GIL as well
+static bool workerRunning = false;
+
+void Backfill_Init(BackfillWriteFunc write) {
+    writeFunc = write;
+}
+
+const char *Backfill_StatusName(BackfillJobStatus status) {
+    switch (status) {
+        case BackfillJob_Running:
+            return "running";
+        case BackfillJob_Done:
+            return "done";
+        case BackfillJob_Aborted:
+            return "aborted";
+    }
+    return "unknown";
+}
+
+static void freeJob(BackfillJob *job) {
+    RedisModule_FreeString(NULL, job->srcKey);
+    RedisModule_FreeString(NULL, job->destKey);
+    free(job);
+}
+
+static void removeJobAt(size_t pos) {
+    freeJob(jobs[pos]);
+    memmove(&jobs[pos], &jobs[pos + 1], (jobsCount - pos - 1) * sizeof(*jobs));
+    --jobsCount;
+}
+
+static void pruneFinishedJobs(void) {
+    size_t finished = 0;
+    for (size_t i = 0; i < jobsCount; ++i) {
+        finished += jobs[i]->status != BackfillJob_Running;
+    }
+    // drop the oldest ones first
+    for (size_t i = 0; i < jobsCount && finished > BACKFILL_MAX_FINISHED_JOBS;) {
+        if (jobs[i]->status != BackfillJob_Running) {
+            removeJobAt(i);
+            --finished;
+        } else {
+            ++i;
+        }
+    }
+}
+
+static BackfillJob *findJob(int dbId, RedisModuleString *destKey, size_t *pos) {
+    for (size_t i = 0; i < jobsCount; ++i) {
+        if (jobs[i]->dbId == dbId && RedisModule_StringCompare(jobs[i]->destKey, destKey) == 0) {
+            if (pos) {
+                *pos = i;
+            }
+            return jobs[i];
+        }
+    }
+    return NULL;
+}
+
+static CompactionRule *findRule(Series *series, const BackfillJob *job) {
+    for (CompactionRule *rule = series->rules; rule != NULL; rule = rule->nextRule) {
+        if (RedisModule_StringCompare(rule->destKey, job->destKey) == 0) {
+            // a rule recreated with other parameters gets its own job
+            if (rule->aggType != job->aggType || rule->bucketDuration != job->bucketDuration ||
+                rule->timestampAlignment != job->timestampAlignment) {
+                return NULL;
+            }
+            return rule;
+        }
+    }
+    return NULL;
+}
+
+// Returns the end of the next slice: the end of the bucket holding the last sample of the chunk
+// that brings the samples after the cursor to BACKFILL_SLICE_SAMPLES, so that a bucket is never
+// split between two slices. The samples are counted from the chunks metadata, only the slice
+// itself is decoded, by runSlice.
+static timestamp_t sliceEnd(Series *series, const BackfillJob *job) {
+    timestamp_t rax_key;
+    seriesEncodeTimestamp(&rax_key, job->cursor);
+    // the first chunk is keyed 0, so the seek always finds the chunk holding the cursor
+    RedisModuleDictIter *iter =
+        RedisModule_DictIteratorStartC(series->chunks, "<=", &rax_key, sizeof(rax_key));
+
+    timestamp_t last = job->endTimestamp;
+    uint64_t total = 0;
+    Chunk_t *chunk;
+    while (RedisModule_DictNextC(iter, NULL, (void **)&chunk)) {
+        if (series->funcs->GetFirstTimestamp(chunk) > job->endTimestamp) {
+            break;
+        }
+        if (series->funcs->GetLastTimestamp(chunk) < job->cursor) {
+            continue;
+        }
+        // the chunk holding the cursor is counted whole, making the slice at most a chunk shorter
+        total += series->funcs->GetNumOfSample(chunk);
+        if (total >= BACKFILL_SLICE_SAMPLES) {
+            last = series->funcs->GetLastTimestamp(chunk);
+            break;
+        }
+    }
+    RedisModule_DictIteratorStop(iter);
+
+    if (last >= job->endTimestamp) {
+        return job->endTimestamp;
+    }
+    const timestamp_t bucketEnd =
+        CalcBucketStart(last, job->bucketDuration, job->timestampAlignment) +
+        job->bucketDuration - 1;
+    return min(bucketEnd, job->endTimestamp);
+}
+
+// Runs one slice of a job. Called while holding the GIL, with the job's db selected.
+static void runSlice(RedisModuleCtx *ctx, BackfillJob *job) {
+    Series *src;
+    RedisModuleKey *srcKey;
+    if (GetSeries(
+            ctx, job->srcKey, &srcKey, &src, REDISMODULE_READ, GetSeriesFlags_SilentOperation) !=
+        GetSeriesResult_Success) {
+        job->status = BackfillJob_Aborted;
+        return;
+    }
+
+    CompactionRule *rule = findRule(src, job);
+    if (rule == NULL) {
+        RedisModule_CloseKey(srcKey);
+        job->status = BackfillJob_Aborted;
+        return;
+    }
+
+    const timestamp_t end = sliceEnd(src, job);
+    RangeArgs args = { 0 };
+    args.startTimestamp = job->cursor;
+    args.endTimestamp = end;
+    args.alignment = TimestampAlignment;
+    args.timestampAlignment = job->timestampAlignment;
+    args.aggregationArgs.timeDelta = job->bucketDuration;
+    args.aggregationArgs.bucketTS = BucketStartTimestamp;
+    args.aggregationArgs.numClasses = 1;
+    args.aggregationArgs.classes = &rule->aggClass;
+
+    Sample *samples = NULL;
+    size_t count = 0, capacity = 0;
+    AbstractIterator *iter = SeriesQuery(src, &args, false, true);
+    EnrichedChunk *chunk;
+    while ((chunk = iter->GetNext(iter))) {
+        const size_t n = chunk->samples.num_samples;
+        if (count + n > capacity) {
+            capacity = max(capacity * 2, count + n);
+            samples = realloc(samples, capacity * sizeof(Sample));
+        }
+        for (size_t i = 0; i < n; ++i) {
+            samples[count++] = (Sample){ .timestamp = chunk->samples.timestamps[i],
+                                         .value = Samples_value_at(&chunk->samples, i, 0) };
+        }
+    }
+    iter->Close(iter);
+    RedisModule_CloseKey(srcKey);
+
+    if (count > 0) {
+        Series *dest;
+        RedisModuleKey *destKey;
+        if (GetSeries(ctx,
+                      job->destKey,
+                      &destKey,
+                      &dest,
+                      REDISMODULE_READ | REDISMODULE_WRITE,
+                      GetSeriesFlags_SilentOperation) != GetSeriesResult_Success) {
+            free(samples);
+            job->status = BackfillJob_Aborted;
+            return;
+        }
+        writeFunc(ctx, job->destKey, dest, samples, count);
+        RedisModule_CloseKey(destKey);
+        job->bucketsWritten += count;
+    }
+    free(samples);
+
+    if (end >= job->endTimestamp) {
+        job->status = BackfillJob_Done;
+        // the buckets before the rule was created are whole as well
+        const timestamp_t first =
+            CalcBucketStart(job->startTimestamp, job->bucketDuration, job->timestampAlignment);
+        rule->watermark = min(rule->watermark, BucketStartNormalize(first));
+    } else {
+        job->cursor = end + 1;
+    }
+}
+
+static void *Backfill_WorkerMain(void *arg) {
+    RedisModuleCtx *ctx = RedisModule_GetThreadSafeContext(NULL);
+    const struct timespec yield = { .tv_sec = 0, .tv_nsec = BACKFILL_YIELD_US * 1000L };
+    size_t next = 0;
+
+    while (true) {
+        RedisModule_ThreadSafeContextLock(ctx);
+
+        // round robin over the running jobs, one slice each
+        BackfillJob *job = NULL;
+        for (size_t i = 0; i < jobsCount; ++i) {
+            BackfillJob *candidate = jobs[(next + i) % jobsCount];
+            if (candidate->status == BackfillJob_Running) {
+                job = candidate;
+                next = (next + i + 1) % jobsCount;
+                break;
+            }
+        }
+        if (job == NULL) {
+            workerRunning = false;
+            RedisModule_ThreadSafeContextUnlock(ctx);
+            break;
+        }
+
+        if (RedisModule_GetSelectedDb(ctx) != job->dbId) {
+            RedisModule_SelectDb(ctx, job->dbId);
+        }
+        runSlice(ctx, job);
+        RedisModule_ThreadSafeContextUnlock(ctx);
+
+        nanosleep(&yield, NULL);
+    }
+
+    RedisModule_FreeThreadSafeContext(ctx);
+    return NULL;
+}
+
+static void startWorkerIfNeeded(void) {
+    if (workerRunning) {
+        return;
+    }
+
+    pthread_attr_t attr;
+    pthread_t thread;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&thread, &attr, Backfill_WorkerMain, NULL) == 0) {
+        workerRunning = true;
+    } else {
+        RedisModule_Log(rts_staticCtx, "warning", "Failed to start the backfill worker");
+    }
+    pthread_attr_destroy(&attr);
+}
+
+void Backfill_Start(RedisModuleCtx *ctx,
+                    RedisModuleString *srcKey,
+                    const CompactionRule *rule,
+                    timestamp_t start,
+                    timestamp_t end) {
+    const int dbId = RedisModule_GetSelectedDb(ctx);
+    size_t pos;
+    if (findJob(dbId, rule->destKey, &pos) != NULL) {
+        removeJobAt(pos);
+    }
+
+    BackfillJob *job = calloc(1, sizeof(*job));
+    job->srcKey = RedisModule_CreateStringFromString(NULL, srcKey);
+    job->destKey = RedisModule_CreateStringFromString(NULL, rule->destKey);
+    job->dbId = dbId;
+    job->aggType = rule->aggType;
+    job->bucketDuration = rule->bucketDuration;
+    job->timestampAlignment = rule->timestampAlignment;
+    job->startTimestamp = start;
+    job->endTimestamp = end;
+    job->cursor = start;
+    job->status = BackfillJob_Running;
+
+    if (jobsCount == jobsCapacity) {
+        jobsCapacity = jobsCapacity ? jobsCapacity * 2 : 16;
+        jobs = realloc(jobs, jobsCapacity * sizeof(*jobs));
+    }
+    jobs[jobsCount++] = job;
+    pruneFinishedJobs();
+
+    startWorkerIfNeeded();
+    if (!workerRunning) {
+        job->status = BackfillJob_Aborted;
+    }
+}
+
+const BackfillJob *Backfill_GetJob(RedisModuleCtx *ctx, RedisModuleString *destKey) {
+    return findJob(RedisModule_GetSelectedDb(ctx), destKey, NULL);
+}
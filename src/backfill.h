@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2006-Present, Redis Ltd.
+ * All rights reserved.
+ *
+ * Licensed under your choice of (a) the Redis Source Available License 2.0
+ * (RSALv2); or (b) the Server Side Public License v1 (SSPLv1); or (c) the
+ * GNU Affero General Public License v3 (AGPLv3).
+ */
+#ifndef BACKFILL_H
+#define BACKFILL_H
+
+#include "generic_chunk.h"
+#include "tsdb.h"
+
+#include "RedisModulesSDK/redismodule.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Background backfill of a compaction rule (TS.CREATERULE ... BACKFILL).
+ *
+ * A rule only aggregates samples that arrive after it was created. A backfill job aggregates
+ * the closed buckets that already existed in the source when the rule was created and writes
+ * them into the destination. A single module worker thread runs the jobs: for each slice it
+ * takes the GIL, reopens the keys by name, aggregates one slice of the source with SeriesQuery
+ * and writes the resulting buckets, then releases the GIL before the next slice.
+ *
+ * Jobs are in-memory only; a restart (or a failover) stops them.
+ */
+typedef enum BackfillJobStatus
+{
+    BackfillJob_Running = 0,
+    BackfillJob_Done,
+    BackfillJob_Aborted,
+} BackfillJobStatus;
+
+typedef struct BackfillJob
+{
+    RedisModuleString *srcKey;
+    RedisModuleString *destKey;
+    int dbId;
+    TS_AGG_TYPES_T aggType;
+    timestamp_t bucketDuration;
+    timestamp_t timestampAlignment;
+    timestamp_t startTimestamp; // first source timestamp to aggregate
+    timestamp_t endTimestamp;   // last source timestamp to aggregate (end of a closed bucket)
+    timestamp_t cursor;         // next source timestamp to aggregate
+    long long bucketsWritten;
+    BackfillJobStatus status;
+} BackfillJob;
+
+// Writes aggregated buckets into the destination of a job. Provided by module.c.
+typedef void (*BackfillWriteFunc)(RedisModuleCtx *ctx,
+                                  RedisModuleString *destKey,
+                                  Series *dest,
+                                  const Sample *samples,
+                                  size_t count);
+
+void Backfill_Init(BackfillWriteFunc write);
+
+// Schedules a job aggregating [start, end] of the source into the rule's destination. A job of a
+// previous rule with the same destination is dropped. Must be called while holding the GIL.
+void Backfill_Start(RedisModuleCtx *ctx,
+                    RedisModuleString *srcKey,
+                    const CompactionRule *rule,
+                    timestamp_t start,
+                    timestamp_t end);
+
+// Returns the latest job writing into destKey in the selected db, or NULL.
+const BackfillJob *Backfill_GetJob(RedisModuleCtx *ctx, RedisModuleString *destKey);
+
+const char *Backfill_StatusName(BackfillJobStatus status);
+
+#endif // BACKFILL_H
@@ -19,6 +19,7 @@ Chunk_t *Uncompressed_NewChunk(size_t size) {
     newChunk->base_timestamp = 0;
     newChunk->num_samples = 0;
     newChunk->size = size;
+    newChunk->refCount = 1;
     newChunk->samples = (Sample *)malloc(size);
 #ifdef DEBUG
     memset(newChunk->samples, 0, size);
@@ -28,6 +29,9 @@ Chunk_t *Uncompressed_NewChunk(size_t size) {
 }
 
 void Uncompressed_FreeChunk(Chunk_t *chunk) {
+    if (__atomic_sub_fetch(&((Chunk *)chunk)->refCount, 1, __ATOMIC_ACQ_REL) > 0) {
+        return;
+    }
     if (((Chunk *)chunk)->samples) {
         free(((Chunk *)chunk)->samples);
     }
@@ -70,15 +74,43 @@ Chunk_t *Uncompressed_CloneChunk(const Chunk_t *src) {
     memcpy(dst, _src, sizeof(Chunk));
     dst->samples = (Sample *)malloc(dst->size);
     memcpy(dst->samples, _src->samples, dst->size);
+    dst->refCount = 1;
     return dst;
 }
 
+Chunk_t *Uncompressed_RetainChunk(Chunk_t *chunk) {
+    __atomic_add_fetch(&((Chunk *)chunk)->refCount, 1, __ATOMIC_RELAXED);
+    return chunk;
+}
+
+bool Uncompressed_IsChunkShared(const Chunk_t *chunk) {
+    return __atomic_load_n(&((const Chunk *)chunk)->refCount, __ATOMIC_ACQUIRE) > 1;
+}
+
+void Uncompressed_ResizeChunk(Chunk_t *chunk, size_t newSize) {
+    Chunk *regChunk = (Chunk *)chunk;
+    const size_t used = regChunk->num_samples * SAMPLE_SIZE;
+    if (newSize <= regChunk->size) {
+        newSize = used;
+    }
+    if (newSize == 0 || newSize == regChunk->size) {
+        return;
+    }
+
+    regChunk->samples = realloc(regChunk->samples, newSize);
+    regChunk->size = newSize;
+}
+
 int Uncompressed_DefragChunk(RedisModuleDefragCtx *ctx,
                              void *data,
                              __unused unsigned char *key,
                              __unused size_t keylen,
                              void **newptr) {
     Chunk *chunk = (Chunk *)data;
+    if (Uncompressed_IsChunkShared(chunk)) { // a snapshot still points to it
+        *newptr = data;
+        return DefragStatus_Finished;
+    }
     chunk = defragPtr(ctx, chunk);
     chunk->samples = defragPtr(ctx, chunk->samples);
     *newptr = (void *)chunk;
@@ -342,6 +374,7 @@ int Uncompressed_LoadFromRDB(Chunk_t **chunk, struct RedisModuleIO *io) {
     }
     errdefer(err, Uncompressed_FreeChunk(uncompchunk));
 
+    uncompchunk->refCount = 1;
     uncompchunk->base_timestamp = LoadUnsigned_IOError(io, err, TSDB_ERROR);
     uncompchunk->num_samples = LoadUnsigned_IOError(io, err, TSDB_ERROR);
     uncompchunk->size = LoadUnsigned_IOError(io, err, TSDB_ERROR);
@@ -370,6 +403,7 @@ void Uncompressed_MRSerialize(Chunk_t *chunk, WriteSerializationCtx *sctx) {
 
 int Uncompressed_MRDeserialize(Chunk_t **chunk, ReaderSerializationCtx *sctx) {
     Chunk *uncompchunk = (Chunk *)calloc(1, sizeof(*uncompchunk));
+    uncompchunk->refCount = 1;
 
     uncompchunk->base_timestamp = MR_SerializationCtxReadLongLongWrapper(sctx);
     uncompchunk->num_samples = MR_SerializationCtxReadLongLongWrapper(sctx);
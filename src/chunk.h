@@ -20,6 +20,7 @@ typedef struct Chunk
     Sample *samples;
     unsigned int num_samples;
     size_t size;
+    uint32_t refCount; // the series and the snapshots sharing the chunk, see RetainChunk
 } Chunk;
 
 Chunk_t *Uncompressed_NewChunk(size_t size);
@@ -32,6 +33,9 @@ void Uncompressed_FreeChunk(Chunk_t *chunk);
  */
 Chunk_t *Uncompressed_SplitChunk(Chunk_t *chunk);
 Chunk_t *Uncompressed_CloneChunk(const Chunk_t *src);
+Chunk_t *Uncompressed_RetainChunk(Chunk_t *chunk);
+bool Uncompressed_IsChunkShared(const Chunk_t *chunk);
+void Uncompressed_ResizeChunk(Chunk_t *chunk, size_t newSize);
 int Uncompressed_DefragChunk(RedisModuleDefragCtx *ctx,
                              void *data,
                              unsigned char *key,
@@ -32,6 +32,14 @@ static const RedisModuleCommandArg AGGREGATOR_OPTIONS[] = {
     { .name = "twa", .type = REDISMODULE_ARG_TYPE_PURE_TOKEN, .token = "twa" },
     { .name = "countnan", .type = REDISMODULE_ARG_TYPE_PURE_TOKEN, .token = "countnan" },
     { .name = "countall", .type = REDISMODULE_ARG_TYPE_PURE_TOKEN, .token = "countall" },
+    { .name = "p50", .type = REDISMODULE_ARG_TYPE_PURE_TOKEN, .token = "p50" },
+    { .name = "p90", .type = REDISMODULE_ARG_TYPE_PURE_TOKEN, .token = "p90" },
+    { .name = "p95", .type = REDISMODULE_ARG_TYPE_PURE_TOKEN, .token = "p95" },
+    { .name = "p99", .type = REDISMODULE_ARG_TYPE_PURE_TOKEN, .token = "p99" },
+    { .name = "p999", .type = REDISMODULE_ARG_TYPE_PURE_TOKEN, .token = "p999" },
+    { .name = "rate", .type = REDISMODULE_ARG_TYPE_PURE_TOKEN, .token = "rate" },
+    { .name = "increase", .type = REDISMODULE_ARG_TYPE_PURE_TOKEN, .token = "increase" },
+    { .name = "irate", .type = REDISMODULE_ARG_TYPE_PURE_TOKEN, .token = "irate" },
     { 0 }
 };
 
@@ -42,6 +50,13 @@ static const RedisModuleCommandArg ENCODING_OPTIONS[] = {
     { 0 }
 };
 
+// Shared chunk size options
+static const RedisModuleCommandArg CHUNK_SIZE_OPTIONS[] = {
+    { .name = "bytes", .type = REDISMODULE_ARG_TYPE_INTEGER },
+    { .name = "AUTO", .type = REDISMODULE_ARG_TYPE_PURE_TOKEN, .token = "AUTO" },
+    { 0 }
+};
+
 // Shared bucket timestamp options
 static const RedisModuleCommandArg BUCKETTIMESTAMP_OPTIONS[] = {
     { .name = "start", .type = REDISMODULE_ARG_TYPE_PURE_TOKEN, .token = "start" },
@@ -53,6 +68,21 @@ static const RedisModuleCommandArg BUCKETTIMESTAMP_OPTIONS[] = {
     { 0 }
 };
 
+static const RedisModuleCommandArg FORMAT_OPTIONS[] = {
+    { .name = "resp", .type = REDISMODULE_ARG_TYPE_PURE_TOKEN, .token = "RESP" },
+    { .name = "binary", .type = REDISMODULE_ARG_TYPE_PURE_TOKEN, .token = "BINARY" },
+    { 0 }
+};
+
+static const RedisModuleCommandArg WINDOW_OPTIONS[] = {
+    { .name = "sma", .type = REDISMODULE_ARG_TYPE_PURE_TOKEN, .token = "sma" },
+    { .name = "ewma", .type = REDISMODULE_ARG_TYPE_PURE_TOKEN, .token = "ewma" },
+    { .name = "std", .type = REDISMODULE_ARG_TYPE_PURE_TOKEN, .token = "std" },
+    { .name = "min", .type = REDISMODULE_ARG_TYPE_PURE_TOKEN, .token = "min" },
+    { .name = "max", .type = REDISMODULE_ARG_TYPE_PURE_TOKEN, .token = "max" },
+    { 0 }
+};
+
 // ===============================
 // TS.ADD key timestamp value [options...]
 // ===============================
@@ -92,7 +122,10 @@ static const RedisModuleCommandArg TS_ADD_ARGS[] = {
       .flags = REDISMODULE_CMD_ARG_OPTIONAL,
       .subargs =
           (RedisModuleCommandArg[]){
-              { .name = "size", .type = REDISMODULE_ARG_TYPE_INTEGER, .token = "CHUNK_SIZE" },
+              { .name = "size",
+                .type = REDISMODULE_ARG_TYPE_ONEOF,
+                .token = "CHUNK_SIZE",
+                .subargs = (RedisModuleCommandArg *)CHUNK_SIZE_OPTIONS },
               { 0 } } },
     { .name = "DUPLICATE_POLICY",
       .type = REDISMODULE_ARG_TYPE_BLOCK,
@@ -211,7 +244,9 @@ static const RedisModuleCommandArg TS_INCRBY_ARGS[] = {
           (RedisModuleCommandArg[]){ { .name = "chunk_size_token",
                                        .type = REDISMODULE_ARG_TYPE_PURE_TOKEN,
                                        .token = "CHUNK_SIZE" },
-                                     { .name = "size", .type = REDISMODULE_ARG_TYPE_INTEGER },
+                                     { .name = "size",
+                                       .type = REDISMODULE_ARG_TYPE_ONEOF,
+                                       .subargs = (RedisModuleCommandArg *)CHUNK_SIZE_OPTIONS },
                                      { 0 } } },
     { .name = "duplicate_policy_block",
       .type = REDISMODULE_ARG_TYPE_BLOCK,
@@ -331,7 +366,9 @@ static const RedisModuleCommandArg TS_DECRBY_ARGS[] = {
           (RedisModuleCommandArg[]){ { .name = "chunk_size_token",
                                        .type = REDISMODULE_ARG_TYPE_PURE_TOKEN,
                                        .token = "CHUNK_SIZE" },
-                                     { .name = "size", .type = REDISMODULE_ARG_TYPE_INTEGER },
+                                     { .name = "size",
+                                       .type = REDISMODULE_ARG_TYPE_ONEOF,
+                                       .subargs = (RedisModuleCommandArg *)CHUNK_SIZE_OPTIONS },
                                      { 0 } } },
     { .name = "duplicate_policy_block",
       .type = REDISMODULE_ARG_TYPE_BLOCK,
@@ -411,7 +448,10 @@ static const RedisModuleCommandArg TS_ALTER_ARGS[] = {
       .flags = REDISMODULE_CMD_ARG_OPTIONAL,
       .subargs =
           (RedisModuleCommandArg[]){
-              { .name = "size", .type = REDISMODULE_ARG_TYPE_INTEGER, .token = "CHUNK_SIZE" },
+              { .name = "size",
+                .type = REDISMODULE_ARG_TYPE_ONEOF,
+                .token = "CHUNK_SIZE",
+                .subargs = (RedisModuleCommandArg *)CHUNK_SIZE_OPTIONS },
               { 0 } } },
     { .name = "DUPLICATE_POLICY",
       .type = REDISMODULE_ARG_TYPE_BLOCK,
@@ -514,7 +554,10 @@ static const RedisModuleCommandArg TS_CREATE_ARGS[] = {
       .flags = REDISMODULE_CMD_ARG_OPTIONAL,
       .subargs =
           (RedisModuleCommandArg[]){
-              { .name = "size", .type = REDISMODULE_ARG_TYPE_INTEGER, .token = "CHUNK_SIZE" },
+              { .name = "size",
+                .type = REDISMODULE_ARG_TYPE_ONEOF,
+                .token = "CHUNK_SIZE",
+                .subargs = (RedisModuleCommandArg *)CHUNK_SIZE_OPTIONS },
               { 0 } } },
     { .name = "DUPLICATE_POLICY",
       .type = REDISMODULE_ARG_TYPE_BLOCK,
@@ -581,6 +624,7 @@ static const RedisModuleCommandInfo TS_CREATE_INFO = {
 
 // ===============================
 // TS.CREATERULE sourceKey destKey AGGREGATION aggregator bucketDuration [alignTimestamp]
+// [BACKFILL]
 // ===============================
 static const RedisModuleCommandKeySpec TS_CREATERULE_KEYSPECS[] = {
     { .notes = "Source time series key",
@@ -616,17 +660,21 @@ static const RedisModuleCommandArg TS_CREATERULE_ARGS[] = {
     { .name = "alignTimestamp",
       .type = REDISMODULE_ARG_TYPE_INTEGER,
       .flags = REDISMODULE_CMD_ARG_OPTIONAL },
+    { .name = "BACKFILL",
+      .type = REDISMODULE_ARG_TYPE_PURE_TOKEN,
+      .flags = REDISMODULE_CMD_ARG_OPTIONAL,
+      .token = "BACKFILL" },
     { 0 }
 };
 
 static const RedisModuleCommandInfo TS_CREATERULE_INFO = {
     .version = REDISMODULE_COMMAND_INFO_VERSION,
     .summary = "Create a compaction rule",
-    .complexity = "O(1)",
+    .complexity = "O(1), or O(N) with BACKFILL where N is the number of samples in the source series",
     .since = "1.0.0",
     // TS.CREATERULE sourceKey destKey AGGREGATION aggregator bucketDuration
-    // [alignTimestamp] -- 6 tokens minimum, matching the argc != 6 && argc != 7
-    // check in TSDB_createRule
+    // [alignTimestamp] [BACKFILL] -- 6 tokens minimum, matching the argc != 6 && argc != 7
+    // check in TSDB_createRule (after BACKFILL is stripped)
     .arity = -6,
     .key_specs = (RedisModuleCommandKeySpec *)TS_CREATERULE_KEYSPECS,
     .args = (RedisModuleCommandArg *)TS_CREATERULE_ARGS,
@@ -694,6 +742,111 @@ static const RedisModuleCommandInfo TS_DELETERULE_INFO = {
     .args = (RedisModuleCommandArg *)TS_DELETERULE_ARGS,
 };
 
+// ===============================
+// TS.BACKFILLSTATUS destKey
+// ===============================
+static const RedisModuleCommandKeySpec TS_BACKFILLSTATUS_KEYSPECS[] = {
+    { .flags = REDISMODULE_CMD_KEY_RO,
+      .begin_search_type = REDISMODULE_KSPEC_BS_INDEX,
+      .bs.index = { .pos = 1 },
+      .find_keys_type = REDISMODULE_KSPEC_FK_RANGE,
+      .fk.range = { .lastkey = 0, .keystep = 1, .limit = 0 } },
+    { 0 }
+};
+
+static const RedisModuleCommandArg TS_BACKFILLSTATUS_ARGS[] = {
+    { .name = "destKey", .type = REDISMODULE_ARG_TYPE_KEY, .key_spec_index = 0 },
+    { 0 }
+};
+
+static const RedisModuleCommandInfo TS_BACKFILLSTATUS_INFO = {
+    .version = REDISMODULE_COMMAND_INFO_VERSION,
+    .summary = "Report the progress of the backfill job started by TS.CREATERULE BACKFILL",
+    .complexity = "O(n) where n is the number of backfill jobs",
+    .since = "8.10.0",
+    .tips = "dont_cache",
+    .arity = 2,
+    .key_specs = (RedisModuleCommandKeySpec *)TS_BACKFILLSTATUS_KEYSPECS,
+    .args = (RedisModuleCommandArg *)TS_BACKFILLSTATUS_ARGS,
+};
+
+// ===============================
+// TS.WCREATE key FIELDS numfields field [field ...]
+//  [RETENTION retentionPeriod]
+//  [CHUNK_SIZE size]
+// ===============================
+static const RedisModuleCommandKeySpec TS_WCREATE_KEYSPECS[] = {
+    { .notes = "",
+      .flags = REDISMODULE_CMD_KEY_RW | REDISMODULE_CMD_KEY_INSERT,
+      .begin_search_type = REDISMODULE_KSPEC_BS_INDEX,
+      .bs.index = { .pos = 1 },
+      .find_keys_type = REDISMODULE_KSPEC_FK_RANGE,
+      .fk.range = { .lastkey = 0, .keystep = 1, .limit = 0 } },
+    { 0 }
+};
+
+static const RedisModuleCommandArg TS_WCREATE_ARGS[] = {
+    { .name = "key", .type = REDISMODULE_ARG_TYPE_KEY, .key_spec_index = 0 },
+    { .name = "numfields", .type = REDISMODULE_ARG_TYPE_INTEGER, .token = "FIELDS" },
+    { .name = "field", .type = REDISMODULE_ARG_TYPE_STRING, .flags = REDISMODULE_CMD_ARG_MULTIPLE },
+    { .name = "RETENTION",
+      .type = REDISMODULE_ARG_TYPE_BLOCK,
+      .flags = REDISMODULE_CMD_ARG_OPTIONAL,
+      .subargs = (RedisModuleCommandArg[]){ { .name = "retentionPeriod",
+                                              .type = REDISMODULE_ARG_TYPE_INTEGER,
+                                              .token = "RETENTION" },
+                                            { 0 } } },
+    { .name = "CHUNK_SIZE",
+      .type = REDISMODULE_ARG_TYPE_BLOCK,
+      .flags = REDISMODULE_CMD_ARG_OPTIONAL,
+      .subargs =
+          (RedisModuleCommandArg[]){
+              { .name = "size", .type = REDISMODULE_ARG_TYPE_INTEGER, .token = "CHUNK_SIZE" },
+              { 0 } } },
+    { 0 }
+};
+
+static const RedisModuleCommandInfo TS_WCREATE_INFO = {
+    .version = REDISMODULE_COMMAND_INFO_VERSION,
+    .summary =
+        "Create a new wide time series, holding several fields sampled at the same timestamps",
+    .complexity = "O(n) where n is the number of fields",
+    .since = "8.10.0",
+    .arity = -5,
+    .key_specs = (RedisModuleCommandKeySpec *)TS_WCREATE_KEYSPECS,
+    .args = (RedisModuleCommandArg *)TS_WCREATE_ARGS,
+};
+
+// ===============================
+// TS.WADD key timestamp value [value ...]
+// ===============================
+static const RedisModuleCommandKeySpec TS_WADD_KEYSPECS[] = {
+    { .notes = "",
+      .flags = REDISMODULE_CMD_KEY_RW | REDISMODULE_CMD_KEY_INSERT,
+      .begin_search_type = REDISMODULE_KSPEC_BS_INDEX,
+      .bs.index = { .pos = 1 },
+      .find_keys_type = REDISMODULE_KSPEC_FK_RANGE,
+      .fk.range = { .lastkey = 0, .keystep = 1, .limit = 0 } },
+    { 0 }
+};
+
+static const RedisModuleCommandArg TS_WADD_ARGS[] = {
+    { .name = "key", .type = REDISMODULE_ARG_TYPE_KEY, .key_spec_index = 0 },
+    { .name = "timestamp", .type = REDISMODULE_ARG_TYPE_STRING },
+    { .name = "value", .type = REDISMODULE_ARG_TYPE_DOUBLE, .flags = REDISMODULE_CMD_ARG_MULTIPLE },
+    { 0 }
+};
+
+static const RedisModuleCommandInfo TS_WADD_INFO = {
+    .version = REDISMODULE_COMMAND_INFO_VERSION,
+    .summary = "Append a row of values, one per field, to a wide time series",
+    .complexity = "O(n) where n is the number of fields",
+    .since = "8.10.0",
+    .arity = -4,
+    .key_specs = (RedisModuleCommandKeySpec *)TS_WADD_KEYSPECS,
+    .args = (RedisModuleCommandArg *)TS_WADD_ARGS,
+};
+
 // ===============================
 // TS.GET key [LATEST]
 // ===============================
@@ -773,11 +926,14 @@ static const RedisModuleCommandInfo TS_READ_INFO = {
 
 // ===============================
 // TS.REVRANGE key fromTimestamp toTimestamp
+//  [FIELD field]
 //  [LATEST]
 //  [FILTER_BY_TS ts...]
 //  [FILTER_BY_VALUE min max]
 //  [COUNT count]
 //  [[ALIGN align] AGGREGATION aggregator bucketDuration [BUCKETTIMESTAMP bt] [EMPTY]]
+//  [FORMAT RESP | BINARY]
+//  [WINDOW sma | std | min | max size | WINDOW ewma alpha]
 // ===============================
 static const RedisModuleCommandKeySpec TS_REVRANGE_KEYSPECS[] = {
     { .flags = REDISMODULE_CMD_KEY_RO,
@@ -794,6 +950,10 @@ static const RedisModuleCommandArg TS_REVRANGE_ARGS[] = {
       .type = REDISMODULE_ARG_TYPE_STRING }, // Actually an int, but we also allow '-'
     { .name = "toTimestamp",
       .type = REDISMODULE_ARG_TYPE_STRING }, // Actually an int, but we also allow '+'
+    { .name = "field",
+      .type = REDISMODULE_ARG_TYPE_STRING,
+      .flags = REDISMODULE_CMD_ARG_OPTIONAL,
+      .token = "FIELD" },
     { .name = "latest",
       .type = REDISMODULE_ARG_TYPE_PURE_TOKEN,
       .flags = REDISMODULE_CMD_ARG_OPTIONAL,
@@ -860,6 +1020,22 @@ static const RedisModuleCommandArg TS_REVRANGE_ARGS[] = {
                 .flags = REDISMODULE_CMD_ARG_OPTIONAL,
                 .token = "EMPTY" },
               { 0 } } },
+    { .name = "format",
+      .type = REDISMODULE_ARG_TYPE_ONEOF,
+      .flags = REDISMODULE_CMD_ARG_OPTIONAL,
+      .token = "FORMAT",
+      .subargs = (RedisModuleCommandArg *)FORMAT_OPTIONS },
+    { .name = "window",
+      .type = REDISMODULE_ARG_TYPE_BLOCK,
+      .flags = REDISMODULE_CMD_ARG_OPTIONAL,
+      .subargs =
+          (RedisModuleCommandArg[]){
+              { .name = "window", .type = REDISMODULE_ARG_TYPE_PURE_TOKEN, .token = "WINDOW" },
+              { .name = "function",
+                .type = REDISMODULE_ARG_TYPE_ONEOF,
+                .subargs = (RedisModuleCommandArg *)WINDOW_OPTIONS },
+              { .name = "sizeOrAlpha", .type = REDISMODULE_ARG_TYPE_DOUBLE },
+              { 0 } } },
     { 0 }
 };
 
@@ -876,11 +1052,14 @@ static const RedisModuleCommandInfo TS_REVRANGE_INFO = {
 
 // ===============================
 // TS.RANGE key fromTimestamp toTimestamp
+//  [FIELD field]
 //  [LATEST]
 //  [FILTER_BY_TS ts...]
 //  [FILTER_BY_VALUE min max]
 //  [COUNT count]
 //  [[ALIGN align] AGGREGATION aggregator bucketDuration [BUCKETTIMESTAMP bt] [EMPTY]]
+//  [FORMAT RESP | BINARY]
+//  [WINDOW sma | std | min | max size | WINDOW ewma alpha]
 // ===============================
 static const RedisModuleCommandKeySpec TS_RANGE_KEYSPECS[] = {
     { .flags = REDISMODULE_CMD_KEY_RO,
@@ -897,6 +1076,10 @@ static const RedisModuleCommandArg TS_RANGE_ARGS[] = {
       .type = REDISMODULE_ARG_TYPE_STRING }, // Actually an int, but we also allow '-'
     { .name = "toTimestamp",
       .type = REDISMODULE_ARG_TYPE_STRING }, // Actually an int, but we also allow '+'
+    { .name = "field",
+      .type = REDISMODULE_ARG_TYPE_STRING,
+      .flags = REDISMODULE_CMD_ARG_OPTIONAL,
+      .token = "FIELD" },
     { .name = "latest",
       .type = REDISMODULE_ARG_TYPE_PURE_TOKEN,
       .flags = REDISMODULE_CMD_ARG_OPTIONAL,
@@ -963,6 +1146,22 @@ static const RedisModuleCommandArg TS_RANGE_ARGS[] = {
                 .flags = REDISMODULE_CMD_ARG_OPTIONAL,
                 .token = "EMPTY" },
               { 0 } } },
+    { .name = "format",
+      .type = REDISMODULE_ARG_TYPE_ONEOF,
+      .flags = REDISMODULE_CMD_ARG_OPTIONAL,
+      .token = "FORMAT",
+      .subargs = (RedisModuleCommandArg *)FORMAT_OPTIONS },
+    { .name = "window",
+      .type = REDISMODULE_ARG_TYPE_BLOCK,
+      .flags = REDISMODULE_CMD_ARG_OPTIONAL,
+      .subargs =
+          (RedisModuleCommandArg[]){
+              { .name = "window", .type = REDISMODULE_ARG_TYPE_PURE_TOKEN, .token = "WINDOW" },
+              { .name = "function",
+                .type = REDISMODULE_ARG_TYPE_ONEOF,
+                .subargs = (RedisModuleCommandArg *)WINDOW_OPTIONS },
+              { .name = "sizeOrAlpha", .type = REDISMODULE_ARG_TYPE_DOUBLE },
+              { 0 } } },
     { 0 }
 };
 
@@ -985,6 +1184,7 @@ static const RedisModuleCommandInfo TS_RANGE_INFO = {
 //  [COUNT count]
 //  [[ALIGN align] AGGREGATION aggregator[,aggregator...] bucketDuration [BUCKETTIMESTAMP bt]
 //  [EMPTY]]
+//  [EXPR expression]
 // ===============================
 static const RedisModuleCommandKeySpec TS_NREVRANGE_KEYSPECS[] = {
     { .flags = REDISMODULE_CMD_KEY_RO | REDISMODULE_CMD_KEY_ACCESS,
@@ -1071,6 +1271,10 @@ static const RedisModuleCommandArg TS_NREVRANGE_ARGS[] = {
                 .flags = REDISMODULE_CMD_ARG_OPTIONAL,
                 .token = "EMPTY" },
               { 0 } } },
+    { .name = "expr",
+      .type = REDISMODULE_ARG_TYPE_STRING,
+      .flags = REDISMODULE_CMD_ARG_OPTIONAL,
+      .token = "EXPR" },
     { 0 }
 };
 
@@ -1094,6 +1298,7 @@ static const RedisModuleCommandInfo TS_NREVRANGE_INFO = {
 //  [COUNT count]
 //  [[ALIGN align] AGGREGATION aggregator[,aggregator...] bucketDuration [BUCKETTIMESTAMP bt]
 //  [EMPTY]]
+//  [EXPR expression]
 // ===============================
 static const RedisModuleCommandKeySpec TS_NRANGE_KEYSPECS[] = {
     { .flags = REDISMODULE_CMD_KEY_RO | REDISMODULE_CMD_KEY_ACCESS,
@@ -1180,6 +1385,10 @@ static const RedisModuleCommandArg TS_NRANGE_ARGS[] = {
                 .flags = REDISMODULE_CMD_ARG_OPTIONAL,
                 .token = "EMPTY" },
               { 0 } } },
+    { .name = "expr",
+      .type = REDISMODULE_ARG_TYPE_STRING,
+      .flags = REDISMODULE_CMD_ARG_OPTIONAL,
+      .token = "EXPR" },
     { 0 }
 };
 
@@ -1483,6 +1692,26 @@ static const RedisModuleCommandArg TS_MRANGE_ARGS[] = {
                           .token = "EMPTY" },
                         { 0 } } },
               { 0 } } },
+    { .name = "format",
+      .type = REDISMODULE_ARG_TYPE_ONEOF,
+      .flags = REDISMODULE_CMD_ARG_OPTIONAL,
+      .token = "FORMAT",
+      .subargs = (RedisModuleCommandArg *)FORMAT_OPTIONS },
+    { .name = "window",
+      .type = REDISMODULE_ARG_TYPE_BLOCK,
+      .flags = REDISMODULE_CMD_ARG_OPTIONAL,
+      .subargs =
+          (RedisModuleCommandArg[]){
+              { .name = "window", .type = REDISMODULE_ARG_TYPE_PURE_TOKEN, .token = "WINDOW" },
+              { .name = "function",
+                .type = REDISMODULE_ARG_TYPE_ONEOF,
+                .subargs = (RedisModuleCommandArg *)WINDOW_OPTIONS },
+              { .name = "sizeOrAlpha", .type = REDISMODULE_ARG_TYPE_DOUBLE },
+              { 0 } } },
+    { .name = "cursor",
+      .type = REDISMODULE_ARG_TYPE_STRING,
+      .flags = REDISMODULE_CMD_ARG_OPTIONAL,
+      .token = "CURSOR" },
     { .name = "FILTER",
       .type = REDISMODULE_ARG_TYPE_BLOCK,
       .subargs =
@@ -1631,6 +1860,26 @@ static const RedisModuleCommandArg TS_MREVRANGE_ARGS[] = {
                           .token = "EMPTY" },
                         { 0 } } },
               { 0 } } },
+    { .name = "format",
+      .type = REDISMODULE_ARG_TYPE_ONEOF,
+      .flags = REDISMODULE_CMD_ARG_OPTIONAL,
+      .token = "FORMAT",
+      .subargs = (RedisModuleCommandArg *)FORMAT_OPTIONS },
+    { .name = "window",
+      .type = REDISMODULE_ARG_TYPE_BLOCK,
+      .flags = REDISMODULE_CMD_ARG_OPTIONAL,
+      .subargs =
+          (RedisModuleCommandArg[]){
+              { .name = "window", .type = REDISMODULE_ARG_TYPE_PURE_TOKEN, .token = "WINDOW" },
+              { .name = "function",
+                .type = REDISMODULE_ARG_TYPE_ONEOF,
+                .subargs = (RedisModuleCommandArg *)WINDOW_OPTIONS },
+              { .name = "sizeOrAlpha", .type = REDISMODULE_ARG_TYPE_DOUBLE },
+              { 0 } } },
+    { .name = "cursor",
+      .type = REDISMODULE_ARG_TYPE_STRING,
+      .flags = REDISMODULE_CMD_ARG_OPTIONAL,
+      .token = "CURSOR" },
     { .name = "FILTER",
       .type = REDISMODULE_ARG_TYPE_BLOCK,
       .subargs =
@@ -1672,6 +1921,90 @@ static const RedisModuleCommandInfo TS_MREVRANGE_INFO = {
     .args = (RedisModuleCommandArg *)TS_MREVRANGE_ARGS,
 };
 
+// ===============================
+// TS.MTOPK k fromTimestamp toTimestamp AGGREGATION aggregator [BOTTOM] [options...]
+// ===============================
+static const RedisModuleCommandKeySpec TS_MTOPK_KEYSPECS[] = { { 0 } };
+
+static const RedisModuleCommandArg TS_MTOPK_ARGS[] = {
+    { .name = "k", .type = REDISMODULE_ARG_TYPE_INTEGER },
+    { .name = "fromTimestamp", .type = REDISMODULE_ARG_TYPE_STRING },
+    { .name = "toTimestamp", .type = REDISMODULE_ARG_TYPE_STRING },
+    { .name = "AGGREGATION",
+      .type = REDISMODULE_ARG_TYPE_ONEOF,
+      .token = "AGGREGATION",
+      .subargs = (RedisModuleCommandArg *)AGGREGATOR_OPTIONS },
+    { .name = "BOTTOM",
+      .type = REDISMODULE_ARG_TYPE_PURE_TOKEN,
+      .flags = REDISMODULE_CMD_ARG_OPTIONAL,
+      .token = "BOTTOM" },
+    { .name = "LATEST",
+      .type = REDISMODULE_ARG_TYPE_PURE_TOKEN,
+      .flags = REDISMODULE_CMD_ARG_OPTIONAL,
+      .token = "LATEST" },
+    { .name = "FILTER_BY_TS",
+      .type = REDISMODULE_ARG_TYPE_BLOCK,
+      .flags = REDISMODULE_CMD_ARG_MULTIPLE | REDISMODULE_CMD_ARG_OPTIONAL,
+      .subargs = (RedisModuleCommandArg[]){ { .name = "FILTER_BY_TS",
+                                              .type = REDISMODULE_ARG_TYPE_PURE_TOKEN,
+                                              .token = "FILTER_BY_TS" },
+                                            { .name = "timestamp",
+                                              .type = REDISMODULE_ARG_TYPE_STRING,
+                                              .flags = REDISMODULE_CMD_ARG_MULTIPLE },
+                                            { 0 } } },
+    { .name = "FILTER_BY_VALUE",
+      .type = REDISMODULE_ARG_TYPE_BLOCK,
+      .flags = REDISMODULE_CMD_ARG_OPTIONAL,
+      .subargs = (RedisModuleCommandArg[]){ { .name = "FILTER_BY_VALUE",
+                                              .type = REDISMODULE_ARG_TYPE_PURE_TOKEN,
+                                              .token = "FILTER_BY_VALUE" },
+                                            { .name = "min", .type = REDISMODULE_ARG_TYPE_DOUBLE },
+                                            { .name = "max", .type = REDISMODULE_ARG_TYPE_DOUBLE },
+                                            { 0 } } },
+    { .name = "labels",
+      .type = REDISMODULE_ARG_TYPE_ONEOF,
+      .flags = REDISMODULE_CMD_ARG_OPTIONAL,
+      .subargs =
+          (RedisModuleCommandArg[]){
+              { .name = "WITHLABELS",
+                .type = REDISMODULE_ARG_TYPE_PURE_TOKEN,
+                .token = "WITHLABELS" },
+              { .name = "SELECTED_LABELS",
+                .type = REDISMODULE_ARG_TYPE_BLOCK,
+                .subargs = (RedisModuleCommandArg[]){ { .name = "SELECTED_LABELS",
+                                                        .type = REDISMODULE_ARG_TYPE_PURE_TOKEN,
+                                                        .token = "SELECTED_LABELS" },
+                                                      { .name = "label",
+                                                        .type = REDISMODULE_ARG_TYPE_STRING,
+                                                        .flags = REDISMODULE_CMD_ARG_MULTIPLE },
+                                                      { 0 } } },
+              { 0 } } },
+    { .name = "FILTER",
+      .type = REDISMODULE_ARG_TYPE_BLOCK,
+      .subargs =
+          (RedisModuleCommandArg[]){
+              { .name = "FILTER", .type = REDISMODULE_ARG_TYPE_PURE_TOKEN, .token = "FILTER" },
+              { .name = "filterExpr",
+                .type = REDISMODULE_ARG_TYPE_STRING,
+                .flags = REDISMODULE_CMD_ARG_MULTIPLE },
+              { 0 } } },
+    { 0 }
+};
+
+static const RedisModuleCommandInfo TS_MTOPK_INFO = {
+    .version = REDISMODULE_COMMAND_INFO_VERSION,
+    .summary = "Return the k time series with the highest (or lowest) aggregated value over a "
+               "range",
+    .complexity = "O(s*(n/m+k)) where s = Number of matching series, n = Number of data points, "
+                  "m = Chunk size (data points per chunk), k = Number of data points that are in "
+                  "the requested ranges",
+    .since = "8.10.0",
+    .tips = "dont_cache",
+    .arity = -7,
+    .key_specs = (RedisModuleCommandKeySpec *)TS_MTOPK_KEYSPECS,
+    .args = (RedisModuleCommandArg *)TS_MTOPK_ARGS,
+};
+
 int RegisterTSCommandInfos(RedisModuleCtx *ctx) {
     // Register TS.ADD command info
     RedisModuleCommand *cmd_add = RedisModule_GetCommand(ctx, "TS.ADD");
@@ -1730,6 +2063,22 @@ int RegisterTSCommandInfos(RedisModuleCtx *ctx) {
         RedisModule_SetCommandInfo(cmd_deleterule, &TS_DELETERULE_INFO) == REDISMODULE_ERR)
         return REDISMODULE_ERR;
 
+    // Register TS.BACKFILLSTATUS command info
+    RedisModuleCommand *cmd_backfillstatus = RedisModule_GetCommand(ctx, "TS.BACKFILLSTATUS");
+    if (!cmd_backfillstatus ||
+        RedisModule_SetCommandInfo(cmd_backfillstatus, &TS_BACKFILLSTATUS_INFO) == REDISMODULE_ERR)
+        return REDISMODULE_ERR;
+
+    // Register TS.WCREATE command info
+    RedisModuleCommand *cmd_wcreate = RedisModule_GetCommand(ctx, "TS.WCREATE");
+    if (!cmd_wcreate || RedisModule_SetCommandInfo(cmd_wcreate, &TS_WCREATE_INFO) == REDISMODULE_ERR)
+        return REDISMODULE_ERR;
+
+    // Register TS.WADD command info
+    RedisModuleCommand *cmd_wadd = RedisModule_GetCommand(ctx, "TS.WADD");
+    if (!cmd_wadd || RedisModule_SetCommandInfo(cmd_wadd, &TS_WADD_INFO) == REDISMODULE_ERR)
+        return REDISMODULE_ERR;
+
     // Register TS.GET command info
     RedisModuleCommand *cmd_get = RedisModule_GetCommand(ctx, "TS.GET");
     if (!cmd_get || RedisModule_SetCommandInfo(cmd_get, &TS_GET_INFO) == REDISMODULE_ERR)
@@ -1807,5 +2156,10 @@ int RegisterTSCommandInfos(RedisModuleCtx *ctx) {
         return REDISMODULE_ERR;
     }
 
+    // Register TS.MTOPK command info
+    RedisModuleCommand *cmd_mtopk = RedisModule_GetCommand(ctx, "TS.MTOPK");
+    if (!cmd_mtopk || RedisModule_SetCommandInfo(cmd_mtopk, &TS_MTOPK_INFO) == REDISMODULE_ERR)
+        return REDISMODULE_ERR;
+
     return REDISMODULE_OK;
 }
@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) 2006-Present, Redis Ltd.
+ * All rights reserved.
+ *
+ * Licensed under your choice of (a) the Redis Source Available License 2.0
+ * (RSALv2); or (b) the Server Side Public License v1 (SSPLv1); or (c) the
+ * GNU Affero General Public License v3 (AGPLv3).
+ */
+#include "columnar_reduce.h"
+
+#include "common.h"
+#include "consts.h"
+#include "enriched_chunk.h"
+#include "utils/arch_features.h"
+
+#if defined(__x86_64__)
+#include "compactions/compaction_avx2.h"
+#endif
+
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "rmutil/alloc.h"
+
+// The kernels are written without branches so the compiler can vectorize them
+void ColumnSum(double *__restrict__ acc,
+               double *__restrict__ cnt,
+               const double *__restrict__ values,
+               size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        const bool valid = !isnan(values[i]);
+        acc[i] += valid ? values[i] : 0;
+        cnt[i] += valid;
+    }
+}
+
+void ColumnMin(double *__restrict__ acc,
+               double *__restrict__ cnt,
+               const double *__restrict__ values,
+               size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        // false for NaN
+        acc[i] = values[i] < acc[i] ? values[i] : acc[i];
+        cnt[i] += !isnan(values[i]);
+    }
+}
+
+void ColumnMax(double *__restrict__ acc,
+               double *__restrict__ cnt,
+               const double *__restrict__ values,
+               size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        acc[i] = values[i] > acc[i] ? values[i] : acc[i];
+        cnt[i] += !isnan(values[i]);
+    }
+}
+
+static ColumnReduceKernel columnSum = ColumnSum;
+static ColumnReduceKernel columnMin = ColumnMin;
+static ColumnReduceKernel columnMax = ColumnMax;
+
+void initColumnarReduceFunctions() {
+#if defined(__x86_64__)
+    const X86Features *features = getArchitectureOptimization();
+    if (features && features->avx2) {
+        columnSum = ColumnSumAVX2;
+        columnMin = ColumnMinAVX2;
+        columnMax = ColumnMaxAVX2;
+    }
+#endif // __x86_64__
+}
+
+typedef struct ColumnReducer
+{
+    ColumnReduceKernel kernel;
+    double init; // initial value of the accumulators, the same as the reducer's context
+} ColumnReducer;
+
+static bool getColumnReducer(TS_AGG_TYPES_T type, ColumnReducer *reducer) {
+    switch (type) {
+        case TS_AGG_SUM:
+        case TS_AGG_AVG:
+        case TS_AGG_COUNT:
+            *reducer = (ColumnReducer){ .kernel = columnSum, .init = 0 };
+            return true;
+        case TS_AGG_MIN:
+            *reducer = (ColumnReducer){ .kernel = columnMin, .init = DBL_MAX };
+            return true;
+        case TS_AGG_MAX:
+            *reducer = (ColumnReducer){ .kernel = columnMax, .init = -DBL_MAX };
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Returns false when the value of a bucket can't be derived from its accumulators alone
+static bool finalizeBucket(TS_AGG_TYPES_T type, double acc, double cnt, double *value) {
+    if (cnt == 0) {
+        // no valid input in the bucket, see MultiSeriesAggDupSampleIterator_GetNext
+        *value = type == TS_AGG_COUNT ? 0 : NAN;
+        return true;
+    }
+    switch (type) {
+        case TS_AGG_COUNT:
+            *value = cnt;
+            return true;
+        case TS_AGG_AVG:
+            // the avg context switches to a running mean on overflow
+            *value = acc / cnt;
+            return isfinite(acc);
+        default:
+            *value = acc;
+            return true;
+    }
+}
+
+bool ColumnarReduce(Series *dest,
+                    Series **series,
+                    size_t n_series,
+                    const ReducerArgs *reducerArgs,
+                    const RangeArgs *args) {
+    ColumnReducer reducer;
+    if (args->aggregationArgs.numClasses != 1 || args->skipAggregation || n_series < 2 ||
+        !getColumnReducer(reducerArgs->agg_type, &reducer)) {
+        return false;
+    }
+    const timestamp_t delta = args->aggregationArgs.timeDelta;
+
+    // COUNT applies to the reduced series, in the order of the reply, not to its members
+    RangeArgs memberArgs = *args;
+    memberArgs.count = -1;
+
+    bool fits = true;
+    size_t totalSamples = 0;
+    timestamp_t first = UINT64_MAX, last = 0;
+    EnrichedChunk **members = calloc(n_series, sizeof(*members));
+    for (size_t i = 0; i < n_series; i++) {
+        members[i] = SeriesQueryMaterialize(series[i], &memberArgs, false);
+        const Samples *samples = &members[i]->samples;
+        if (samples->num_samples == 0) {
+            continue;
+        }
+        totalSamples += samples->num_samples;
+        first = min(first, samples->timestamps[0]);
+        last = max(last, samples->timestamps[samples->num_samples - 1]);
+        fits = fits && samples->values_per_sample == 1;
+    }
+
+    const size_t numBuckets = totalSamples > 0 ? (last - first) / delta + 1 : 0;
+    fits = fits && numBuckets <= COLUMNAR_REDUCE_MAX_SPARSENESS * totalSamples;
+
+    double *acc = NULL, *cnt = NULL;
+    bool *present = NULL;
+    if (fits && numBuckets > 0) {
+        acc = malloc(numBuckets * sizeof(*acc));
+        cnt = calloc(numBuckets, sizeof(*cnt));
+        present = calloc(numBuckets, sizeof(*present));
+        for (size_t b = 0; b < numBuckets; b++) {
+            acc[b] = reducer.init;
+        }
+
+        for (size_t i = 0; fits && i < n_series; i++) {
+            const Samples *samples = &members[i]->samples;
+            // fold every run of consecutive buckets at once
+            size_t runStart = 0;
+            for (size_t j = 1; j <= samples->num_samples; j++) {
+                if (j < samples->num_samples &&
+                    samples->timestamps[j] == samples->timestamps[j - 1] + delta) {
+                    continue;
+                }
+                const timestamp_t offset = samples->timestamps[runStart] - first;
+                if (offset % delta != 0) {
+                    // a bucket off the grid, e.g. a first bucket normalized to 0
+                    fits = false;
+                    break;
+                }
+                const size_t bucket = offset / delta;
+                const size_t n = j - runStart;
+                reducer.kernel(acc + bucket, cnt + bucket, samples->_values + runStart, n);
+                memset(present + bucket, true, n * sizeof(*present));
+                runStart = j;
+            }
+        }
+    }
+
+    // the values are only added to dest once all of them are known to be valid
+    double *values = fits ? malloc(max(numBuckets, 1) * sizeof(*values)) : NULL;
+    for (size_t b = 0; fits && b < numBuckets; b++) {
+        fits = !present[b] || finalizeBucket(reducerArgs->agg_type, acc[b], cnt[b], &values[b]);
+    }
+    for (size_t b = 0; fits && b < numBuckets; b++) {
+        if (present[b]) {
+            SeriesAddSample(dest, first + b * delta, values[b]);
+        }
+    }
+
+    free(values);
+    free(acc);
+    free(cnt);
+    free(present);
+    for (size_t i = 0; i < n_series; i++) {
+        FreeEnrichedChunk(members[i]);
+    }
+    free(members);
+
+    return fits;
+}
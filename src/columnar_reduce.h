@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2006-Present, Redis Ltd.
+ * All rights reserved.
+ *
+ * Licensed under your choice of (a) the Redis Source Available License 2.0
+ * (RSALv2); or (b) the Server Side Public License v1 (SSPLv1); or (c) the
+ * GNU Affero General Public License v3 (AGPLv3).
+ */
+#ifndef COLUMNAR_REDUCE_H
+#define COLUMNAR_REDUCE_H
+
+#include "query_language.h"
+#include "tsdb.h"
+
+#include <stdbool.h>
+
+/*
+ * GROUPBY/REDUCE over aggregated series.
+ *
+ * When the group members are aggregated, every one of them reports its buckets on the same grid
+ * (same bucket duration and alignment). Instead of merging the members sample by sample through a
+ * heap, each member is laid out on an array indexed by bucket and the arrays are reduced column
+ * by column with vector kernels.
+ */
+
+// A grid larger than this many buckets per reduced sample is too sparse for the columnar reducer
+#define COLUMNAR_REDUCE_MAX_SPARSENESS 4
+
+typedef void (*ColumnReduceKernel)(double *__restrict__ acc,
+                                   double *__restrict__ cnt,
+                                   const double *__restrict__ values,
+                                   size_t n);
+
+// The portable kernels: fold values[i] into acc[i] and add 1 to cnt[i] for every non-NaN value
+void ColumnSum(double *__restrict__ acc,
+               double *__restrict__ cnt,
+               const double *__restrict__ values,
+               size_t n);
+void ColumnMin(double *__restrict__ acc,
+               double *__restrict__ cnt,
+               const double *__restrict__ values,
+               size_t n);
+void ColumnMax(double *__restrict__ acc,
+               double *__restrict__ cnt,
+               const double *__restrict__ values,
+               size_t n);
+
+void initColumnarReduceFunctions();
+
+// Reduces the series into dest when the query and the reducer fit the columnar reducer. Returns
+// false, leaving dest untouched, when the sample by sample reducer should be used instead.
+bool ColumnarReduce(Series *dest,
+                    Series **series,
+                    size_t n_series,
+                    const ReducerArgs *reducerArgs,
+                    const RangeArgs *args);
+
+#endif // COLUMNAR_REDUCE_H
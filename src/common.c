@@ -29,6 +29,11 @@ int NotifyCallback(RedisModuleCtx *ctx, int type, const char *event, RedisModule
         return REDISMODULE_OK;
     }
 
+    if (strcasecmp(event, "move_to") == 0) {
+        MoveSeriesTo(ctx, key);
+        return REDISMODULE_OK;
+    }
+
     // Will be called in replicaof or on load rdb on load time
     if (strcasecmp(event, "loaded") == 0) {
         IndexMetricFromName(ctx, key);
@@ -9,6 +9,7 @@
 #include "compaction.h"
 
 #include "load_io_error_macros.h"
+#include "quantile_sketch.h"
 #include "rdb.h"
 
 #include "rmutil/alloc.h"
@@ -63,6 +64,22 @@ typedef struct TwaContext
     int64_t iteration;
 } TwaContext;
 
+// rate, increase and irate of a counter
+typedef struct CounterContext
+{
+    Sample first;      // the earliest sample of the bucket
+    Sample last;       // the latest sample of the bucket
+    Sample beforeLast; // the sample before last, for irate
+    Sample appended;   // the last appended sample, in the order of the iteration
+    Sample neighbors[2];
+    uint64_t numNeighbors;
+    uint64_t count;
+    double increase; // from first to last, corrected for the counter resets
+    timestamp_t bucketStartTS;
+    timestamp_t bucketEndTS;
+    bool hasBucketParams;
+} CounterContext;
+
 typedef struct StdContext
 {
     double sum;
@@ -458,6 +475,219 @@ int TwaReadContext(void *contextPtr, RedisModuleIO *io, int encver) {
     return TSDB_OK;
 }
 
+/* The increase of a counter from v1 to v2, a lower v2 meaning that the counter was reset to 0 in
+ * between */
+static inline double counterDelta(double v1, double v2) {
+    return v2 >= v1 ? v2 - v1 : v2;
+}
+
+void *CounterCreateContext(__unused bool reverse) {
+    CounterContext *context = (CounterContext *)calloc(1, sizeof(CounterContext));
+    return context;
+}
+
+void *CounterCloneContext(void *contextPtr) {
+    CounterContext *buf = (CounterContext *)malloc(sizeof(CounterContext));
+    memcpy(buf, contextPtr, sizeof(CounterContext));
+    return buf;
+}
+
+void CounterReset(void *contextPtr) {
+    memset(contextPtr, 0, sizeof(CounterContext));
+}
+
+void CounterAddBucketParams(void *contextPtr, timestamp_t bucketStartTS, timestamp_t bucketEndTS) {
+    CounterContext *context = (CounterContext *)contextPtr;
+    // reversed iterations pass the edges swapped
+    context->bucketStartTS = min(bucketStartTS, bucketEndTS);
+    context->bucketEndTS = max(bucketStartTS, bucketEndTS);
+    context->hasBucketParams = true;
+}
+
+/* The samples around the bucket, the one before and the one after. Which is which is only known
+ * once the samples of the bucket are, as a reversed iteration passes them the other way around. */
+static void CounterAddNeighbor(void *contextPtr, double value, timestamp_t ts) {
+    CounterContext *context = (CounterContext *)contextPtr;
+    if (isnan(value) || context->numNeighbors == 2) {
+        return;
+    }
+    context->neighbors[context->numNeighbors].timestamp = ts;
+    context->neighbors[context->numNeighbors].value = value;
+    context->numNeighbors++;
+}
+
+void CounterAddValue(void *contextPtr, double value, timestamp_t ts) {
+    CounterContext *context = (CounterContext *)contextPtr;
+    if (isnan(value)) {
+        return;
+    }
+    const Sample sample = { .timestamp = ts, .value = value };
+    if (context->count == 0) {
+        context->first = context->last = context->beforeLast = sample;
+    } else {
+        // the samples come in order, forward or reversed, so the appended ones are adjacent
+        if (ts > context->appended.timestamp) {
+            context->increase += counterDelta(context->appended.value, value);
+        } else {
+            context->increase += counterDelta(value, context->appended.value);
+        }
+        if (ts < context->first.timestamp) {
+            if (context->count == 1) {
+                context->beforeLast = sample;
+            }
+            context->first = sample;
+        } else if (ts > context->last.timestamp) {
+            context->beforeLast = context->last;
+            context->last = sample;
+        }
+    }
+    context->appended = sample;
+    context->count++;
+}
+
+void CounterGetLastSample(void *contextPtr, Sample *sample) {
+    *sample = ((CounterContext *)contextPtr)->appended;
+}
+
+/* The increase between the edges of the bucket, and the time it covers. The deltas from the
+ * samples around the bucket are interpolated at its edges, so that the increases of consecutive
+ * buckets add up to the increase of the counter. Without the edges or the samples around, the
+ * bucket covers its first to its last sample. */
+static void CounterBucketIncrease(const CounterContext *context,
+                                  double *increase,
+                                  timestamp_t *from,
+                                  timestamp_t *to) {
+    *increase = context->increase;
+    *from = context->first.timestamp;
+    *to = context->last.timestamp;
+    if (!context->hasBucketParams) {
+        return;
+    }
+    for (uint64_t i = 0; i < context->numNeighbors; i++) {
+        const Sample *neighbor = &context->neighbors[i];
+        if (neighbor->timestamp < context->first.timestamp &&
+            context->bucketStartTS < context->first.timestamp) {
+            const timestamp_t edge = max(context->bucketStartTS, neighbor->timestamp);
+            *increase += counterDelta(neighbor->value, context->first.value) *
+                         (double)(context->first.timestamp - edge) /
+                         (double)(context->first.timestamp - neighbor->timestamp);
+            *from = edge;
+        } else if (neighbor->timestamp > context->last.timestamp &&
+                   context->bucketEndTS > context->last.timestamp) {
+            const timestamp_t edge = min(context->bucketEndTS, neighbor->timestamp);
+            *increase += counterDelta(context->last.value, neighbor->value) *
+                         (double)(edge - context->last.timestamp) /
+                         (double)(neighbor->timestamp - context->last.timestamp);
+            *to = edge;
+        }
+    }
+}
+
+int IncreaseFinalize(void *contextPtr, double *value) {
+    CounterContext *context = (CounterContext *)contextPtr;
+    double increase;
+    timestamp_t from, to;
+    CounterBucketIncrease(context, &increase, &from, &to);
+    if (unlikely(context->count == 0 || from == to)) {
+        *value = NAN;
+        return TSDB_ERROR;
+    }
+    *value = increase;
+    return TSDB_OK;
+}
+
+int RateFinalize(void *contextPtr, double *value) {
+    CounterContext *context = (CounterContext *)contextPtr;
+    double increase;
+    timestamp_t from, to;
+    CounterBucketIncrease(context, &increase, &from, &to);
+    if (unlikely(context->count == 0 || from == to)) {
+        *value = NAN;
+        return TSDB_ERROR;
+    }
+    // per second, the timestamps being in milliseconds
+    *value = increase * 1000 / (double)(to - from);
+    return TSDB_OK;
+}
+
+int IrateFinalize(void *contextPtr, double *value) {
+    CounterContext *context = (CounterContext *)contextPtr;
+    const Sample *last = &context->last;
+    const Sample *prev = NULL;
+    if (context->count > 1) {
+        prev = &context->beforeLast;
+    } else if (context->count == 1) {
+        // the sample before the bucket, if any
+        for (uint64_t i = 0; i < context->numNeighbors; i++) {
+            if (context->neighbors[i].timestamp < last->timestamp) {
+                prev = &context->neighbors[i];
+            }
+        }
+    }
+    if (unlikely(prev == NULL)) {
+        *value = NAN;
+        return TSDB_ERROR;
+    }
+    *value =
+        counterDelta(prev->value, last->value) * 1000 / (double)(last->timestamp - prev->timestamp);
+    return TSDB_OK;
+}
+
+static void CounterSaveSample(RedisModuleIO *io, const Sample *sample) {
+    RedisModule_SaveUnsigned(io, sample->timestamp);
+    RedisModule_SaveDouble(io, sample->value);
+}
+
+static int CounterLoadSample(RedisModuleIO *io, Sample *sample) {
+    bool err = false;
+    sample->timestamp = LoadUnsigned_IOError(io, err, TSDB_ERROR);
+    sample->value = LoadDouble_IOError(io, err, TSDB_ERROR);
+    return TSDB_OK;
+}
+
+void CounterWriteContext(void *contextPtr, RedisModuleIO *io) {
+    CounterContext *context = (CounterContext *)contextPtr;
+    CounterSaveSample(io, &context->first);
+    CounterSaveSample(io, &context->last);
+    CounterSaveSample(io, &context->beforeLast);
+    CounterSaveSample(io, &context->appended);
+    RedisModule_SaveUnsigned(io, context->numNeighbors);
+    for (uint64_t i = 0; i < context->numNeighbors; i++) {
+        CounterSaveSample(io, &context->neighbors[i]);
+    }
+    RedisModule_SaveUnsigned(io, context->count);
+    RedisModule_SaveDouble(io, context->increase);
+    RedisModule_SaveUnsigned(io, context->bucketStartTS);
+    RedisModule_SaveUnsigned(io, context->bucketEndTS);
+    RedisModule_SaveUnsigned(io, context->hasBucketParams);
+}
+
+int CounterReadContext(void *contextPtr, RedisModuleIO *io, REDISMODULE_ATTR_UNUSED int encver) {
+    CounterContext *context = (CounterContext *)contextPtr;
+    bool err = false;
+    if (CounterLoadSample(io, &context->first) != TSDB_OK ||
+        CounterLoadSample(io, &context->last) != TSDB_OK ||
+        CounterLoadSample(io, &context->beforeLast) != TSDB_OK ||
+        CounterLoadSample(io, &context->appended) != TSDB_OK) {
+        return TSDB_ERROR;
+    }
+    context->numNeighbors = LoadUnsigned_IOError(io, err, TSDB_ERROR);
+    if (context->numNeighbors > 2) {
+        return TSDB_ERROR;
+    }
+    for (uint64_t i = 0; i < context->numNeighbors; i++) {
+        if (CounterLoadSample(io, &context->neighbors[i]) != TSDB_OK) {
+            return TSDB_ERROR;
+        }
+    }
+    context->count = LoadUnsigned_IOError(io, err, TSDB_ERROR);
+    context->increase = LoadDouble_IOError(io, err, TSDB_ERROR);
+    context->bucketStartTS = LoadUnsigned_IOError(io, err, TSDB_ERROR);
+    context->bucketEndTS = LoadUnsigned_IOError(io, err, TSDB_ERROR);
+    context->hasBucketParams = LoadUnsigned_IOError(io, err, TSDB_ERROR);
+    return TSDB_OK;
+}
+
 void *StdCreateContext(__unused bool reverse) {
     StdContext *context = (StdContext *)malloc(sizeof(StdContext));
     context->cnt = 0;
@@ -489,6 +719,10 @@ static inline double variance(double sum, double sum_2, double count) {
     return (sum_2 - 2 * sum * sum / count + pow(sum / count, 2) * count) / count;
 }
 
+double VarianceFromSums(double sum, double sum_2, double count) {
+    return variance(sum, sum_2, count);
+}
+
 int VarPopulationFinalize(void *contextPtr, double *value) {
     StdContext *context = (StdContext *)contextPtr;
     uint64_t count = context->cnt;
@@ -552,6 +786,106 @@ int StdReadContext(void *contextPtr, RedisModuleIO *io, REDISMODULE_ATTR_UNUSED
     return TSDB_OK;
 }
 
+void *QuantileCreateContext(__unused bool reverse) {
+    QuantileSketch *context = (QuantileSketch *)malloc(sizeof(QuantileSketch));
+    QuantileSketch_Init(context);
+    return context;
+}
+
+void *QuantileCloneContext(void *contextPtr) {
+    QuantileSketch *context = QuantileCreateContext(false);
+    QuantileSketch_Merge(context, contextPtr);
+    return context;
+}
+
+void QuantileFreeContext(void *contextPtr) {
+    QuantileSketch_Reset(contextPtr);
+    free(contextPtr);
+}
+
+void QuantileAddValue(void *contextPtr, double value, __attribute__((unused)) timestamp_t ts) {
+    QuantileSketch_Add(contextPtr, value);
+}
+
+void QuantileReset(void *contextPtr) {
+    QuantileSketch_Reset(contextPtr);
+}
+
+bool AggTypeUsesBucketEdges(TS_AGG_TYPES_T aggType) {
+    switch (aggType) {
+        case TS_AGG_TWA:
+        case TS_AGG_RATE:
+        case TS_AGG_INCREASE:
+        case TS_AGG_IRATE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+double AggTypeQuantile(TS_AGG_TYPES_T aggType) {
+    switch (aggType) {
+        case TS_AGG_P50:
+            return 0.5;
+        case TS_AGG_P90:
+            return 0.9;
+        case TS_AGG_P95:
+            return 0.95;
+        case TS_AGG_P99:
+            return 0.99;
+        case TS_AGG_P999:
+            return 0.999;
+        default:
+            return 0;
+    }
+}
+
+static int QuantileFinalize(void *contextPtr, TS_AGG_TYPES_T aggType, double *value) {
+    QuantileSketch *context = (QuantileSketch *)contextPtr;
+    if (unlikely(context->count == 0)) {
+        return TSDB_ERROR;
+    }
+    *value = QuantileSketch_Quantile(context, AggTypeQuantile(aggType));
+    return TSDB_OK;
+}
+
+int P50Finalize(void *contextPtr, double *value) {
+    return QuantileFinalize(contextPtr, TS_AGG_P50, value);
+}
+
+int P90Finalize(void *contextPtr, double *value) {
+    return QuantileFinalize(contextPtr, TS_AGG_P90, value);
+}
+
+int P95Finalize(void *contextPtr, double *value) {
+    return QuantileFinalize(contextPtr, TS_AGG_P95, value);
+}
+
+int P99Finalize(void *contextPtr, double *value) {
+    return QuantileFinalize(contextPtr, TS_AGG_P99, value);
+}
+
+int P999Finalize(void *contextPtr, double *value) {
+    return QuantileFinalize(contextPtr, TS_AGG_P999, value);
+}
+
+void QuantileWriteContext(void *contextPtr, RedisModuleIO *io) {
+    size_t len;
+    char *buf = QuantileSketch_Encode(contextPtr, &len);
+    RedisModule_SaveStringBuffer(io, buf, len);
+    free(buf);
+}
+
+int QuantileReadContext(void *contextPtr, RedisModuleIO *io, REDISMODULE_ATTR_UNUSED int encver) {
+    bool err = false;
+    size_t len = 0;
+    char *buf = LoadStringBuffer_IOError(io, &len, err, TSDB_ERROR);
+    QuantileSketch_Reset(contextPtr);
+    const bool decoded = QuantileSketch_Decode(contextPtr, buf, len);
+    RedisModule_Free(buf);
+    return decoded ? TSDB_OK : TSDB_ERROR;
+}
+
 void rm_free(void *ptr) {
     free(ptr);
 }
@@ -977,6 +1311,158 @@ static AggregationClass aggCountAll = {
     .isValueValid = allValueValid,
 };
 
+static AggregationClass aggRate = {
+    .type = TS_AGG_RATE,
+    .createContext = CounterCreateContext,
+    .appendValue = CounterAddValue,
+    .appendValueVec = NULL,
+    .freeContext = rm_free,
+    .finalize = RateFinalize,
+    .finalizeEmpty = finalize_empty_with_NAN,
+    .writeContext = CounterWriteContext,
+    .readContext = CounterReadContext,
+    .addBucketParams = CounterAddBucketParams,
+    .addPrevBucketLastSample = CounterAddNeighbor,
+    .addNextBucketFirstSample = CounterAddNeighbor,
+    .getLastSample = CounterGetLastSample,
+    .resetContext = CounterReset,
+    .cloneContext = CounterCloneContext,
+    .isValueValid = nonNaNValueValid,
+};
+
+static AggregationClass aggIncrease = {
+    .type = TS_AGG_INCREASE,
+    .createContext = CounterCreateContext,
+    .appendValue = CounterAddValue,
+    .appendValueVec = NULL,
+    .freeContext = rm_free,
+    .finalize = IncreaseFinalize,
+    .finalizeEmpty = finalize_empty_with_NAN,
+    .writeContext = CounterWriteContext,
+    .readContext = CounterReadContext,
+    .addBucketParams = CounterAddBucketParams,
+    .addPrevBucketLastSample = CounterAddNeighbor,
+    .addNextBucketFirstSample = CounterAddNeighbor,
+    .getLastSample = CounterGetLastSample,
+    .resetContext = CounterReset,
+    .cloneContext = CounterCloneContext,
+    .isValueValid = nonNaNValueValid,
+};
+
+static AggregationClass aggIrate = {
+    .type = TS_AGG_IRATE,
+    .createContext = CounterCreateContext,
+    .appendValue = CounterAddValue,
+    .appendValueVec = NULL,
+    .freeContext = rm_free,
+    .finalize = IrateFinalize,
+    .finalizeEmpty = finalize_empty_with_NAN,
+    .writeContext = CounterWriteContext,
+    .readContext = CounterReadContext,
+    .addBucketParams = CounterAddBucketParams,
+    .addPrevBucketLastSample = CounterAddNeighbor,
+    .addNextBucketFirstSample = CounterAddNeighbor,
+    .getLastSample = CounterGetLastSample,
+    .resetContext = CounterReset,
+    .cloneContext = CounterCloneContext,
+    .isValueValid = nonNaNValueValid,
+};
+
+static AggregationClass aggP50 = {
+    .type = TS_AGG_P50,
+    .createContext = QuantileCreateContext,
+    .appendValue = QuantileAddValue,
+    .appendValueVec = NULL,
+    .freeContext = QuantileFreeContext,
+    .finalize = P50Finalize,
+    .finalizeEmpty = finalize_empty_with_NAN,
+    .writeContext = QuantileWriteContext,
+    .readContext = QuantileReadContext,
+    .addBucketParams = NULL,
+    .addPrevBucketLastSample = NULL,
+    .addNextBucketFirstSample = NULL,
+    .getLastSample = NULL,
+    .resetContext = QuantileReset,
+    .cloneContext = QuantileCloneContext,
+    .isValueValid = nonNaNValueValid,
+};
+
+static AggregationClass aggP90 = {
+    .type = TS_AGG_P90,
+    .createContext = QuantileCreateContext,
+    .appendValue = QuantileAddValue,
+    .appendValueVec = NULL,
+    .freeContext = QuantileFreeContext,
+    .finalize = P90Finalize,
+    .finalizeEmpty = finalize_empty_with_NAN,
+    .writeContext = QuantileWriteContext,
+    .readContext = QuantileReadContext,
+    .addBucketParams = NULL,
+    .addPrevBucketLastSample = NULL,
+    .addNextBucketFirstSample = NULL,
+    .getLastSample = NULL,
+    .resetContext = QuantileReset,
+    .cloneContext = QuantileCloneContext,
+    .isValueValid = nonNaNValueValid,
+};
+
+static AggregationClass aggP95 = {
+    .type = TS_AGG_P95,
+    .createContext = QuantileCreateContext,
+    .appendValue = QuantileAddValue,
+    .appendValueVec = NULL,
+    .freeContext = QuantileFreeContext,
+    .finalize = P95Finalize,
+    .finalizeEmpty = finalize_empty_with_NAN,
+    .writeContext = QuantileWriteContext,
+    .readContext = QuantileReadContext,
+    .addBucketParams = NULL,
+    .addPrevBucketLastSample = NULL,
+    .addNextBucketFirstSample = NULL,
+    .getLastSample = NULL,
+    .resetContext = QuantileReset,
+    .cloneContext = QuantileCloneContext,
+    .isValueValid = nonNaNValueValid,
+};
+
+static AggregationClass aggP99 = {
+    .type = TS_AGG_P99,
+    .createContext = QuantileCreateContext,
+    .appendValue = QuantileAddValue,
+    .appendValueVec = NULL,
+    .freeContext = QuantileFreeContext,
+    .finalize = P99Finalize,
+    .finalizeEmpty = finalize_empty_with_NAN,
+    .writeContext = QuantileWriteContext,
+    .readContext = QuantileReadContext,
+    .addBucketParams = NULL,
+    .addPrevBucketLastSample = NULL,
+    .addNextBucketFirstSample = NULL,
+    .getLastSample = NULL,
+    .resetContext = QuantileReset,
+    .cloneContext = QuantileCloneContext,
+    .isValueValid = nonNaNValueValid,
+};
+
+static AggregationClass aggP999 = {
+    .type = TS_AGG_P999,
+    .createContext = QuantileCreateContext,
+    .appendValue = QuantileAddValue,
+    .appendValueVec = NULL,
+    .freeContext = QuantileFreeContext,
+    .finalize = P999Finalize,
+    .finalizeEmpty = finalize_empty_with_NAN,
+    .writeContext = QuantileWriteContext,
+    .readContext = QuantileReadContext,
+    .addBucketParams = NULL,
+    .addPrevBucketLastSample = NULL,
+    .addNextBucketFirstSample = NULL,
+    .getLastSample = NULL,
+    .resetContext = QuantileReset,
+    .cloneContext = QuantileCloneContext,
+    .isValueValid = nonNaNValueValid,
+};
+
 void initGlobalCompactionFunctions() {
     const X86Features *features = getArchitectureOptimization();
     aggMax.appendValueVec = MaxAppendValuesVec;
@@ -1015,6 +1501,14 @@ int StringLenAggTypeToEnum(const char *agg_type, size_t len) {
 
     switch (len) {
         case 3:
+            if (strncmp(agg_type_lower, "p50", len) == 0)
+                return TS_AGG_P50;
+            if (strncmp(agg_type_lower, "p90", len) == 0)
+                return TS_AGG_P90;
+            if (strncmp(agg_type_lower, "p95", len) == 0)
+                return TS_AGG_P95;
+            if (strncmp(agg_type_lower, "p99", len) == 0)
+                return TS_AGG_P99;
             if (strncmp(agg_type_lower, "min", len) == 0)
                 return TS_AGG_MIN;
             if (strncmp(agg_type_lower, "max", len) == 0)
@@ -1029,6 +1523,10 @@ int StringLenAggTypeToEnum(const char *agg_type, size_t len) {
         case 4:
             if (strncmp(agg_type_lower, "last", len) == 0)
                 return TS_AGG_LAST;
+            if (strncmp(agg_type_lower, "p999", len) == 0)
+                return TS_AGG_P999;
+            if (strncmp(agg_type_lower, "rate", len) == 0)
+                return TS_AGG_RATE;
             break;
         case 5:
             if (strncmp(agg_type_lower, "count", len) == 0)
@@ -1045,12 +1543,16 @@ int StringLenAggTypeToEnum(const char *agg_type, size_t len) {
                 return TS_AGG_VAR_P;
             if (strncmp(agg_type_lower, "var.s", len) == 0)
                 return TS_AGG_VAR_S;
+            if (strncmp(agg_type_lower, "irate", len) == 0)
+                return TS_AGG_IRATE;
             break;
         case 8:
             if (strncmp(agg_type_lower, "countnan", len) == 0)
                 return TS_AGG_COUNT_NAN;
             if (strncmp(agg_type_lower, "countall", len) == 0)
                 return TS_AGG_COUNT_ALL;
+            if (strncmp(agg_type_lower, "increase", len) == 0)
+                return TS_AGG_INCREASE;
             break;
     }
 
@@ -1089,6 +1591,22 @@ const char *AggTypeEnumToString(TS_AGG_TYPES_T aggType) {
             return "COUNTNAN";
         case TS_AGG_COUNT_ALL:
             return "COUNTALL";
+        case TS_AGG_P50:
+            return "P50";
+        case TS_AGG_P90:
+            return "P90";
+        case TS_AGG_P95:
+            return "P95";
+        case TS_AGG_P99:
+            return "P99";
+        case TS_AGG_P999:
+            return "P999";
+        case TS_AGG_RATE:
+            return "RATE";
+        case TS_AGG_INCREASE:
+            return "INCREASE";
+        case TS_AGG_IRATE:
+            return "IRATE";
         case TS_AGG_NONE:
         case TS_AGG_INVALID:
         case TS_AGG_TYPES_MAX:
@@ -1129,6 +1647,22 @@ const char *AggTypeEnumToStringLowerCase(TS_AGG_TYPES_T aggType) {
             return "countnan";
         case TS_AGG_COUNT_ALL:
             return "countall";
+        case TS_AGG_P50:
+            return "p50";
+        case TS_AGG_P90:
+            return "p90";
+        case TS_AGG_P95:
+            return "p95";
+        case TS_AGG_P99:
+            return "p99";
+        case TS_AGG_P999:
+            return "p999";
+        case TS_AGG_RATE:
+            return "rate";
+        case TS_AGG_INCREASE:
+            return "increase";
+        case TS_AGG_IRATE:
+            return "irate";
         case TS_AGG_NONE:
         case TS_AGG_INVALID:
         case TS_AGG_TYPES_MAX:
@@ -1169,6 +1703,22 @@ AggregationClass *GetAggClass(TS_AGG_TYPES_T aggType) {
             return &aggCountNaN;
         case TS_AGG_COUNT_ALL:
             return &aggCountAll;
+        case TS_AGG_P50:
+            return &aggP50;
+        case TS_AGG_P90:
+            return &aggP90;
+        case TS_AGG_P95:
+            return &aggP95;
+        case TS_AGG_P99:
+            return &aggP99;
+        case TS_AGG_P999:
+            return &aggP999;
+        case TS_AGG_RATE:
+            return &aggRate;
+        case TS_AGG_INCREASE:
+            return &aggIncrease;
+        case TS_AGG_IRATE:
+            return &aggIrate;
         case TS_AGG_NONE:
         case TS_AGG_INVALID:
         case TS_AGG_TYPES_MAX:
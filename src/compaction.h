@@ -55,6 +55,19 @@ const char *AggTypeEnumToString(TS_AGG_TYPES_T aggType);
 const char *AggTypeEnumToStringLowerCase(TS_AGG_TYPES_T aggType);
 void initGlobalCompactionFunctions();
 
+/* The population variance of values given their sum, the sum of their squares and their count, the
+ * same way the std and var aggregations compute it. */
+double VarianceFromSums(double sum, double sum_2, double count);
+
+/* True for the aggregations that also use the edges of the bucket and the samples around it,
+ * passed by addBucketParams, addPrevBucketLastSample and addNextBucketFirstSample: twa, rate,
+ * increase and irate. */
+bool AggTypeUsesBucketEdges(TS_AGG_TYPES_T aggType);
+
+/* The quantile computed by the p50, p90, p95, p99 and p999 aggregations, 0 for the other
+ * aggregations. */
+double AggTypeQuantile(TS_AGG_TYPES_T aggType);
+
 /* LOCF seed for empty-bucket emission of TS_AGG_LAST. The caller must verify the
  * aggregation is TS_AGG_LAST before calling. */
 void LastValueSeedLocf(void *contextPtr, double value, timestamp_t ts);
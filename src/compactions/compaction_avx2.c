@@ -49,3 +49,64 @@ void MaxAppendValuesAVX2(void *__restrict__ context,
 
     return;
 }
+
+/* GROUPBY column kernels, see ColumnSum/ColumnMin/ColumnMax in columnar_reduce.c. NaN values are
+ * masked out with an ordered compare. */
+void ColumnSumAVX2(double *__restrict__ acc,
+                   double *__restrict__ cnt,
+                   const double *__restrict__ values,
+                   size_t n) {
+    const __m256d ones = _mm256_set1_pd(1.0);
+    size_t i = 0;
+    for (; i + VECTOR_SIZE_AVX2 <= n; i += VECTOR_SIZE_AVX2) {
+        const __m256d v = _mm256_loadu_pd(&values[i]);
+        const __m256d valid = _mm256_cmp_pd(v, v, _CMP_ORD_Q);
+        _mm256_storeu_pd(&acc[i], _mm256_add_pd(_mm256_loadu_pd(&acc[i]), _mm256_and_pd(valid, v)));
+        _mm256_storeu_pd(&cnt[i],
+                         _mm256_add_pd(_mm256_loadu_pd(&cnt[i]), _mm256_and_pd(valid, ones)));
+    }
+    for (; i < n; i++) {
+        const bool valid = !isnan(values[i]);
+        acc[i] += valid ? values[i] : 0;
+        cnt[i] += valid;
+    }
+}
+
+// _mm256_min_pd(a, b) is a < b ? a : b, so a NaN value keeps the accumulator
+void ColumnMinAVX2(double *__restrict__ acc,
+                   double *__restrict__ cnt,
+                   const double *__restrict__ values,
+                   size_t n) {
+    const __m256d ones = _mm256_set1_pd(1.0);
+    size_t i = 0;
+    for (; i + VECTOR_SIZE_AVX2 <= n; i += VECTOR_SIZE_AVX2) {
+        const __m256d v = _mm256_loadu_pd(&values[i]);
+        const __m256d valid = _mm256_cmp_pd(v, v, _CMP_ORD_Q);
+        _mm256_storeu_pd(&acc[i], _mm256_min_pd(v, _mm256_loadu_pd(&acc[i])));
+        _mm256_storeu_pd(&cnt[i],
+                         _mm256_add_pd(_mm256_loadu_pd(&cnt[i]), _mm256_and_pd(valid, ones)));
+    }
+    for (; i < n; i++) {
+        acc[i] = values[i] < acc[i] ? values[i] : acc[i];
+        cnt[i] += !isnan(values[i]);
+    }
+}
+
+void ColumnMaxAVX2(double *__restrict__ acc,
+                   double *__restrict__ cnt,
+                   const double *__restrict__ values,
+                   size_t n) {
+    const __m256d ones = _mm256_set1_pd(1.0);
+    size_t i = 0;
+    for (; i + VECTOR_SIZE_AVX2 <= n; i += VECTOR_SIZE_AVX2) {
+        const __m256d v = _mm256_loadu_pd(&values[i]);
+        const __m256d valid = _mm256_cmp_pd(v, v, _CMP_ORD_Q);
+        _mm256_storeu_pd(&acc[i], _mm256_max_pd(v, _mm256_loadu_pd(&acc[i])));
+        _mm256_storeu_pd(&cnt[i],
+                         _mm256_add_pd(_mm256_loadu_pd(&cnt[i]), _mm256_and_pd(valid, ones)));
+    }
+    for (; i < n; i++) {
+        acc[i] = values[i] > acc[i] ? values[i] : acc[i];
+        cnt[i] += !isnan(values[i]);
+    }
+}
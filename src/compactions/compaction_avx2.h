@@ -9,9 +9,24 @@
 #ifndef COMPACTION_AVX2_H
 #define COMPACTION_AVX2_H
 
+#include <stddef.h>
+
 void MaxAppendValuesAVX2(void *__restrict__ context,
                          double *__restrict__ values,
                          size_t si,
                          size_t ei);
 
+void ColumnSumAVX2(double *__restrict__ acc,
+                   double *__restrict__ cnt,
+                   const double *__restrict__ values,
+                   size_t n);
+void ColumnMinAVX2(double *__restrict__ acc,
+                   double *__restrict__ cnt,
+                   const double *__restrict__ values,
+                   size_t n);
+void ColumnMaxAVX2(double *__restrict__ acc,
+                   double *__restrict__ cnt,
+                   const double *__restrict__ values,
+                   size_t n);
+
 #endif // COMPACTION_AVX2_H
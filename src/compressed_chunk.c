@@ -38,11 +38,15 @@ Chunk_t *Compressed_NewChunk(size_t size) {
     chunk->prevLeading = 32;
     chunk->prevTrailing = 32;
     chunk->prevTimestamp = 0;
+    chunk->refCount = 1;
     return chunk;
 }
 
 void Compressed_FreeChunk(Chunk_t *chunk) {
     CompressedChunk *cmpChunk = chunk;
+    if (__atomic_sub_fetch(&cmpChunk->refCount, 1, __ATOMIC_ACQ_REL) > 0) {
+        return;
+    }
     if (cmpChunk->data) {
         free(cmpChunk->data);
     }
@@ -56,15 +60,29 @@ Chunk_t *Compressed_CloneChunk(const Chunk_t *chunk) {
     memcpy(newChunk, oldChunk, sizeof(CompressedChunk));
     newChunk->data = malloc(newChunk->size);
     memcpy(newChunk->data, oldChunk->data, oldChunk->size);
+    newChunk->refCount = 1;
     return newChunk;
 }
 
+Chunk_t *Compressed_RetainChunk(Chunk_t *chunk) {
+    __atomic_add_fetch(&((CompressedChunk *)chunk)->refCount, 1, __ATOMIC_RELAXED);
+    return chunk;
+}
+
+bool Compressed_IsChunkShared(const Chunk_t *chunk) {
+    return __atomic_load_n(&((const CompressedChunk *)chunk)->refCount, __ATOMIC_ACQUIRE) > 1;
+}
+
 int Compressed_DefragChunk(RedisModuleDefragCtx *ctx,
                            void *data,
                            __unused unsigned char *key,
                            __unused size_t keylen,
                            void **newptr) {
     CompressedChunk *chunk = data;
+    if (Compressed_IsChunkShared(chunk)) { // a snapshot still points to it
+        *newptr = data;
+        return DefragStatus_Finished;
+    }
     chunk = defragPtr(ctx, chunk);
     chunk->data = defragPtr(ctx, chunk->data);
     *newptr = (void *)chunk;
@@ -75,6 +93,9 @@ static void swapChunks(CompressedChunk *a, CompressedChunk *b) {
     CompressedChunk tmp = *a;
     *a = *b;
     *b = tmp;
+    // the references are to the chunks, not to their contents
+    b->refCount = a->refCount;
+    a->refCount = tmp.refCount;
 }
 
 static void ensureAddSample(CompressedChunk *chunk, Sample *sample) {
@@ -112,6 +133,21 @@ static void trimChunk(CompressedChunk *chunk) {
     }
 }
 
+void Compressed_ResizeChunk(Chunk_t *chunk, size_t newSize) {
+    CompressedChunk *cmpChunk = chunk;
+    if (newSize <= cmpChunk->size) {
+        // same as trimChunk, the allocation is kept 8 bytes aligned and past the last bit written
+        trimChunk(cmpChunk);
+        return;
+    }
+
+    newSize += (sizeof(binary_t) - newSize % sizeof(binary_t)) % sizeof(binary_t);
+    const size_t oldSize = cmpChunk->size;
+    cmpChunk->data = (uint64_t *)realloc(cmpChunk->data, newSize);
+    memset((char *)cmpChunk->data + oldSize, 0, newSize - oldSize);
+    cmpChunk->size = newSize;
+}
+
 Chunk_t *Compressed_SplitChunk(Chunk_t *chunk) {
     CompressedChunk *curChunk = chunk;
     size_t split = curChunk->count / 2;
@@ -511,7 +547,8 @@ void Compressed_SaveToRDB(Chunk_t *chunk, struct RedisModuleIO *io) {
                          (SaveStringBufferFunc)RedisModule_SaveStringBuffer);
 }
 
-int Compressed_LoadFromRDB(Chunk_t **chunk, struct RedisModuleIO *io) {
+// minSampleBits is the minimal encoded size of every sample after the first one
+static int loadFromRDB(Chunk_t **chunk, struct RedisModuleIO *io, uint64_t minSampleBits) {
     bool err = false;
     errdefer(err, *chunk = NULL);
 
@@ -523,6 +560,7 @@ int Compressed_LoadFromRDB(Chunk_t **chunk, struct RedisModuleIO *io) {
     }
     errdefer(err, Compressed_FreeChunk(compchunk));
 
+    compchunk->refCount = 1;
     compchunk->data = NULL;
     compchunk->size = LoadUnsigned_IOError(io, err, TSDB_ERROR);
     compchunk->count = LoadUnsigned_IOError(io, err, TSDB_ERROR);
@@ -554,10 +592,11 @@ int Compressed_LoadFromRDB(Chunk_t **chunk, struct RedisModuleIO *io) {
         return TSDB_ERROR; /* gorilla.c reads/writes data in binary_t (8-byte) words */
     }
     /* Every sample after the first costs >=2 bits to encode (appendInteger/appendFloat
-     * in gorilla.c), so idx must be able to cover count-1 appended samples.
-     * Written as idx/2 < count-1 (equivalent to idx < 2*(count-1) for non-negative
-     * integers) to avoid overflow when count is attacker-inflated near UINT64_MAX. */
-    if (compchunk->count > 0 && compchunk->idx / 2 < compchunk->count - 1) {
+     * in gorilla.c), or >=1 bit in a column stream, so idx must be able to cover count-1
+     * appended samples. Written as idx/minSampleBits < count-1 (equivalent to
+     * idx < minSampleBits*(count-1) for non-negative integers) to avoid overflow when
+     * count is attacker-inflated near UINT64_MAX. */
+    if (compchunk->count > 0 && compchunk->idx / minSampleBits < compchunk->count - 1) {
         err = true;
         return TSDB_ERROR;
     }
@@ -566,6 +605,14 @@ int Compressed_LoadFromRDB(Chunk_t **chunk, struct RedisModuleIO *io) {
     return TSDB_OK;
 }
 
+int Compressed_LoadFromRDB(Chunk_t **chunk, struct RedisModuleIO *io) {
+    return loadFromRDB(chunk, io, 2);
+}
+
+int Compressed_LoadStreamFromRDB(CompressedChunk **chunk, struct RedisModuleIO *io) {
+    return loadFromRDB((Chunk_t **)chunk, io, 1);
+}
+
 void Compressed_MRSerialize(Chunk_t *chunk, WriteSerializationCtx *sctx) {
     Compressed_Serialize(chunk,
                          sctx,
@@ -576,6 +623,7 @@ void Compressed_MRSerialize(Chunk_t *chunk, WriteSerializationCtx *sctx) {
 int Compressed_MRDeserialize(Chunk_t **chunk, ReaderSerializationCtx *sctx) {
     CompressedChunk *compchunk = (CompressedChunk *)malloc(sizeof(*compchunk));
 
+    compchunk->refCount = 1;
     compchunk->data = NULL;
     compchunk->size = MR_SerializationCtxReadLongLongWrapper(sctx);
     compchunk->count = MR_SerializationCtxReadLongLongWrapper(sctx);
@@ -20,7 +20,10 @@
 Chunk_t *Compressed_NewChunk(size_t size);
 void Compressed_FreeChunk(Chunk_t *chunk);
 Chunk_t *Compressed_CloneChunk(const Chunk_t *chunk);
+Chunk_t *Compressed_RetainChunk(Chunk_t *chunk);
+bool Compressed_IsChunkShared(const Chunk_t *chunk);
 Chunk_t *Compressed_SplitChunk(Chunk_t *chunk);
+void Compressed_ResizeChunk(Chunk_t *chunk, size_t newSize);
 int Compressed_DefragChunk(RedisModuleDefragCtx *ctx,
                            void *data,
                            unsigned char *key,
@@ -53,6 +56,8 @@ double Compressed_GetLastValue(Chunk_t *chunk);
 // RDB
 void Compressed_SaveToRDB(Chunk_t *chunk, struct RedisModuleIO *io);
 int Compressed_LoadFromRDB(Chunk_t **chunk, struct RedisModuleIO *io);
+// Same as Compressed_LoadFromRDB for a timestamp or value column stream (see gorilla.h)
+int Compressed_LoadStreamFromRDB(CompressedChunk **chunk, struct RedisModuleIO *io);
 
 // LibMR
 void Compressed_MRSerialize(Chunk_t *chunk, WriteSerializationCtx *sctx);
@@ -12,6 +12,7 @@
 #include "libmr_integration.h"
 #include "module.h"
 #include "parse_policies.h"
+#include "query_cache.h"
 #include "query_language.h"
 #include "RedisModulesSDK/redismodule.h"
 
@@ -49,6 +50,19 @@ void InitConfig(void) {
     TSGlobalConfig.libmrProtocol = LIBMR_PROTOCOL_DEFAULT;
     TSGlobalConfig.password = NULL;
     TSGlobalConfig.topologyEvents = !RTS_IsEnterprise();
+    TSGlobalConfig.asyncCompaction = false;
+    TSGlobalConfig.compactionMaxLag = ASYNC_COMPACTION_MAX_LAG_DEFAULT;
+    TSGlobalConfig.notifyBatchEvent = false;
+    TSGlobalConfig.rollupRouting = false;
+    TSGlobalConfig.chunkAutoTargetSamples = CHUNK_AUTO_TARGET_SAMPLES_DEFAULT;
+    TSGlobalConfig.chunkAutoTargetSpan = 0;
+    TSGlobalConfig.queryThreads = 0;
+    TSGlobalConfig.mrangeBatchSize = 0;
+    TSGlobalConfig.shardLockBudget = 0;
+    TSGlobalConfig.labelSummaryTTL = 0;
+    TSGlobalConfig.cursorPageSize = CURSOR_PAGE_SIZE_DEFAULT;
+    TSGlobalConfig.cursorTTL = CURSOR_TTL_DEFAULT;
+    TSGlobalConfig.queryCacheMaxMemory = 0;
 
     if (getConfigStringCache) {
         RedisModule_FreeString(rts_staticCtx, getConfigStringCache);
@@ -343,6 +357,12 @@ static int setModernStringConfigValue(const char *name,
 static int getModernBoolConfigValue(const char *name, void *privdata) {
     if (!strcasecmp("ts-topology-events", name)) {
         return TSGlobalConfig.topologyEvents;
+    } else if (!strcasecmp("ts-compaction-async", name)) {
+        return TSGlobalConfig.asyncCompaction;
+    } else if (!strcasecmp("ts-notify-batch-event", name)) {
+        return TSGlobalConfig.notifyBatchEvent;
+    } else if (!strcasecmp("ts-rollup-routing", name)) {
+        return TSGlobalConfig.rollupRouting;
     }
 
     return 0;
@@ -359,6 +379,18 @@ static int setModernBoolConfigValue(const char *name,
     if (!strcasecmp("ts-topology-events", name)) {
         TSGlobalConfig.topologyEvents = value;
 
+        return REDISMODULE_OK;
+    } else if (!strcasecmp("ts-compaction-async", name)) {
+        TSGlobalConfig.asyncCompaction = value;
+
+        return REDISMODULE_OK;
+    } else if (!strcasecmp("ts-notify-batch-event", name)) {
+        TSGlobalConfig.notifyBatchEvent = value;
+
+        return REDISMODULE_OK;
+    } else if (!strcasecmp("ts-rollup-routing", name)) {
+        TSGlobalConfig.rollupRouting = value;
+
         return REDISMODULE_OK;
     }
 
@@ -374,6 +406,26 @@ static long long getModernIntegerConfigValue(const char *name, void *privdata) {
         return TSGlobalConfig.chunkSizeBytes;
     } else if (!strcasecmp("ts-ignore-max-time-diff", name)) {
         return TSGlobalConfig.ignoreMaxTimeDiff;
+    } else if (!strcasecmp("ts-compaction-async-max-lag", name)) {
+        return TSGlobalConfig.compactionMaxLag;
+    } else if (!strcasecmp("ts-chunk-auto-target-samples", name)) {
+        return TSGlobalConfig.chunkAutoTargetSamples;
+    } else if (!strcasecmp("ts-chunk-auto-target-span", name)) {
+        return TSGlobalConfig.chunkAutoTargetSpan;
+    } else if (!strcasecmp("ts-query-threads", name)) {
+        return TSGlobalConfig.queryThreads;
+    } else if (!strcasecmp("ts-mrange-batch-size", name)) {
+        return TSGlobalConfig.mrangeBatchSize;
+    } else if (!strcasecmp("ts-shard-lock-budget", name)) {
+        return TSGlobalConfig.shardLockBudget;
+    } else if (!strcasecmp("ts-label-summary-ttl", name)) {
+        return TSGlobalConfig.labelSummaryTTL;
+    } else if (!strcasecmp("ts-cursor-page-size", name)) {
+        return TSGlobalConfig.cursorPageSize;
+    } else if (!strcasecmp("ts-cursor-ttl", name)) {
+        return TSGlobalConfig.cursorTTL;
+    } else if (!strcasecmp("ts-query-cache-max-memory", name)) {
+        return TSGlobalConfig.queryCacheMaxMemory;
     }
 
     return 0;
@@ -416,6 +468,47 @@ static int setModernIntegerConfigValue(const char *name,
 
         TSGlobalConfig.ignoreMaxTimeDiff = value;
 
+        return REDISMODULE_OK;
+    } else if (!strcasecmp("ts-compaction-async-max-lag", name)) {
+        TSGlobalConfig.compactionMaxLag = value;
+
+        return REDISMODULE_OK;
+    } else if (!strcasecmp("ts-chunk-auto-target-samples", name)) {
+        TSGlobalConfig.chunkAutoTargetSamples = value;
+
+        return REDISMODULE_OK;
+    } else if (!strcasecmp("ts-chunk-auto-target-span", name)) {
+        TSGlobalConfig.chunkAutoTargetSpan = value;
+
+        return REDISMODULE_OK;
+    } else if (!strcasecmp("ts-query-threads", name)) {
+        TSGlobalConfig.queryThreads = value;
+
+        return REDISMODULE_OK;
+    } else if (!strcasecmp("ts-mrange-batch-size", name)) {
+        TSGlobalConfig.mrangeBatchSize = value;
+
+        return REDISMODULE_OK;
+    } else if (!strcasecmp("ts-shard-lock-budget", name)) {
+        TSGlobalConfig.shardLockBudget = value;
+
+        return REDISMODULE_OK;
+    } else if (!strcasecmp("ts-label-summary-ttl", name)) {
+        TSGlobalConfig.labelSummaryTTL = value;
+
+        return REDISMODULE_OK;
+    } else if (!strcasecmp("ts-cursor-page-size", name)) {
+        TSGlobalConfig.cursorPageSize = value;
+
+        return REDISMODULE_OK;
+    } else if (!strcasecmp("ts-cursor-ttl", name)) {
+        TSGlobalConfig.cursorTTL = value;
+
+        return REDISMODULE_OK;
+    } else if (!strcasecmp("ts-query-cache-max-memory", name)) {
+        TSGlobalConfig.queryCacheMaxMemory = value;
+        QueryCache_Evict();
+
         return REDISMODULE_OK;
     }
 
@@ -624,6 +717,273 @@ bool RegisterModernConfigurationOptions(RedisModuleCtx *ctx) {
                     12,
                     TSGlobalConfig.topologyEvents ? "true" : "false");
 
+    if (RedisModule_RegisterBoolConfig(ctx,
+                                       "ts-compaction-async",
+                                       TSGlobalConfig.asyncCompaction,
+                                       REDISMODULE_CONFIG_UNPREFIXED,
+                                       getModernBoolConfigValue,
+                                       setModernBoolConfigValue,
+                                       NULL,
+                                       NULL)) {
+        return false;
+    }
+
+    RedisModule_Log(ctx,
+                    "notice",
+                    "\t{ %-*s: %*s }",
+                    23,
+                    "ts-compaction-async",
+                    12,
+                    TSGlobalConfig.asyncCompaction ? "true" : "false");
+
+    if (RedisModule_RegisterNumericConfig(ctx,
+                                          "ts-compaction-async-max-lag",
+                                          TSGlobalConfig.compactionMaxLag,
+                                          REDISMODULE_CONFIG_UNPREFIXED,
+                                          ASYNC_COMPACTION_MAX_LAG_MIN,
+                                          ASYNC_COMPACTION_MAX_LAG_MAX,
+                                          getModernIntegerConfigValue,
+                                          setModernIntegerConfigValue,
+                                          NULL,
+                                          NULL)) {
+        return false;
+    }
+
+    RedisModule_Log(ctx,
+                    "notice",
+                    "\t{ %-*s: %*lld }",
+                    23,
+                    "ts-compaction-async-max-lag",
+                    12,
+                    TSGlobalConfig.compactionMaxLag);
+
+    if (RedisModule_RegisterNumericConfig(ctx,
+                                          "ts-chunk-auto-target-samples",
+                                          TSGlobalConfig.chunkAutoTargetSamples,
+                                          REDISMODULE_CONFIG_UNPREFIXED,
+                                          CHUNK_AUTO_TARGET_SAMPLES_MIN,
+                                          CHUNK_AUTO_TARGET_SAMPLES_MAX,
+                                          getModernIntegerConfigValue,
+                                          setModernIntegerConfigValue,
+                                          NULL,
+                                          NULL)) {
+        return false;
+    }
+
+    RedisModule_Log(ctx,
+                    "notice",
+                    "\t{ %-*s: %*lld }",
+                    23,
+                    "ts-chunk-auto-target-samples",
+                    12,
+                    TSGlobalConfig.chunkAutoTargetSamples);
+
+    if (RedisModule_RegisterNumericConfig(ctx,
+                                          "ts-chunk-auto-target-span",
+                                          TSGlobalConfig.chunkAutoTargetSpan,
+                                          REDISMODULE_CONFIG_UNPREFIXED,
+                                          CHUNK_AUTO_TARGET_SPAN_MIN,
+                                          CHUNK_AUTO_TARGET_SPAN_MAX,
+                                          getModernIntegerConfigValue,
+                                          setModernIntegerConfigValue,
+                                          NULL,
+                                          NULL)) {
+        return false;
+    }
+
+    RedisModule_Log(ctx,
+                    "notice",
+                    "\t{ %-*s: %*lld }",
+                    23,
+                    "ts-chunk-auto-target-span",
+                    12,
+                    TSGlobalConfig.chunkAutoTargetSpan);
+
+    if (RedisModule_RegisterNumericConfig(ctx,
+                                          "ts-query-threads",
+                                          TSGlobalConfig.queryThreads,
+                                          REDISMODULE_CONFIG_UNPREFIXED,
+                                          QUERY_THREADS_MIN,
+                                          QUERY_THREADS_MAX,
+                                          getModernIntegerConfigValue,
+                                          setModernIntegerConfigValue,
+                                          NULL,
+                                          NULL)) {
+        return false;
+    }
+
+    RedisModule_Log(ctx,
+                    "notice",
+                    "\t{ %-*s: %*lld }",
+                    23,
+                    "ts-query-threads",
+                    12,
+                    TSGlobalConfig.queryThreads);
+
+    if (RedisModule_RegisterNumericConfig(ctx,
+                                          "ts-mrange-batch-size",
+                                          TSGlobalConfig.mrangeBatchSize,
+                                          REDISMODULE_CONFIG_UNPREFIXED,
+                                          MRANGE_BATCH_SIZE_MIN,
+                                          MRANGE_BATCH_SIZE_MAX,
+                                          getModernIntegerConfigValue,
+                                          setModernIntegerConfigValue,
+                                          NULL,
+                                          NULL)) {
+        return false;
+    }
+
+    RedisModule_Log(ctx,
+                    "notice",
+                    "\t{ %-*s: %*lld }",
+                    23,
+                    "ts-mrange-batch-size",
+                    12,
+                    TSGlobalConfig.mrangeBatchSize);
+
+    if (RedisModule_RegisterNumericConfig(ctx,
+                                          "ts-shard-lock-budget",
+                                          TSGlobalConfig.shardLockBudget,
+                                          REDISMODULE_CONFIG_UNPREFIXED,
+                                          SHARD_LOCK_BUDGET_MIN,
+                                          SHARD_LOCK_BUDGET_MAX,
+                                          getModernIntegerConfigValue,
+                                          setModernIntegerConfigValue,
+                                          NULL,
+                                          NULL)) {
+        return false;
+    }
+
+    RedisModule_Log(ctx,
+                    "notice",
+                    "\t{ %-*s: %*lld }",
+                    23,
+                    "ts-shard-lock-budget",
+                    12,
+                    TSGlobalConfig.shardLockBudget);
+
+    if (RedisModule_RegisterNumericConfig(ctx,
+                                          "ts-label-summary-ttl",
+                                          TSGlobalConfig.labelSummaryTTL,
+                                          REDISMODULE_CONFIG_UNPREFIXED,
+                                          LABEL_SUMMARY_TTL_MIN,
+                                          LABEL_SUMMARY_TTL_MAX,
+                                          getModernIntegerConfigValue,
+                                          setModernIntegerConfigValue,
+                                          NULL,
+                                          NULL)) {
+        return false;
+    }
+
+    RedisModule_Log(ctx,
+                    "notice",
+                    "\t{ %-*s: %*lld }",
+                    23,
+                    "ts-label-summary-ttl",
+                    12,
+                    TSGlobalConfig.labelSummaryTTL);
+
+    if (RedisModule_RegisterNumericConfig(ctx,
+                                          "ts-cursor-page-size",
+                                          TSGlobalConfig.cursorPageSize,
+                                          REDISMODULE_CONFIG_UNPREFIXED,
+                                          CURSOR_PAGE_SIZE_MIN,
+                                          CURSOR_PAGE_SIZE_MAX,
+                                          getModernIntegerConfigValue,
+                                          setModernIntegerConfigValue,
+                                          NULL,
+                                          NULL)) {
+        return false;
+    }
+
+    RedisModule_Log(ctx,
+                    "notice",
+                    "\t{ %-*s: %*lld }",
+                    23,
+                    "ts-cursor-page-size",
+                    12,
+                    TSGlobalConfig.cursorPageSize);
+
+    if (RedisModule_RegisterNumericConfig(ctx,
+                                          "ts-cursor-ttl",
+                                          TSGlobalConfig.cursorTTL,
+                                          REDISMODULE_CONFIG_UNPREFIXED,
+                                          CURSOR_TTL_MIN,
+                                          CURSOR_TTL_MAX,
+                                          getModernIntegerConfigValue,
+                                          setModernIntegerConfigValue,
+                                          NULL,
+                                          NULL)) {
+        return false;
+    }
+
+    RedisModule_Log(ctx,
+                    "notice",
+                    "\t{ %-*s: %*lld }",
+                    23,
+                    "ts-cursor-ttl",
+                    12,
+                    TSGlobalConfig.cursorTTL);
+
+    if (RedisModule_RegisterBoolConfig(ctx,
+                                       "ts-notify-batch-event",
+                                       TSGlobalConfig.notifyBatchEvent,
+                                       REDISMODULE_CONFIG_UNPREFIXED,
+                                       getModernBoolConfigValue,
+                                       setModernBoolConfigValue,
+                                       NULL,
+                                       NULL)) {
+        return false;
+    }
+
+    RedisModule_Log(ctx,
+                    "notice",
+                    "\t{ %-*s: %*s }",
+                    23,
+                    "ts-notify-batch-event",
+                    12,
+                    TSGlobalConfig.notifyBatchEvent ? "true" : "false");
+
+    if (RedisModule_RegisterBoolConfig(ctx,
+                                       "ts-rollup-routing",
+                                       TSGlobalConfig.rollupRouting,
+                                       REDISMODULE_CONFIG_UNPREFIXED,
+                                       getModernBoolConfigValue,
+                                       setModernBoolConfigValue,
+                                       NULL,
+                                       NULL)) {
+        return false;
+    }
+
+    RedisModule_Log(ctx,
+                    "notice",
+                    "\t{ %-*s: %*s }",
+                    23,
+                    "ts-rollup-routing",
+                    12,
+                    TSGlobalConfig.rollupRouting ? "true" : "false");
+
+    if (RedisModule_RegisterNumericConfig(ctx,
+                                          "ts-query-cache-max-memory",
+                                          TSGlobalConfig.queryCacheMaxMemory,
+                                          REDISMODULE_CONFIG_UNPREFIXED,
+                                          QUERY_CACHE_MAX_MEMORY_MIN,
+                                          QUERY_CACHE_MAX_MEMORY_MAX,
+                                          getModernIntegerConfigValue,
+                                          setModernIntegerConfigValue,
+                                          NULL,
+                                          NULL)) {
+        return false;
+    }
+
+    RedisModule_Log(ctx,
+                    "notice",
+                    "\t{ %-*s: %*lld }",
+                    23,
+                    "ts-query-cache-max-memory",
+                    12,
+                    TSGlobalConfig.queryCacheMaxMemory);
+
     RedisModule_Log(ctx, "notice", "]");
 
     return true;
@@ -26,6 +26,30 @@
 #define IGNORE_MAX_TIME_DIFF_MAX LLONG_MAX
 #define IGNORE_MAX_VAL_DIFF_MIN 0.0
 #define IGNORE_MAX_VAL_DIFF_MAX DBL_MAX
+#define ASYNC_COMPACTION_MAX_LAG_DEFAULT 1024
+#define ASYNC_COMPACTION_MAX_LAG_MIN 1
+#define ASYNC_COMPACTION_MAX_LAG_MAX 1048576
+#define QUERY_THREADS_MIN 0
+#define QUERY_THREADS_MAX 64
+#define MRANGE_BATCH_SIZE_MIN 0
+#define MRANGE_BATCH_SIZE_MAX 1048576
+#define SHARD_LOCK_BUDGET_MIN 0
+#define SHARD_LOCK_BUDGET_MAX 10000000
+#define LABEL_SUMMARY_TTL_MIN 0
+#define LABEL_SUMMARY_TTL_MAX 86400000
+#define CURSOR_PAGE_SIZE_DEFAULT 10000
+#define CURSOR_PAGE_SIZE_MIN 1
+#define CURSOR_PAGE_SIZE_MAX 16777216
+#define CURSOR_TTL_DEFAULT 60000
+#define CURSOR_TTL_MIN 0
+#define CURSOR_TTL_MAX 86400000
+#define QUERY_CACHE_MAX_MEMORY_MIN 0
+#define QUERY_CACHE_MAX_MEMORY_MAX LLONG_MAX
+#define CHUNK_AUTO_TARGET_SAMPLES_DEFAULT 1024
+#define CHUNK_AUTO_TARGET_SAMPLES_MIN 16
+#define CHUNK_AUTO_TARGET_SAMPLES_MAX 1048576
+#define CHUNK_AUTO_TARGET_SPAN_MIN 0
+#define CHUNK_AUTO_TARGET_SPAN_MAX LLONG_MAX
 
 typedef struct
 {
@@ -43,6 +67,23 @@ typedef struct
     long long ignoreMaxTimeDiff; // Insert filter max time diff with the last sample
     double ignoreMaxValDiff;     // Insert filter max value diff with the last sample
     bool topologyEvents;         // Subscribe to cluster topology change events
+    bool asyncCompaction;        // Run compaction rules off the write path
+    long long compactionMaxLag;  // Max pending samples per series before compacting inline
+    bool notifyBatchEvent;       // One aggregated keyspace event per batched write
+    bool rollupRouting;          // Read aggregated queries from matching compactions
+    // Worker threads for multi-series queries, 0 runs them inline. The queries that rollupRouting
+    // or the query cache may answer run inline too, see parallel_query.h
+    long long queryThreads;
+    long long mrangeBatchSize;   // Max series per shard per cluster MRANGE round, 0 disables
+    long long shardLockBudget;   // Max us the shard mappers hold the GIL at once, 0 disables
+    long long labelSummaryTTL;   // Max age (ms) of the cached shard label summaries, 0 disables
+    long long cursorPageSize;    // Max samples per MRANGE CURSOR page
+    long long cursorTTL;         // Idle time (ms) before a cursor's series set is dropped
+    // Max bytes of the buckets kept by the query cache, 0 disables it
+    long long queryCacheMaxMemory;
+    // Chunk size targets of CHUNK_SIZE AUTO series, the span (ms) takes precedence when non-zero
+    long long chunkAutoTargetSamples;
+    long long chunkAutoTargetSpan;
 } TSConfig;
 
 extern TSConfig TSGlobalConfig;
@@ -47,6 +47,7 @@
 #define RETENTION_TIME_DEFAULT 0LL
 #define Chunk_SIZE_BYTES_SECS 4096LL // fills one page 4096
 #define SPLIT_FACTOR 1.2
+#define CHUNK_SIZE_AUTO_INITIAL_BYTES 128LL // first allocation of a CHUNK_SIZE AUTO chunk
 #define DEFAULT_DUPLICATE_POLICY DP_BLOCK
 
 /* TS.Range Aggregation types */
@@ -69,6 +70,14 @@ typedef enum
     TS_AGG_TWA,
     TS_AGG_COUNT_NAN,
     TS_AGG_COUNT_ALL,
+    TS_AGG_P50,
+    TS_AGG_P90,
+    TS_AGG_P95,
+    TS_AGG_P99,
+    TS_AGG_P999,
+    TS_AGG_RATE,
+    TS_AGG_INCREASE,
+    TS_AGG_IRATE,
     TS_AGG_TYPES_MAX
 } TS_AGG_TYPES_T;
 
@@ -115,6 +124,9 @@ static inline __attribute__((always_inline)) const char *DuplicatePolicyToString
 
 #define SERIES_OPT_DEFAULT_COMPRESSION SERIES_OPT_COMPRESSED_GORILLA
 
+// chunkSizeBytes is recomputed from the observed ingest rate whenever a chunk is closed
+#define SERIES_OPT_CHUNK_SIZE_AUTO 0x4
+
 /* LibMR Protocol */
 typedef enum LibmrProtocol
 {
@@ -157,6 +169,7 @@ typedef enum
 #define TS_ADD_DUPLICATE_POLICY_ARG "ON_DUPLICATE"
 #define UNCOMPRESSED_ARG_STR "uncompressed"
 #define COMPRESSED_GORILLA_ARG_STR "compressed"
+#define CHUNK_SIZE_AUTO_ARG_STR "auto"
 
 // DC - Don't Care (Arbitrary value)
 #define DC 0
@@ -0,0 +1,264 @@
+/*
+ * Copyright (c) 2006-Present, Redis Ltd.
+ * All rights reserved.
+ *
+ * Licensed under your choice of (a) the Redis Source Available License 2.0
+ * (RSALv2); or (b) the Server Side Public License v1 (SSPLv1); or (c) the
+ * GNU Affero General Public License v3 (AGPLv3).
+ */
+#include "downsample_iterator.h"
+
+#include "enriched_chunk.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include "rmutil/alloc.h"
+
+#define DOWNSAMPLE_INITIAL_CAPACITY 64
+
+static void emitSample(DownsampleIterator *self, timestamp_t timestamp, double value) {
+    Samples *samples = &self->out->samples;
+    if (samples->num_samples == samples->size) {
+        ReallocSamplesArray(samples, max(samples->size * 2, DOWNSAMPLE_INITIAL_CAPACITY));
+    }
+    samples->timestamps[samples->num_samples] = timestamp;
+    Samples_value_at(samples, samples->num_samples, 0) = value;
+    samples->num_samples++;
+}
+
+static inline uint64_t bucketOf(const DownsampleIterator *self, timestamp_t timestamp) {
+    if (timestamp < self->firstBucketTS) {
+        return 0;
+    }
+    return min((timestamp - self->firstBucketTS) / self->bucketDuration, self->numBuckets - 1);
+}
+
+static void bucketAppend(DownsampleBucket *bucket, timestamp_t timestamp, double value) {
+    if (bucket->len == bucket->cap) {
+        bucket->cap = max(bucket->cap * 2, DOWNSAMPLE_INITIAL_CAPACITY);
+        bucket->timestamps = realloc(bucket->timestamps, bucket->cap * sizeof(timestamp_t));
+        bucket->values = realloc(bucket->values, bucket->cap * sizeof(double));
+    }
+    bucket->timestamps[bucket->len] = timestamp;
+    bucket->values[bucket->len] = value;
+    bucket->len++;
+}
+
+static void bucketAverage(const DownsampleBucket *bucket, double *x, double *y) {
+    // relative to the first timestamp, so that the sum doesn't lose precision
+    const timestamp_t base = bucket->timestamps[0];
+    double sumX = 0, sumY = 0;
+    for (size_t i = 0; i < bucket->len; ++i) {
+        sumX += (double)(int64_t)(bucket->timestamps[i] - base);
+        sumY += bucket->values[i];
+    }
+    *x = (double)base + sumX / bucket->len;
+    *y = sumY / bucket->len;
+}
+
+/************************
+ *         LTTB         *
+ ************************/
+
+// Keeps the sample of bucket forming the largest triangle with the last kept sample and (x, y)
+static void lttbSelect(DownsampleIterator *self,
+                       const DownsampleBucket *bucket,
+                       double x,
+                       double y) {
+    const double ax = (double)self->prev.timestamp;
+    const double ay = self->prev.value;
+    size_t best = 0;
+    double bestArea = -1;
+    for (size_t i = 0; i < bucket->len; ++i) {
+        // twice the area, which doesn't change the order
+        const double area = fabs((ax - x) * (bucket->values[i] - ay) -
+                                 (ax - (double)bucket->timestamps[i]) * (y - ay));
+        if (area > bestArea) {
+            bestArea = area;
+            best = i;
+        }
+    }
+    self->prev.timestamp = bucket->timestamps[best];
+    self->prev.value = bucket->values[best];
+    emitSample(self, self->prev.timestamp, self->prev.value);
+}
+
+static void lttbAdd(DownsampleIterator *self, timestamp_t timestamp, double value) {
+    if (!self->started) {
+        self->started = true;
+        self->prev.timestamp = timestamp;
+        self->prev.value = value;
+        emitSample(self, timestamp, value);
+        return;
+    }
+
+    const uint64_t index = bucketOf(self, timestamp);
+    if (self->next.len > 0 && index != self->next.index) {
+        // next is complete, its average is the third point of the triangles of cur
+        if (self->cur.len > 0) {
+            double x, y;
+            bucketAverage(&self->next, &x, &y);
+            lttbSelect(self, &self->cur, x, y);
+        }
+        DownsampleBucket complete = self->cur;
+        self->cur = self->next;
+        self->next = complete;
+        self->next.len = 0;
+    }
+    self->next.index = index;
+    bucketAppend(&self->next, timestamp, value);
+}
+
+static void lttbFinish(DownsampleIterator *self) {
+    if (self->next.len == 0) {
+        return; // at most a single sample, which is already kept
+    }
+
+    // the last sample is kept as is, and ends the triangles of the buckets before it
+    self->next.len--;
+    const timestamp_t lastTimestamp = self->next.timestamps[self->next.len];
+    const double lastValue = self->next.values[self->next.len];
+    if (self->cur.len > 0) {
+        double x = (double)lastTimestamp, y = lastValue;
+        if (self->next.len > 0) {
+            bucketAverage(&self->next, &x, &y);
+        }
+        lttbSelect(self, &self->cur, x, y);
+    }
+    if (self->next.len > 0) {
+        lttbSelect(self, &self->next, (double)lastTimestamp, lastValue);
+    }
+    emitSample(self, lastTimestamp, lastValue);
+}
+
+/************************
+ *          M4          *
+ ************************/
+
+static void m4Flush(DownsampleIterator *self) {
+    if (!self->hasBucket) {
+        return;
+    }
+    self->hasBucket = false;
+
+    // in the order of the query, every sample once
+    Sample kept[4] = { self->first, self->min, self->max, self->last };
+    for (size_t i = 1; i < 4; ++i) {
+        const Sample sample = kept[i];
+        size_t j = i;
+        while (j > 0 && (self->reverse ? kept[j - 1].timestamp < sample.timestamp
+                                       : kept[j - 1].timestamp > sample.timestamp)) {
+            kept[j] = kept[j - 1];
+            --j;
+        }
+        kept[j] = sample;
+    }
+    for (size_t i = 0; i < 4; ++i) {
+        if (i == 0 || kept[i].timestamp != kept[i - 1].timestamp) {
+            emitSample(self, kept[i].timestamp, kept[i].value);
+        }
+    }
+}
+
+static void m4Add(DownsampleIterator *self, timestamp_t timestamp, double value) {
+    const uint64_t index = bucketOf(self, timestamp);
+    if (self->hasBucket && index != self->bucketIndex) {
+        m4Flush(self);
+    }
+
+    const Sample sample = { .timestamp = timestamp, .value = value };
+    if (!self->hasBucket) {
+        self->hasBucket = true;
+        self->bucketIndex = index;
+        self->first = self->last = self->min = self->max = sample;
+        return;
+    }
+    self->last = sample;
+    if (value < self->min.value) {
+        self->min = sample;
+    }
+    if (value > self->max.value) {
+        self->max = sample;
+    }
+}
+
+EnrichedChunk *DownsampleIterator_GetNextChunk(struct AbstractIterator *iter) {
+    DownsampleIterator *self = (DownsampleIterator *)iter;
+    ResetEnrichedChunk(self->out);
+    self->out->rev = self->reverse;
+
+    while (self->out->samples.num_samples == 0 && !self->done) {
+        EnrichedChunk *chunk = self->base.input->GetNext(self->base.input);
+        if (!chunk) {
+            self->done = true;
+            if (self->type == DOWNSAMPLE_LTTB) {
+                lttbFinish(self);
+            } else {
+                m4Flush(self);
+            }
+            break;
+        }
+
+        const Samples *samples = &chunk->samples;
+        for (size_t i = 0; i < samples->num_samples; ++i) {
+            const double value = Samples_value_at(samples, i, 0);
+            if (isnan(value)) {
+                continue;
+            }
+            if (self->type == DOWNSAMPLE_LTTB) {
+                lttbAdd(self, samples->timestamps[i], value);
+            } else {
+                m4Add(self, samples->timestamps[i], value);
+            }
+        }
+    }
+
+    return self->out->samples.num_samples > 0 ? self->out : NULL;
+}
+
+DownsampleIterator *DownsampleIterator_New(AbstractIterator *input,
+                                           const DownsampleArgs *args,
+                                           Series *series,
+                                           timestamp_t start,
+                                           timestamp_t end,
+                                           bool reverse) {
+    DownsampleIterator *iter = calloc(1, sizeof(*iter));
+    iter->base.GetNext = DownsampleIterator_GetNextChunk;
+    iter->base.Close = DownsampleIterator_Close;
+    iter->base.input = input;
+    iter->type = args->type;
+    iter->reverse = reverse;
+    iter->out = NewEnrichedChunk();
+
+    // The buckets span the samples in the range rather than the range, which is usually open
+    timestamp_t first = start, last = end;
+    if (series->totalSamples > 0) {
+        Chunk_t *chunk = NULL;
+        RedisModuleDictIter *dictIter =
+            RedisModule_DictIteratorStartC(series->chunks, "^", NULL, 0);
+        if (RedisModule_DictNextC(dictIter, NULL, (void **)&chunk)) {
+            first = max(start, series->funcs->GetFirstTimestamp(chunk));
+        }
+        RedisModule_DictIteratorStop(dictIter);
+        last = min(end, series->lastTimestamp);
+    }
+    if (last < first) {
+        last = first;
+    }
+
+    iter->numBuckets = args->type == DOWNSAMPLE_LTTB ? args->points - 2 : args->points / 4;
+    iter->firstBucketTS = first;
+    iter->bucketDuration = (last - first) / iter->numBuckets + 1;
+    return iter;
+}
+
+void DownsampleIterator_Close(struct AbstractIterator *iterator) {
+    DownsampleIterator *self = (DownsampleIterator *)iterator;
+    iterator->input->Close(iterator->input);
+    FreeEnrichedChunk(self->out);
+    free(self->cur.timestamps);
+    free(self->cur.values);
+    free(self->next.timestamps);
+    free(self->next.values);
+    free(self);
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2006-Present, Redis Ltd.
+ * All rights reserved.
+ *
+ * Licensed under your choice of (a) the Redis Source Available License 2.0
+ * (RSALv2); or (b) the Server Side Public License v1 (SSPLv1); or (c) the
+ * GNU Affero General Public License v3 (AGPLv3).
+ */
+#ifndef DOWNSAMPLE_ITERATOR_H
+#define DOWNSAMPLE_ITERATOR_H
+
+#include "abstract_iterator.h"
+#include "query_language.h"
+#include "tsdb.h"
+
+/*
+ * TS.RANGE/TS.MRANGE ... AGGREGATION lttb|m4 points
+ *
+ * Downsamples the samples of a series for plotting, keeping some of its samples as they are
+ * instead of replacing every bucket by a value. The range of the series is split into buckets of
+ * equal duration, so a single pass over the samples is enough:
+ *
+ * lttb (Largest-Triangle-Three-Buckets) keeps the first and the last samples, and from each of the
+ *      points - 2 buckets in between the sample forming the largest triangle with the sample kept
+ *      from the previous bucket and the average of the next bucket. Only two buckets of samples
+ *      are held at a time.
+ * m4   keeps the first, last, minimum and maximum samples of each of points / 4 buckets.
+ *
+ * At most points samples are replied, fewer when some buckets are empty. NaN samples are skipped.
+ */
+
+typedef struct DownsampleBucket
+{
+    timestamp_t *timestamps;
+    double *values;
+    size_t len;
+    size_t cap;
+    uint64_t index;
+} DownsampleBucket;
+
+typedef struct DownsampleIterator
+{
+    AbstractIterator base;
+    DownsampleType type;
+    bool reverse;
+    bool done;
+    timestamp_t firstBucketTS;
+    timestamp_t bucketDuration;
+    uint64_t numBuckets;
+    EnrichedChunk *out;
+    // lttb: the last kept sample, the bucket to choose from and the bucket after it
+    bool started;
+    Sample prev;
+    DownsampleBucket cur;
+    DownsampleBucket next;
+    // m4: the first, last, minimum and maximum samples of the current bucket
+    bool hasBucket;
+    uint64_t bucketIndex;
+    Sample first, last, min, max;
+} DownsampleIterator;
+
+// start and end are the range of the query, narrowed to the samples of series to size the buckets
+DownsampleIterator *DownsampleIterator_New(AbstractIterator *input,
+                                           const DownsampleArgs *args,
+                                           Series *series,
+                                           timestamp_t start,
+                                           timestamp_t end,
+                                           bool reverse);
+EnrichedChunk *DownsampleIterator_GetNextChunk(struct AbstractIterator *iter);
+void DownsampleIterator_Close(struct AbstractIterator *iterator);
+
+#endif // DOWNSAMPLE_ITERATOR_H
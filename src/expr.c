@@ -0,0 +1,280 @@
+/*
+ * Copyright (c) 2006-Present, Redis Ltd.
+ * All rights reserved.
+ *
+ * Licensed under your choice of (a) the Redis Source Available License 2.0
+ * (RSALv2); or (b) the Server Side Public License v1 (SSPLv1); or (c) the
+ * GNU Affero General Public License v3 (AGPLv3).
+ */
+#include "expr.h"
+
+#include "common.h"
+
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "rmutil/alloc.h"
+
+// Parentheses and unary minus, bounding the recursion of the parser
+#define EXPR_MAX_NESTING 64
+#define EXPR_MAX_COLUMN (1 << 16)
+#define EXPR_MAX_NUMBER_LEN 64
+
+#define EXPR_ERROR(msg) RTS_ERR " TSDB: invalid EXPR, " msg
+
+typedef struct ExprParser
+{
+    const char *p;
+    const char *end;
+    ExprInstr *code;
+    size_t len;
+    size_t cap;
+    size_t depth;
+    size_t maxDepth;
+    size_t nesting;
+    size_t numColumns;
+    const char *error;
+} ExprParser;
+
+static void emit(ExprParser *parser, ExprInstr instr) {
+    ExprInstr *last = parser->len > 0 ? &parser->code[parser->len - 1] : NULL;
+    if (instr.op == EXPR_OP_NEG && last && last->op == EXPR_OP_CONST) {
+        last->constant = -last->constant;
+        return;
+    }
+    if (instr.op >= EXPR_OP_ADD && parser->len > 1 && last->op == EXPR_OP_CONST &&
+        parser->code[parser->len - 2].op == EXPR_OP_CONST) {
+        // both operands are constants
+        const double b = last->constant;
+        double *a = &parser->code[parser->len - 2].constant;
+        switch (instr.op) {
+            case EXPR_OP_ADD:
+                *a += b;
+                break;
+            case EXPR_OP_SUB:
+                *a -= b;
+                break;
+            case EXPR_OP_MUL:
+                *a *= b;
+                break;
+            default:
+                *a /= b;
+                break;
+        }
+        parser->len--;
+        parser->depth--;
+        return;
+    }
+
+    if (instr.op == EXPR_OP_COLUMN || instr.op == EXPR_OP_CONST) {
+        if (++parser->depth > parser->maxDepth) {
+            parser->maxDepth = parser->depth;
+        }
+    } else if (instr.op != EXPR_OP_NEG) {
+        parser->depth--;
+    }
+    if (parser->len == parser->cap) {
+        parser->cap = parser->cap ? parser->cap * 2 : 16;
+        parser->code = realloc(parser->code, parser->cap * sizeof(*parser->code));
+    }
+    parser->code[parser->len++] = instr;
+}
+
+static char peek(ExprParser *parser) {
+    while (parser->p < parser->end && isspace((unsigned char)*parser->p)) {
+        parser->p++;
+    }
+    return parser->p < parser->end ? *parser->p : '\0';
+}
+
+static bool parseSum(ExprParser *parser);
+
+static bool parseNumber(ExprParser *parser) {
+    char buf[EXPR_MAX_NUMBER_LEN + 1];
+    size_t n = 0;
+    while (parser->p < parser->end && n < EXPR_MAX_NUMBER_LEN &&
+           (isdigit((unsigned char)*parser->p) || *parser->p == '.' || *parser->p == 'e' ||
+            *parser->p == 'E' ||
+            ((*parser->p == '+' || *parser->p == '-') && n > 0 &&
+             (buf[n - 1] == 'e' || buf[n - 1] == 'E')))) {
+        buf[n++] = *parser->p++;
+    }
+    buf[n] = '\0';
+    char *numEnd;
+    const double value = strtod(buf, &numEnd);
+    if (n == 0 || numEnd != buf + n) {
+        parser->error = EXPR_ERROR("bad number");
+        return false;
+    }
+    emit(parser, (ExprInstr){ .op = EXPR_OP_CONST, .constant = value });
+    return true;
+}
+
+static bool parseColumn(ExprParser *parser) {
+    parser->p++; // $
+    size_t column = 0;
+    const char *start = parser->p;
+    while (parser->p < parser->end && isdigit((unsigned char)*parser->p)) {
+        column = column * 10 + (*parser->p++ - '0');
+        if (column >= EXPR_MAX_COLUMN) {
+            parser->error = EXPR_ERROR("column out of range");
+            return false;
+        }
+    }
+    if (parser->p == start) {
+        parser->error = EXPR_ERROR("expected a column number after $");
+        return false;
+    }
+    if (column + 1 > parser->numColumns) {
+        parser->numColumns = column + 1;
+    }
+    emit(parser, (ExprInstr){ .op = EXPR_OP_COLUMN, .column = column });
+    return true;
+}
+
+// unary := '-' unary | '(' sum ')' | '$' digits | number
+static bool parseUnary(ExprParser *parser) {
+    const char c = peek(parser);
+    if (c == '-' || c == '(') {
+        if (++parser->nesting > EXPR_MAX_NESTING) {
+            parser->error = EXPR_ERROR("nested too deeply");
+            return false;
+        }
+        parser->p++;
+        if (c == '-') {
+            if (!parseUnary(parser)) {
+                return false;
+            }
+            emit(parser, (ExprInstr){ .op = EXPR_OP_NEG });
+        } else {
+            if (!parseSum(parser)) {
+                return false;
+            }
+            if (peek(parser) != ')') {
+                parser->error = EXPR_ERROR("missing )");
+                return false;
+            }
+            parser->p++;
+        }
+        parser->nesting--;
+        return true;
+    }
+    if (c == '$') {
+        return parseColumn(parser);
+    }
+    if (isdigit((unsigned char)c) || c == '.') {
+        return parseNumber(parser);
+    }
+    parser->error = EXPR_ERROR("expected a column, a number or (");
+    return false;
+}
+
+// product := unary (('*' | '/') unary)*
+static bool parseProduct(ExprParser *parser) {
+    if (!parseUnary(parser)) {
+        return false;
+    }
+    char c;
+    while ((c = peek(parser)) == '*' || c == '/') {
+        parser->p++;
+        if (!parseUnary(parser)) {
+            return false;
+        }
+        emit(parser, (ExprInstr){ .op = c == '*' ? EXPR_OP_MUL : EXPR_OP_DIV });
+    }
+    return true;
+}
+
+// sum := product (('+' | '-') product)*
+static bool parseSum(ExprParser *parser) {
+    if (!parseProduct(parser)) {
+        return false;
+    }
+    char c;
+    while ((c = peek(parser)) == '+' || c == '-') {
+        parser->p++;
+        if (!parseProduct(parser)) {
+            return false;
+        }
+        emit(parser, (ExprInstr){ .op = c == '+' ? EXPR_OP_ADD : EXPR_OP_SUB });
+    }
+    return true;
+}
+
+Expr *Expr_Compile(const char *src, size_t len, const char **error) {
+    ExprParser parser = { .p = src, .end = src + len };
+    if (parseSum(&parser) && (peek(&parser), parser.p != parser.end)) {
+        parser.error = EXPR_ERROR("unexpected character");
+    }
+    if (parser.error) {
+        free(parser.code);
+        *error = parser.error;
+        return NULL;
+    }
+
+    Expr *expr = malloc(sizeof(*expr));
+    expr->code = parser.code;
+    expr->len = parser.len;
+    expr->stackDepth = parser.maxDepth;
+    expr->numColumns = parser.numColumns;
+    return expr;
+}
+
+void Expr_Free(Expr *expr) {
+    if (!expr) {
+        return;
+    }
+    free(expr->code);
+    free(expr);
+}
+
+// a op= b over n values
+#define EXPR_BINARY_LOOP(a, b, n, op)                                                              \
+    for (size_t j = 0; j < (n); ++j) {                                                             \
+        (a)[j] op(b)[j];                                                                           \
+    }
+
+void Expr_Eval(const Expr *expr, const double *columns, size_t n, double *stack) {
+    size_t sp = 0; // the vectors on the stack
+    for (size_t i = 0; i < expr->len; ++i) {
+        const ExprInstr *instr = &expr->code[i];
+        if (instr->op == EXPR_OP_COLUMN || instr->op == EXPR_OP_CONST) {
+            double *top = stack + sp++ * EXPR_BATCH_SIZE;
+            if (instr->op == EXPR_OP_COLUMN) {
+                memcpy(top, columns + instr->column * EXPR_BATCH_SIZE, n * sizeof(*top));
+            } else {
+                for (size_t j = 0; j < n; ++j) {
+                    top[j] = instr->constant;
+                }
+            }
+            continue;
+        }
+        if (instr->op == EXPR_OP_NEG) {
+            double *top = stack + (sp - 1) * EXPR_BATCH_SIZE;
+            for (size_t j = 0; j < n; ++j) {
+                top[j] = -top[j];
+            }
+            continue;
+        }
+
+        // the binary operators combine the two vectors on top into the first one
+        sp--;
+        double *restrict a = stack + (sp - 1) * EXPR_BATCH_SIZE;
+        const double *restrict b = stack + sp * EXPR_BATCH_SIZE;
+        switch (instr->op) {
+            case EXPR_OP_ADD:
+                EXPR_BINARY_LOOP(a, b, n, +=);
+                break;
+            case EXPR_OP_SUB:
+                EXPR_BINARY_LOOP(a, b, n, -=);
+                break;
+            case EXPR_OP_MUL:
+                EXPR_BINARY_LOOP(a, b, n, *=);
+                break;
+            default:
+                EXPR_BINARY_LOOP(a, b, n, /=);
+                break;
+        }
+    }
+}
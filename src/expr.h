@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2006-Present, Redis Ltd.
+ * All rights reserved.
+ *
+ * Licensed under your choice of (a) the Redis Source Available License 2.0
+ * (RSALv2); or (b) the Server Side Public License v1 (SSPLv1); or (c) the
+ * GNU Affero General Public License v3 (AGPLv3).
+ */
+#ifndef EXPR_H
+#define EXPR_H
+
+#include <stddef.h>
+
+/*
+ * TS.NRANGE/TS.NREVRANGE ... EXPR expression
+ *
+ * An arithmetic expression over the value columns of the pivoted rows, e.g. "($0 - $1) / $2 * 100":
+ *
+ * $N          the value column N of the row, counting the aggregators of every key
+ * number      a constant
+ * + - * /     with the usual precedence, and unary minus
+ * ( )
+ *
+ * The expression is compiled once into a stack bytecode, constant subexpressions folded, and every
+ * instruction is run over a batch of rows at a time. A NaN column, such as a key without a sample
+ * at the timestamp, makes the result NaN, and a division by zero gives an infinity.
+ */
+
+// The rows evaluated at a time
+#define EXPR_BATCH_SIZE 256
+
+typedef enum ExprOpcode
+{
+    EXPR_OP_COLUMN,
+    EXPR_OP_CONST,
+    EXPR_OP_NEG,
+    EXPR_OP_ADD,
+    EXPR_OP_SUB,
+    EXPR_OP_MUL,
+    EXPR_OP_DIV,
+} ExprOpcode;
+
+typedef struct ExprInstr
+{
+    ExprOpcode op;
+    size_t column;   // EXPR_OP_COLUMN
+    double constant; // EXPR_OP_CONST
+} ExprInstr;
+
+typedef struct Expr
+{
+    ExprInstr *code;
+    size_t len;
+    size_t stackDepth; // the vectors needed to evaluate it
+    size_t numColumns; // 1 + the highest column used
+} Expr;
+
+// Returns NULL and sets error to a static error reply when the expression is invalid
+Expr *Expr_Compile(const char *src, size_t len, const char **error);
+void Expr_Free(Expr *expr);
+
+// Evaluates the rows [0, n) of columns, where column c starts at columns + c * EXPR_BATCH_SIZE.
+// stack holds stackDepth * EXPR_BATCH_SIZE values, and the results are left at its start.
+void Expr_Eval(const Expr *expr, const double *columns, size_t n, double *stack);
+
+#endif // EXPR_H
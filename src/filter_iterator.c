@@ -267,10 +267,13 @@ AggregationIterator *AggregationIterator_New(struct AbstractIterator *input,
     iter->startTimestamp = startTimestamp;
     iter->endTimestamp = endTimestamp;
     iter->hasTwa = false;
+    iter->hasEdgeAggs = false;
     for (size_t i = 0; i < numAggregations; i++) {
         if (aggregations[i]->type == TS_AGG_TWA) {
             iter->hasTwa = true;
-            break;
+        }
+        if (AggTypeUsesBucketEdges(aggregations[i]->type)) {
+            iter->hasEdgeAggs = true;
         }
     }
     iter->handled_empty_prefix = false;
@@ -980,7 +983,7 @@ static void agg_iter_init_if_needed(AggregationIterator *self,
         CalcBucketStart(init_ts, aggregationTimeDelta, self->timestampAlignment);
     self->initialized = true;
 
-    if (self->hasTwa) {
+    if (self->hasEdgeAggs) {
         timestamp_t ta = twa_calc_ta(self->reverse,
                                      BucketStartNormalize(self->aggregationLastTimestamp),
                                      self->aggregationLastTimestamp + aggregationTimeDelta,
@@ -992,7 +995,7 @@ static void agg_iter_init_if_needed(AggregationIterator *self,
                                      self->startTimestamp,
                                      self->endTimestamp);
         for (size_t a = 0; a < self->numAggregations; a++) {
-            if (self->aggregations[a].type == TS_AGG_TWA) {
+            if (AggTypeUsesBucketEdges(self->aggregations[a].type)) {
                 self->aggregations[a].addBucketParams(self->aggregationContexts[a],
                                                       (!self->reverse) ? ta : tb,
                                                       (!self->reverse) ? tb : ta);
@@ -1000,7 +1003,7 @@ static void agg_iter_init_if_needed(AggregationIterator *self,
         }
     }
 
-    if (self->hasTwa && !((!is_reversed) && init_ts == 0)) {
+    if (self->hasEdgeAggs && !((!is_reversed) && init_ts == 0)) {
         RangeArgs args = {
             .aggregationArgs = { 0 },
             .filterByValueArgs = self->byValueArgs,
@@ -1011,11 +1014,11 @@ static void agg_iter_init_if_needed(AggregationIterator *self,
         };
         AbstractSampleIterator *sample_iterator =
             SeriesCreateSampleIterator(self->series, &args, !is_reversed, true);
-        // Skip NaN samples - they shouldn't be used for TWA interpolation
+        // Skip NaN samples - they shouldn't be used for interpolation
         while (sample_iterator->GetNext(sample_iterator, sample) == CR_OK) {
             if (!isnan(sample->value)) {
                 for (size_t a = 0; a < self->numAggregations; a++) {
-                    if (self->aggregations[a].type == TS_AGG_TWA) {
+                    if (AggTypeUsesBucketEdges(self->aggregations[a].type)) {
                         self->aggregations[a].addPrevBucketLastSample(
                             self->aggregationContexts[a], sample->value, sample->timestamp);
                     }
@@ -1195,16 +1198,16 @@ static int agg_iter_general_on_bucket_boundary(AggregationIterator *self,
                                                Sample *twa_last_samples,
                                                bool *twaHadValid) {
     for (size_t a = 0; a < self->numAggregations; a++) {
-        if (self->aggregations[a].type == TS_AGG_TWA &&
+        if (AggTypeUsesBucketEdges(self->aggregations[a].type) &&
             self->aggregations[a].isValueValid(sample->value)) {
             self->aggregations[a].addNextBucketFirstSample(
                 self->aggregationContexts[a], sample->value, sample->timestamp);
         }
     }
 
-    if (self->hasTwa) {
+    if (self->hasEdgeAggs) {
         for (size_t a = 0; a < self->numAggregations; a++) {
-            if (self->aggregations[a].type == TS_AGG_TWA) {
+            if (AggTypeUsesBucketEdges(self->aggregations[a].type)) {
                 twaHadValid[a] = self->validPerAgg[a];
                 self->aggregations[a].getLastSample(self->aggregationContexts[a],
                                                     &twa_last_samples[a]);
@@ -1247,14 +1250,14 @@ static int agg_iter_general_on_bucket_boundary(AggregationIterator *self,
     }
     agg_iter_advance_context_scope(self, aggregationTimeDelta, contextScope);
 
-    if (self->hasTwa) {
+    if (self->hasEdgeAggs) {
         timestamp_t tb = twa_calc_tb(self->reverse,
                                      self->aggregationLastTimestamp,
                                      *contextScope,
                                      self->startTimestamp,
                                      self->endTimestamp);
         for (size_t a = 0; a < self->numAggregations; a++) {
-            if (self->aggregations[a].type == TS_AGG_TWA) {
+            if (AggTypeUsesBucketEdges(self->aggregations[a].type)) {
                 if (twaHadValid[a] &&
                     self->aggregations[a].isValueValid(twa_last_samples[a].value)) {
                     self->aggregations[a].addPrevBucketLastSample(self->aggregationContexts[a],
@@ -1360,7 +1363,7 @@ static EnrichedChunk *agg_iter_finalize(AggregationIterator *self,
                                         Sample *sample) {
     self->hasUnFinalizedContext = false;
     for (size_t a = 0; a < self->numAggregations; a++) {
-        if (self->aggregations[a].type == TS_AGG_TWA) {
+        if (AggTypeUsesBucketEdges(self->aggregations[a].type)) {
             Sample last_sample;
             self->aggregations[a].getLastSample(self->aggregationContexts[a], &last_sample);
             if (!(is_reversed && last_sample.timestamp == 0)) {
@@ -1581,3 +1584,45 @@ void AggregationIterator_Close(struct AbstractIterator *iterator) {
     FreeEnrichedChunk(self->aux_chunk);
     free(iterator);
 }
+
+ConcatIterator *ConcatIterator_New(AbstractIterator *head,
+                                   AbstractIterator *middle,
+                                   AbstractIterator *tail,
+                                   bool reverse) {
+    ConcatIterator *iter = malloc(sizeof(ConcatIterator));
+    iter->base.GetNext = ConcatIterator_GetNextChunk;
+    iter->base.Close = ConcatIterator_Close;
+    iter->base.input = NULL;
+    iter->numSegments = 0;
+    iter->current = 0;
+    AbstractIterator *const segments[CONCAT_MAX_SEGMENTS] = { reverse ? tail : head,
+                                                              middle,
+                                                              reverse ? head : tail };
+    for (size_t i = 0; i < CONCAT_MAX_SEGMENTS; i++) {
+        if (segments[i]) {
+            iter->segments[iter->numSegments++] = segments[i];
+        }
+    }
+    return iter;
+}
+
+EnrichedChunk *ConcatIterator_GetNextChunk(struct AbstractIterator *iter) {
+    ConcatIterator *self = (ConcatIterator *)iter;
+    while (self->current < self->numSegments) {
+        AbstractIterator *segment = self->segments[self->current];
+        EnrichedChunk *chunk = segment->GetNext(segment);
+        if (chunk) {
+            return chunk;
+        }
+        self->current++;
+    }
+    return NULL;
+}
+
+void ConcatIterator_Close(struct AbstractIterator *iterator) {
+    ConcatIterator *self = (ConcatIterator *)iterator;
+    for (size_t i = 0; i < self->numSegments; i++) {
+        self->segments[i]->Close(self->segments[i]);
+    }
+    free(iterator);
+}
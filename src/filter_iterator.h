@@ -58,7 +58,8 @@ typedef struct AggregationIterator
     Series *series;
     api_timestamp_t startTimestamp;
     api_timestamp_t endTimestamp;
-    bool hasTwa; // precomputed: any aggregation is TWA
+    bool hasTwa;      // precomputed: any aggregation is TWA
+    bool hasEdgeAggs; // precomputed: any aggregation is TWA, rate, increase or irate
     bool handled_empty_prefix;
     bool handled_empty_suffix;
     timestamp_t prev_ts;
@@ -88,4 +89,25 @@ AggregationIterator *AggregationIterator_New(struct AbstractIterator *input,
 EnrichedChunk *AggregationIterator_GetNextChunk(struct AbstractIterator *iter);
 void AggregationIterator_Close(struct AbstractIterator *iterator);
 
+#define CONCAT_MAX_SEGMENTS 3
+
+// Consecutive ranges of a query read from different sources, see rollup_route.h and
+// query_cache.h
+typedef struct ConcatIterator
+{
+    AbstractIterator base;
+    AbstractIterator *segments[CONCAT_MAX_SEGMENTS];
+    size_t numSegments;
+    size_t current;
+} ConcatIterator;
+
+// head, middle and tail follow each other in time, any of them may be NULL. They're read in the
+// order of the reply, and closed along with the iterator.
+ConcatIterator *ConcatIterator_New(AbstractIterator *head,
+                                   AbstractIterator *middle,
+                                   AbstractIterator *tail,
+                                   bool reverse);
+EnrichedChunk *ConcatIterator_GetNextChunk(struct AbstractIterator *iter);
+void ConcatIterator_Close(struct AbstractIterator *iterator);
+
 #endif // FILTER_ITERATOR_H
@@ -12,7 +12,10 @@ static const ChunkFuncs regChunk = {
     .FreeChunk = Uncompressed_FreeChunk,
     .SplitChunk = Uncompressed_SplitChunk,
     .CloneChunk = Uncompressed_CloneChunk,
+    .RetainChunk = Uncompressed_RetainChunk,
+    .IsChunkShared = Uncompressed_IsChunkShared,
     .DefragChunk = Uncompressed_DefragChunk,
+    .ResizeChunk = Uncompressed_ResizeChunk,
 
     .AddSample = Uncompressed_AddSample,
     .UpsertSample = Uncompressed_UpsertSample,
@@ -36,8 +39,11 @@ static const ChunkFuncs comprChunk = {
     .NewChunk = Compressed_NewChunk,
     .FreeChunk = Compressed_FreeChunk,
     .CloneChunk = Compressed_CloneChunk,
+    .RetainChunk = Compressed_RetainChunk,
+    .IsChunkShared = Compressed_IsChunkShared,
     .SplitChunk = Compressed_SplitChunk,
     .DefragChunk = Compressed_DefragChunk,
+    .ResizeChunk = Compressed_ResizeChunk,
 
     .AddSample = Compressed_AddSample,
     .UpsertSample = Compressed_UpsertSample,
@@ -48,10 +48,18 @@ typedef struct UpsertCtx
 typedef struct ChunkFuncs
 {
     Chunk_t *(*NewChunk)(size_t sampleCount);
+    // Drops a reference to the chunk, the last one frees it
     void (*FreeChunk)(Chunk_t *chunk);
     Chunk_t *(*CloneChunk)(const Chunk_t *chunk);
+    // Snapshots share the chunks of the series instead of cloning them. A reference is taken
+    // under the GIL or through another reference, while a snapshot may drop its own on a query
+    // thread. The series clones a shared chunk before modifying it, see SeriesUnshareChunk.
+    Chunk_t *(*RetainChunk)(Chunk_t *chunk);
+    bool (*IsChunkShared)(const Chunk_t *chunk);
     Chunk_t *(*SplitChunk)(Chunk_t *chunk);
     RedisModuleDefragDictValueCallback DefragChunk;
+    // Grows the chunk to newSize bytes. A newSize not above the current size shrinks it to fit.
+    void (*ResizeChunk)(Chunk_t *chunk, size_t newSize);
 
     size_t (*DelRange)(Chunk_t *chunk, timestamp_t startTs, timestamp_t endTs);
     ChunkResult (*AddSample)(Chunk_t *chunk, Sample *sample);
@@ -442,6 +442,57 @@ ChunkResult Compressed_Append(CompressedChunk *chunk, timestamp_t timestamp, dou
     return CR_OK;
 }
 
+/*
+ * Single column variants of Compressed_Append, used by wide series where a chunk holds one
+ * timestamp stream and one value stream per field. A timestamp stream only encodes the
+ * timestamps of its samples and a value stream only their values; both are regular
+ * CompressedChunk buffers, the unused half of the header is left untouched.
+ */
+ChunkResult Compressed_AppendTimestamp(CompressedChunk *chunk, timestamp_t timestamp) {
+    if (chunk->count == 0) {
+        chunk->baseTimestamp = chunk->prevTimestamp = timestamp;
+        chunk->prevTimestampDelta = 0;
+    } else {
+        uint64_t idx = chunk->idx;
+        uint64_t prevTimestamp = chunk->prevTimestamp;
+        int64_t prevTimestampDelta = chunk->prevTimestampDelta;
+        if (appendInteger(chunk, timestamp) != CR_OK) {
+            zero_bits(chunk->data, chunk->size, idx, chunk->idx);
+            chunk->idx = idx;
+            chunk->prevTimestamp = prevTimestamp;
+            chunk->prevTimestampDelta = prevTimestampDelta;
+            return CR_END;
+        }
+    }
+    chunk->count++;
+    return CR_OK;
+}
+
+ChunkResult Compressed_AppendValue(CompressedChunk *chunk, double value) {
+    if (isnan(value)) {
+        union64bits canonical_nan;
+        canonical_nan.u = CANONICAL_NAN_BITS;
+        value = canonical_nan.d;
+    }
+
+    if (chunk->count == 0) {
+        chunk->baseValue.d = chunk->prevValue.d = value;
+    } else {
+        // appendFloat writes its control bit unchecked, relying on appendInteger for it
+        if (!isSpaceAvailable(chunk, 1)) {
+            return CR_END;
+        }
+        uint64_t idx = chunk->idx;
+        if (appendFloat(chunk, value) != CR_OK) {
+            zero_bits(chunk->data, chunk->size, idx, chunk->idx);
+            chunk->idx = idx;
+            return CR_END;
+        }
+    }
+    chunk->count++;
+    return CR_OK;
+}
+
 /********************************** READ *********************************/
 /*
  * This function decodes timestamps inserted by appendInteger.
@@ -548,3 +599,30 @@ ChunkResult Compressed_ChunkIteratorGetNext(ChunkIter_t *abstractIter, Sample *s
     iter->count++;
     return CR_OK;
 }
+
+void Compressed_DecodeTimestamps(const CompressedChunk *chunk, timestamp_t *out) {
+    if (chunk->count == 0) {
+        return;
+    }
+    Compressed_Iterator iter = { .idx = 0, .prevDelta = 0, .prevTS = chunk->baseTimestamp };
+    const uint64_t *bins = chunk->data;
+    out[0] = chunk->baseTimestamp;
+    for (uint64_t i = 1; i < chunk->count; ++i) {
+        out[i] = iter.prevTS +=
+            Bins_bitoff(bins, iter.idx++) ? iter.prevDelta : readInteger(&iter, bins);
+    }
+}
+
+void Compressed_DecodeValues(const CompressedChunk *chunk, double *out) {
+    if (chunk->count == 0) {
+        return;
+    }
+    Compressed_Iterator iter = {
+        .idx = 0, .prevValue = chunk->baseValue, .leading = 32, .trailing = 32, .blocksize = 0
+    };
+    const uint64_t *bins = chunk->data;
+    out[0] = chunk->baseValue.d;
+    for (uint64_t i = 1; i < chunk->count; ++i) {
+        out[i] = Bins_bitoff(bins, iter.idx++) ? iter.prevValue.d : readFloat(&iter, bins);
+    }
+}
@@ -50,6 +50,8 @@ typedef struct CompressedChunk
     union64bits prevValue;
     uint8_t prevLeading;
     uint8_t prevTrailing;
+
+    uint32_t refCount; // the series and the snapshots sharing the chunk, see RetainChunk
 } CompressedChunk;
 
 typedef struct Compressed_Iterator
@@ -72,4 +74,11 @@ typedef struct Compressed_Iterator
 ChunkResult Compressed_Append(CompressedChunk *chunk, uint64_t timestamp, double value);
 ChunkResult Compressed_ChunkIteratorGetNext(ChunkIter_t *iter, Sample *sample);
 
+// Column streams (see wide_series.h): a chunk holding only timestamps or only values.
+ChunkResult Compressed_AppendTimestamp(CompressedChunk *chunk, timestamp_t timestamp);
+ChunkResult Compressed_AppendValue(CompressedChunk *chunk, double value);
+// Decode all the samples of a column stream, out must hold chunk->count entries.
+void Compressed_DecodeTimestamps(const CompressedChunk *chunk, timestamp_t *out);
+void Compressed_DecodeValues(const CompressedChunk *chunk, double *out);
+
 #endif
@@ -33,9 +33,15 @@ typedef enum
     Indexer_Remove = 0x2,
 } INDEXER_OPERATION_T;
 
+// Bumped whenever an entry is added to or removed from labelsIndex, see IndexLabelSummary. It
+// starts at a random value, so that a restarted shard doesn't repeat the versions of its last run.
+static uint64_t labelsIndexVersion = 0;
+
 void IndexInit() {
     labelsIndex = RedisModule_CreateDict(NULL);
     tsLabelIndex = RedisModule_CreateDict(NULL);
+    RedisModule_GetRandomBytes((unsigned char *)&labelsIndexVersion, sizeof(labelsIndexVersion));
+    labelsIndexVersion++;
 }
 
 static int DefragIndexLeaf(RedisModuleDefragCtx *ctx,
@@ -187,6 +193,7 @@ static inline void labelsIndexRemoveTsKey(RedisModuleDict *leaf,
     if (RedisModule_DictSize(leaf) == 0) {
         RedisModule_FreeDict(NULL, leaf);
         RedisModule_DictDel(_labelsIndex, key, NULL);
+        labelsIndexVersion++;
     }
 }
 
@@ -200,6 +207,7 @@ void labelIndexUnderKey(INDEXER_OPERATION_T op,
     if (nokey) {
         leaf = RedisModule_CreateDict(NULL);
         RedisModule_DictSet(_labelsIndex, key, leaf);
+        labelsIndexVersion++;
     }
 
     RedisModuleDict *ts_leaf = RedisModule_DictGet(_tsLabelIndex, ts_key, &nokey);
@@ -276,12 +284,69 @@ void RemoveAllIndexedMetrics_generic(RedisModuleDict *_labelsIndex,
     RedisModule_DictIteratorStop(iter);
     RedisModule_FreeDict(NULL, *_tsLabelIndex);
     *_tsLabelIndex = RedisModule_CreateDict(NULL);
+    labelsIndexVersion++;
 }
 
 void RemoveAllIndexedMetrics() {
     RemoveAllIndexedMetrics_generic(labelsIndex, &tsLabelIndex);
 }
 
+const LabelSummary *IndexLabelSummary() {
+    static LabelSummary *summary = NULL;
+    static uint64_t summaryVersion = 0;
+    if (summary && summaryVersion == labelsIndexVersion) {
+        return summary;
+    }
+
+    if (!summary) {
+        summary = malloc(sizeof(*summary));
+    }
+    memset(summary, 0, sizeof(*summary));
+    RedisModuleDictIter *iter = RedisModule_DictIteratorStartC(labelsIndex, "^", NULL, 0);
+    char *entry;
+    size_t entryLen;
+    while ((entry = RedisModule_DictNextC(iter, &entryLen, NULL)) != NULL) {
+        LabelSummary_Add(summary, entry, entryLen);
+    }
+    RedisModule_DictIteratorStop(iter);
+    summaryVersion = labelsIndexVersion;
+    return summary;
+}
+
+uint64_t IndexLabelsVersion() {
+    return labelsIndexVersion;
+}
+
+static bool summaryMayContain(const LabelSummary *summary, RedisModuleString *entry) {
+    size_t len;
+    const char *buf = RedisModule_StringPtrLen(entry, &len);
+    const bool found = LabelSummary_MayContain(summary, buf, len);
+    RedisModule_FreeString(NULL, entry);
+    return found;
+}
+
+bool LabelSummaryMayMatch(const LabelSummary *summary, const QueryPredicateList *predicates) {
+    for (size_t i = 0; i < predicates->count; i++) {
+        const QueryPredicate *predicate = &predicates->list[i];
+        const char *key = RedisModule_StringPtrLen(predicate->key, NULL);
+        bool found = !IS_INCLUSION(predicate->type);
+        if (predicate->type == CONTAINS) {
+            found = summaryMayContain(summary, RedisModule_CreateStringPrintf(NULL, K_PREFIX, key));
+        }
+        if (predicate->type == EQ || predicate->type == LIST_MATCH) {
+            for (size_t j = 0; !found && j < predicate->valueListCount; j++) {
+                const char *value = RedisModule_StringPtrLen(predicate->valuesList[j], NULL);
+                found = summaryMayContain(
+                    summary, RedisModule_CreateStringPrintf(NULL, KV_PREFIX, key, value));
+            }
+        }
+        if (!found) {
+            return false;
+        }
+    }
+    return true;
+}
+
 int IsKeyIndexed(RedisModuleString *ts_key) {
     int nokey;
     RedisModule_DictGet(tsLabelIndex, ts_key, &nokey);
@@ -9,6 +9,7 @@
 #ifndef INDEXER_H
 #define INDEXER_H
 
+#include "label_summary.h"
 #include "RedisModulesSDK/redismodule.h"
 
 #include <stdint.h>
@@ -103,4 +104,11 @@ void QueryLabelsFromIndex(const char *tsKey,
                           void *userData);
 
 int CountPredicateType(QueryPredicateList *queries, PredicateType type);
+
+// The summary of the entries of the local label index, rebuilt only after the index changed
+const LabelSummary *IndexLabelSummary();
+// Changes whenever an entry is added to or removed from the local label index
+uint64_t IndexLabelsVersion();
+// Returns false when no series holding the entries of the summary can match the predicates
+bool LabelSummaryMayMatch(const LabelSummary *summary, const QueryPredicateList *predicates);
 #endif
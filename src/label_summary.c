@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2006-Present, Redis Ltd.
+ * All rights reserved.
+ *
+ * Licensed under your choice of (a) the Redis Source Available License 2.0
+ * (RSALv2); or (b) the Server Side Public License v1 (SSPLv1); or (c) the
+ * GNU Affero General Public License v3 (AGPLv3).
+ */
+#include "label_summary.h"
+
+#include "rmutil/alloc.h"
+
+// FNV-1a followed by the splitmix64 finalizer, whose two halves seed the double hashing
+static uint64_t hashEntry(const char *entry, size_t len) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (uint8_t)entry[i];
+        h *= 0x100000001b3ULL;
+    }
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebULL;
+    h ^= h >> 31;
+    return h;
+}
+
+static inline uint32_t bitOf(uint64_t h, uint32_t i) {
+    const uint32_t h1 = (uint32_t)h, h2 = (uint32_t)(h >> 32) | 1;
+    return (h1 + i * h2) % LABEL_SUMMARY_BITS;
+}
+
+void LabelSummary_Add(LabelSummary *summary, const char *entry, size_t len) {
+    const uint64_t h = hashEntry(entry, len);
+    for (uint32_t i = 0; i < LABEL_SUMMARY_HASHES; i++) {
+        const uint32_t bit = bitOf(h, i);
+        summary->bits[bit / 8] |= 1 << (bit % 8);
+    }
+}
+
+bool LabelSummary_MayContain(const LabelSummary *summary, const char *entry, size_t len) {
+    const uint64_t h = hashEntry(entry, len);
+    for (uint32_t i = 0; i < LABEL_SUMMARY_HASHES; i++) {
+        const uint32_t bit = bitOf(h, i);
+        if (!(summary->bits[bit / 8] & (1 << (bit % 8)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void LabelSummary_Merge(LabelSummary *dst, const LabelSummary *src) {
+    for (size_t i = 0; i < sizeof(dst->bits); i++) {
+        dst->bits[i] |= src->bits[i];
+    }
+}
@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) 2006-Present, Redis Ltd.
+ * All rights reserved.
+ *
+ * Licensed under your choice of (a) the Redis Source Available License 2.0
+ * (RSALv2); or (b) the Server Side Public License v1 (SSPLv1); or (c) the
+ * GNU Affero General Public License v3 (AGPLv3).
+ */
+#ifndef LABEL_SUMMARY_H
+#define LABEL_SUMMARY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * A bloom filter over the entries of a shard's label index.
+ *
+ * Every shard publishes the summary of its index (TS.INTERNAL_LABEL_SUMMARY), along with the
+ * version of the index, and the coordinator caches them for ts-label-summary-ttl milliseconds.
+ * A multi-shard query lists the shards whose summary rules its filter out. Such a shard replies
+ * with no series without querying its index, unless its index changed since the summary was taken.
+ * The filter is a byte array, so it is the same on shards of any endianness.
+ */
+
+#define LABEL_SUMMARY_BITS (1 << 18)
+#define LABEL_SUMMARY_HASHES 4
+
+typedef struct LabelSummary
+{
+    uint8_t bits[LABEL_SUMMARY_BITS / 8];
+} LabelSummary;
+
+void LabelSummary_Add(LabelSummary *summary, const char *entry, size_t len);
+bool LabelSummary_MayContain(const LabelSummary *summary, const char *entry, size_t len);
+// Adds the entries of src to dst
+void LabelSummary_Merge(LabelSummary *dst, const LabelSummary *src);
+
+#endif // LABEL_SUMMARY_H
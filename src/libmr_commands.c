@@ -3,12 +3,14 @@
 #include "LibMR/src/utils/arr.h"
 #include "LibMR/src/mr.h"
 #include "LibMR/src/cluster.h"
+#include "common.h"
 #include "consts.h"
 #include "libmr_integration.h"
 #include "module.h"
 #include "query_language.h"
 #include "reply.h"
 #include "resultset.h"
+#include "topk.h"
 #include "utils/blocked_client.h"
 
 #include "rmutil/alloc.h"
@@ -135,6 +137,10 @@ static void *collect_node_results(ExecutionCtx *eCtx, RedisModuleCtx *ctx) {
             nodesResults = array_append(nodesResults, r); // keep full record for numAggClasses
             continue;
         }
+        if (r->recordType == GetPartialGroupListRecordType()) {
+            nodesResults = array_append(nodesResults, r); // the groups are taken from the record
+            continue;
+        }
         if (r->recordType == GetStringListRecordType()) {
             StringListRecord *record = (StringListRecord *)r;
             nodesResults = array_append(nodesResults, record->stringList);
@@ -164,100 +170,313 @@ __error:
 }
 
 // Build coordinator RangeArgs from the original args: open the time window so the coordinator
-// accepts all pre-aggregated buckets from shards, skip re-aggregation, and clear FILTERBY
-// (shards already applied it per-series before reducing).
+// accepts all pre-aggregated buckets from shards, skip re-aggregation, and clear FILTERBY and
+// WINDOW (shards already applied them per-series before reducing).
 static RangeArgs RangeArgsSkipReAggregation(const RangeArgs *src) {
     RangeArgs a = *src;
     a.skipAggregation = true;
     a.filterByValueArgs.hasValue = false;
     a.filterByTSArgs.hasValue = false;
+    a.window.type = WINDOW_NONE;
     a.startTimestamp = 0;
     a.endTimestamp = UINT64_MAX;
     return a;
 }
 
-static void mrange_done_internal(ExecutionCtx *eCtx, RedisModuleCtx *ctx, MRangeData *data) {
+static QueryPredicates_Arg *MRangeQueryArg(const MRangeArgs *args,
+                                           const RedisModuleString *userName) {
+    QueryPredicates_Arg *queryArg = calloc(1, sizeof *queryArg);
+    queryArg->shouldReturnNull = false;
+    queryArg->refCount = 1;
+    queryArg->count = args->queryPredicates->count;
+    queryArg->startTimestamp = args->rangeArgs.startTimestamp;
+    queryArg->endTimestamp = args->rangeArgs.endTimestamp;
+    queryArg->latest = args->rangeArgs.latest;
+    // Atomic even though this call site is main-thread-only: LibMR's own Duplicate/ObjectFree
+    // step-arg callbacks (QueryPredicates_Duplicate/QueryPredicates_ObjectFree) touch this same
+    // ref from their own execution threads over the object's life, so every mutation site has
+    // to stay atomic for the count to be consistent (see QueryPredicateList_Free in indexer.c).
+    __atomic_add_fetch(&args->queryPredicates->ref, 1, __ATOMIC_RELAXED);
+    queryArg->predicates = args->queryPredicates;
+    queryArg->withLabels = args->withLabels;
+    queryArg->limitLabelsSize = args->numLimitLabels;
+    queryArg->limitLabels = calloc(args->numLimitLabels, sizeof *queryArg->limitLabels);
+    memcpy(queryArg->limitLabels,
+           args->limitLabels,
+           args->numLimitLabels * sizeof *queryArg->limitLabels);
+    for (int i = 0; i < queryArg->limitLabelsSize; i++) {
+        RedisModule_RetainString(NULL, queryArg->limitLabels[i]);
+    }
+
+    queryArg->userName = userName ? RedisModule_CreateStringFromString(NULL, userName) : NULL;
+    queryArg->excludeEmpty = args->excludeEmpty;
+    // Always send FILTERBY to shards; they apply it regardless of aggregation.
+    queryArg->filterByValueArgs = args->rangeArgs.filterByValueArgs;
+    queryArg->filterByTSArgs = args->rangeArgs.filterByTSArgs;
+    // Push aggregation to every shard for all cases (single-agg and multi-agg).
+    // Multi-agg + GROUPBY is rejected at parse time, so no special case is needed.
+    if (args->rangeArgs.aggregationArgs.numClasses > 0) {
+        queryArg->numAggClasses = args->rangeArgs.aggregationArgs.numClasses;
+        for (size_t i = 0; i < args->rangeArgs.aggregationArgs.numClasses; i++)
+            queryArg->aggTypes[i] = args->rangeArgs.aggregationArgs.classes[i]->type;
+        queryArg->aggTimeDelta = args->rangeArgs.aggregationArgs.timeDelta;
+        queryArg->aggBucketTS = args->rangeArgs.aggregationArgs.bucketTS;
+        queryArg->aggEmpty = args->rangeArgs.aggregationArgs.empty;
+        queryArg->alignment = args->rangeArgs.alignment;
+        queryArg->timestampAlignment = args->rangeArgs.timestampAlignment;
+    } else {
+        queryArg->numAggClasses = 0;
+    }
+    queryArg->downsample = args->rangeArgs.downsample;
+    queryArg->window = args->rangeArgs.window;
+    if (args->reverse && !args->groupByLabel) {
+        // the windows follow the order of the reply, the shards reply forward: the coordinator
+        // runs them once the series are reversed, see mrange_done_internal
+        queryArg->window.type = WINDOW_NONE;
+    }
+    // The shards encode their series in a blob, see series_blob.h (TS.INTERNAL_MRANGE only)
+    queryArg->binaryReply = true;
+    // GROUPBY is reduced on the shards (INTERNAL protocol only)
+    queryArg->groupByReducer = TS_AGG_NONE;
+    if (args->groupByLabel) {
+        queryArg->groupByReducer = args->groupByReducerArgs.agg_type;
+        queryArg->groupByLabel =
+            RedisModule_CreateString(NULL, args->groupByLabel, strlen(args->groupByLabel));
+    }
+    return queryArg;
+}
+
+// Merges the partial states of the groups of all the shards and finalizes the reducer
+static void mrange_done_internal_grouped(RedisModuleCtx *ctx,
+                                         ARR(PartialGroupListRecord *) nodesResults,
+                                         MRangeArgs *args) {
+    TS_ResultSet *resultset = ResultSet_Create();
+    ResultSet_GroupbyLabel(resultset, args->groupByLabel);
+    array_foreach(nodesResults, record, {
+        for (size_t g = 0; g < array_len(record->groups); g++) {
+            ResultSet_AddPartialGroup(
+                resultset, record->groups[g], args->groupByReducerArgs.agg_type);
+            record->groups[g] = NULL; // owned by the result set
+        }
+    });
+
+    // The shards already aggregated, filtered and handled the latest flag
+    RangeArgs coordArgs = RangeArgsSkipReAggregation(&args->rangeArgs);
+    coordArgs.latest = false;
+    ResultSet_ApplyReducer(ctx, resultset, &coordArgs, &args->groupByReducerArgs);
+
+    // Do not apply the aggregation on the resultset, do apply max results on the final result
+    RangeArgs minimizedArgs = RangeArgs_ZeroProcessing(&coordArgs);
+
+    replyResultSet(ctx,
+                   resultset,
+                   args->withLabels,
+                   args->limitLabels,
+                   args->numLimitLabels,
+                   &minimizedArgs,
+                   args->reverse);
+    ResultSet_Free(resultset);
+}
+
+static void MRangeData_Free(MRangeData *data) {
+    MRangeArgs_Free(&data->args);
+    if (data->userName)
+        RedisModule_FreeString(NULL, data->userName);
+    for (size_t i = 0; i < data->cursorsCount; i++)
+        RedisModule_FreeString(NULL, data->cursors[i]);
+    free(data->cursors);
+    free(data);
+}
+
+static void mrange_done(ExecutionCtx *eCtx, void *privateData);
+
+// Ends the reply of a batched query after the error of a failed round, which took the place of
+// the next series
+static void mrange_end_with_error(RedisModuleCtx *ctx, const MRangeData *data) {
+    if (_ReplyMap(ctx))
+        RedisModule_ReplyWithNull(ctx);
+    ReplySetMapOrArrayLength(ctx, data->replyLen + 1, false);
+}
+
+static int compare_slot_range_values(const void *a, const void *b) {
+    const RedisModuleSlotRange *ra = a, *rb = b;
+    return (int)ra->start - (int)rb->start;
+}
+
+// Identifies the slots of every shard of a round. A round whose slots moved since the first one
+// would skip or repeat the series of the moved slots, as the shards resume after their own keys.
+static uint64_t slots_fingerprint(ExecutionCtx *eCtx) {
+    uint64_t hash = 14695981039346656037ULL; // FNV-1a
+    const size_t len = MR_ExecutionCtxGetResultsLen(eCtx);
+    for (size_t i = 0; i < len; i++) {
+        Record *r = MR_ExecutionCtxGetResult(eCtx, i);
+        if (r->recordType != GetSlotRangesRecordType())
+            continue;
+        // the ranges of a shard, whatever the order they are in
+        RedisModuleSlotRangeArray *sra = ((SlotRangesRecord *)r)->slotRanges;
+        qsort(sra->ranges, sra->num_ranges, sizeof(*sra->ranges), compare_slot_range_values);
+        uint64_t shardHash = 14695981039346656037ULL;
+        for (int32_t j = 0; j < sra->num_ranges; j++) {
+            shardHash = (shardHash ^ sra->ranges[j].start) * 1099511628211ULL;
+            shardHash = (shardHash ^ sra->ranges[j].end) * 1099511628211ULL;
+        }
+        // the shards reply in any order
+        hash ^= shardHash;
+    }
+    return hash;
+}
+
+// Runs on the main thread once the previous round of a batched query is replied. The shards
+// that have more series resume after their cursor, the rest reply with nothing.
+static void mrange_next_round(void *privateData) {
+    MRangeData *data = privateData;
+    QueryPredicates_Arg *queryArg = MRangeQueryArg(&data->args, data->userName);
+    queryArg->batchSize = data->batchSize;
+    queryArg->resume = true;
+    queryArg->cursors = data->cursors; // moving ownership of the cursors to QueryPredicates_Arg
+    queryArg->cursorsCount = data->cursorsCount;
+    data->cursors = NULL;
+    data->cursorsCount = 0;
+
+    ExecutionBuilder *builder = MR_CreateEmptyExecutionBuilder();
+    MR_ExecutionBuilderInternalCommand(builder, "TS.INTERNAL_SLOT_RANGES", NULL);
+    MR_ExecutionBuilderInternalCommand(builder, "TS.INTERNAL_MRANGE", queryArg);
+
+    MRError *err = NULL;
+    Execution *exec = MR_CreateExecution(builder, &err);
+    if (err) {
+        // the error is the last element of the reply, see mrange_done_internal
+        RedisModule_ReplyWithError(data->ctx, MR_ErrorGetMessage(err));
+        mrange_end_with_error(data->ctx, data);
+        MR_FreeExecutionBuilder(builder);
+        RedisModuleBlockedClient *bc = data->bc;
+        RedisModuleCtx *ctx = data->ctx;
+        MRangeData_Free(data);
+        RTS_UnblockClient(bc, ctx);
+        return;
+    }
+
+    MR_ExecutionSetOnDoneHandler(exec, mrange_done, data);
+
+    MR_Run(exec);
+    MR_FreeExecution(exec);
+    MR_FreeExecutionBuilder(builder);
+}
+
+// Replies numKeys series of the shards, numAggTypes Series per key
+static void mrange_reply_series(RedisModuleCtx *ctx,
+                                MRangeArgs *args,
+                                const RangeArgs *replyArgs,
+                                Series **sl,
+                                size_t numKeys,
+                                size_t numAggTypes) {
+    for (size_t k = 0; k < numKeys; k++) {
+        Series **group = &sl[k * numAggTypes];
+        if (numAggTypes > 1) {
+            ReplyMultiAggSeriesGroup(ctx,
+                                     group,
+                                     numAggTypes,
+                                     args->withLabels,
+                                     args->limitLabels,
+                                     args->numLimitLabels,
+                                     replyArgs,
+                                     args->reverse);
+        } else {
+            ReplySeriesArrayPos(ctx,
+                                group[0],
+                                args->withLabels,
+                                args->limitLabels,
+                                args->numLimitLabels,
+                                replyArgs,
+                                args->reverse,
+                                false,
+                                NULL,
+                                NULL);
+        }
+    }
+}
+
+// Returns true when the next round of a batched query was scheduled, the client stays blocked
+static bool mrange_done_internal(ExecutionCtx *eCtx, RedisModuleCtx *ctx, MRangeData *data) {
     MRangeArgs *args = &data->args;
-    RedisModuleBlockedClient *bc = data->bc;
+    const bool batched = data->batchSize > 0;
+    bool nextRound = false;
 
     ARR(SeriesListRecord *) nodesResults = collect_node_results(eCtx, ctx);
-    if (!nodesResults)
+    if (!nodesResults) {
+        if (batched && data->round > 0)
+            mrange_end_with_error(ctx, data);
         goto __done;
+    }
 
-    TS_ResultSet *resultset = NULL;
     if (args->groupByLabel) {
-        resultset = ResultSet_Create();
-        ResultSet_GroupbyLabel(resultset, args->groupByLabel);
-    } else {
+        mrange_done_internal_grouped(ctx, (ARR(PartialGroupListRecord *))nodesResults, args);
+        goto __done;
+    }
+
+    // Shards always apply FILTERBY (aggregation or not); the coordinator must not re-apply it.
+    RangeArgs coordArgs = RangeArgsSkipReAggregation(&args->rangeArgs);
+    if (args->reverse) {
+        coordArgs.window = args->rangeArgs.window;
+    }
+
+    if (!batched) {
         size_t totalLen = 0;
         array_foreach(nodesResults, record, {
             size_t N = (record->numAggClasses > 1) ? record->numAggClasses : 1;
             totalLen += array_len(record->seriesList) / N;
         });
         ReplyWithMapOrArray(ctx, totalLen, false);
+        array_foreach(nodesResults, record, {
+            size_t N = (record->numAggClasses > 1) ? record->numAggClasses : 1;
+            ARR(Series *) sl = record->seriesList;
+            mrange_reply_series(ctx, args, &coordArgs, sl, array_len(sl) / N, N);
+        });
+        goto __done;
     }
 
-    // Shards always apply FILTERBY (aggregation or not); the coordinator must not re-apply it.
-    RangeArgs coordArgs = RangeArgsSkipReAggregation(&args->rangeArgs);
-    const RangeArgs *replyArgs = &coordArgs;
+    // A batched query replies with the series of each round as it comes in, and the records of
+    // the round are freed once they are replied. The reply can't be taken back, so a round that
+    // fails after the first one ends it with an error in place of the next series (with a null
+    // value in a RESP3 map): the series before the error are whole, the ones after are missing.
+    // A round whose shards own other slots than in the first round fails that way too.
+    const uint64_t fingerprint = slots_fingerprint(eCtx);
+    if (data->round == 0) {
+        // the number of series is only known after the last round
+        ReplyWithMapOrArray(ctx, REDISMODULE_POSTPONED_ARRAY_LEN, false);
+        data->slotsFingerprint = fingerprint;
+    } else if (fingerprint != data->slotsFingerprint) {
+        RTS_ReplyGeneralError(ctx, "TSDB: the cluster slots moved during a batched query");
+        mrange_end_with_error(ctx, data);
+        goto __done;
+    }
 
+    data->cursors = malloc(array_len(nodesResults) * sizeof(*data->cursors));
     array_foreach(nodesResults, record, {
+        size_t N = (record->numAggClasses > 1) ? record->numAggClasses : 1;
         ARR(Series *) sl = record->seriesList;
-        size_t numAggTypes = (record->numAggClasses > 1) ? record->numAggClasses : 1;
-        size_t numKeys = array_len(sl) / numAggTypes;
-        for (size_t k = 0; k < numKeys; k++) {
-            Series **group = &sl[k * numAggTypes];
-            if (args->groupByLabel) {
-                ResultSet_AddSeries(
-                    resultset, group[0], RedisModule_StringPtrLen(group[0]->keyName, NULL));
-            } else if (numAggTypes > 1) {
-                ReplyMultiAggSeriesGroup(ctx,
-                                         group,
-                                         numAggTypes,
-                                         args->withLabels,
-                                         args->limitLabels,
-                                         args->numLimitLabels,
-                                         replyArgs,
-                                         args->reverse);
-            } else {
-                ReplySeriesArrayPos(ctx,
-                                    group[0],
-                                    args->withLabels,
-                                    args->limitLabels,
-                                    args->numLimitLabels,
-                                    replyArgs,
-                                    args->reverse,
-                                    false,
-                                    NULL,
-                                    NULL);
-            }
+        mrange_reply_series(ctx, args, &coordArgs, sl, array_len(sl) / N, N);
+        data->replyLen += array_len(sl) / N;
+        if (record->resumeAfter) {
+            data->cursors[data->cursorsCount++] = record->resumeAfter;
+            record->resumeAfter = NULL; // owned by data
         }
     });
-
-    if (args->groupByLabel) {
-        // Apply the reducer on pre-aggregated data (agg already stripped in coordArgs)
-        RangeArgs rangeArgs = coordArgs;
-        rangeArgs.latest = false; // we already handled the latest flag in the client side
-        ResultSet_ApplyReducer(ctx, resultset, &rangeArgs, &args->groupByReducerArgs);
-
-        // Do not apply the aggregation on the resultset, do apply max results on the final result
-        RangeArgs minimizedArgs = RangeArgs_ZeroProcessing(&coordArgs);
-
-        replyResultSet(ctx,
-                       resultset,
-                       args->withLabels,
-                       args->limitLabels,
-                       args->numLimitLabels,
-                       &minimizedArgs,
-                       args->reverse);
-        ResultSet_Free(resultset);
+    data->round++;
+    if (data->cursorsCount > 0) {
+        // the execution can't be created from the LibMR thread
+        RedisModule_EventLoopAddOneShot(mrange_next_round, data);
+        nextRound = true;
+    } else {
+        ReplySetMapOrArrayLength(ctx, data->replyLen, false);
     }
 
 __done:
     if (nodesResults)
         array_free(nodesResults);
-    MRangeArgs_Free(&data->args);
-    free(data);
+    if (!nextRound)
+        MRangeData_Free(data);
+    return nextRound;
 }
 
 static void mrange_done_gears(ExecutionCtx *eCtx, RedisModuleCtx *ctx, MRangeData *data) {
@@ -365,21 +584,24 @@ static void mrange_done_gears(ExecutionCtx *eCtx, RedisModuleCtx *ctx, MRangeDat
     array_free(tempSeries);
 
 __done:
-    MRangeArgs_Free(&data->args);
-    free(data);
+    MRangeData_Free(data);
 }
 
 static void mrange_done(ExecutionCtx *eCtx, void *privateData) {
     MRangeData *data = privateData;
     RedisModuleBlockedClient *bc = data->bc;
-    RedisModuleCtx *ctx = RedisModule_GetThreadSafeContext(bc);
+    if (!data->ctx) {
+        data->ctx = RedisModule_GetThreadSafeContext(bc);
+    }
+    RedisModuleCtx *ctx = data->ctx;
 
     switch (TSGlobalConfig.libmrProtocol) {
         case LIBMR_PROTOCOL_GEARS:
             mrange_done_gears(eCtx, ctx, data);
             break;
         case LIBMR_PROTOCOL_INTERNAL:
-            mrange_done_internal(eCtx, ctx, data);
+            if (mrange_done_internal(eCtx, ctx, data))
+                return;
             break;
         default:
             RedisModule_ReplyWithError(ctx, "Unknown LibMR protocol");
@@ -550,6 +772,126 @@ static void queryindex_done(ExecutionCtx *eCtx, void *privateData) {
     RTS_UnblockClient(bc, ctx);
 }
 
+typedef struct ShardLabelSummary
+{
+    ShardIndexVersion index;
+    LabelSummary *summary;
+} ShardLabelSummary;
+
+typedef struct ClusterLabelSummaries
+{
+    size_t numShards;
+    ShardLabelSummary *shards;
+} ClusterLabelSummaries;
+
+static void ClusterLabelSummaries_Free(ClusterLabelSummaries *summaries) {
+    if (!summaries) {
+        return;
+    }
+    for (size_t i = 0; i < summaries->numShards; i++) {
+        free(summaries->shards[i].summary);
+    }
+    free(summaries->shards);
+    free(summaries);
+}
+
+// The label summaries of all the shards, see label_summary.h. It is only used on the main thread.
+static struct
+{
+    ClusterLabelSummaries *summaries; // NULL until a refresh succeeded
+    mstime_t fetchedAt;               // when the refresh that fetched the summaries started
+    mstime_t refreshStartedAt;
+    bool refreshing;
+} clusterLabelSummary;
+
+static void label_summary_install(void *privateData) {
+    ClusterLabelSummaries *summaries = privateData;
+    if (summaries) {
+        ClusterLabelSummaries_Free(clusterLabelSummary.summaries);
+        clusterLabelSummary.summaries = summaries;
+        clusterLabelSummary.fetchedAt = clusterLabelSummary.refreshStartedAt;
+    }
+    clusterLabelSummary.refreshing = false;
+}
+
+static void label_summary_done(ExecutionCtx *eCtx, void *privateData) {
+    // The summaries are only installed once every shard replied with its own, so that they all
+    // belong to the same cluster topology
+    ClusterLabelSummaries *summaries = NULL;
+    size_t len = MR_ExecutionCtxGetResultsLen(eCtx);
+    if (MR_ExecutionCtxGetErrorsLen(eCtx) == 0 && len == MR_ClusterGetSize()) {
+        summaries = calloc(1, sizeof(*summaries));
+        summaries->shards = calloc(len, sizeof(*summaries->shards));
+        for (size_t i = 0; i < len; i++) {
+            Record *r = MR_ExecutionCtxGetResult(eCtx, i);
+            if (r->recordType != GetLabelSummaryRecordType() ||
+                !((LabelSummaryRecord *)r)->summary) {
+                ClusterLabelSummaries_Free(summaries);
+                summaries = NULL;
+                break;
+            }
+            // moving ownership of the summary to the shard's entry
+            LabelSummaryRecord *record = (LabelSummaryRecord *)r;
+            ShardLabelSummary *shard = &summaries->shards[summaries->numShards++];
+            shard->index = record->index;
+            shard->summary = record->summary;
+            record->summary = NULL;
+        }
+    }
+    RedisModule_EventLoopAddOneShot(label_summary_install, summaries);
+}
+
+static void refreshClusterLabelSummary() {
+    if (clusterLabelSummary.refreshing) {
+        return;
+    }
+
+    ExecutionBuilder *builder = MR_CreateEmptyExecutionBuilder();
+    MR_ExecutionBuilderInternalCommand(builder, "TS.INTERNAL_LABEL_SUMMARY", NULL);
+    MRError *err = NULL;
+    Execution *exec = MR_CreateExecution(builder, &err);
+    if (err) {
+        MR_FreeExecutionBuilder(builder);
+        return;
+    }
+
+    clusterLabelSummary.refreshing = true;
+    clusterLabelSummary.refreshStartedAt = RedisModule_Milliseconds();
+    MR_ExecutionSetOnDoneHandler(exec, label_summary_done, NULL);
+    MR_Run(exec);
+    MR_FreeExecution(exec);
+    MR_FreeExecutionBuilder(builder);
+}
+
+// Lists in queryArg->skipShards the shards that held no series matching the predicates, according
+// to their label summaries of at most ts-label-summary-ttl ms ago. A listed shard skips the query
+// unless its label index changed since, see QueryShardIndex. Missing or expired summaries are
+// refreshed in the background.
+static void clusterLabelSummarySkipShards(QueryPredicates_Arg *queryArg) {
+    if (TSGlobalConfig.labelSummaryTTL == 0 ||
+        TSGlobalConfig.libmrProtocol != LIBMR_PROTOCOL_INTERNAL) {
+        return;
+    }
+
+    const ClusterLabelSummaries *summaries = clusterLabelSummary.summaries;
+    if (!summaries || RedisModule_Milliseconds() - clusterLabelSummary.fetchedAt >=
+                          TSGlobalConfig.labelSummaryTTL) {
+        refreshClusterLabelSummary();
+        return;
+    }
+
+    for (size_t i = 0; i < summaries->numShards; i++) {
+        const ShardLabelSummary *shard = &summaries->shards[i];
+        if (LabelSummaryMayMatch(shard->summary, queryArg->predicates)) {
+            continue;
+        }
+        if (!queryArg->skipShards) {
+            queryArg->skipShards = malloc(summaries->numShards * sizeof(*queryArg->skipShards));
+        }
+        queryArg->skipShards[queryArg->skipShardsCount++] = shard->index;
+    }
+}
+
 int TSDB_mget_MR(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     MGetArgs args;
     if (parseMGetCommand(ctx, argv, argc, &args) != REDISMODULE_OK) {
@@ -577,6 +919,7 @@ int TSDB_mget_MR(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     queryArg->resp3 = _ReplyMap(ctx);
     queryArg->userName = CopyCurrentUserName(ctx);
     queryArg->numAggClasses = 0;
+    clusterLabelSummarySkipShards(queryArg);
 
     MRError *err = NULL;
 
@@ -621,48 +964,23 @@ int TSDB_mrange_MR(RedisModuleCtx *ctx, RedisModuleString **argv, int argc, bool
     }
     args.reverse = reverse;
 
-    QueryPredicates_Arg *queryArg = calloc(1, sizeof *queryArg);
-    queryArg->shouldReturnNull = false;
-    queryArg->refCount = 1;
-    queryArg->count = args.queryPredicates->count;
-    queryArg->startTimestamp = args.rangeArgs.startTimestamp;
-    queryArg->endTimestamp = args.rangeArgs.endTimestamp;
-    queryArg->latest = args.rangeArgs.latest;
-    // Atomic even though this call site is main-thread-only: LibMR's own Duplicate/ObjectFree
-    // step-arg callbacks (QueryPredicates_Duplicate/QueryPredicates_ObjectFree) touch this same
-    // ref from their own execution threads over the object's life, so every mutation site has
-    // to stay atomic for the count to be consistent (see QueryPredicateList_Free in indexer.c).
-    __atomic_add_fetch(&args.queryPredicates->ref, 1, __ATOMIC_RELAXED);
-    queryArg->predicates = args.queryPredicates;
-    queryArg->withLabels = args.withLabels;
-    queryArg->limitLabelsSize = args.numLimitLabels;
-    queryArg->limitLabels = calloc(args.numLimitLabels, sizeof *queryArg->limitLabels);
-    memcpy(queryArg->limitLabels,
-           args.limitLabels,
-           args.numLimitLabels * sizeof *queryArg->limitLabels);
-    for (int i = 0; i < queryArg->limitLabelsSize; i++) {
-        RedisModule_RetainString(ctx, queryArg->limitLabels[i]);
+    if (args.cursor) {
+        // the rounds of ts-mrange-batch-size bound the clustered queries instead
+        RTS_ReplyGeneralError(ctx, "TSDB: CURSOR is not supported in cluster mode");
+        MRangeArgs_Free(&args);
+        return REDISMODULE_OK;
     }
 
-    queryArg->userName = CopyCurrentUserName(ctx);
-    queryArg->excludeEmpty = args.excludeEmpty;
-    // Always send FILTERBY to shards; they apply it regardless of aggregation.
-    queryArg->filterByValueArgs = args.rangeArgs.filterByValueArgs;
-    queryArg->filterByTSArgs = args.rangeArgs.filterByTSArgs;
-    // Push aggregation to every shard for all cases (single-agg and multi-agg).
-    // Multi-agg + GROUPBY is rejected at parse time, so no special case is needed.
-    if (args.rangeArgs.aggregationArgs.numClasses > 0) {
-        queryArg->numAggClasses = args.rangeArgs.aggregationArgs.numClasses;
-        for (size_t i = 0; i < args.rangeArgs.aggregationArgs.numClasses; i++)
-            queryArg->aggTypes[i] = args.rangeArgs.aggregationArgs.classes[i]->type;
-        queryArg->aggTimeDelta = args.rangeArgs.aggregationArgs.timeDelta;
-        queryArg->aggBucketTS = args.rangeArgs.aggregationArgs.bucketTS;
-        queryArg->aggEmpty = args.rangeArgs.aggregationArgs.empty;
-        queryArg->alignment = args.rangeArgs.alignment;
-        queryArg->timestampAlignment = args.rangeArgs.timestampAlignment;
-    } else {
-        queryArg->numAggClasses = 0;
+    RedisModuleString *userName = CopyCurrentUserName(ctx);
+    QueryPredicates_Arg *queryArg = MRangeQueryArg(&args, userName);
+    // Ungrouped queries can be split into rounds of at most batchSize series per shard, see
+    // mrange_next_round. GROUPBY already replies with one partial state per group.
+    size_t batchSize = 0;
+    if (TSGlobalConfig.libmrProtocol == LIBMR_PROTOCOL_INTERNAL && !args.groupByLabel) {
+        batchSize = TSGlobalConfig.mrangeBatchSize;
     }
+    queryArg->batchSize = batchSize;
+    clusterLabelSummarySkipShards(queryArg);
 
     MRError *err = NULL;
 
@@ -676,7 +994,10 @@ int TSDB_mrange_MR(RedisModuleCtx *ctx, RedisModuleString **argv, int argc, bool
         case LIBMR_PROTOCOL_INTERNAL: {
             builder = MR_CreateEmptyExecutionBuilder();
             MR_ExecutionBuilderInternalCommand(builder, "TS.INTERNAL_SLOT_RANGES", NULL);
-            MR_ExecutionBuilderInternalCommand(builder, "TS.INTERNAL_MRANGE", queryArg);
+            MR_ExecutionBuilderInternalCommand(
+                builder,
+                args.groupByLabel ? "TS.INTERNAL_MRANGE_GROUPBY" : "TS.INTERNAL_MRANGE",
+                queryArg);
             break;
         }
         default: {
@@ -688,13 +1009,17 @@ int TSDB_mrange_MR(RedisModuleCtx *ctx, RedisModuleString **argv, int argc, bool
     if (err) {
         RedisModule_ReplyWithError(ctx, MR_ErrorGetMessage(err));
         MR_FreeExecutionBuilder(builder);
+        if (userName)
+            RedisModule_FreeString(NULL, userName);
         return REDISMODULE_OK;
     }
 
     RedisModuleBlockedClient *bc = RTS_BlockClient(ctx, rts_free_rctx);
-    MRangeData *data = malloc(sizeof(struct MRangeData)); // freed by mrange_done
+    MRangeData *data = calloc(1, sizeof(struct MRangeData)); // freed by mrange_done
     data->bc = bc;
     data->args = args;
+    data->userName = userName;
+    data->batchSize = batchSize;
 
     MR_ExecutionSetOnDoneHandler(exec, mrange_done, data);
 
@@ -711,7 +1036,7 @@ int TSDB_queryindex_MR(RedisModuleCtx *ctx, QueryPredicateList *queries) {
     queryArg->count = queries->count;
     queryArg->startTimestamp = 0;
     queryArg->endTimestamp = 0;
-    __atomic_add_fetch(&queries->ref, 1, __ATOMIC_RELAXED); // see rationale in TSDB_mrange_MR above
+    __atomic_add_fetch(&queries->ref, 1, __ATOMIC_RELAXED); // see rationale in MRangeQueryArg above
     queryArg->predicates = queries;
     queryArg->withLabels = false;
     queryArg->limitLabelsSize = 0;
@@ -719,6 +1044,7 @@ int TSDB_queryindex_MR(RedisModuleCtx *ctx, QueryPredicateList *queries) {
     queryArg->resp3 = _ReplySet(ctx);
     queryArg->userName = CopyCurrentUserName(ctx);
     queryArg->numAggClasses = 0;
+    clusterLabelSummarySkipShards(queryArg);
 
     MRError *err = NULL;
 
@@ -832,7 +1158,7 @@ int TSDB_querylabels_MR(RedisModuleCtx *ctx,
     }
     if (queries != NULL) {
         __atomic_add_fetch(
-            &queries->ref, 1, __ATOMIC_RELAXED); // see rationale in TSDB_mrange_MR above
+            &queries->ref, 1, __ATOMIC_RELAXED); // see rationale in MRangeQueryArg above
         queryArg->predicates = queries;
         queryArg->hasFilter = true;
     }
@@ -879,3 +1205,77 @@ int TSDB_querylabels_MR(RedisModuleCtx *ctx,
     MR_FreeExecutionBuilder(builder);
     return REDISMODULE_OK;
 }
+
+// Merges the best series of every shard into the final k
+static void mtopk_done(ExecutionCtx *eCtx, void *privateData) {
+    MTopKData *data = privateData;
+    RedisModuleBlockedClient *bc = data->bc;
+    RedisModuleCtx *ctx = RedisModule_GetThreadSafeContext(bc);
+
+    ARR(SeriesListRecord *) nodesResults = collect_node_results(eCtx, ctx);
+    if (nodesResults) {
+        TopKHeap heap;
+        TopKHeap_Init(&heap, data->args.k, data->args.bottom);
+        // every series holds the single sample replied by its shard
+        array_foreach(nodesResults, record, {
+            array_foreach(record->seriesList, s, {
+                TopKHeap_Offer(&heap, s, s->lastTimestamp, s->lastValue);
+            });
+        });
+        MTopK_Reply(ctx, &heap, &data->args);
+        TopKHeap_Free(&heap);
+        array_free(nodesResults);
+    }
+
+    MTopKArgs_Free(&data->args);
+    free(data);
+    RTS_UnblockClient(bc, ctx);
+}
+
+int TSDB_mtopk_MR(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+    MTopKArgs args;
+    if (parseMTopKCommand(ctx, argv, argc, &args) != REDISMODULE_OK) {
+        return REDISMODULE_OK;
+    }
+
+    if (TSGlobalConfig.libmrProtocol != LIBMR_PROTOCOL_INTERNAL) {
+        RTS_ReplyGeneralError(ctx, "TSDB: TS.MTOPK needs the internal LibMR protocol");
+        MTopKArgs_Free(&args);
+        return REDISMODULE_OK;
+    }
+
+    RedisModuleString *userName = CopyCurrentUserName(ctx);
+    QueryPredicates_Arg *queryArg = MRangeQueryArg(&args.mrange, userName);
+    if (userName)
+        RedisModule_FreeString(NULL, userName);
+    // the shards reply the value of every series as a single sample, see MTopK_ReplyShard
+    queryArg->binaryReply = false;
+    queryArg->topK = args.k;
+    queryArg->topKBottom = args.bottom;
+    clusterLabelSummarySkipShards(queryArg);
+
+    ExecutionBuilder *builder = MR_CreateEmptyExecutionBuilder();
+    MR_ExecutionBuilderInternalCommand(builder, "TS.INTERNAL_SLOT_RANGES", NULL);
+    MR_ExecutionBuilderInternalCommand(builder, "TS.INTERNAL_MTOPK", queryArg);
+
+    MRError *err = NULL;
+    Execution *exec = MR_CreateExecution(builder, &err);
+    if (err) {
+        RedisModule_ReplyWithError(ctx, MR_ErrorGetMessage(err));
+        MR_FreeExecutionBuilder(builder);
+        MTopKArgs_Free(&args);
+        return REDISMODULE_OK;
+    }
+
+    RedisModuleBlockedClient *bc = RTS_BlockClient(ctx, rts_free_rctx);
+    MTopKData *data = calloc(1, sizeof(*data)); // freed by mtopk_done
+    data->bc = bc;
+    data->args = args;
+
+    MR_ExecutionSetOnDoneHandler(exec, mtopk_done, data);
+
+    MR_Run(exec);
+    MR_FreeExecution(exec);
+    MR_FreeExecutionBuilder(builder);
+    return REDISMODULE_OK;
+}
@@ -9,9 +9,25 @@ typedef struct MRangeData
 {
     RedisModuleBlockedClient *bc;
     MRangeArgs args;
-
+    // Batched queries (ts-mrange-batch-size) reply over several rounds of internal commands. A
+    // round that fails after the first one ends the reply with its error, see
+    // mrange_done_internal.
+    RedisModuleString *userName;
+    size_t batchSize;
+    RedisModuleCtx *ctx; // the reply is built on the same context across the rounds
+    size_t round;
+    long long replyLen;
+    uint64_t slotsFingerprint;   // of the slot ranges of the shards in the first round
+    RedisModuleString **cursors; // where the shards with more series resume in the next round
+    size_t cursorsCount;
 } MRangeData;
 
+typedef struct MTopKData
+{
+    RedisModuleBlockedClient *bc;
+    MTopKArgs args;
+} MTopKData;
+
 typedef struct MData
 {
     RedisModuleBlockedClient *bc;
@@ -22,6 +38,7 @@ typedef struct MData
 int TSDB_mget_MR(RedisModuleCtx *ctx, RedisModuleString **argv, int argc);
 int TSDB_queryindex_MR(RedisModuleCtx *ctx, QueryPredicateList *queries);
 int TSDB_mrange_MR(RedisModuleCtx *ctx, RedisModuleString **argv, int argc, bool reverse);
+int TSDB_mtopk_MR(RedisModuleCtx *ctx, RedisModuleString **argv, int argc);
 int TSDB_querylabels_MR(RedisModuleCtx *ctx,
                         QueryLabelsSubtype subtype,
                         RedisModuleString *label,
@@ -8,8 +8,11 @@
 #include "indexer.h"
 #include "module.h"
 #include "query_language.h"
+#include "series_blob.h"
+#include "topk.h"
 #include "tsdb.h"
 #include <math.h>
+#include <sched.h>
 #include "reply.h"
 
 #include "RedisModulesSDK/redismodule.h"
@@ -28,7 +31,9 @@ static MRRecordType *LongRecordType = NULL;
 static MRRecordType *DoubleRecordType = NULL;
 static MRRecordType *MapRecordType = NULL;
 static MRRecordType *SlotRangesRecordType = NULL;
+static MRRecordType *LabelSummaryRecordType = NULL;
 static MRRecordType *SeriesListRecordType = NULL;
+static MRRecordType *PartialGroupListRecordType = NULL;
 static MRRecordType *StringListRecordType = NULL;
 
 static void QueryPredicates_FreeUserName(QueryPredicates_Arg *predicate_list) {
@@ -38,6 +43,33 @@ static void QueryPredicates_FreeUserName(QueryPredicates_Arg *predicate_list) {
     }
 }
 
+static void QueryPredicates_FreeGroupByLabel(QueryPredicates_Arg *predicate_list) {
+    if (predicate_list->groupByLabel) {
+        RedisModule_FreeString(NULL, predicate_list->groupByLabel);
+        predicate_list->groupByLabel = NULL;
+    }
+}
+
+static void QueryPredicates_FreeCursors(QueryPredicates_Arg *predicate_list) {
+    if (!predicate_list->cursors) {
+        return;
+    }
+    for (size_t i = 0; i < predicate_list->cursorsCount; i++) {
+        if (predicate_list->cursors[i]) {
+            RedisModule_FreeString(NULL, predicate_list->cursors[i]);
+        }
+    }
+    free(predicate_list->cursors);
+    predicate_list->cursors = NULL;
+    predicate_list->cursorsCount = 0;
+}
+
+static void QueryPredicates_FreeSkipShards(QueryPredicates_Arg *predicate_list) {
+    free(predicate_list->skipShards);
+    predicate_list->skipShards = NULL;
+    predicate_list->skipShardsCount = 0;
+}
+
 static void QueryPredicates_FreeLimitLabels(QueryPredicates_Arg *predicate_list) {
     if (!predicate_list->limitLabels) {
         return;
@@ -72,10 +104,18 @@ MRRecordType *GetSlotRangesRecordType() {
     return SlotRangesRecordType;
 }
 
+MRRecordType *GetLabelSummaryRecordType() {
+    return LabelSummaryRecordType;
+}
+
 MRRecordType *GetSeriesListRecordType() {
     return SeriesListRecordType;
 }
 
+MRRecordType *GetPartialGroupListRecordType() {
+    return PartialGroupListRecordType;
+}
+
 MRRecordType *GetStringListRecordType() {
     return StringListRecordType;
 }
@@ -90,6 +130,9 @@ static void QueryPredicates_ObjectFree(void *arg) {
     QueryPredicateList_Free(predicate_list->predicates);
     QueryPredicates_FreeLimitLabels(predicate_list);
     QueryPredicates_FreeUserName(predicate_list);
+    QueryPredicates_FreeGroupByLabel(predicate_list);
+    QueryPredicates_FreeCursors(predicate_list);
+    QueryPredicates_FreeSkipShards(predicate_list);
     free(predicate_list);
 }
 
@@ -152,8 +195,12 @@ static void LongRecord_SendReply(RedisModuleCtx *rctx, void *r);
 // Internal command records
 static Record *SlotRangesRecord_Create(RedisModuleSlotRangeArray *slotRanges);
 static void SlotRangesRecord_Free(void *base);
+static Record *LabelSummaryRecord_Create(const redisReply *reply);
+static void LabelSummaryRecord_Free(void *base);
 static Record *SeriesListRecord_Create(ARR(Series *) seriesList, size_t numAggClasses);
 static void SeriesListRecord_Free(void *base);
+static Record *PartialGroupListRecord_Create(ARR(PartialGroup *) groups);
+static void PartialGroupListRecord_Free(void *base);
 static Record *StringListRecord_Create(ARR(RedisModuleString *) stringList);
 static void StringListRecord_Free(void *base);
 
@@ -222,6 +269,30 @@ static void QueryPredicates_ArgSerialize(WriteSerializationCtx *sctx, void *arg,
         }
     }
     MR_SerializationCtxWriteLongLong(sctx, predicate_list->excludeEmpty, error);
+    MR_SerializationCtxWriteLongLong(sctx, predicate_list->groupByReducer, error);
+    if (predicate_list->groupByReducer != TS_AGG_NONE) {
+        SerializationCtxWriteRedisString(sctx, predicate_list->groupByLabel, error);
+    }
+    MR_SerializationCtxWriteLongLong(sctx, predicate_list->batchSize, error);
+    MR_SerializationCtxWriteLongLong(sctx, predicate_list->resume, error);
+    MR_SerializationCtxWriteLongLong(sctx, predicate_list->cursorsCount, error);
+    for (size_t i = 0; i < predicate_list->cursorsCount; i++) {
+        SerializationCtxWriteRedisString(sctx, predicate_list->cursors[i], error);
+    }
+    MR_SerializationCtxWriteLongLong(sctx, predicate_list->binaryReply, error);
+    MR_SerializationCtxWriteLongLong(sctx, predicate_list->downsample.type, error);
+    MR_SerializationCtxWriteLongLong(sctx, predicate_list->downsample.points, error);
+    MR_SerializationCtxWriteLongLong(sctx, predicate_list->window.type, error);
+    MR_SerializationCtxWriteLongLong(sctx, predicate_list->window.size, error);
+    MR_SerializationCtxWriteDouble(sctx, predicate_list->window.alpha, error);
+    MR_SerializationCtxWriteLongLong(sctx, predicate_list->topK, error);
+    MR_SerializationCtxWriteLongLong(sctx, predicate_list->topKBottom, error);
+    MR_SerializationCtxWriteLongLong(sctx, predicate_list->skipShardsCount, error);
+    for (size_t i = 0; i < predicate_list->skipShardsCount; i++) {
+        const ShardIndexVersion *shard = &predicate_list->skipShards[i];
+        MR_SerializationCtxWriteBuffer(sctx, shard->shardId, sizeof(shard->shardId), error);
+        MR_SerializationCtxWriteLongLong(sctx, (long long)shard->version, error);
+    }
 }
 
 static void SerializationCtxWriteRedisString(WriteSerializationCtx *sctx,
@@ -259,6 +330,9 @@ static void QueryPredicates_CleanupFailedDeserialization(QueryPredicates_Arg *pr
     }
     free(predicates->predicates);
     QueryPredicates_FreeLimitLabels(predicates);
+    QueryPredicates_FreeGroupByLabel(predicates);
+    QueryPredicates_FreeCursors(predicates);
+    QueryPredicates_FreeSkipShards(predicates);
     free(predicates);
 }
 
@@ -358,6 +432,52 @@ static void *QueryPredicates_ArgDeserialize_impl(ReaderSerializationCtx *sctx,
         }
     }
     predicates->excludeEmpty = MR_SerializationCtxReadLongLong(sctx, error);
+    predicates->groupByReducer = MR_SerializationCtxReadLongLong(sctx, error);
+    if (predicates->groupByReducer < TS_AGG_NONE ||
+        predicates->groupByReducer >= TS_AGG_TYPES_MAX) {
+        goto err;
+    }
+    if (predicates->groupByReducer != TS_AGG_NONE) {
+        predicates->groupByLabel = SerializationCtxReadRedisString(sctx, error);
+    }
+    predicates->batchSize = MR_SerializationCtxReadLongLong(sctx, error);
+    predicates->resume = MR_SerializationCtxReadLongLong(sctx, error);
+    const long long cursorsCount = MR_SerializationCtxReadLongLong(sctx, error);
+    if (unlikely((expect_resp && *error) || cursorsCount < 0)) {
+        goto err;
+    }
+    predicates->cursors = calloc(cursorsCount, sizeof *predicates->cursors);
+    predicates->cursorsCount = cursorsCount;
+    for (size_t i = 0; i < predicates->cursorsCount; i++) {
+        predicates->cursors[i] = SerializationCtxReadRedisString(sctx, error);
+        if (unlikely(expect_resp && *error)) {
+            goto err;
+        }
+    }
+    predicates->binaryReply = MR_SerializationCtxReadLongLong(sctx, error);
+    predicates->downsample.type = MR_SerializationCtxReadLongLong(sctx, error);
+    predicates->downsample.points = MR_SerializationCtxReadLongLong(sctx, error);
+    predicates->window.type = MR_SerializationCtxReadLongLong(sctx, error);
+    predicates->window.size = MR_SerializationCtxReadLongLong(sctx, error);
+    predicates->window.alpha = MR_SerializationCtxReadDouble(sctx, error);
+    predicates->topK = MR_SerializationCtxReadLongLong(sctx, error);
+    predicates->topKBottom = MR_SerializationCtxReadLongLong(sctx, error);
+    const long long skipShardsCount = MR_SerializationCtxReadLongLong(sctx, error);
+    if (unlikely((expect_resp && *error) || skipShardsCount < 0)) {
+        goto err;
+    }
+    predicates->skipShards = calloc(skipShardsCount, sizeof *predicates->skipShards);
+    predicates->skipShardsCount = skipShardsCount;
+    for (size_t i = 0; i < predicates->skipShardsCount; i++) {
+        ShardIndexVersion *shard = &predicates->skipShards[i];
+        size_t len;
+        const char *shardId = MR_SerializationCtxReadBuffer(sctx, &len, error);
+        if (unlikely((expect_resp && *error) || len != sizeof(shard->shardId))) {
+            goto err;
+        }
+        memcpy(shard->shardId, shardId, sizeof(shard->shardId));
+        shard->version = (uint64_t)MR_SerializationCtxReadLongLong(sctx, error);
+    }
 
     if (unlikely(expect_resp && *error)) {
         goto err;
@@ -693,6 +813,37 @@ _cleanup:
     }
 }
 
+// The mappers copy the matching series while holding the GIL. With ts-shard-lock-budget (us)
+// they let the main thread run between two series once the lock was held that long. Every
+// series is still copied as a whole under the lock.
+typedef struct ShardLock
+{
+    RedisModuleString *userName;
+    uint64_t acquiredAt;
+} ShardLock;
+
+static void ShardLock_Acquire(ShardLock *lock) {
+    RedisModule_ThreadSafeContextLock(rts_staticCtx);
+    // the context is shared, other executions may have set their own user meanwhile
+    ApplyCtxUser(rts_staticCtx, lock->userName);
+    lock->acquiredAt = RedisModule_MonotonicMicroseconds();
+}
+
+static void ShardLock_Release(ShardLock *lock) {
+    ReleaseCtxUser(rts_staticCtx);
+    RedisModule_ThreadSafeContextUnlock(rts_staticCtx);
+}
+
+static void ShardLock_YieldIfOverBudget(ShardLock *lock) {
+    const uint64_t budget = TSGlobalConfig.shardLockBudget;
+    if (budget == 0 || RedisModule_MonotonicMicroseconds() - lock->acquiredAt < budget) {
+        return;
+    }
+    ShardLock_Release(lock);
+    sched_yield();
+    ShardLock_Acquire(lock);
+}
+
 // LATEST is ignored for a series that is not a compaction.
 #define should_finalize_last_bucket(pred, series)                                                  \
     ((pred)->latest && (series)->srcKey && (pred)->endTimestamp > (series)->lastTimestamp)
@@ -705,13 +856,14 @@ Record *ShardSeriesMapper(ExecutionCtx *rctx, void *arg) {
     }
     predicates->shouldReturnNull = true;
 
-    RedisModule_ThreadSafeContextLock(rts_staticCtx);
-    ApplyCtxUser(rts_staticCtx, predicates->userName);
+    ShardLock lock = { .userName = predicates->userName };
+    ShardLock_Acquire(&lock);
 
     // The permission error is ignored.
     RedisModuleDict *result = QueryIndex(
         rts_staticCtx, predicates->predicates->list, predicates->predicates->count, NULL);
 
+    // The dict is private, the iterator stays valid while the lock is released
     RedisModuleDictIter *iter = RedisModule_DictIteratorStartC(result, "^", NULL, 0);
     char *currentKey;
     size_t currentKeyLen;
@@ -721,6 +873,7 @@ Record *ShardSeriesMapper(ExecutionCtx *rctx, void *arg) {
     const GetSeriesFlags flags = GetSeriesFlags_SilentOperation | GetSeriesFlags_CheckForAcls;
 
     while ((currentKey = RedisModule_DictNextC(iter, &currentKeyLen, NULL)) != NULL) {
+        ShardLock_YieldIfOverBudget(&lock);
         RedisModuleKey *key;
         RedisModuleString *keyName =
             RedisModule_CreateString(rts_staticCtx, currentKey, currentKeyLen);
@@ -745,8 +898,7 @@ Record *ShardSeriesMapper(ExecutionCtx *rctx, void *arg) {
 
     RedisModule_DictIteratorStop(iter);
     RedisModule_FreeDict(rts_staticCtx, result);
-    ReleaseCtxUser(rts_staticCtx);
-    RedisModule_ThreadSafeContextUnlock(rts_staticCtx);
+    ShardLock_Release(&lock);
 
     return series_list;
 }
@@ -764,8 +916,8 @@ Record *ShardMgetMapper(ExecutionCtx *rctx, void *arg) {
         limitLabelsStr[i] = RedisModule_StringPtrLen(predicates->limitLabels[i], NULL);
     }
 
-    RedisModule_ThreadSafeContextLock(rts_staticCtx);
-    ApplyCtxUser(rts_staticCtx, predicates->userName);
+    ShardLock lock = { .userName = predicates->userName };
+    ShardLock_Acquire(&lock);
 
     // The permission error is ignored.
     RedisModuleDict *result = QueryIndex(
@@ -786,6 +938,7 @@ Record *ShardMgetMapper(ExecutionCtx *rctx, void *arg) {
     const GetSeriesFlags flags = GetSeriesFlags_SilentOperation | GetSeriesFlags_CheckForAcls;
 
     while ((currentKey = RedisModule_DictNextC(iter, &currentKeyLen, NULL)) != NULL) {
+        ShardLock_YieldIfOverBudget(&lock);
         RedisModuleKey *key;
         RedisModuleString *keyName =
             RedisModule_CreateString(rts_staticCtx, currentKey, currentKeyLen);
@@ -848,8 +1001,7 @@ Record *ShardMgetMapper(ExecutionCtx *rctx, void *arg) {
     RedisModule_DictIteratorStop(iter);
     RedisModule_FreeDict(rts_staticCtx, result);
     free(limitLabelsStr);
-    ReleaseCtxUser(rts_staticCtx);
-    RedisModule_ThreadSafeContextUnlock(rts_staticCtx);
+    ShardLock_Release(&lock);
 
     return series_listOrMap;
 }
@@ -1010,10 +1162,47 @@ static Record *SlotRangesReplyParser(const redisReply *reply) {
 static InternalCommandCallbacks SlotRangesCallbacks = { .command = TS_INTERNAL_SLOT_RANGES,
                                                         .replyParser = SlotRangesReplyParser };
 
-static void TS_INTERNAL_MRANGE_impl(RedisModuleCtx *ctx, void *args) {
-    QueryPredicates_Arg *queryArg = args;
+// Replies the shard's id, the version of its label index and the summary of the index
+static void TS_INTERNAL_LABEL_SUMMARY(RedisModuleCtx *ctx, void *args) {
+    const char *shardId = RedisModule_GetMyClusterID();
+    const LabelSummary *summary = IndexLabelSummary();
+    RedisModule_ReplyWithArray(ctx, 3);
+    // no id outside of a cluster
+    RedisModule_ReplyWithStringBuffer(
+        ctx, shardId ? shardId : "", shardId ? REDISMODULE_NODE_ID_LEN : 0);
+    RedisModule_ReplyWithLongLong(ctx, (long long)IndexLabelsVersion());
+    RedisModule_ReplyWithStringBuffer(ctx, (const char *)summary->bits, sizeof(summary->bits));
+}
+
+static Record *LabelSummaryReplyParser(const redisReply *reply) {
+    return LabelSummaryRecord_Create(reply);
+}
+
+static InternalCommandCallbacks LabelSummaryCallbacks = { .command = TS_INTERNAL_LABEL_SUMMARY,
+                                                          .replyParser = LabelSummaryReplyParser };
+
+// Queries the label index of the shard, unless the coordinator listed the shard in skipShards and
+// its index is still at the version of the summary that ruled the predicates out
+static RedisModuleDict *QueryShardIndex(RedisModuleCtx *ctx,
+                                        const QueryPredicates_Arg *queryArg,
+                                        const QueryPredicateList *predicates) {
+    const char *shardId = RedisModule_GetMyClusterID();
+    for (size_t i = 0; shardId && i < queryArg->skipShardsCount; i++) {
+        const ShardIndexVersion *shard = &queryArg->skipShards[i];
+        if (!memcmp(shard->shardId, shardId, sizeof(shard->shardId))) {
+            if (shard->version == IndexLabelsVersion()) {
+                return RedisModule_CreateDict(ctx);
+            }
+            break;
+        }
+    }
+    return QueryIndex(ctx, predicates->list, predicates->count, NULL);
+}
 
-    ApplyCtxUser(ctx, queryArg->userName);
+// aggClasses must outlive mrangeArgs
+static void MRangeArgsFromQueryArg(const QueryPredicates_Arg *queryArg,
+                                   MRangeArgs *args,
+                                   AggregationClass **aggClasses) {
     MRangeArgs mrangeArgs;
     mrangeArgs.rangeArgs.startTimestamp = queryArg->startTimestamp;
     mrangeArgs.rangeArgs.endTimestamp = queryArg->endTimestamp;
@@ -1024,11 +1213,14 @@ static void TS_INTERNAL_MRANGE_impl(RedisModuleCtx *ctx, void *args) {
     mrangeArgs.rangeArgs.aggregationArgs.bucketTS = BucketStartTimestamp;
     mrangeArgs.rangeArgs.aggregationArgs.numClasses = 0;
     mrangeArgs.rangeArgs.aggregationArgs.classes = NULL;
+    mrangeArgs.rangeArgs.downsample = queryArg->downsample;
+    mrangeArgs.rangeArgs.window = queryArg->window;
     mrangeArgs.rangeArgs.filterByValueArgs = queryArg->filterByValueArgs;
     mrangeArgs.rangeArgs.filterByTSArgs = queryArg->filterByTSArgs;
     mrangeArgs.rangeArgs.alignment = DefaultAlignment;
     mrangeArgs.rangeArgs.timestampAlignment = 0;
     mrangeArgs.rangeArgs.skipAggregation = false;
+    mrangeArgs.rangeArgs.binaryFormat = false;
     // Include all the labels because the aggregated result might be grouped by a label (in
     // mrange_done)
     mrangeArgs.withLabels = true;
@@ -1039,8 +1231,8 @@ static void TS_INTERNAL_MRANGE_impl(RedisModuleCtx *ctx, void *args) {
     mrangeArgs.groupByReducerArgs.agg_type = TS_AGG_NONE;
     mrangeArgs.reverse = false;
     mrangeArgs.excludeEmpty = queryArg->excludeEmpty;
+    mrangeArgs.cursor = NULL;
 
-    AggregationClass *aggClasses[TS_AGG_TYPES_MAX] = { 0 };
     if (queryArg->numAggClasses > 0) {
         for (size_t i = 0; i < queryArg->numAggClasses; i++) {
             aggClasses[i] = GetAggClass(queryArg->aggTypes[i]);
@@ -1053,10 +1245,57 @@ static void TS_INTERNAL_MRANGE_impl(RedisModuleCtx *ctx, void *args) {
         mrangeArgs.rangeArgs.alignment = queryArg->alignment;
         mrangeArgs.rangeArgs.timestampAlignment = queryArg->timestampAlignment;
     }
+    *args = mrangeArgs;
+}
 
-    RedisModuleDict *qi =
-        QueryIndex(ctx, mrangeArgs.queryPredicates->list, mrangeArgs.queryPredicates->count, NULL);
-    replyUngroupedMultiRange(ctx, qi, &mrangeArgs);
+// The cursor in the slots of this shard, NULL when the shard has no more series to send
+static RedisModuleString *LocalCursor(RedisModuleCtx *ctx, const QueryPredicates_Arg *queryArg) {
+    RedisModuleSlotRangeArray *sra = RedisModule_ClusterGetLocalSlotRanges(ctx);
+    if (sra == NULL) {
+        return NULL;
+    }
+    RedisModuleString *cursor = NULL;
+    for (size_t i = 0; i < queryArg->cursorsCount && !cursor; i++) {
+        unsigned int slot = RedisModule_ClusterKeySlot(queryArg->cursors[i]);
+        for (int j = 0; j < sra->num_ranges; j++) {
+            if (sra->ranges[j].start <= slot && slot <= sra->ranges[j].end) {
+                cursor = queryArg->cursors[i];
+                break;
+            }
+        }
+    }
+    RedisModule_ClusterFreeSlotRanges(ctx, sra);
+    return cursor;
+}
+
+static void TS_INTERNAL_MRANGE_impl(RedisModuleCtx *ctx, void *args) {
+    QueryPredicates_Arg *queryArg = args;
+
+    RedisModuleString *resumeAfter = NULL;
+    if (queryArg->resume) {
+        resumeAfter = LocalCursor(ctx, queryArg);
+        if (!resumeAfter) {
+            RedisModule_ReplyWithArray(ctx, 0);
+            return;
+        }
+    }
+
+    ApplyCtxUser(ctx, queryArg->userName);
+    MRangeArgs mrangeArgs;
+    AggregationClass *aggClasses[TS_AGG_TYPES_MAX] = { 0 };
+    MRangeArgsFromQueryArg(queryArg, &mrangeArgs, aggClasses);
+
+    RedisModuleDict *qi = QueryShardIndex(ctx, queryArg, mrangeArgs.queryPredicates);
+    if (queryArg->binaryReply) {
+        SeriesBlob blob;
+        SeriesBlob_Init(&blob, max(mrangeArgs.rangeArgs.aggregationArgs.numClasses, 1));
+        replyUngroupedMultiRangeBatch(
+            ctx, qi, &mrangeArgs, resumeAfter, queryArg->batchSize, &blob);
+        SeriesBlob_Free(&blob);
+    } else {
+        replyUngroupedMultiRangeBatch(
+            ctx, qi, &mrangeArgs, resumeAfter, queryArg->batchSize, NULL);
+    }
     RedisModule_FreeDict(ctx, qi);
     ReleaseCtxUser(ctx);
 }
@@ -1171,13 +1410,48 @@ static ARR(Series *) ParseSeriesAllAggs(const redisReply *reply, size_t minNumAg
     return result;
 }
 
+// A shard reply encoded with SeriesBlob_AddSeries, see series_blob.h
+static Record *SeriesBlobReplyParser(const redisReply *reply) {
+    size_t numSeries, numAgg;
+    bool more;
+    Series **series = SeriesBlob_Decode(reply->str, reply->len, &numSeries, &numAgg, &more);
+    RedisModule_Assert(series);
+    RedisModule_Assert(numSeries > 0 || !more);
+
+    ARR(Series *) seriesList = array_new(Series *, numSeries * numAgg);
+    for (size_t i = 0; i < numSeries * numAgg; i++) {
+        seriesList = array_append(seriesList, series[i]);
+    }
+    free(series);
+
+    SeriesListRecord *record = (SeriesListRecord *)SeriesListRecord_Create(seriesList, numAgg);
+    if (more) {
+        record->resumeAfter =
+            RedisModule_CreateStringFromString(NULL, seriesList[(numSeries - 1) * numAgg]->keyName);
+    }
+    return &record->base;
+}
+
 static Record *SeriesListReplyParser(const redisReply *reply) {
+    if (reply->type == REDIS_REPLY_STRING) {
+        return SeriesBlobReplyParser(reply);
+    }
     RedisModule_Assert(reply->type == REDIS_REPLY_ARRAY);
 
+    // A trailing integer marks a batch after which the shard has more series, see
+    // replyUngroupedMultiRangeBatch
+    size_t numKeys = reply->elements;
+    const bool more =
+        numKeys > 0 && reply->element[numKeys - 1]->type == REDIS_REPLY_INTEGER;
+    if (more) {
+        numKeys--;
+        RedisModule_Assert(numKeys > 0);
+    }
+
     // First pass: determine numAgg from populated keys without allocating Series.
     // Empty keys have zero samples so they cannot reveal the agg count on their own.
     size_t numAgg = 1;
-    for (size_t i = 0; i < reply->elements; i++) {
+    for (size_t i = 0; i < numKeys; i++) {
         const redisReply *el = reply->element[i];
         RedisModule_Assert(el->type == REDIS_REPLY_ARRAY && el->elements == 3);
         const redisReply *samples = el->element[2];
@@ -1193,20 +1467,142 @@ static Record *SeriesListReplyParser(const redisReply *reply) {
 
     // Second pass: parse every key passing the true numAgg as the floor so empty keys
     // produce the same number of Series as populated ones, keeping the stride uniform.
-    ARR(Series *) seriesList = array_new(Series *, reply->elements * numAgg);
-    for (size_t i = 0; i < reply->elements; i++) {
+    ARR(Series *) seriesList = array_new(Series *, numKeys * numAgg);
+    for (size_t i = 0; i < numKeys; i++) {
         ARR(Series *) group = ParseSeriesAllAggs(reply->element[i], numAgg);
         for (size_t a = 0; a < array_len(group); a++)
             seriesList = array_append(seriesList, group[a]);
         array_free(group); // free wrapper only; Series pointers are now in seriesList
     }
 
-    return SeriesListRecord_Create(seriesList, numAgg);
+    SeriesListRecord *record = (SeriesListRecord *)SeriesListRecord_Create(seriesList, numAgg);
+    if (more) {
+        const redisReply *last = reply->element[numKeys - 1]->element[0];
+        record->resumeAfter = RedisModule_CreateString(NULL, last->str, last->len);
+    }
+    return &record->base;
 }
 
 static InternalCommandCallbacks MrangeCallbacks = { .command = TS_INTERNAL_MRANGE,
                                                     .replyParser = SeriesListReplyParser };
 
+// The best topK series of the shard, merged by the coordinator, see topk.h
+static void TS_INTERNAL_MTOPK(RedisModuleCtx *ctx, void *args) {
+    QueryPredicates_Arg *queryArg = args;
+
+    ApplyCtxUser(ctx, queryArg->userName);
+    MTopKArgs topkArgs;
+    AggregationClass *aggClasses[TS_AGG_TYPES_MAX] = { 0 };
+    MRangeArgsFromQueryArg(queryArg, &topkArgs.mrange, aggClasses);
+    topkArgs.k = queryArg->topK;
+    topkArgs.bottom = queryArg->topKBottom;
+
+    const QueryPredicateList *predicates = topkArgs.mrange.queryPredicates;
+    RedisModuleDict *qi = QueryShardIndex(ctx, queryArg, predicates);
+    if (CheckDictSeriesPermissions(
+            ctx, qi, GetSeriesFlags_CheckForAcls | GetSeriesFlags_SilentOperation) ==
+        GetSeriesResult_PermissionError) {
+        RTS_ReplyKeyPermissionsError(ctx);
+    } else {
+        TopKHeap heap;
+        TopKHeap_Init(&heap, topkArgs.k, topkArgs.bottom);
+        MTopK_AddSeries(ctx, &heap, qi, &topkArgs);
+        MTopK_ReplyShard(ctx, &heap);
+        TopKHeap_Free(&heap);
+    }
+    RedisModule_FreeDict(ctx, qi);
+    ReleaseCtxUser(ctx);
+}
+
+static InternalCommandCallbacks MtopkCallbacks = { .command = TS_INTERNAL_MTOPK,
+                                                   .replyParser = SeriesListReplyParser };
+
+// Groups the matching series of the shard and reduces every group to partial states, see
+// ResultSet_ReplyPartialReduce
+static void TS_INTERNAL_MRANGE_GROUPBY(RedisModuleCtx *ctx, void *args) {
+    QueryPredicates_Arg *queryArg = args;
+    RedisModule_Assert(queryArg->groupByReducer != TS_AGG_NONE);
+
+    ApplyCtxUser(ctx, queryArg->userName);
+    MRangeArgs mrangeArgs;
+    AggregationClass *aggClasses[TS_AGG_TYPES_MAX] = { 0 };
+    MRangeArgsFromQueryArg(queryArg, &mrangeArgs, aggClasses);
+    mrangeArgs.groupByLabel = RedisModule_StringPtrLen(queryArg->groupByLabel, NULL);
+    mrangeArgs.groupByReducerArgs.agg_type = queryArg->groupByReducer;
+    mrangeArgs.groupByReducerArgs.aggregationClass = GetAggClass(queryArg->groupByReducer);
+
+    RedisModuleDict *qi = QueryShardIndex(ctx, queryArg, mrangeArgs.queryPredicates);
+    replyPartialGroupedMultiRange(ctx, qi, &mrangeArgs);
+    RedisModule_FreeDict(ctx, qi);
+    ReleaseCtxUser(ctx);
+}
+
+// Parses the reply of TS_INTERNAL_MRANGE_GROUPBY:
+// [[label value, [keys], [[timestamp, count, values...], ...]], ...]
+// The values of a quantile reducer are a single encoded sketch.
+static Record *PartialGroupListReplyParser(const redisReply *reply) {
+    RedisModule_Assert(reply->type == REDIS_REPLY_ARRAY);
+    ARR(PartialGroup *) groups = array_new(PartialGroup *, reply->elements);
+    for (size_t i = 0; i < reply->elements; i++) {
+        const redisReply *groupElement = reply->element[i];
+        RedisModule_Assert(groupElement->type == REDIS_REPLY_ARRAY && groupElement->elements == 3);
+        const redisReply *labelElement = groupElement->element[0];
+        const redisReply *keysElement = groupElement->element[1];
+        const redisReply *rowsElement = groupElement->element[2];
+        RedisModule_Assert(labelElement->type == REDIS_REPLY_STRING);
+        RedisModule_Assert(keysElement->type == REDIS_REPLY_ARRAY);
+        RedisModule_Assert(rowsElement->type == REDIS_REPLY_ARRAY);
+
+        PartialGroup *group = calloc(1, sizeof(*group));
+        group->labelValue = strndup(labelElement->str, labelElement->len);
+        group->keysCount = keysElement->elements;
+        group->keys = malloc(max(group->keysCount, 1) * sizeof(*group->keys));
+        for (size_t k = 0; k < keysElement->elements; k++) {
+            const redisReply *keyElement = keysElement->element[k];
+            RedisModule_Assert(keyElement->type == REDIS_REPLY_STRING);
+            group->keys[k] = RedisModule_CreateString(NULL, keyElement->str, keyElement->len);
+        }
+
+        group->count = rowsElement->elements;
+        group->timestamps = malloc(max(group->count, 1) * sizeof(*group->timestamps));
+        group->partials = calloc(max(group->count, 1), sizeof(*group->partials));
+        for (size_t r = 0; r < rowsElement->elements; r++) {
+            const redisReply *row = rowsElement->element[r];
+            RedisModule_Assert(row->type == REDIS_REPLY_ARRAY && row->elements >= 2 &&
+                               row->elements <= 2 + REDUCER_PARTIAL_MAX_VALUES);
+            RedisModule_Assert(row->element[0]->type == REDIS_REPLY_INTEGER &&
+                               row->element[1]->type == REDIS_REPLY_INTEGER);
+            group->timestamps[r] = row->element[0]->integer;
+            group->partials[r].count = row->element[1]->integer;
+            const redisReply *sketchElement = row->element[row->elements - 1];
+            const size_t magicLen = strlen(QUANTILE_SKETCH_MAGIC);
+            if (row->elements == 3 && sketchElement->type == REDIS_REPLY_STRING &&
+                sketchElement->len > magicLen &&
+                memcmp(sketchElement->str, QUANTILE_SKETCH_MAGIC, magicLen) == 0) {
+                // the values of a quantile reducer
+                QuantileSketch *sketch = malloc(sizeof(*sketch));
+                RedisModule_Assert(
+                    QuantileSketch_Decode(sketch, sketchElement->str, sketchElement->len));
+                group->partials[r].sketch = sketch;
+                continue;
+            }
+            for (size_t v = 2; v < row->elements; v++) {
+                // element type may appear as status string for values starting with '+'/'-'
+                parse_double_cstr(row->element[v]->str,
+                                  row->element[v]->len,
+                                  &group->partials[r].values[v - 2]);
+            }
+        }
+        groups = array_append(groups, group);
+    }
+
+    return PartialGroupListRecord_Create(groups);
+}
+
+static InternalCommandCallbacks MrangeGroupByCallbacks = {
+    .command = TS_INTERNAL_MRANGE_GROUPBY, .replyParser = PartialGroupListReplyParser
+};
+
 static void TS_INTERNAL_MGET(RedisModuleCtx *ctx, void *args) {
     QueryPredicates_Arg *queryArg = args;
     ApplyCtxUser(ctx, queryArg->userName);
@@ -1218,8 +1614,7 @@ static void TS_INTERNAL_MGET(RedisModuleCtx *ctx, void *args) {
     mgetArgs.queryPredicates = queryArg->predicates;
     mgetArgs.latest = queryArg->latest;
 
-    RedisModuleDict *qi =
-        QueryIndex(ctx, mgetArgs.queryPredicates->list, mgetArgs.queryPredicates->count, NULL);
+    RedisModuleDict *qi = QueryShardIndex(ctx, queryArg, mgetArgs.queryPredicates);
 
     if (CheckDictSeriesPermissions(
             ctx, qi, GetSeriesFlags_CheckForAcls | GetSeriesFlags_SilentOperation) ==
@@ -1289,8 +1684,7 @@ static InternalCommandCallbacks MgetCallbacks = { .command = TS_INTERNAL_MGET,
 static void TS_INTERNAL_QUERYINDEX(RedisModuleCtx *ctx, void *args) {
     QueryPredicates_Arg *queryArg = args;
     ApplyCtxUser(ctx, queryArg->userName);
-    RedisModuleDict *qi =
-        QueryIndex(ctx, queryArg->predicates->list, queryArg->predicates->count, NULL);
+    RedisModuleDict *qi = QueryShardIndex(ctx, queryArg, queryArg->predicates);
     RedisModuleDictIter *iter = RedisModule_DictIteratorStartC(qi, "^", NULL, 0);
 
     const char *keyName;
@@ -1504,16 +1898,33 @@ int register_mr(RedisModuleCtx *ctx, long long numThreads) {
         return REDISMODULE_ERR;
     }
 
+    PartialGroupListRecordType = MR_RecordTypeCreate(
+        "PartialGroupListRecord", PartialGroupListRecord_Free, NULL, NULL, NULL, NULL, NULL, NULL);
+    if (MR_RegisterRecord(PartialGroupListRecordType) != REDISMODULE_OK) {
+        return REDISMODULE_ERR;
+    }
+
     StringListRecordType = MR_RecordTypeCreate(
         "StringListRecord", StringListRecord_Free, NULL, NULL, NULL, NULL, NULL, NULL);
     if (MR_RegisterRecord(StringListRecordType) != REDISMODULE_OK) {
         return REDISMODULE_ERR;
     }
 
+    LabelSummaryRecordType = MR_RecordTypeCreate(
+        "LabelSummaryRecord", LabelSummaryRecord_Free, NULL, NULL, NULL, NULL, NULL, NULL);
+    if (MR_RegisterRecord(LabelSummaryRecordType) != REDISMODULE_OK) {
+        return REDISMODULE_ERR;
+    }
+
     MR_RegisterReader("ShardSeriesMapper", ShardSeriesMapper, QueryPredicatesType);
     MR_RegisterInternalCommand(
         "TS.INTERNAL_SLOT_RANGES", &SlotRangesCallbacks, QueryPredicatesType);
+    MR_RegisterInternalCommand(
+        "TS.INTERNAL_LABEL_SUMMARY", &LabelSummaryCallbacks, QueryPredicatesType);
     MR_RegisterInternalCommand("TS.INTERNAL_MRANGE", &MrangeCallbacks, QueryPredicatesType);
+    MR_RegisterInternalCommand(
+        "TS.INTERNAL_MRANGE_GROUPBY", &MrangeGroupByCallbacks, QueryPredicatesType);
+    MR_RegisterInternalCommand("TS.INTERNAL_MTOPK", &MtopkCallbacks, QueryPredicatesType);
     MR_RegisterInternalCommand("TS.INTERNAL_MGET", &MgetCallbacks, QueryPredicatesType);
     MR_RegisterInternalCommand("TS.INTERNAL_QUERYINDEX", &QueryIndexCallbacks, QueryPredicatesType);
     MR_RegisterInternalCommand(
@@ -1722,7 +2133,7 @@ Record *SeriesRecord_New(Series *series,
         out->labels[i].value = RedisModule_CreateStringFromString(NULL, series->labels[i].value);
     }
 
-    // clone chunks
+    // share the chunks, only the open last chunk is cloned, see snapshotAddChunk
     out->chunks = calloc(RedisModule_DictSize(series->chunks) + 1,
                          sizeof(Chunk_t *)); // + 1 in case of latest flag
     RedisModuleDictIter *iter = RedisModule_DictIteratorStartC(series->chunks, "^", NULL, 0);
@@ -1741,7 +2152,8 @@ Record *SeriesRecord_New(Series *series,
                 break;
             }
 
-            out->chunks[index] = out->funcs->CloneChunk(chunk);
+            out->chunks[index] = chunk == series->lastChunk ? out->funcs->CloneChunk(chunk)
+                                                            : out->funcs->RetainChunk(chunk);
             index++;
         }
     }
@@ -1839,7 +2251,7 @@ Series *SeriesRecord_IntoSeries(SeriesRecord *record) {
         chunk = record->chunks[chunk_index];
         s->totalSamples += s->funcs->GetNumOfSample(chunk);
         dictOperator(s->chunks,
-                     s->funcs->CloneChunk(chunk),
+                     s->funcs->RetainChunk(chunk),
                      record->funcs->GetFirstTimestamp(chunk),
                      DICT_OP_SET);
     }
@@ -1934,17 +2346,65 @@ static void SlotRangesRecord_Free(void *base) {
     free(record);
 }
 
+static Record *LabelSummaryRecord_Create(const redisReply *reply) {
+    LabelSummaryRecord *result =
+        (LabelSummaryRecord *)MR_RecordCreate(LabelSummaryRecordType, sizeof(*result));
+    result->summary = NULL;
+    if (reply->type != REDIS_REPLY_ARRAY || reply->elements != 3) {
+        return &result->base;
+    }
+
+    const redisReply *shardId = reply->element[0];
+    const redisReply *version = reply->element[1];
+    const redisReply *bits = reply->element[2];
+    if (shardId->type != REDIS_REPLY_STRING || shardId->len > sizeof(result->index.shardId) ||
+        version->type != REDIS_REPLY_INTEGER || bits->type != REDIS_REPLY_STRING ||
+        bits->len != sizeof(result->summary->bits)) {
+        return &result->base;
+    }
+    memset(result->index.shardId, 0, sizeof(result->index.shardId));
+    memcpy(result->index.shardId, shardId->str, shardId->len);
+    result->index.version = (uint64_t)version->integer;
+    result->summary = malloc(sizeof(*result->summary));
+    memcpy(result->summary->bits, bits->str, sizeof(result->summary->bits));
+    return &result->base;
+}
+
+static void LabelSummaryRecord_Free(void *base) {
+    LabelSummaryRecord *record = base;
+    free(record->summary);
+    free(record);
+}
+
 static Record *SeriesListRecord_Create(ARR(Series *) seriesList, size_t numAggClasses) {
     SeriesListRecord *result =
         (SeriesListRecord *)MR_RecordCreate(SeriesListRecordType, sizeof(*result));
     result->seriesList = seriesList;
     result->numAggClasses = numAggClasses;
+    result->resumeAfter = NULL;
     return &result->base;
 }
 
 static void SeriesListRecord_Free(void *base) {
     SeriesListRecord *record = base;
     array_free_ex(record->seriesList, FreeSeries(*(Series **)ptr));
+    if (record->resumeAfter) {
+        RedisModule_FreeString(NULL, record->resumeAfter);
+    }
+    free(record);
+}
+
+static Record *PartialGroupListRecord_Create(ARR(PartialGroup *) groups) {
+    PartialGroupListRecord *result =
+        (PartialGroupListRecord *)MR_RecordCreate(PartialGroupListRecordType, sizeof(*result));
+    result->groups = groups;
+    return &result->base;
+}
+
+static void PartialGroupListRecord_Free(void *base) {
+    PartialGroupListRecord *record = base;
+    // the groups taken by the coordinator's result set are NULL
+    array_free_ex(record->groups, PartialGroup_Free(*(PartialGroup **)ptr));
     free(record);
 }
 
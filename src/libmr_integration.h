@@ -3,6 +3,7 @@
 #include "generic_chunk.h"
 #include "indexer.h"
 #include "query_language.h"
+#include "resultset.h"
 #include "tsdb.h"
 
 #ifndef REDIS_TIMESERIES_CLEAN_MR_INTEGRATION_H
@@ -15,6 +16,13 @@ typedef enum QueryType
     QUERY_MRANGE,
 } QueryType;
 
+// The version of a shard's label index when its label summary was taken, see label_summary.h
+typedef struct ShardIndexVersion
+{
+    char shardId[REDISMODULE_NODE_ID_LEN];
+    uint64_t version;
+} ShardIndexVersion;
+
 typedef struct QueryPredicates_Arg
 {
     bool shouldReturnNull;
@@ -39,9 +47,30 @@ typedef struct QueryPredicates_Arg
     bool aggEmpty;
     RangeAlignment alignment;
     timestamp_t timestampAlignment;
+    DownsampleArgs downsample; // lttb and m4 are applied on the shards as well
+    WindowArgs window;         // and so are the windows
     FilterByValueArgs filterByValueArgs;
     FilterByTSArgs filterByTSArgs;
     bool excludeEmpty;
+    // GROUPBY/REDUCE, reduced to partial states on shards (TS.INTERNAL_MRANGE_GROUPBY only)
+    RedisModuleString *groupByLabel;
+    TS_AGG_TYPES_T groupByReducer;
+    // Batched TS.INTERNAL_MRANGE: at most batchSize series per shard (0 for all of them). When
+    // resume is set, every shard continues after the cursor in its own slots, or replies with
+    // nothing if it has none.
+    size_t batchSize;
+    bool resume;
+    RedisModuleString **cursors;
+    size_t cursorsCount;
+    // TS.INTERNAL_MRANGE replies with a series blob instead of RESP, see series_blob.h
+    bool binaryReply;
+    // TS.INTERNAL_MTOPK replies with the topK best series of the shard
+    size_t topK;
+    bool topKBottom;
+    // The shards whose label summary rules the predicates out. Such a shard replies with no series
+    // as long as its label index is still at the version of the summary, see QueryShardIndex.
+    ShardIndexVersion *skipShards;
+    size_t skipShardsCount;
 } QueryPredicates_Arg;
 
 typedef struct StringRecord
@@ -98,13 +127,28 @@ typedef struct SlotRangesRecord
     RedisModuleSlotRangeArray *slotRanges;
 } SlotRangesRecord;
 
+// The reply of a shard to TS.INTERNAL_LABEL_SUMMARY
+typedef struct LabelSummaryRecord
+{
+    Record base;
+    ShardIndexVersion index;
+    LabelSummary *summary; // NULL when the shard replied with something unexpected
+} LabelSummaryRecord;
+
 typedef struct SeriesListRecord
 {
     Record base;
     ARR(Series *) seriesList;
     size_t numAggClasses; // >1: seriesList has numAggClasses Series per key (multi-agg pre-agg)
+    RedisModuleString *resumeAfter; // the shard's cursor when it has more series, else NULL
 } SeriesListRecord;
 
+typedef struct PartialGroupListRecord
+{
+    Record base;
+    ARR(PartialGroup *) groups;
+} PartialGroupListRecord;
+
 typedef struct StringListRecord
 {
     Record base;
@@ -133,7 +177,9 @@ MRRecordType *GetMapRecordType();
 MRRecordType *GetListRecordType();
 MRRecordType *GetSeriesRecordType();
 MRRecordType *GetSlotRangesRecordType();
+MRRecordType *GetLabelSummaryRecordType();
 MRRecordType *GetSeriesListRecordType();
+MRRecordType *GetPartialGroupListRecordType();
 MRRecordType *GetStringListRecordType();
 Record *MapRecord_GetRecord(MapRecord *record, size_t index);
 size_t MapRecord_GetLen(MapRecord *record);
@@ -13,19 +13,31 @@
 
 #include "module.h"
 
+#include "async_compaction.h"
+#include "backfill.h"
+#include "columnar_reduce.h"
 #include "compaction.h"
 #include "common.h"
 #include "config.h"
+#include "expr.h"
 #include "indexer.h"
 #include "libmr_commands.h"
 #include "libmr_integration.h"
+#include "mrange_cursor.h"
+#include "notify.h"
+#include "parallel_query.h"
+#include "query_cache.h"
 #include "query_language.h"
 #include "rdb.h"
 #include "reply.h"
 #include "resultset.h"
+#include "rollup_route.h"
+#include "series_blob.h"
 #include "short_read.h"
+#include "topk.h"
 #include "tsdb.h"
 #include "version.h"
+#include "wide_series.h"
 
 #include "LibMR/src/cluster.h"
 #include "LibMR/src/mr.h"
@@ -114,6 +126,7 @@ static bool LoadConfiguration(RedisModuleCtx *ctx, RedisModuleString **argv, int
 }
 
 RedisModuleType *SeriesType;
+RedisModuleType *WideSeriesType;
 RedisModuleCtx *rts_staticCtx; // global redis ctx
 bool isReshardTrimming = false, isAsmTrimming = false, isAsmImporting = false;
 
@@ -171,11 +184,12 @@ int TSDB_info(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     const bool reply_map = _ReplyMap(ctx);
 
     const int is_debug = RMUtil_ArgExists("DEBUG", argv, argc, 1);
-    if (is_debug) {
-        ReplyWithMapOrArray(ctx, 16 * 2, true); // 16 fields x 2 (key + value)
-    } else {
-        ReplyWithMapOrArray(ctx, 14 * 2, true); // 14 fields x 2 (key + value)
-    }
+    // compactionLag is only reported when async compaction is (or was) in use
+    const bool with_lag = TSGlobalConfig.asyncCompaction || AsyncCompaction_HasPending(series);
+    const bool auto_chunk_size = series->options & SERIES_OPT_CHUNK_SIZE_AUTO;
+    const long num_fields =
+        14 + (with_lag ? 1 : 0) + (auto_chunk_size ? 1 : 0) + (is_debug ? 2 : 0);
+    ReplyWithMapOrArray(ctx, num_fields * 2, true); // key + value per field
 
     long long skippedSamples;
     long long firstTimestamp = getFirstValidTimestamp(series, &skippedSamples);
@@ -194,6 +208,10 @@ int TSDB_info(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     RedisModule_ReplyWithLongLong(ctx, RedisModule_DictSize(series->chunks));
     RedisModule_ReplyWithSimpleString(ctx, "chunkSize");
     RedisModule_ReplyWithLongLong(ctx, series->chunkSizeBytes);
+    if (auto_chunk_size) {
+        RedisModule_ReplyWithSimpleString(ctx, "chunkSizeMode");
+        RedisModule_ReplyWithSimpleString(ctx, CHUNK_SIZE_AUTO_ARG_STR);
+    }
     RedisModule_ReplyWithSimpleString(ctx, "chunkType");
     RedisModule_ReplyWithSimpleString(ctx, ChunkTypeToString(series->options));
     RedisModule_ReplyWithSimpleString(ctx, "duplicatePolicy");
@@ -239,6 +257,11 @@ int TSDB_info(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     RedisModule_ReplyWithSimpleString(ctx, "ignoreMaxValDiff");
     RedisModule_ReplyWithDouble(ctx, series->ignoreMaxValDiff);
 
+    if (with_lag) {
+        RedisModule_ReplyWithSimpleString(ctx, "compactionLag");
+        RedisModule_ReplyWithLongLong(ctx, AsyncCompaction_Lag(series));
+    }
+
     if (is_debug) {
         RedisModuleDictIter *iter = RedisModule_DictIteratorStartC(series->chunks, ">", "", 0);
         Chunk_t *chunk = NULL;
@@ -464,37 +487,30 @@ int TSDB_querylabels(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     return REDISMODULE_OK;
 }
 
-// multi-series groupby logic
-static int replyGroupedMultiRange(RedisModuleCtx *ctx,
-                                  TS_ResultSet *resultset,
-                                  RedisModuleDict *result,
-                                  const MRangeArgs *args) {
+// Adds the series of the result to their groups
+static int groupMultiRange(RedisModuleCtx *ctx, TS_ResultSet *resultset, RedisModuleDict *result) {
     RedisModuleDictIter *iter;
     char *currentKey = NULL;
     size_t currentKeyLen;
     Series *series = NULL;
-    int exitStatus = REDISMODULE_OK;
 
     if (CheckDictSeriesPermissions(
             ctx, result, GetSeriesFlags_CheckForAcls | GetSeriesFlags_SilentOperation) ==
         GetSeriesResult_PermissionError) {
         RTS_ReplyKeyPermissionsError(ctx);
-        exitStatus = REDISMODULE_ERR;
-        goto exit;
+        return REDISMODULE_ERR;
     }
 
     iter = RedisModule_DictIteratorStartC(result, "^", NULL, 0);
 
     while ((currentKey = RedisModule_DictNextC(iter, &currentKeyLen, NULL)) != NULL) {
         RedisModuleKey *key;
+        // Freed right away, shards run this without auto memory
+        RedisModuleString *keyName = RedisModule_CreateString(ctx, currentKey, currentKeyLen);
         // ACL permissions were already validated by CheckDictSeriesPermissions above.
-        const GetSeriesResult status =
-            GetSeries(ctx,
-                      RedisModule_CreateString(ctx, currentKey, currentKeyLen),
-                      &key,
-                      &series,
-                      REDISMODULE_READ,
-                      GetSeriesFlags_SilentOperation);
+        const GetSeriesResult status = GetSeries(
+            ctx, keyName, &key, &series, REDISMODULE_READ, GetSeriesFlags_SilentOperation);
+        RedisModule_FreeString(ctx, keyName);
         if (status != GetSeriesResult_Success) {
             // The iterator may have been invalidated, stop and restart from after the current
             // key.
@@ -507,6 +523,18 @@ static int replyGroupedMultiRange(RedisModuleCtx *ctx,
         RedisModule_CloseKey(key);
     }
     RedisModule_DictIteratorStop(iter);
+    return REDISMODULE_OK;
+}
+
+// multi-series groupby logic
+static int replyGroupedMultiRange(RedisModuleCtx *ctx,
+                                  TS_ResultSet *resultset,
+                                  RedisModuleDict *result,
+                                  const MRangeArgs *args) {
+    int exitStatus = groupMultiRange(ctx, resultset, result);
+    if (exitStatus != REDISMODULE_OK) {
+        goto exit;
+    }
 
     ResultSet_ApplyReducer(ctx, resultset, &args->rangeArgs, &args->groupByReducerArgs);
 
@@ -565,7 +593,27 @@ GetSeriesResult CheckDictSeriesPermissions(RedisModuleCtx *ctx,
     return ret;
 }
 
-int replyUngroupedMultiRange(RedisModuleCtx *ctx, RedisModuleDict *result, const MRangeArgs *args) {
+int replyPartialGroupedMultiRange(RedisModuleCtx *ctx,
+                                  RedisModuleDict *result,
+                                  const MRangeArgs *args) {
+    TS_ResultSet *resultset = ResultSet_Create();
+    ResultSet_GroupbyLabel(resultset, args->groupByLabel);
+
+    int exitStatus = groupMultiRange(ctx, resultset, result);
+    if (exitStatus == REDISMODULE_OK) {
+        ResultSet_ReplyPartialReduce(
+            ctx, resultset, &args->rangeArgs, &args->groupByReducerArgs);
+    }
+    ResultSet_Free(resultset);
+    return exitStatus;
+}
+
+int replyUngroupedMultiRangeBatch(RedisModuleCtx *ctx,
+                                  RedisModuleDict *result,
+                                  const MRangeArgs *args,
+                                  RedisModuleString *resumeAfter,
+                                  size_t limit,
+                                  SeriesBlob *blob) {
     RedisModuleDictIter *iter;
     RedisModuleString *currentKey;
     long long replylen = 0;
@@ -576,9 +624,13 @@ int replyUngroupedMultiRange(RedisModuleCtx *ctx, RedisModuleDict *result, const
         RTS_ReplyKeyPermissionsError(ctx);
         return REDISMODULE_ERR;
     }
-    iter = RedisModule_DictIteratorStartC(result, "^", NULL, 0);
-    ReplyWithMapOrArray(ctx, REDISMODULE_POSTPONED_ARRAY_LEN, false);
-    while ((currentKey = RedisModule_DictNext(ctx, iter, NULL)) != NULL) {
+    iter = resumeAfter ? RedisModule_DictIteratorStart(result, ">", resumeAfter)
+                       : RedisModule_DictIteratorStartC(result, "^", NULL, 0);
+    if (!blob) {
+        ReplyWithMapOrArray(ctx, REDISMODULE_POSTPONED_ARRAY_LEN, false);
+    }
+    while ((limit == 0 || replylen < limit) &&
+           (currentKey = RedisModule_DictNext(ctx, iter, NULL)) != NULL) {
         RedisModuleKey *key;
         // ACL permissions were already validated by CheckDictSeriesPermissions above.
         const GetSeriesResult status = GetSeries(
@@ -593,34 +645,78 @@ int replyUngroupedMultiRange(RedisModuleCtx *ctx, RedisModuleDict *result, const
 
         EnrichedChunk *first_chunk = NULL;
         AbstractIterator *probe = NULL;
+        RollupRoute route;
+        const bool routed = RollupRoute_Plan(ctx, series, &args->rangeArgs, &route);
+        if (routed) {
+            probe = RollupRoute_Query(&route, args->reverse);
+        } else {
+            probe = QueryCache_Query(ctx, series, &args->rangeArgs, args->reverse);
+        }
         if (args->excludeEmpty) {
-            probe = SeriesQueryIfNonEmpty(series, &args->rangeArgs, args->reverse, &first_chunk);
+            probe = probe ? IteratorIfNonEmpty(probe, &first_chunk)
+                          : SeriesQueryIfNonEmpty(
+                                series, &args->rangeArgs, args->reverse, &first_chunk);
             if (!probe) {
+                if (routed) {
+                    RollupRoute_Close(&route);
+                }
                 RedisModule_CloseKey(key);
                 RedisModule_FreeString(ctx, currentKey);
                 continue;
             }
         }
-        ReplySeriesArrayPos(ctx,
-                            series,
-                            args->withLabels,
-                            (RedisModuleString **)args->limitLabels,
-                            args->numLimitLabels,
-                            &args->rangeArgs,
-                            args->reverse,
-                            false,
-                            probe,
-                            first_chunk);
+        if (blob) {
+            if (!probe) {
+                probe = SeriesQuery(series, &args->rangeArgs, args->reverse, true);
+            }
+            SeriesBlob_AddSeries(blob,
+                                 series,
+                                 args->withLabels,
+                                 (RedisModuleString **)args->limitLabels,
+                                 args->numLimitLabels,
+                                 probe,
+                                 first_chunk);
+        } else {
+            ReplySeriesArrayPos(ctx,
+                                series,
+                                args->withLabels,
+                                (RedisModuleString **)args->limitLabels,
+                                args->numLimitLabels,
+                                &args->rangeArgs,
+                                args->reverse,
+                                false,
+                                probe,
+                                first_chunk);
+        }
+        if (routed) {
+            RollupRoute_Close(&route);
+        }
         replylen++;
         RedisModule_CloseKey(key);
         RedisModule_FreeString(ctx, currentKey);
     }
 
+    const bool more =
+        limit > 0 && replylen == limit && RedisModule_DictNextC(iter, NULL, NULL) != NULL;
     RedisModule_DictIteratorStop(iter);
+    if (blob) {
+        SeriesBlob_Finish(blob, more);
+        RedisModule_ReplyWithStringBuffer(ctx, blob->buf, blob->len);
+        return REDISMODULE_OK;
+    }
+    if (more) {
+        // more series left, the caller resumes after the last one
+        RedisModule_ReplyWithLongLong(ctx, 1);
+        replylen++;
+    }
     ReplySetMapOrArrayLength(ctx, replylen, false);
     return REDISMODULE_OK;
 }
 
+int replyUngroupedMultiRange(RedisModuleCtx *ctx, RedisModuleDict *result, const MRangeArgs *args) {
+    return replyUngroupedMultiRangeBatch(ctx, result, args, NULL, 0, NULL);
+}
+
 static int TSDB_generic_mrange(RedisModuleCtx *ctx, RedisModuleString **argv, int argc, bool rev) {
     MRangeArgs args;
     if (parseMRangeCommand(ctx, argv, argc, &args) != REDISMODULE_OK) {
@@ -628,6 +724,12 @@ static int TSDB_generic_mrange(RedisModuleCtx *ctx, RedisModuleString **argv, in
     }
     args.reverse = rev;
 
+    if (args.cursor) {
+        const int result = MRangeCursor_Reply(ctx, argv, argc, &args);
+        MRangeArgs_Free(&args);
+        return result;
+    }
+
     bool hasPermissionError = false;
     RedisModuleDict *resultSeries = QueryIndex(
         ctx, args.queryPredicates->list, args.queryPredicates->count, &hasPermissionError);
@@ -645,6 +747,13 @@ static int TSDB_generic_mrange(RedisModuleCtx *ctx, RedisModuleString **argv, in
 
         result = replyGroupedMultiRange(ctx, resultset, resultSeries, &args);
     } else {
+        // the workers read the raw series only, see parallel_query.h
+        if (RollupRoute_MayApply(&args.rangeArgs) || QueryCache_MayApply(&args.rangeArgs)) {
+            ParallelQuery_KeepInline();
+        } else if (ParallelQuery_MRange(ctx, resultSeries, &args)) {
+            // args are owned by the parallel query from here
+            return REDISMODULE_OK;
+        }
         result = replyUngroupedMultiRange(ctx, resultSeries, &args);
     }
 
@@ -687,25 +796,156 @@ int TSDB_mrevrange(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     return TSDB_generic_mrange(ctx, argv, argc, true);
 }
 
+// TS.MTOPK k fromTimestamp toTimestamp AGGREGATION aggregator [BOTTOM] [options] FILTER ...
+// See topk.h
+int TSDB_mtopk(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+    RedisModule_AutoMemory(ctx);
+    if (IsMRCluster()) {
+        int ctxFlags = RedisModule_GetContextFlags(ctx);
+
+        if (ctxFlags & (REDISMODULE_CTX_FLAGS_LUA | REDISMODULE_CTX_FLAGS_MULTI |
+                        REDISMODULE_CTX_FLAGS_DENY_BLOCKING)) {
+            RedisModule_ReplyWithError(ctx,
+                                       "Can not run multi sharded command inside a multi exec, "
+                                       "lua, or when blocking is not allowed");
+            return REDISMODULE_OK;
+        }
+        return TSDB_mtopk_MR(ctx, argv, argc);
+    }
+
+    MTopKArgs args;
+    if (parseMTopKCommand(ctx, argv, argc, &args) != REDISMODULE_OK) {
+        return REDISMODULE_ERR;
+    }
+
+    bool hasPermissionError = false;
+    RedisModuleDict *resultSeries = QueryIndex(ctx,
+                                               args.mrange.queryPredicates->list,
+                                               args.mrange.queryPredicates->count,
+                                               &hasPermissionError);
+    if (hasPermissionError) {
+        MTopKArgs_Free(&args);
+        RTS_ReplyKeyPermissionsError(ctx);
+        return REDISMODULE_ERR;
+    }
+
+    TopKHeap heap;
+    TopKHeap_Init(&heap, args.k, args.bottom);
+    MTopK_AddSeries(ctx, &heap, resultSeries, &args);
+    MTopK_Reply(ctx, &heap, &args);
+    TopKHeap_Free(&heap);
+    MTopKArgs_Free(&args);
+    return REDISMODULE_OK;
+}
+
+// TS.RANGE/TS.REVRANGE key fromTimestamp toTimestamp [FIELD field] [options] on a wide series.
+// With FIELD the reply is that of a regular series, without it every field is returned pivoted
+// by timestamp like TS.NRANGE does, with the same aggregators applied to all the fields, and
+// FORMAT BINARY, lttb, m4 and EXPR are rejected.
+static int wideSeriesRange(RedisModuleCtx *ctx,
+                           WideSeries *series,
+                           RedisModuleString **argv,
+                           int argc,
+                           bool rev) {
+    // FIELD is removed before parsing, so that a field name is never mistaken for an option
+    RedisModuleString **rangeArgv = malloc(argc * sizeof(*rangeArgv));
+    int rangeArgc = 0;
+    int field = -1;
+    for (int i = 0; i < argc; ++i) {
+        if (i >= 4 && RMUtil_StringEqualsCaseC(argv[i], "FIELD")) {
+            if (i + 1 >= argc) {
+                free(rangeArgv);
+                return RedisModule_WrongArity(ctx);
+            }
+            field = WideSeriesFieldIndex(series, argv[++i]);
+            if (field < 0) {
+                free(rangeArgv);
+                return RTS_ReplyGeneralError(ctx, "TSDB: the field does not exist");
+            }
+            continue;
+        }
+        if (i >= 4 && RMUtil_StringEqualsCaseC(argv[i], "EXPR")) {
+            // would otherwise be ignored by parseRangeArguments
+            free(rangeArgv);
+            return RTS_ReplyGeneralError(ctx, "TSDB: EXPR is not supported on a wide series");
+        }
+        rangeArgv[rangeArgc++] = argv[i];
+    }
+
+    RangeArgs rangeArgs = { 0 };
+    if (parseRangeArguments(ctx, 2, rangeArgv, rangeArgc, &rangeArgs) != REDISMODULE_OK) {
+        goto _out;
+    }
+
+    if (field >= 0) {
+        ReplySeriesRange(ctx, &series->fields[field], &rangeArgs, rev);
+        goto _out;
+    }
+
+    if (rangeArgs.binaryFormat) {
+        // the rows hold the values of several fields
+        RTS_ReplyGeneralError(ctx, "TSDB: FORMAT BINARY needs a FIELD on a wide series");
+        goto _out;
+    }
+    if (rangeArgs.downsample.type != DOWNSAMPLE_NONE) {
+        // the fields would be downsampled to different timestamps
+        RTS_ReplyGeneralError(ctx, "TSDB: lttb and m4 need a FIELD on a wide series");
+        goto _out;
+    }
+
+    const size_t numClasses = rangeArgs.aggregationArgs.numClasses;
+    AbstractIterator **iters = malloc(series->numFields * sizeof(*iters));
+    size_t *aggsPerField = malloc(series->numFields * sizeof(*aggsPerField));
+    for (size_t i = 0; i < series->numFields; ++i) {
+        iters[i] = SeriesQuery(&series->fields[i], &rangeArgs, rev, true);
+        aggsPerField[i] = numClasses ? numClasses : 1;
+    }
+    ReplySeriesNRange(ctx, iters, series->numFields, aggsPerField, rangeArgs.count, rev, NULL);
+    free(iters);
+    free(aggsPerField);
+
+_out:
+    free(rangeArgs.aggregationArgs.classes);
+    free(rangeArgv);
+    return REDISMODULE_OK;
+}
+
 int TSDB_generic_range(RedisModuleCtx *ctx, RedisModuleString **argv, int argc, bool rev) {
     if (argc < 4) {
         return RedisModule_WrongArity(ctx);
     }
 
-    Series *series;
     RedisModuleKey *key;
-    const GetSeriesResult status =
-        GetSeries(ctx, argv[1], &key, &series, REDISMODULE_READ, GetSeriesFlags_CheckForAcls);
+    Series *series;
+    WideSeries *wide;
+    const GetSeriesResult status = GetSeriesOrWideSeries(
+        ctx, argv[1], &key, &series, &wide, REDISMODULE_READ, GetSeriesFlags_CheckForAcls);
     if (status != GetSeriesResult_Success) {
         return REDISMODULE_ERR;
     }
+    if (wide) {
+        wideSeriesRange(ctx, wide, argv, argc, rev);
+        RedisModule_CloseKey(key);
+        return REDISMODULE_OK;
+    }
 
     RangeArgs rangeArgs = { 0 };
     if (parseRangeArguments(ctx, 2, argv, argc, &rangeArgs) != REDISMODULE_OK) {
         goto _out;
     }
 
-    ReplySeriesRange(ctx, series, &rangeArgs, rev);
+    RollupRoute route;
+    AbstractIterator *cached;
+    if (RollupRoute_Plan(ctx, series, &rangeArgs, &route)) {
+        ParallelQuery_KeepInline();
+        ReplySeriesRangeFromIter(ctx, RollupRoute_Query(&route, rev), NULL, &rangeArgs);
+        RollupRoute_Close(&route);
+    } else if ((cached = QueryCache_Query(ctx, series, &rangeArgs, rev)) != NULL) {
+        ParallelQuery_KeepInline();
+        ReplySeriesRangeFromIter(ctx, cached, NULL, &rangeArgs);
+    } else if (!ParallelQuery_Range(ctx, series, &rangeArgs, rev)) {
+        ReplySeriesRange(ctx, series, &rangeArgs, rev);
+    }
 
 _out:
     free(rangeArgs.aggregationArgs.classes);
@@ -724,11 +964,14 @@ int TSDB_revrange(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
 // TS.NRANGE/TS.NREVRANGE numkeys key [key...] fromTimestamp toTimestamp [options]
 //   [LATEST] [FILTER_BY_TS ts...] [FILTER_BY_VALUE min max] [COUNT count]
 //   [[ALIGN align] AGGREGATION aggspec [aggspec ...] bucketDuration [BUCKETTIMESTAMP bt] [EMPTY]]
+//   [EXPR expression]
 // Like TS.RANGE but over an explicit list of same-slot keys, returning results pivoted by
 // timestamp: one row per distinct timestamp, NaN where a key has no sample. Each aggspec is
 // comma-separated to request multiple aggregators for that key (e.g. "AVG,SUM"). The number of
 // aggspecs must equal numkeys; all share a single bucketDuration.
 // Reply format: [timestamp, [v0, v1, ...]] flat — all agg values across all keys in one array.
+// With EXPR expression the reply is [timestamp, value] instead, the value of the expression over
+// the values of the row ($0 is v0 and so on).
 int TSDB_generic_nrange(RedisModuleCtx *ctx, RedisModuleString **argv, int argc, bool rev) {
     // argv: [0]=cmd [1]=numkeys [2..1+numkeys]=keys [2+numkeys]=from [3+numkeys]=to ...
     if (argc < 5) {
@@ -762,6 +1005,30 @@ int TSDB_generic_nrange(RedisModuleCtx *ctx, RedisModuleString **argv, int argc,
     size_t numClasses = 0;
     int rv = REDISMODULE_ERR;
     size_t opened = 0;
+    Expr *expr = NULL;
+
+    // EXPR is removed before parsing, so that the expression is never mistaken for an option
+    RedisModuleString **rangeArgv = malloc(argc * sizeof(*rangeArgv));
+    int rangeArgc = 0;
+    for (int i = 0; i < argc; ++i) {
+        if (i >= rangeStart + 2 && RMUtil_StringEqualsCaseC(argv[i], "EXPR")) {
+            if (i + 1 >= argc || expr) {
+                RTS_ReplyGeneralError(ctx, "TSDB: EXPR needs a single expression");
+                goto cleanup;
+            }
+            size_t len;
+            const char *src = RedisModule_StringPtrLen(argv[++i], &len);
+            const char *error;
+            if (!(expr = Expr_Compile(src, len, &error))) {
+                RedisModule_ReplyWithError(ctx, error);
+                goto cleanup;
+            }
+            continue;
+        }
+        rangeArgv[rangeArgc++] = argv[i];
+    }
+    argv = rangeArgv;
+    argc = rangeArgc;
 
     aggs_per_key = malloc((size_t)numKeys * sizeof(*aggs_per_key));
     for (size_t i = 0; i < (size_t)numKeys; i++)
@@ -849,6 +1116,27 @@ int TSDB_generic_nrange(RedisModuleCtx *ctx, RedisModuleString **argv, int argc,
         }
     }
 
+    if (rangeArgs.binaryFormat) {
+        // the rows of TS.NRANGE hold the values of several series
+        RTS_ReplyGeneralError(ctx, "TSDB: FORMAT BINARY is not supported by TS.NRANGE");
+        goto cleanup;
+    }
+    if (rangeArgs.downsample.type != DOWNSAMPLE_NONE) {
+        // the series would be downsampled to different timestamps
+        RTS_ReplyGeneralError(ctx, "TSDB: lttb and m4 are not supported by TS.NRANGE");
+        goto cleanup;
+    }
+    if (expr) {
+        size_t rowWidth = 0;
+        for (size_t i = 0; i < (size_t)numKeys; i++) {
+            rowWidth += aggs_per_key[i];
+        }
+        if (expr->numColumns > rowWidth) {
+            RTS_ReplyGeneralError(ctx, "TSDB: EXPR uses a column beyond the values of the keys");
+            goto cleanup;
+        }
+    }
+
     keys = calloc(numKeys, sizeof(RedisModuleKey *));
     series = calloc(numKeys, sizeof(Series *));
 
@@ -881,10 +1169,12 @@ int TSDB_generic_nrange(RedisModuleCtx *ctx, RedisModuleString **argv, int argc,
         iters[i] = SeriesQuery(series[i], &perKey, rev, true);
     }
 
-    ReplySeriesNRange(ctx, iters, (size_t)numKeys, aggs_per_key, rangeArgs.count, rev);
+    ReplySeriesNRange(ctx, iters, (size_t)numKeys, aggs_per_key, rangeArgs.count, rev, expr);
     rv = REDISMODULE_OK;
 
 cleanup:
+    Expr_Free(expr);
+    free(rangeArgv);
     free(allClasses);
     free(iters);
     free(aggs_per_key);
@@ -916,7 +1206,8 @@ static void handleCompaction(RedisModuleCtx *ctx,
                              Series *series,
                              CompactionRule *rule,
                              api_timestamp_t timestamp,
-                             double value) {
+                             double value,
+                             const GetSeriesFlags flags) {
     timestamp_t currentTimestamp =
         CalcBucketStart(timestamp, rule->bucketDuration, rule->timestampAlignment);
     timestamp_t currentTimestampNormalized = BucketStartNormalize(currentTimestamp);
@@ -925,7 +1216,7 @@ static void handleCompaction(RedisModuleCtx *ctx,
         // first sample, lets init the startCurrentTimeBucket
         rule->startCurrentTimeBucket = currentTimestampNormalized;
 
-        if (rule->aggClass->type == TS_AGG_TWA) {
+        if (AggTypeUsesBucketEdges(rule->aggClass->type)) {
             rule->aggClass->addBucketParams(rule->aggContext,
                                             currentTimestampNormalized,
                                             currentTimestamp + rule->bucketDuration);
@@ -935,7 +1226,6 @@ static void handleCompaction(RedisModuleCtx *ctx,
     if (currentTimestampNormalized > rule->startCurrentTimeBucket) {
         Series *destSeries;
         RedisModuleKey *key;
-        const GetSeriesFlags flags = GetSeriesFlags_SilentOperation | GetSeriesFlags_CheckForAcls;
         const GetSeriesResult status = GetSeries(
             ctx, rule->destKey, &key, &destSeries, REDISMODULE_READ | REDISMODULE_WRITE, flags);
         if (status != GetSeriesResult_Success) {
@@ -944,7 +1234,8 @@ static void handleCompaction(RedisModuleCtx *ctx,
             return;
         }
 
-        if (rule->aggClass->type == TS_AGG_TWA && rule->aggClass->isValueValid(value)) {
+        if (AggTypeUsesBucketEdges(rule->aggClass->type) &&
+            rule->aggClass->isValueValid(value)) {
             rule->aggClass->addNextBucketFirstSample(rule->aggContext, value, timestamp);
         }
 
@@ -953,23 +1244,22 @@ static void handleCompaction(RedisModuleCtx *ctx,
             double aggVal;
             if (rule->aggClass->finalize(rule->aggContext, &aggVal) == TSDB_OK) {
                 internalAdd(ctx, destSeries, rule->startCurrentTimeBucket, aggVal, DP_LAST, false);
-                RedisModule_NotifyKeyspaceEvent(
-                    ctx, REDISMODULE_NOTIFY_MODULE, "ts.add:dest", rule->destKey);
+                Notify_KeyspaceEvent(ctx, "ts.add:dest", rule->destKey);
             }
         }
         Sample last_sample;
-        if (rule->aggClass->type == TS_AGG_TWA) {
+        if (AggTypeUsesBucketEdges(rule->aggClass->type)) {
             rule->aggClass->getLastSample(rule->aggContext, &last_sample);
         }
         rule->aggClass->resetContext(rule->aggContext);
         rule->validSamplesInBucket = false;
-        if (rule->aggClass->type == TS_AGG_TWA) {
+        if (AggTypeUsesBucketEdges(rule->aggClass->type)) {
             rule->aggClass->addBucketParams(rule->aggContext,
                                             currentTimestampNormalized,
                                             currentTimestamp + rule->bucketDuration);
         }
 
-        if (rule->aggClass->type == TS_AGG_TWA && hadValidSamples &&
+        if (AggTypeUsesBucketEdges(rule->aggClass->type) && hadValidSamples &&
             rule->aggClass->isValueValid(last_sample.value)) {
             rule->aggClass->addPrevBucketLastSample(
                 rule->aggContext, last_sample.value, last_sample.timestamp);
@@ -983,6 +1273,83 @@ static void handleCompaction(RedisModuleCtx *ctx,
     }
 }
 
+// Feeds samples of a series through all of its rules, in order
+static void applyCompactionRules(RedisModuleCtx *ctx,
+                                 Series *series,
+                                 const Sample *samples,
+                                 size_t count,
+                                 const GetSeriesFlags flags) {
+    if (series->rules) {
+        deleteReferenceToDeletedSeries(ctx, series, flags);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        for (CompactionRule *rule = series->rules; rule != NULL; rule = rule->nextRule) {
+            handleCompaction(ctx, series, rule, samples[i].timestamp, samples[i].value, flags);
+        }
+    }
+}
+
+// Apply callback of the async compaction queues. The context's user is the one who wrote the
+// samples, see applyAsWriter.
+static void applyQueuedCompactions(RedisModuleCtx *ctx,
+                                   Series *series,
+                                   const Sample *samples,
+                                   size_t count,
+                                   bool checkAcls) {
+    const GetSeriesFlags flags =
+        GetSeriesFlags_SilentOperation | (checkAcls ? GetSeriesFlags_CheckForAcls : 0);
+    applyCompactionRules(ctx, series, samples, count, flags);
+}
+
+// Write callback of the TS.CREATERULE BACKFILL jobs. Replicas and the AOF don't run the jobs, so
+// every written bucket is propagated on its own.
+static void writeBackfilledBuckets(RedisModuleCtx *ctx,
+                                   RedisModuleString *destKey,
+                                   Series *dest,
+                                   const Sample *samples,
+                                   size_t count) {
+    Notify_BeginBatch();
+    for (size_t i = 0; i < count; i++) {
+        if (internalAdd(ctx, dest, samples[i].timestamp, samples[i].value, DP_LAST, false) !=
+            REDISMODULE_OK) {
+            continue;
+        }
+        RedisModuleString *value = RedisModule_CreateStringFromDouble(ctx, samples[i].value);
+        RedisModule_Replicate(ctx,
+                              "TS.ADD",
+                              "slscc",
+                              destKey,
+                              (long long)samples[i].timestamp,
+                              value,
+                              "ON_DUPLICATE",
+                              "LAST");
+        RedisModule_FreeString(ctx, value);
+    }
+    Notify_KeyspaceEvent(ctx, "ts.add:dest", destKey);
+    Notify_EndBatch(ctx);
+}
+
+static void compactSample(RedisModuleCtx *ctx,
+                          Series *series,
+                          api_timestamp_t timestamp,
+                          double value) {
+    if (TSGlobalConfig.asyncCompaction) {
+        if (!AsyncCompaction_Enqueue(ctx, series, timestamp, value)) {
+            // ts-compaction-async-max-lag reached, catch up inline
+            AsyncCompaction_FlushSeries(ctx, series);
+            AsyncCompaction_Enqueue(ctx, series, timestamp, value);
+        }
+        return;
+    }
+
+    // Async mode may have been turned off while samples were still queued
+    AsyncCompaction_FlushSeries(ctx, series);
+    const Sample sample = { .timestamp = timestamp, .value = value };
+    applyCompactionRules(
+        ctx, series, &sample, 1, GetSeriesFlags_SilentOperation | GetSeriesFlags_CheckForAcls);
+}
+
 static inline bool filter_close_samples(DuplicatePolicy dp_policy,
                                         const Series *series,
                                         api_timestamp_t timestamp,
@@ -1023,6 +1390,8 @@ static int internalAdd(RedisModuleCtx *ctx,
     }
 
     if (timestamp <= series->lastTimestamp && series->totalSamples != 0) {
+        // upsertCompaction recalculates buckets from the rules' current state
+        AsyncCompaction_FlushSeries(ctx, series);
         if (SeriesUpsertSample(series, timestamp, value, dp_policy) != REDISMODULE_OK) {
             RTS_ReplyGeneralError(ctx,
                                   "TSDB: Error at upsert, update is not supported when "
@@ -1034,19 +1403,14 @@ static int internalAdd(RedisModuleCtx *ctx,
         SeriesAddSample(series, timestamp, value);
         // handle compaction rules
         if (series->rules) {
-            const GetSeriesFlags flags =
-                GetSeriesFlags_SilentOperation | GetSeriesFlags_CheckForAcls;
-            deleteReferenceToDeletedSeries(ctx, series, flags);
-        }
-
-        for (CompactionRule *rule = series->rules; rule != NULL; rule = rule->nextRule) {
-            handleCompaction(ctx, series, rule, timestamp, value);
+            compactSample(ctx, series, timestamp, value);
         }
     }
     // Wake any TS.READ waiters parked on this key. Cheap no-op when no client
     // is blocked; harmless extra try_reply when the upsert was an in-place
     // update (the reply_cb will re-check and stay parked if nothing changed).
-    RedisModule_SignalKeyAsReady(ctx, series->keyName);
+    // Within a batched write the key is signaled once, when the command ends.
+    Notify_KeyReady(ctx, series->keyName);
 
     if (should_reply) {
         RedisModule_ReplyWithLongLong(ctx, timestamp);
@@ -1121,6 +1485,9 @@ int TSDB_madd(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
 
     RedisModuleString *curTimeStr = NULL;
 
+    // a key written several times is notified and signaled once
+    Notify_BeginBatch();
+    AsyncCompaction_BeginWrite();
     RedisModule_ReplyWithArray(ctx, (argc - 1) / 3);
     const RedisModuleString **replArgv = malloc((argc - 1) * sizeof *replArgv);
     const RedisModuleString **offset = replArgv;
@@ -1154,8 +1521,10 @@ int TSDB_madd(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     free(replArgv);
 
     for (int i = 1; i < argc; i += 3) {
-        RedisModule_NotifyKeyspaceEvent(ctx, REDISMODULE_NOTIFY_MODULE, "ts.add", argv[i]);
+        Notify_KeyspaceEvent(ctx, "ts.add", argv[i]);
     }
+    AsyncCompaction_EndWrite();
+    Notify_EndBatch(ctx);
 
     return REDISMODULE_OK;
 }
@@ -1176,6 +1545,8 @@ int TSDB_add(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
         timestampStr = getCurrentTime(ctx);
     }
 
+    Notify_BeginBatch();
+    AsyncCompaction_BeginWrite();
     const int result = add(ctx, keyName, timestampStr, valueStr, argv, argc);
     if (result == REDISMODULE_OK) {
         const size_t replArgc = argc - 1;
@@ -1188,11 +1559,151 @@ int TSDB_add(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
         free(replArgv);
     }
 
-    RedisModule_NotifyKeyspaceEvent(ctx, REDISMODULE_NOTIFY_MODULE, "ts.add", keyName);
+    Notify_KeyspaceEvent(ctx, "ts.add", keyName);
+    AsyncCompaction_EndWrite();
+    Notify_EndBatch(ctx);
 
     return result;
 }
 
+// TS.WCREATE key FIELDS numfields field [field ...] [RETENTION retentionPeriod] [CHUNK_SIZE size]
+int TSDB_wcreate(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+    RedisModule_AutoMemory(ctx);
+
+    if (argc < 5) {
+        return RedisModule_WrongArity(ctx);
+    }
+
+    RedisModuleString *keyName = argv[1];
+    if (!RMUtil_StringEqualsCaseC(argv[2], "FIELDS")) {
+        return RTS_ReplyGeneralError(ctx, "TSDB: FIELDS is required");
+    }
+
+    long long numFields;
+    if (RedisModule_StringToLongLong(argv[3], &numFields) != REDISMODULE_OK || numFields <= 0 ||
+        numFields > WIDE_SERIES_MAX_FIELDS) {
+        return RTS_ReplyGeneralError(ctx, "TSDB: numfields must be between 1 and 1024");
+    }
+    if (numFields > argc - 4) {
+        return RedisModule_WrongArity(ctx);
+    }
+
+    RedisModuleString **fields = argv + 4;
+    for (long long i = 0; i < numFields; ++i) {
+        for (long long j = 0; j < i; ++j) {
+            if (RedisModule_StringCompare(fields[i], fields[j]) == 0) {
+                return RTS_ReplyGeneralError(ctx, "TSDB: duplicate field name");
+            }
+        }
+    }
+
+    // options are only looked for after the field names
+    RedisModuleString **opts = fields + numFields;
+    const int optsCount = argc - 4 - (int)numFields;
+    long long retentionTime = TSGlobalConfig.retentionPolicy;
+    long long chunkSizeBytes = TSGlobalConfig.chunkSizeBytes;
+    if (RMUtil_ArgIndex("RETENTION", opts, optsCount) >= 0 &&
+        (RMUtil_ParseArgsAfter("RETENTION", opts, optsCount, "l", &retentionTime) !=
+             REDISMODULE_OK ||
+         retentionTime < 0)) {
+        return RTS_ReplyGeneralError(ctx, "TSDB: Couldn't parse RETENTION");
+    }
+    if (ParseChunkSize(ctx, opts, optsCount, "CHUNK_SIZE", &chunkSizeBytes, NULL) != TSDB_OK) {
+        return REDISMODULE_ERR;
+    }
+
+    RedisModuleKey *key = RedisModule_OpenKey(ctx, keyName, REDISMODULE_READ | REDISMODULE_WRITE);
+    if (RedisModule_KeyType(key) != REDISMODULE_KEYTYPE_EMPTY) {
+        RedisModule_CloseKey(key);
+        return RTS_ReplyGeneralError(ctx, "TSDB: key already exists");
+    }
+
+    RedisModuleString **fieldNames = malloc(numFields * sizeof(*fieldNames));
+    for (long long i = 0; i < numFields; ++i) {
+        fieldNames[i] = RedisModule_CreateStringFromString(NULL, fields[i]);
+    }
+    WideSeries *series = NewWideSeries(fieldNames, numFields, retentionTime, chunkSizeBytes);
+    RedisModule_ModuleTypeSetValue(key, WideSeriesType, series);
+    RedisModule_CloseKey(key);
+
+    RedisModule_ReplyWithSimpleString(ctx, "OK");
+    RedisModule_ReplicateVerbatim(ctx);
+
+    RedisModule_NotifyKeyspaceEvent(ctx, REDISMODULE_NOTIFY_MODULE, "ts.wcreate", keyName);
+
+    return REDISMODULE_OK;
+}
+
+// TS.WADD key timestamp value [value ...], one value per field in the order of TS.WCREATE
+int TSDB_wadd(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+    RedisModule_AutoMemory(ctx);
+
+    if (argc < 4) {
+        return RedisModule_WrongArity(ctx);
+    }
+
+    RedisModuleString *keyName = argv[1];
+    RedisModuleKey *key = RedisModule_OpenKey(ctx, keyName, REDISMODULE_READ | REDISMODULE_WRITE);
+    if (RedisModule_KeyType(key) == REDISMODULE_KEYTYPE_EMPTY) {
+        RedisModule_CloseKey(key);
+        return RTS_ReplyGeneralError(ctx, "TSDB: the key does not exist");
+    }
+    if (RedisModule_ModuleTypeGetType(key) != WideSeriesType) {
+        RedisModule_CloseKey(key);
+        return RTS_ReplyGeneralError(ctx, "TSDB: the key is not a wide series");
+    }
+    WideSeries *series = RedisModule_ModuleTypeGetValue(key);
+
+    if (argc - 3 != series->numFields) {
+        RedisModule_CloseKey(key);
+        return RTS_ReplyGeneralError(ctx,
+                                     "TSDB: the number of values must match the number of fields");
+    }
+
+    RedisModuleString *timestampStr = argv[2];
+    if (stringEqualsC(timestampStr, "*")) {
+        timestampStr = getCurrentTime(ctx);
+    }
+    long long timestamp;
+    if (RedisModule_StringToLongLong(timestampStr, &timestamp) != REDISMODULE_OK) {
+        RedisModule_CloseKey(key);
+        return RTS_ReplyGeneralError(ctx, "TSDB: invalid timestamp");
+    }
+    if (timestamp < 0) {
+        RedisModule_CloseKey(key);
+        return RTS_ReplyGeneralError(ctx, "TSDB: invalid timestamp, must be a nonnegative integer");
+    }
+
+    double *values = malloc(series->numFields * sizeof(*values));
+    for (size_t i = 0; i < series->numFields; ++i) {
+        if (!parse_double(argv[3 + i], &values[i])) {
+            free(values);
+            RedisModule_CloseKey(key);
+            return RTS_ReplyGeneralError(ctx, "TSDB: invalid value");
+        }
+    }
+
+    const int rv = WideSeriesAddRow(series, timestamp, values);
+    free(values);
+    RedisModule_CloseKey(key);
+    if (rv != TSDB_OK) {
+        return RTS_ReplyGeneralError(
+            ctx, "TSDB: timestamp must be newer than the last sample of a wide series");
+    }
+
+    RedisModule_ReplyWithLongLong(ctx, timestamp);
+
+    const size_t replArgc = argc - 1;
+    RedisModuleString **replArgv = malloc(replArgc * sizeof(*replArgv));
+    memcpy(replArgv, argv + 1, replArgc * sizeof(*replArgv)); // skip the command name
+    replArgv[1] = timestampStr; // In case the timestamp was "*"
+    RedisModule_Replicate(ctx, "TS.WADD", "v", replArgv, replArgc);
+    free(replArgv);
+    Notify_KeyspaceEvent(ctx, "ts.wadd", keyName);
+
+    return REDISMODULE_OK;
+}
+
 int CreateTsKey(RedisModuleCtx *ctx,
                 RedisModuleString *keyName,
                 const CreateCtx *cCtx,
@@ -1274,7 +1785,13 @@ int TSDB_alter(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     }
 
     if (RMUtil_ArgIndex("CHUNK_SIZE", argv, argc) > 0) {
-        series->chunkSizeBytes = cCtx.chunkSizeBytes;
+        if (cCtx.options & SERIES_OPT_CHUNK_SIZE_AUTO) {
+            // the current size is the initial target
+            series->options |= SERIES_OPT_CHUNK_SIZE_AUTO;
+        } else {
+            series->options &= ~SERIES_OPT_CHUNK_SIZE_AUTO;
+            series->chunkSizeBytes = cCtx.chunkSizeBytes;
+        }
     }
 
     if (RMUtil_ArgIndex("DUPLICATE_POLICY", argv, argc) > 0) {
@@ -1332,6 +1849,7 @@ int TSDB_deleteRule(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     }
 
     RedisModuleString *destKeyName = argv[2];
+    AsyncCompaction_FlushSeries(ctx, srcSeries);
     if (!SeriesDeleteRule(srcSeries, destKeyName)) {
         RedisModule_CloseKey(srcKey);
         return RTS_ReplyGeneralError(ctx, "TSDB: compaction rule does not exist");
@@ -1365,12 +1883,54 @@ int TSDB_deleteRule(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     return REDISMODULE_OK;
 }
 
+// The bucket holding the last sample of the source is still open: it is aggregated right away
+// into the rule's context, so that following samples complete it as if the rule always existed.
+// The closed buckets before it are written into the destination by a background job. Replicas
+// and the AOF only seed the open bucket, the job's writes are propagated as they happen.
+static void backfillRule(RedisModuleCtx *ctx,
+                         RedisModuleString *srcKeyName,
+                         Series *srcSeries,
+                         CompactionRule *rule) {
+    const timestamp_t openBucket =
+        CalcBucketStart(srcSeries->lastTimestamp, rule->bucketDuration, rule->timestampAlignment);
+    const timestamp_t openBucketNormalized = BucketStartNormalize(openBucket);
+
+    bool isEmpty = true;
+    if (SeriesCalcRange(srcSeries,
+                        openBucketNormalized,
+                        openBucket + rule->bucketDuration - 1,
+                        rule,
+                        NULL,
+                        &isEmpty) == TSDB_OK) {
+        rule->startCurrentTimeBucket = openBucketNormalized;
+        rule->validSamplesInBucket = !isEmpty;
+        rule->watermark = openBucketNormalized;
+    }
+
+    const int ctxFlags = RedisModule_GetContextFlags(ctx);
+    if (ctxFlags & (REDISMODULE_CTX_FLAGS_REPLICATED | REDISMODULE_CTX_FLAGS_LOADING)) {
+        return;
+    }
+
+    long long skipped;
+    const timestamp_t firstTimestamp = getFirstValidTimestamp(srcSeries, &skipped);
+    if (openBucketNormalized > firstTimestamp) {
+        Backfill_Start(ctx, srcKeyName, rule, firstTimestamp, openBucketNormalized - 1);
+    }
+}
+
 /*
-TS.CREATERULE sourceKey destKey AGGREGATION aggregationType bucketDuration
+TS.CREATERULE sourceKey destKey AGGREGATION aggregationType bucketDuration [alignTimestamp] [BACKFILL]
 */
 int TSDB_createRule(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     RedisModule_AutoMemory(ctx);
 
+    // BACKFILL is always the last argument, strip it so the alignment is found at its usual place
+    const bool backfill = argc > 6 && RMUtil_StringEqualsCaseC(argv[argc - 1], "BACKFILL");
+    if (backfill) {
+        argc--;
+    }
+
     if (argc != 6 && argc != 7) {
         return RedisModule_WrongArity(ctx);
     }
@@ -1439,16 +1999,25 @@ int TSDB_createRule(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
         return RTS_ReplyGeneralError(ctx, "TSDB: the destination key already has a src rule");
     }
 
+    // samples queued before the rule existed must not be aggregated into it
+    AsyncCompaction_FlushSeries(ctx, srcSeries);
+
     // add src to dest
     SeriesSetSrcRule(ctx, destSeries, srcSeries->keyName);
 
     // Last add the rule to source
-    if (SeriesAddRule(ctx, srcSeries, destSeries, aggType, bucketDuration, alignmentTS) == NULL) {
+    CompactionRule *rule =
+        SeriesAddRule(ctx, srcSeries, destSeries, aggType, bucketDuration, alignmentTS);
+    if (rule == NULL) {
         RedisModule_CloseKey(srcKey);
         RedisModule_CloseKey(destKey);
         RedisModule_ReplyWithSimpleString(ctx, "TSDB: ERROR creating rule");
         return REDISMODULE_ERR;
     }
+
+    if (backfill && srcSeries->totalSamples > 0) {
+        backfillRule(ctx, srcKeyName, srcSeries, rule);
+    }
     RedisModule_ReplyWithSimpleString(ctx, "OK");
     RedisModule_ReplicateVerbatim(ctx);
 
@@ -1463,6 +2032,37 @@ int TSDB_createRule(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     return REDISMODULE_OK;
 }
 
+/*
+TS.BACKFILLSTATUS destKey
+*/
+int TSDB_backfillStatus(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+    if (argc != 2) {
+        return RedisModule_WrongArity(ctx);
+    }
+
+    const BackfillJob *job = Backfill_GetJob(ctx, argv[1]);
+    if (job == NULL) {
+        return RTS_ReplyGeneralError(ctx, "TSDB: the key has no backfill job");
+    }
+
+    ReplyWithMapOrArray(ctx, 7 * 2, true);
+    RedisModule_ReplyWithSimpleString(ctx, "sourceKey");
+    RedisModule_ReplyWithString(ctx, job->srcKey);
+    RedisModule_ReplyWithSimpleString(ctx, "destKey");
+    RedisModule_ReplyWithString(ctx, job->destKey);
+    RedisModule_ReplyWithSimpleString(ctx, "status");
+    RedisModule_ReplyWithSimpleString(ctx, Backfill_StatusName(job->status));
+    RedisModule_ReplyWithSimpleString(ctx, "fromTimestamp");
+    RedisModule_ReplyWithLongLong(ctx, job->startTimestamp);
+    RedisModule_ReplyWithSimpleString(ctx, "toTimestamp");
+    RedisModule_ReplyWithLongLong(ctx, job->endTimestamp);
+    RedisModule_ReplyWithSimpleString(ctx, "currentTimestamp");
+    RedisModule_ReplyWithLongLong(ctx, job->cursor);
+    RedisModule_ReplyWithSimpleString(ctx, "bucketsWritten");
+    RedisModule_ReplyWithLongLong(ctx, job->bucketsWritten);
+    return REDISMODULE_OK;
+}
+
 /*
 TS.INCRBY ts_key NUMBER [TIMESTAMP timestamp]
 */
@@ -1528,7 +2128,11 @@ int TSDB_incrby(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
         result -= incrby;
     }
 
+    Notify_BeginBatch();
+    AsyncCompaction_BeginWrite();
     int rv = internalAdd(ctx, series, currentUpdatedTime, result, DP_LAST, true);
+    AsyncCompaction_EndWrite();
+    Notify_EndBatch(ctx);
 
     if (useLocalTimestamp) {
         const char *replCmd = isIncr ? "TS.INCRBY" : "TS.DECRBY";
@@ -2328,6 +2932,7 @@ int TSDB_delete(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
         return REDISMODULE_ERR;
     }
 
+    AsyncCompaction_FlushSeries(ctx, series);
     size_t deleted = SeriesDelRange(series, args.startTimestamp, args.endTimestamp);
 
     RedisModule_ReplyWithLongLong(ctx, deleted);
@@ -2339,17 +2944,23 @@ int TSDB_delete(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
 }
 
 void FlushEventCallback(RedisModuleCtx *ctx, RedisModuleEvent eid, uint64_t subevent, void *data) {
-    if ((!memcmp(&eid, &RedisModuleEvent_FlushDB, sizeof(eid))) &&
-        subevent == REDISMODULE_SUBEVENT_FLUSHDB_END) {
+    if (memcmp(&eid, &RedisModuleEvent_FlushDB, sizeof(eid))) {
+        return;
+    }
+    if (subevent == REDISMODULE_SUBEVENT_FLUSHDB_START) {
+        // the series may be freed by a lazyfree thread, out of the queues' registry
+        const RedisModuleFlushInfo *fi = data;
+        AsyncCompaction_DropDb(fi->dbnum);
+    } else if (subevent == REDISMODULE_SUBEVENT_FLUSHDB_END) {
         RemoveAllIndexedMetrics();
     }
 }
 
 void swapDbEventCallback(RedisModuleCtx *ctx, RedisModuleEvent e, uint64_t sub, void *data) {
     RedisModule_Log(ctx, "warning", "swapdb isn't supported by redis timeseries");
-    if ((!memcmp(&e, &RedisModuleEvent_FlushDB, sizeof(e)))) {
+    if ((!memcmp(&e, &RedisModuleEvent_SwapDB, sizeof(e)))) {
         RedisModuleSwapDbInfo *ei = data;
-        REDISMODULE_NOT_USED(ei);
+        AsyncCompaction_SwapDb(ei->dbnum_first, ei->dbnum_second);
     }
 }
 
@@ -2375,6 +2986,16 @@ int keyRemovedFromDbDict(RedisModuleCtx *ctx,
 
 int persistence_in_progress = 0;
 
+static void TSInfoFunc(RedisModuleInfoCtx *ctx, int for_crash_report) {
+    REDISMODULE_NOT_USED(for_crash_report);
+    RedisModule_InfoAddSection(ctx, "");
+    RedisModule_InfoAddFieldULongLong(ctx, "cursors_cached", MRangeCursor_NumCached());
+    RedisModule_InfoAddFieldULongLong(ctx, "cursors_cached_memory", MRangeCursor_MemUsage());
+    RedisModule_InfoAddFieldULongLong(ctx, "parallel_queries", ParallelQuery_NumRun());
+    RedisModule_InfoAddFieldULongLong(
+        ctx, "parallel_queries_kept_inline", ParallelQuery_NumKeptInline());
+}
+
 void persistCallback(RedisModuleCtx *ctx, RedisModuleEvent eid, uint64_t subevent, void *data) {
     if (memcmp(&eid, &RedisModuleEvent_Persistence, sizeof(eid)) != 0) {
         return;
@@ -2384,6 +3005,8 @@ void persistCallback(RedisModuleCtx *ctx, RedisModuleEvent eid, uint64_t subeven
         subevent == REDISMODULE_SUBEVENT_PERSISTENCE_AOF_START ||
         subevent == REDISMODULE_SUBEVENT_PERSISTENCE_SYNC_RDB_START ||
         subevent == REDISMODULE_SUBEVENT_PERSISTENCE_SYNC_AOF_START) {
+        // rules' contexts are persisted, so they must have seen every persisted sample
+        AsyncCompaction_FlushAll(ctx);
         persistence_in_progress++;
     } else if (subevent == REDISMODULE_SUBEVENT_PERSISTENCE_ENDED ||
                subevent == REDISMODULE_SUBEVENT_PERSISTENCE_FAILED) {
@@ -2704,6 +3327,9 @@ int RedisModule_OnLoad(RedisModuleCtx *ctx, RedisModuleString **argv, int argc)
     }
 
     initGlobalCompactionFunctions();
+    initColumnarReduceFunctions();
+    AsyncCompaction_Init(applyQueuedCompactions);
+    Backfill_Init(writeBackfilledBuckets);
 
     if (register_mr(ctx, TSGlobalConfig.numThreads) != REDISMODULE_OK) {
         FreeConfigAndStaticCtx();
@@ -2720,6 +3346,7 @@ int RedisModule_OnLoad(RedisModuleCtx *ctx, RedisModuleString **argv, int argc)
         .copy = CopySeries,
         .free = FreeSeries,
         .defrag = DefragSeries,
+        .unlink = UnlinkSeries,
     };
 
     SeriesType = RedisModule_CreateDataType(ctx, "TSDB-TYPE", TS_LATEST_ENCVER, &tm);
@@ -2729,6 +3356,26 @@ int RedisModule_OnLoad(RedisModuleCtx *ctx, RedisModuleString **argv, int argc)
         return REDISMODULE_ERR;
     }
 
+    RedisModuleTypeMethods wideTm = {
+        .version = REDISMODULE_TYPE_METHOD_VERSION,
+        .rdb_load = wide_series_rdb_load,
+        .rdb_save = wide_series_rdb_save,
+        .aof_rewrite = RMUtil_DefaultAofRewrite,
+        .mem_usage = WideSeriesMemUsage,
+        .copy = CopyWideSeries,
+        .free = FreeWideSeries,
+        .defrag = DefragWideSeries,
+        .free_effort = WideSeriesFreeEffort,
+    };
+
+    WideSeriesType =
+        RedisModule_CreateDataType(ctx, "TSDB-WIDE", WIDE_SERIES_ENC_VER, &wideTm);
+    if (WideSeriesType == NULL) {
+        FreeConfigAndStaticCtx();
+
+        return REDISMODULE_ERR;
+    }
+
     RedisModuleTypeExtMethods etm = {
         .version = REDISMODULE_TYPE_EXT_METHOD_VERSION,
         .key_added_to_db_dict = keyAddedToDbDict,
@@ -2762,9 +3409,13 @@ int RedisModule_OnLoad(RedisModuleCtx *ctx, RedisModuleString **argv, int argc)
 
     RegisterCommandWithModesAndAcls(ctx, "ts.create", TSDB_create, "write deny-oom", "write fast");
     RegisterCommandWithModesAndAcls(ctx, "ts.alter", TSDB_alter, "write deny-oom", "write");
-    RegisterCommandWithModesAndAcls(ctx, "ts.createrule", TSDB_createRule, "write fast", "write");
+    RegisterCommandWithModesAndAcls(ctx, "ts.createrule", TSDB_createRule, "write", "write");
     RegisterCommandWithModesAndAcls(ctx, "ts.deleterule", TSDB_deleteRule, "write", "write fast");
+    RegisterCommandWithModesAndAcls(
+        ctx, "ts.backfillstatus", TSDB_backfillStatus, "readonly", "read fast");
     RegisterCommandWithModesAndAcls(ctx, "ts.add", TSDB_add, "write deny-oom", "write");
+    RegisterCommandWithModesAndAcls(ctx, "ts.wcreate", TSDB_wcreate, "write deny-oom", "write fast");
+    RegisterCommandWithModesAndAcls(ctx, "ts.wadd", TSDB_wadd, "write deny-oom", "write");
     RegisterCommandWithModesAndAcls(ctx, "ts.incrby", TSDB_incrby, "write deny-oom", "write");
     RegisterCommandWithModesAndAcls(ctx, "ts.decrby", TSDB_incrby, "write deny-oom", "write");
     RegisterCommandWithModesAndAcls(ctx, "ts.range", TSDB_range, "readonly", "read");
@@ -2821,6 +3472,15 @@ int RedisModule_OnLoad(RedisModuleCtx *ctx, RedisModuleString **argv, int argc)
 
     SetCommandAcls(ctx, "ts.mrevrange", "read");
 
+    if (RedisModule_CreateCommand(ctx, "ts.mtopk", TSDB_mtopk, "readonly", 0, 0, -1) ==
+        REDISMODULE_ERR) {
+        FreeConfigAndStaticCtx();
+
+        return REDISMODULE_ERR;
+    }
+
+    SetCommandAcls(ctx, "ts.mtopk", "read");
+
     // TS.NRANGE / TS.NREVRANGE: keys are explicit but at variable positions (after
     // numkeys), so they can't use the fixed first/last/step args; a keynum key-spec
     // is attached via RegisterTSCommandInfos (TS_NRANGE_INFO) for cluster routing.
@@ -2858,6 +3518,13 @@ int RedisModule_OnLoad(RedisModuleCtx *ctx, RedisModuleString **argv, int argc)
         return REDISMODULE_ERR;
     }
 
+    if (RedisModule_RegisterInfoFunc(ctx, TSInfoFunc) != REDISMODULE_OK) {
+        RedisModule_Log(ctx, "warning", "Failed to register timeseries info");
+        FreeConfigAndStaticCtx();
+
+        return REDISMODULE_ERR;
+    }
+
     if (RedisModule_SubscribeToServerEvent) {
         // we have server events support, lets subscribe to relevant events.
         if (RedisModule_ShardingGetKeySlot != NULL) {
@@ -12,6 +12,7 @@
 #include <stdbool.h>
 #include <math.h>
 
+#include "series_blob.h"
 #include "tsdb.h"
 
 #include "RedisModulesSDK/redismodule.h"
@@ -159,6 +160,7 @@ static inline bool CheckKeyIsAllowedToReadWriteC(RedisModuleCtx *ctx,
 }
 
 extern RedisModuleType *SeriesType;
+extern RedisModuleType *WideSeriesType;
 extern RedisModuleCtx *rts_staticCtx;
 
 // Create a new TS key, if key is NULL the function will open the key, the user must call to
@@ -176,6 +178,20 @@ GetSeriesResult CheckDictSeriesPermissions(RedisModuleCtx *ctx,
                                            const GetSeriesFlags flags);
 
 int replyUngroupedMultiRange(RedisModuleCtx *ctx, RedisModuleDict *result, const MRangeArgs *args);
+// Replies with at most limit series (0 for all of them) following resumeAfter (NULL for the
+// first one). A trailing integer element marks that more series are left. With a blob, the series
+// are encoded in it and the reply is the blob instead, see series_blob.h.
+int replyUngroupedMultiRangeBatch(RedisModuleCtx *ctx,
+                                  RedisModuleDict *result,
+                                  const MRangeArgs *args,
+                                  RedisModuleString *resumeAfter,
+                                  size_t limit,
+                                  SeriesBlob *blob);
+// Replies with the partial states of the GROUPBY reducer on a shard, see
+// ResultSet_ReplyPartialReduce
+int replyPartialGroupedMultiRange(RedisModuleCtx *ctx,
+                                  RedisModuleDict *result,
+                                  const MRangeArgs *args);
 
 // ACL: skips candidates the caller can't read. Shared by the local and cluster-fanout
 // TS.QUERYLABELS paths (see libmr_integration.c).
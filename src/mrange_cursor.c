@@ -0,0 +1,457 @@
+/*
+ * Copyright (c) 2006-Present, Redis Ltd.
+ * All rights reserved.
+ *
+ * Licensed under your choice of (a) the Redis Source Available License 2.0
+ * (RSALv2); or (b) the Server Side Public License v1 (SSPLv1); or (c) the
+ * GNU Affero General Public License v3 (AGPLv3).
+ */
+#include "mrange_cursor.h"
+
+#include "common.h"
+#include "config.h"
+#include "indexer.h"
+#include "module.h"
+#include "reply.h"
+#include "tsdb.h"
+
+#include "RedisModulesSDK/redismodule.h"
+#include "rmutil/alloc.h"
+
+#include <inttypes.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct MRangeCursor
+{
+    uint64_t id;              // 0 when the series aren't kept after the page
+    int dbId;                 // the db the series were matched in
+    RedisModuleDict *series;  // the keys of the series matched by the query
+    RedisModuleString *query; // the arguments of the query but the cursor
+    size_t memUsage;          // counted in cachedMemory while the cursor is kept
+    mstime_t expiresAt;
+} MRangeCursor;
+
+// id -> MRangeCursor, only touched on the main thread
+static RedisModuleDict *cursors = NULL;
+static uint64_t lastCursorId = 0;
+static size_t cachedMemory = 0;
+// Drops the cursors no page followed within ts-cursor-ttl, armed for the first of them to expire
+static RedisModuleTimerID expiryTimer;
+static bool expiryTimerArmed = false;
+static mstime_t expiryTimerAt;
+
+typedef struct CursorPosition
+{
+    uint64_t id;
+    long long replied;      // samples of key already replied, 0 when key is over
+    timestamp_t timestamp;  // where key resumes when replied > 0
+    RedisModuleString *key; // NULL on the first page
+} CursorPosition;
+
+static bool parseCursorField(const char **str, const char *end, unsigned long long *value) {
+    char *fieldEnd;
+    if (*str >= end || **str < '0' || **str > '9') {
+        return false;
+    }
+    *value = strtoull(*str, &fieldEnd, 10);
+    if (fieldEnd >= end || *fieldEnd != ':') {
+        return false;
+    }
+    *str = fieldEnd + 1;
+    return true;
+}
+
+static bool parseCursor(const RedisModuleString *cursor, CursorPosition *pos) {
+    size_t len;
+    const char *str = RedisModule_StringPtrLen(cursor, &len);
+    *pos = (CursorPosition){ 0 };
+    if (len == 1 && str[0] == '0') {
+        return true;
+    }
+
+    const char *end = str + len;
+    unsigned long long id, replied, timestamp;
+    if (!parseCursorField(&str, end, &id) || !parseCursorField(&str, end, &replied) ||
+        !parseCursorField(&str, end, &timestamp) || str == end || replied > LLONG_MAX) {
+        return false;
+    }
+    *pos = (CursorPosition){ .id = id,
+                             .replied = replied,
+                             .timestamp = timestamp,
+                             .key = RedisModule_CreateString(NULL, str, end - str) };
+    return true;
+}
+
+static RedisModuleString *querySignature(RedisModuleString **argv,
+                                         int argc,
+                                         const RedisModuleString *cursor) {
+    RedisModuleString *query = RedisModule_CreateString(NULL, "", 0);
+    for (int i = 0; i < argc; i++) {
+        if (argv[i] == cursor) {
+            continue;
+        }
+        size_t len;
+        const char *arg = RedisModule_StringPtrLen(argv[i], &len);
+        char lenPrefix[24];
+        const int prefixLen = snprintf(lenPrefix, sizeof(lenPrefix), "%zu:", len);
+        RedisModule_StringAppendBuffer(NULL, query, lenPrefix, prefixLen);
+        RedisModule_StringAppendBuffer(NULL, query, arg, len);
+    }
+    return query;
+}
+
+static void MRangeCursor_Free(MRangeCursor *cursor) {
+    RedisModule_FreeDict(NULL, cursor->series);
+    RedisModule_FreeString(NULL, cursor->query);
+    free(cursor);
+}
+
+static void dropCursor(MRangeCursor *cursor) {
+    if (cursor->id != 0) {
+        RedisModule_DictDelC(cursors, &cursor->id, sizeof(cursor->id), NULL);
+        cachedMemory -= cursor->memUsage;
+    }
+    MRangeCursor_Free(cursor);
+}
+
+// Drops the expired cursors, and returns when the first of the others expires, 0 without any
+static mstime_t expireCursors(mstime_t now) {
+    if (!cursors || RedisModule_DictSize(cursors) == 0) {
+        return 0;
+    }
+    MRangeCursor *expired[MRANGE_CURSOR_MAX_CACHED];
+    size_t numExpired = 0;
+    mstime_t nextExpiry = 0;
+    RedisModuleDictIter *iter = RedisModule_DictIteratorStartC(cursors, "^", NULL, 0);
+    MRangeCursor *cursor;
+    while (RedisModule_DictNextC(iter, NULL, (void **)&cursor) != NULL) {
+        if (cursor->expiresAt <= now && numExpired < MRANGE_CURSOR_MAX_CACHED) {
+            expired[numExpired++] = cursor;
+        } else if (nextExpiry == 0 || cursor->expiresAt < nextExpiry) {
+            nextExpiry = cursor->expiresAt;
+        }
+    }
+    RedisModule_DictIteratorStop(iter);
+    for (size_t i = 0; i < numExpired; i++) {
+        dropCursor(expired[i]);
+    }
+    return nextExpiry;
+}
+
+static void armExpiryTimer(RedisModuleCtx *ctx, mstime_t now, mstime_t at);
+
+static void onExpiryTimer(RedisModuleCtx *ctx, void *data) {
+    REDISMODULE_NOT_USED(data);
+    expiryTimerArmed = false;
+    const mstime_t now = RedisModule_Milliseconds();
+    const mstime_t nextExpiry = expireCursors(now);
+    if (nextExpiry != 0) {
+        armExpiryTimer(ctx, now, nextExpiry);
+    }
+}
+
+static void armExpiryTimer(RedisModuleCtx *ctx, mstime_t now, mstime_t at) {
+    if (expiryTimerArmed) {
+        if (expiryTimerAt <= at) {
+            // the timer finds the later expiry when it fires
+            return;
+        }
+        RedisModule_StopTimer(ctx, expiryTimer, NULL);
+    }
+    expiryTimer = RedisModule_CreateTimer(ctx, max(at - now, 0), onExpiryTimer, NULL);
+    expiryTimerAt = at;
+    expiryTimerArmed = true;
+}
+
+// Returns the cursor of the query, running the index for a new one when it wasn't kept
+static MRangeCursor *getCursor(RedisModuleCtx *ctx,
+                               const CursorPosition *pos,
+                               RedisModuleString *query,
+                               const MRangeArgs *args,
+                               bool *hasPermissionError) {
+    if (cursors && pos->id != 0) {
+        MRangeCursor *cursor =
+            RedisModule_DictGetC(cursors, (void *)&pos->id, sizeof(pos->id), NULL);
+        // the same query in another db matches other series
+        if (cursor && cursor->dbId == RedisModule_GetSelectedDb(ctx) &&
+            RedisModule_StringCompare(cursor->query, query) == 0) {
+            RedisModule_FreeString(NULL, query);
+            return cursor;
+        }
+    }
+
+    RedisModuleDict *result = QueryIndex(
+        ctx, args->queryPredicates->list, args->queryPredicates->count, hasPermissionError);
+    if (*hasPermissionError) {
+        RedisModule_FreeDict(ctx, result);
+        RedisModule_FreeString(NULL, query);
+        return NULL;
+    }
+
+    // the result of the index belongs to the command, the cursor outlives it
+    MRangeCursor *cursor = calloc(1, sizeof(*cursor));
+    cursor->dbId = RedisModule_GetSelectedDb(ctx);
+    cursor->series = RedisModule_CreateDict(NULL);
+    cursor->query = query;
+    RedisModuleDictIter *iter = RedisModule_DictIteratorStartC(result, "^", NULL, 0);
+    char *key;
+    size_t keyLen;
+    while ((key = RedisModule_DictNextC(iter, &keyLen, NULL)) != NULL) {
+        RedisModule_DictSetC(cursor->series, key, keyLen, NULL);
+    }
+    RedisModule_DictIteratorStop(iter);
+    RedisModule_FreeDict(ctx, result);
+
+    if (!cursors) {
+        cursors = RedisModule_CreateDict(NULL);
+    }
+    if (TSGlobalConfig.cursorTTL > 0 &&
+        RedisModule_DictSize(cursors) < MRANGE_CURSOR_MAX_CACHED) {
+        cursor->id = ++lastCursorId;
+        RedisModule_DictSetC(cursors, &cursor->id, sizeof(cursor->id), cursor);
+        cursor->memUsage = RedisModule_MallocSize(cursor) +
+                           RedisModule_MallocSizeDict(cursor->series) +
+                           RedisModule_MallocSizeString(cursor->query);
+        cachedMemory += cursor->memUsage;
+    }
+    return cursor;
+}
+
+size_t MRangeCursor_NumCached(void) {
+    return cursors ? RedisModule_DictSize(cursors) : 0;
+}
+
+size_t MRangeCursor_MemUsage(void) {
+    return cachedMemory;
+}
+
+typedef struct PageState
+{
+    size_t replied;   // samples of the series in the page
+    timestamp_t last; // timestamp of the last of them
+    bool more;        // the series has samples left after them
+} PageState;
+
+// Passes on at most limit samples of the series, and finds out whether there are more
+typedef struct PageIterator
+{
+    AbstractIterator base;
+    EnrichedChunk *pending; // taken by SeriesQueryIfNonEmpty, passed on first
+    size_t remaining;
+    PageState *state;
+} PageIterator;
+
+static EnrichedChunk *PageIterator_GetNext(AbstractIterator *base) {
+    PageIterator *iter = (PageIterator *)base;
+    if (iter->state->more) {
+        return NULL;
+    }
+
+    EnrichedChunk *chunk = iter->pending ?: iter->base.input->GetNext(iter->base.input);
+    iter->pending = NULL;
+    if (iter->remaining == 0) {
+        // look for a sample left after the page
+        while (chunk && chunk->samples.num_samples == 0) {
+            chunk = iter->base.input->GetNext(iter->base.input);
+        }
+        iter->state->more = chunk != NULL;
+        return NULL;
+    }
+    if (!chunk) {
+        return NULL;
+    }
+
+    size_t n = chunk->samples.num_samples;
+    if (n > iter->remaining) {
+        chunk->samples.num_samples = n = iter->remaining;
+        iter->state->more = true;
+    }
+    if (n > 0) {
+        iter->state->last = chunk->samples.timestamps[n - 1];
+    }
+    iter->remaining -= n;
+    iter->state->replied += n;
+    return chunk;
+}
+
+static void PageIterator_Close(AbstractIterator *base) {
+    base->input->Close(base->input);
+    free(base);
+}
+
+static AbstractIterator *PageIterator_New(AbstractIterator *input,
+                                          EnrichedChunk *first_chunk,
+                                          size_t limit,
+                                          PageState *state) {
+    PageIterator *iter = malloc(sizeof(*iter));
+    iter->base = (AbstractIterator){ .GetNext = PageIterator_GetNext,
+                                     .Close = PageIterator_Close,
+                                     .input = input };
+    iter->pending = first_chunk;
+    iter->remaining = limit;
+    iter->state = state;
+    return &iter->base;
+}
+
+static void replyCursor(RedisModuleCtx *ctx,
+                        uint64_t id,
+                        long long replied,
+                        timestamp_t timestamp,
+                        RedisModuleString *key) {
+    size_t keyLen;
+    const char *keyStr = RedisModule_StringPtrLen(key, &keyLen);
+    RedisModuleString *cursor = RedisModule_CreateStringPrintf(
+        NULL, "%" PRIu64 ":%lld:%" PRIu64 ":", id, replied, timestamp);
+    RedisModule_StringAppendBuffer(NULL, cursor, keyStr, keyLen);
+    RedisModule_ReplyWithString(ctx, cursor);
+    RedisModule_FreeString(NULL, cursor);
+}
+
+int MRangeCursor_Reply(RedisModuleCtx *ctx,
+                       RedisModuleString **argv,
+                       int argc,
+                       const MRangeArgs *args) {
+    CursorPosition pos;
+    if (!parseCursor(args->cursor, &pos)) {
+        RTS_ReplyGeneralError(ctx, "TSDB: invalid cursor");
+        return REDISMODULE_ERR;
+    }
+
+    const mstime_t now = RedisModule_Milliseconds();
+    expireCursors(now);
+
+    bool hasPermissionError = false;
+    MRangeCursor *cursor =
+        getCursor(ctx, &pos, querySignature(argv, argc, args->cursor), args, &hasPermissionError);
+    if (!cursor || CheckDictSeriesPermissions(ctx,
+                                              cursor->series,
+                                              GetSeriesFlags_CheckForAcls |
+                                                  GetSeriesFlags_SilentOperation) ==
+                       GetSeriesResult_PermissionError) {
+        if (cursor) {
+            dropCursor(cursor);
+        }
+        if (pos.key) {
+            RedisModule_FreeString(NULL, pos.key);
+        }
+        RTS_ReplyKeyPermissionsError(ctx);
+        return REDISMODULE_ERR;
+    }
+
+    RedisModuleDictIter *iter;
+    if (!pos.key) {
+        iter = RedisModule_DictIteratorStartC(cursor->series, "^", NULL, 0);
+    } else {
+        iter = RedisModule_DictIteratorStart(cursor->series, pos.replied > 0 ? ">=" : ">", pos.key);
+    }
+
+    const bool splittable = args->rangeArgs.aggregationArgs.numClasses == 0 &&
+                            args->rangeArgs.downsample.type == DOWNSAMPLE_NONE &&
+                            args->rangeArgs.window.type == WINDOW_NONE;
+    long long budget = TSGlobalConfig.cursorPageSize;
+    long long replylen = 0;
+    RedisModuleString *lastKey = NULL;
+    // where the next page starts when the page ends in the middle of a series
+    long long resumeReplied = 0;
+    timestamp_t resumeTimestamp = 0;
+
+    RedisModule_ReplyWithArray(ctx, 2);
+    ReplyWithMapOrArray(ctx, REDISMODULE_POSTPONED_ARRAY_LEN, false);
+    RedisModuleString *currentKey;
+    while (budget > 0 && (currentKey = RedisModule_DictNext(NULL, iter, NULL)) != NULL) {
+        RedisModuleKey *key;
+        Series *series;
+        const GetSeriesResult status = GetSeries(
+            ctx, currentKey, &key, &series, REDISMODULE_READ, GetSeriesFlags_SilentOperation);
+        if (status != GetSeriesResult_Success) {
+            // The series is gone, see replyUngroupedMultiRangeBatch
+            RedisModule_DictIteratorStop(iter);
+            iter = RedisModule_DictIteratorStart(cursor->series, ">", currentKey);
+            RedisModule_FreeString(NULL, currentKey);
+            continue;
+        }
+
+        RangeArgs rangeArgs = args->rangeArgs;
+        long long repliedBefore = 0;
+        if (pos.replied > 0 && RedisModule_StringCompare(currentKey, pos.key) == 0) {
+            repliedBefore = pos.replied;
+            if (args->reverse) {
+                rangeArgs.endTimestamp = pos.timestamp;
+            } else {
+                rangeArgs.startTimestamp = pos.timestamp;
+            }
+        }
+        const long long countLeft =
+            rangeArgs.count == -1 ? LLONG_MAX : max(rangeArgs.count - repliedBefore, 0);
+        // the page iterator applies the count
+        rangeArgs.count = -1;
+
+        EnrichedChunk *first_chunk = NULL;
+        AbstractIterator *input;
+        if (args->excludeEmpty && repliedBefore == 0) {
+            input = SeriesQueryIfNonEmpty(series, &rangeArgs, args->reverse, &first_chunk);
+        } else {
+            input = SeriesQuery(series, &rangeArgs, args->reverse, true);
+        }
+        if (!input) {
+            RedisModule_CloseKey(key);
+            if (lastKey) {
+                RedisModule_FreeString(NULL, lastKey);
+            }
+            lastKey = currentKey;
+            continue;
+        }
+
+        PageState state = { 0 };
+        const size_t limit = splittable ? min(budget, countLeft) : countLeft;
+        ReplySeriesArrayPos(ctx,
+                            series,
+                            args->withLabels,
+                            (RedisModuleString **)args->limitLabels,
+                            args->numLimitLabels,
+                            &rangeArgs,
+                            args->reverse,
+                            false,
+                            PageIterator_New(input, first_chunk, limit, &state),
+                            NULL);
+        RedisModule_CloseKey(key);
+        replylen++;
+        budget -= max(state.replied, 1);
+
+        if (lastKey) {
+            RedisModule_FreeString(NULL, lastKey);
+        }
+        lastKey = currentKey;
+        if (splittable && state.more && state.replied < countLeft) {
+            resumeReplied = repliedBefore + state.replied;
+            resumeTimestamp = args->reverse ? state.last - 1 : state.last + 1;
+            break;
+        }
+    }
+    ReplySetMapOrArrayLength(ctx, replylen, false);
+
+    const bool more = resumeReplied > 0 || (lastKey && RedisModule_DictNextC(iter, NULL, NULL));
+    RedisModule_DictIteratorStop(iter);
+    if (more) {
+        replyCursor(ctx, cursor->id, resumeReplied, resumeTimestamp, lastKey);
+        if (cursor->id != 0) {
+            cursor->expiresAt = now + TSGlobalConfig.cursorTTL;
+            armExpiryTimer(ctx, now, cursor->expiresAt);
+        } else {
+            MRangeCursor_Free(cursor);
+        }
+    } else {
+        RedisModule_ReplyWithCString(ctx, "0");
+        dropCursor(cursor);
+    }
+
+    if (lastKey) {
+        RedisModule_FreeString(NULL, lastKey);
+    }
+    if (pos.key) {
+        RedisModule_FreeString(NULL, pos.key);
+    }
+    return REDISMODULE_OK;
+}
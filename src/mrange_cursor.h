@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2006-Present, Redis Ltd.
+ * All rights reserved.
+ *
+ * Licensed under your choice of (a) the Redis Source Available License 2.0
+ * (RSALv2); or (b) the Server Side Public License v1 (SSPLv1); or (c) the
+ * GNU Affero General Public License v3 (AGPLv3).
+ */
+#ifndef MRANGE_CURSOR_H
+#define MRANGE_CURSOR_H
+
+#include "query_language.h"
+
+#include "RedisModulesSDK/redismodule.h"
+
+/*
+ * TS.MRANGE/TS.MREVRANGE ... CURSOR cursor FILTER ...
+ *
+ * The reply is [page, next cursor]. A page is an MRANGE reply of at most ts-cursor-page-size
+ * samples, where every series counts for one sample at least. The cursor of the first page is 0
+ * and the next cursor is 0 once the query is over.
+ *
+ * A cursor is "<id>:<replied>:<timestamp>:<key>". The query resumes after key, or at key from
+ * timestamp when the page ended in the middle of its samples, replied being the samples of key
+ * already sent. Only raw samples are split across pages, an aggregated series is always sent
+ * whole. id refers to the series matched by the first page in the db of the client, which are
+ * kept for ts-cursor-ttl ms after every page so that the next one doesn't run the index again. A
+ * timer drops them once they expire, and the next page runs the index again and resumes from the
+ * same position, as does a page of the cursor in another db.
+ *
+ * INFO timeseries reports the kept cursors and their memory, as timeseries_cursors_cached and
+ * timeseries_cursors_cached_memory.
+ */
+
+// At most this many queries keep their matched series between pages
+#define MRANGE_CURSOR_MAX_CACHED 1024
+
+// Replies with the page of the query at args->cursor. argv holds the arguments of the query,
+// which a cursor must be used with.
+int MRangeCursor_Reply(RedisModuleCtx *ctx,
+                       RedisModuleString **argv,
+                       int argc,
+                       const MRangeArgs *args);
+
+// The cursors kept between pages, and their memory in bytes
+size_t MRangeCursor_NumCached(void);
+size_t MRangeCursor_MemUsage(void);
+
+#endif // MRANGE_CURSOR_H
@@ -12,7 +12,6 @@
 #include "generic_chunk.h"
 #include "query_language.h"
 #include <math.h>
-#include <assert.h>
 
 ChunkResult MultiSeriesAggDupSampleIterator_GetNext(
     struct AbstractMultiSeriesAggDupSampleIterator *iterator,
@@ -20,29 +19,21 @@ ChunkResult MultiSeriesAggDupSampleIterator_GetNext(
     MultiSeriesAggDupSampleIterator *iter = (MultiSeriesAggDupSampleIterator *)iterator;
     void *aggContext = iter->aggregationContext;
 
-    if (!iter->has_next_sample) {
+    timestamp_t timestamp;
+    const size_t n = iter->base.input->GetNextRun(iter->base.input, &timestamp, iter->values);
+    if (n == 0) {
         return CR_END;
     }
 
-    bool is_valid = iter->aggregation->isValueValid(iter->next_sample.value);
-    if (is_valid) {
-        iter->aggregation->appendValue(
-            aggContext, iter->next_sample.value, iter->next_sample.timestamp);
-    }
-
-    bool any_valid = is_valid;
-    Sample _sample;
-    ChunkResult ret;
-    while ((ret = iter->base.input->GetNext(iter->base.input, &_sample)) == CR_OK &&
-           _sample.timestamp == iter->next_sample.timestamp) {
-        bool _is_valid = iter->aggregation->isValueValid(_sample.value);
-        if (_is_valid) {
-            iter->aggregation->appendValue(aggContext, _sample.value, _sample.timestamp);
+    bool any_valid = false;
+    for (size_t i = 0; i < n; i++) {
+        if (iter->aggregation->isValueValid(iter->values[i])) {
+            iter->aggregation->appendValue(aggContext, iter->values[i], timestamp);
+            any_valid = true;
         }
-        any_valid = any_valid || _is_valid;
     }
 
-    sample->timestamp = iter->next_sample.timestamp;
+    sample->timestamp = timestamp;
     if (likely(any_valid)) {
         iter->aggregation->finalize(aggContext, &sample->value);
     } else {
@@ -58,10 +49,6 @@ ChunkResult MultiSeriesAggDupSampleIterator_GetNext(
         }
     }
     iter->aggregation->resetContext(aggContext);
-    iter->next_sample = _sample;
-    if (ret == CR_END) {
-        iter->has_next_sample = false;
-    }
     return CR_OK;
 }
 
@@ -70,11 +57,13 @@ void MultiSeriesAggDupSampleIterator_Close(
     MultiSeriesAggDupSampleIterator *self = (MultiSeriesAggDupSampleIterator *)iterator;
     iterator->input->Close(iterator->input);
     self->aggregation->freeContext(self->aggregationContext);
+    free(self->values);
     free(iterator);
 }
 
 MultiSeriesAggDupSampleIterator *MultiSeriesAggDupSampleIterator_New(
     AbstractMultiSeriesSampleIterator *input,
+    size_t n_series,
     const ReducerArgs *reducerArgs) {
     MultiSeriesAggDupSampleIterator *newIter = malloc(sizeof(MultiSeriesAggDupSampleIterator));
     newIter->base.input = input;
@@ -82,11 +71,6 @@ MultiSeriesAggDupSampleIterator *MultiSeriesAggDupSampleIterator_New(
     newIter->base.Close = MultiSeriesAggDupSampleIterator_Close;
     newIter->aggregation = reducerArgs->aggregationClass;
     newIter->aggregationContext = newIter->aggregation->createContext(DC);
-    ChunkResult res = newIter->base.input->GetNext(newIter->base.input, &newIter->next_sample);
-    newIter->has_next_sample = true;
-    if (res != CR_OK) {
-        assert(res != CR_ERR); // we don't handle errors in this function currently
-        newIter->has_next_sample = false;
-    }
+    newIter->values = malloc(max(n_series, 1) * sizeof(*newIter->values));
     return newIter;
 }
@@ -18,12 +18,12 @@ typedef struct MultiSeriesAggDupSampleIterator
     AbstractMultiSeriesAggDupSampleIterator base;
     void *aggregationContext;
     AggregationClass *aggregation;
-    Sample next_sample;
-    bool has_next_sample;
+    double *values; // the samples of the current timestamp, one per series at most
 } MultiSeriesAggDupSampleIterator;
 
 MultiSeriesAggDupSampleIterator *MultiSeriesAggDupSampleIterator_New(
     AbstractMultiSeriesSampleIterator *input,
+    size_t n_series,
     const ReducerArgs *reducerArgs);
 
 #endif // REDISTIMESERIES_MULTISERIES_AGG_DUP_SAMPLE_ITERATOR_H
@@ -10,78 +10,117 @@
 #include "abstract_iterator.h"
 #include "multiseries_sample_iterator.h"
 #include "consts.h"
-#include "assert.h"
+#include "enriched_chunk.h"
 
-typedef struct
-{
-    Sample sample;
-    AbstractSampleIterator *iter; // The iterator this sample belongs to
-} MSSample;
-
-// implements min heap
-static int heap_cmp_func(const void *sample1, const void *sample2, __unused const void *udata) {
-    return (((MSSample *)sample1)->sample.timestamp < ((MSSample *)sample2)->sample.timestamp) ? 1
-                                                                                               : -1;
+static inline timestamp_t cursor_timestamp(const MultiSeriesCursor *cursor) {
+    return cursor->chunk->samples.timestamps[cursor->index];
 }
 
-// implements max heap
-static int heap_cmp_func_reverse(const void *sample1,
-                                 const void *sample2,
-                                 __unused const void *udata) {
-    return (((MSSample *)sample1)->sample.timestamp > ((MSSample *)sample2)->sample.timestamp) ? 1
-                                                                                               : -1;
+// Moves past the end of the current chunk to the next non-empty one
+static void cursor_fill(MultiSeriesCursor *cursor) {
+    while (cursor->chunk && cursor->index >= cursor->chunk->samples.num_samples) {
+        cursor->chunk = cursor->input->GetNext(cursor->input);
+        cursor->index = 0;
+    }
 }
 
-void MultiSeriesSampleIterator_Close(struct AbstractMultiSeriesSampleIterator *iterator) {
-    MultiSeriesSampleIterator *iter = (MultiSeriesSampleIterator *)iterator;
-    for (size_t i = 0; i < iter->n_series; ++i) {
-        iter->base.input[i]->Close(iter->base.input[i]);
+// Whether series a's sample comes before series b's one
+static inline bool beats(const MultiSeriesSampleIterator *iter, size_t a, size_t b) {
+    const MultiSeriesCursor *ca = &iter->cursors[a];
+    const MultiSeriesCursor *cb = &iter->cursors[b];
+    if (!ca->chunk || !cb->chunk) {
+        return ca->chunk && (!cb->chunk || a < b);
     }
-    free(iter->base.input);
-    heap_clear_free_items(iter->samples_heap, free);
-    heap_free(iter->samples_heap);
-    free(iterator);
+    const timestamp_t ta = cursor_timestamp(ca), tb = cursor_timestamp(cb);
+    if (ta == tb) {
+        return a < b;
+    }
+    return iter->reverse ? ta > tb : ta < tb;
 }
 
-// Return the smallest timestamp sample and insert new sample from the same iterator if exist
-ChunkResult MultiSeriesSampleIterator_GetNext(struct AbstractMultiSeriesSampleIterator *base,
-                                              Sample *sample) {
-    MultiSeriesSampleIterator *iter = (MultiSeriesSampleIterator *)base;
-    MSSample *hsample = heap_poll(iter->samples_heap);
+// Replays the matches from the leaf of series up to the root
+static void replay(MultiSeriesSampleIterator *iter, size_t series) {
+    size_t winner = series;
+    for (size_t node = (series + iter->n_series) / 2; node > 0; node /= 2) {
+        if (beats(iter, iter->tree[node], winner)) {
+            const size_t loser = winner;
+            winner = iter->tree[node];
+            iter->tree[node] = loser;
+        }
+    }
+    iter->tree[0] = winner;
+}
 
-    if (!hsample) {
-        return CR_END;
+static void build(MultiSeriesSampleIterator *iter) {
+    const size_t n = iter->n_series;
+    // winners[node] for the inner nodes, the leaves n..2n-1 are the series themselves
+    size_t *winners = malloc(2 * n * sizeof(*winners));
+    for (size_t i = 0; i < n; i++) {
+        winners[n + i] = i;
+    }
+    for (size_t node = n - 1; node > 0; node--) {
+        const size_t left = winners[2 * node], right = winners[2 * node + 1];
+        const bool leftWins = beats(iter, left, right);
+        winners[node] = leftWins ? left : right;
+        iter->tree[node] = leftWins ? right : left;
     }
+    iter->tree[0] = n > 1 ? winners[1] : 0;
+    free(winners);
+}
 
-    *sample = hsample->sample;
-    if (hsample->iter->GetNext(hsample->iter, &hsample->sample) == CR_OK) {
-        heap_offer(&iter->samples_heap, hsample);
-    } else { // the series is exhausted free it's sample
-        free(hsample);
+/* Returns in values the samples of all the series at the next timestamp, in series order, and
+ * their number. 0 when all the series are exhausted. */
+size_t MultiSeriesSampleIterator_GetNextRun(struct AbstractMultiSeriesSampleIterator *base,
+                                            timestamp_t *timestamp,
+                                            double *values) {
+    MultiSeriesSampleIterator *iter = (MultiSeriesSampleIterator *)base;
+    size_t n = 0;
+    while (true) {
+        const size_t winner = iter->tree[0];
+        MultiSeriesCursor *cursor = &iter->cursors[winner];
+        if (!cursor->chunk || (n > 0 && cursor_timestamp(cursor) != *timestamp)) {
+            return n;
+        }
+        *timestamp = cursor_timestamp(cursor);
+        values[n++] = Samples_value_at(&cursor->chunk->samples, cursor->index, 0);
+        cursor->index++;
+        cursor_fill(cursor);
+        replay(iter, winner);
     }
+}
 
-    return CR_OK;
+void MultiSeriesSampleIterator_Close(struct AbstractMultiSeriesSampleIterator *iterator) {
+    MultiSeriesSampleIterator *iter = (MultiSeriesSampleIterator *)iterator;
+    for (size_t i = 0; i < iter->n_series; ++i) {
+        iter->cursors[i].input->Close(iter->cursors[i].input);
+    }
+    free(iter->cursors);
+    free(iter->tree);
+    free(iterator);
 }
 
-MultiSeriesSampleIterator *MultiSeriesSampleIterator_New(AbstractSampleIterator **iters,
+MultiSeriesSampleIterator *MultiSeriesSampleIterator_New(AbstractIterator **iters,
                                                          size_t n_series,
                                                          bool reverse) {
     MultiSeriesSampleIterator *newIter = malloc(sizeof(MultiSeriesSampleIterator));
-    newIter->base.input = malloc(sizeof(AbstractSampleIterator *) * n_series);
-    memcpy(newIter->base.input, iters, sizeof(AbstractSampleIterator *) * n_series);
-    newIter->base.GetNext = MultiSeriesSampleIterator_GetNext;
+    newIter->base.GetNextRun = MultiSeriesSampleIterator_GetNextRun;
     newIter->base.Close = MultiSeriesSampleIterator_Close;
     newIter->n_series = n_series;
-    newIter->samples_heap = heap_new(reverse ? heap_cmp_func_reverse : heap_cmp_func, NULL);
-    for (size_t i = 0; i < newIter->n_series; ++i) {
-        AbstractSampleIterator *sample_iter = newIter->base.input[i];
-        MSSample *sample = malloc(sizeof(MSSample));
-        if (sample_iter->GetNext(sample_iter, &sample->sample) == CR_OK) {
-            sample->iter = sample_iter;
-            assert(heap_offer(&newIter->samples_heap, sample) == 0);
-        } else {
-            free(sample);
-        }
+    newIter->reverse = reverse;
+    newIter->cursors = malloc(max(n_series, 1) * sizeof(*newIter->cursors));
+    newIter->tree = calloc(max(n_series, 1), sizeof(*newIter->tree));
+    for (size_t i = 0; i < n_series; ++i) {
+        MultiSeriesCursor *cursor = &newIter->cursors[i];
+        cursor->input = iters[i];
+        cursor->chunk = iters[i]->GetNext(iters[i]);
+        cursor->index = 0;
+        cursor_fill(cursor);
+    }
+    if (n_series == 0) {
+        // a single exhausted cursor
+        newIter->cursors[0] = (MultiSeriesCursor){ 0 };
+    } else {
+        build(newIter);
     }
     return newIter;
 }
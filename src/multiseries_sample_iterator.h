@@ -11,16 +11,32 @@
 #define REDISTIMESERIES_MULTISERIES_SAMPLE_ITERATOR_H
 
 #include "abstract_iterator.h"
-#include "utils/heap.h"
 
+// The position of a series in the merge: the current sample of its current chunk
+typedef struct MultiSeriesCursor
+{
+    AbstractIterator *input;
+    EnrichedChunk *chunk; // NULL once the series is exhausted
+    size_t index;
+} MultiSeriesCursor;
+
+/*
+ * Merges the chunk iterators of several series by timestamp with a tournament (loser) tree over
+ * the series' cursors. tree[0] holds the series with the next sample and every inner node
+ * tree[1..n_series-1] the series that lost the match played there, so advancing the winner only
+ * replays the matches on its path to the root. Ties are won by the series that comes first.
+ */
 typedef struct MultiSeriesSampleIterator
 {
     AbstractMultiSeriesSampleIterator base;
     size_t n_series;
-    heap_t *samples_heap;
+    bool reverse;
+    MultiSeriesCursor *cursors;
+    size_t *tree;
 } MultiSeriesSampleIterator;
 
-MultiSeriesSampleIterator *MultiSeriesSampleIterator_New(AbstractSampleIterator **iters,
+// Takes ownership of the iterators, but not of the iters array
+MultiSeriesSampleIterator *MultiSeriesSampleIterator_New(AbstractIterator **iters,
                                                          size_t n_series,
                                                          bool reverse);
 
@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2006-Present, Redis Ltd.
+ * All rights reserved.
+ *
+ * Licensed under your choice of (a) the Redis Source Available License 2.0
+ * (RSALv2); or (b) the Server Side Public License v1 (SSPLv1); or (c) the
+ * GNU Affero General Public License v3 (AGPLv3).
+ */
+#include "notify.h"
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "rmutil/alloc.h"
+
+#define NOTIFY_BATCH_CHANNEL_FMT "__keyevent@%d__:ts.batch"
+// Dedup keys up to this size are built on the stack
+#define NOTIFY_DEDUP_KEY_STACK_SIZE 256
+
+typedef struct PendingNotification
+{
+    const char *event; // NULL for a TS.READ wake-up
+    RedisModuleString *key;
+    int dbId;
+} PendingNotification;
+
+static int batchDepth = 0;
+static PendingNotification *pending = NULL;
+static size_t pendingCount = 0;
+static size_t pendingCapacity = 0;
+// (db, event, key) triplets already pending in the current batch
+static RedisModuleDict *pendingSet = NULL;
+
+void Notify_BeginBatch(void) {
+    ++batchDepth;
+}
+
+// Returns true the first time a (db, event, key) triplet is seen in the current batch
+static bool markPending(int dbId, const char *event, RedisModuleString *key) {
+    size_t keyLen;
+    const char *keyStr = RedisModule_StringPtrLen(key, &keyLen);
+    const size_t eventLen = event ? strlen(event) : 0;
+    const size_t len = sizeof(dbId) + eventLen + 1 + keyLen;
+
+    char stackBuf[NOTIFY_DEDUP_KEY_STACK_SIZE];
+    char *buf = len <= sizeof(stackBuf) ? stackBuf : malloc(len);
+    memcpy(buf, &dbId, sizeof(dbId));
+    if (eventLen) {
+        memcpy(buf + sizeof(dbId), event, eventLen);
+    }
+    buf[sizeof(dbId) + eventLen] = '\0';
+    memcpy(buf + sizeof(dbId) + eventLen + 1, keyStr, keyLen);
+
+    if (pendingSet == NULL) {
+        pendingSet = RedisModule_CreateDict(NULL);
+    }
+    const bool added = RedisModule_DictSetC(pendingSet, buf, len, NULL) == REDISMODULE_OK;
+
+    if (buf != stackBuf) {
+        free(buf);
+    }
+    return added;
+}
+
+static void addPending(RedisModuleCtx *ctx, const char *event, RedisModuleString *key) {
+    const int dbId = RedisModule_GetSelectedDb(ctx);
+    if (!markPending(dbId, event, key)) {
+        return;
+    }
+
+    if (pendingCount == pendingCapacity) {
+        pendingCapacity = pendingCapacity ? pendingCapacity * 2 : 16;
+        pending = realloc(pending, pendingCapacity * sizeof(*pending));
+    }
+    pending[pendingCount++] = (PendingNotification){
+        .event = event,
+        .key = RedisModule_HoldString(NULL, key),
+        .dbId = dbId,
+    };
+}
+
+void Notify_KeyspaceEvent(RedisModuleCtx *ctx, const char *event, RedisModuleString *key) {
+    if (batchDepth == 0) {
+        RedisModule_NotifyKeyspaceEvent(ctx, REDISMODULE_NOTIFY_MODULE, event, key);
+        return;
+    }
+    addPending(ctx, event, key);
+}
+
+void Notify_KeyReady(RedisModuleCtx *ctx, RedisModuleString *key) {
+    if (batchDepth == 0) {
+        RedisModule_SignalKeyAsReady(ctx, key);
+        return;
+    }
+    addPending(ctx, NULL, key);
+}
+
+static void publishBatchEvent(RedisModuleCtx *ctx, int dbId, long long count) {
+    if (!(RedisModule_GetNotifyKeyspaceEvents() & REDISMODULE_NOTIFY_MODULE)) {
+        return;
+    }
+
+    char channel[64];
+    snprintf(channel, sizeof(channel), NOTIFY_BATCH_CHANNEL_FMT, dbId);
+    RedisModuleString *channelStr = RedisModule_CreateString(NULL, channel, strlen(channel));
+    RedisModuleString *message = RedisModule_CreateStringFromLongLong(NULL, count);
+    // sharded, so that it stays on this node like the keyspace events it sums up
+    RedisModule_PublishMessageShard(ctx, channelStr, message);
+    RedisModule_FreeString(NULL, channelStr);
+    RedisModule_FreeString(NULL, message);
+}
+
+void Notify_EndBatch(RedisModuleCtx *ctx) {
+    if (--batchDepth > 0 || pendingCount == 0) {
+        return;
+    }
+
+    const int originalDb = RedisModule_GetSelectedDb(ctx);
+    // ts.batch is a keyevent channel, only published along with keyevent ('E') notifications
+    const bool batchEvent = TSGlobalConfig.notifyBatchEvent &&
+                            (RedisModule_GetNotifyKeyspaceEvents() & REDISMODULE_NOTIFY_KEYEVENT);
+    long long dbEvents = 0;
+
+    for (size_t i = 0; i < pendingCount; ++i) {
+        const PendingNotification *n = &pending[i];
+        if (n->dbId != RedisModule_GetSelectedDb(ctx)) {
+            if (batchEvent && dbEvents > 0) {
+                publishBatchEvent(ctx, RedisModule_GetSelectedDb(ctx), dbEvents);
+                dbEvents = 0;
+            }
+            RedisModule_SelectDb(ctx, n->dbId);
+        }
+
+        if (n->event == NULL) {
+            RedisModule_SignalKeyAsReady(ctx, n->key);
+        } else {
+            RedisModule_NotifyKeyspaceEvent(ctx, REDISMODULE_NOTIFY_MODULE, n->event, n->key);
+            if (batchEvent) {
+                ++dbEvents;
+            }
+        }
+        RedisModule_FreeString(NULL, n->key);
+    }
+    if (batchEvent && dbEvents > 0) {
+        publishBatchEvent(ctx, RedisModule_GetSelectedDb(ctx), dbEvents);
+    }
+    if (originalDb != RedisModule_GetSelectedDb(ctx)) {
+        RedisModule_SelectDb(ctx, originalDb);
+    }
+
+    pendingCount = 0;
+    RedisModule_FreeDict(NULL, pendingSet);
+    pendingSet = NULL;
+}
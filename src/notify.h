@@ -0,0 +1,36 @@
+/*
+ * Copyright (c) 2006-Present, Redis Ltd.
+ * All rights reserved.
+ *
+ * Licensed under your choice of (a) the Redis Source Available License 2.0
+ * (RSALv2); or (b) the Server Side Public License v1 (SSPLv1); or (c) the
+ * GNU Affero General Public License v3 (AGPLv3).
+ */
+#ifndef NOTIFY_H
+#define NOTIFY_H
+
+#include "RedisModulesSDK/redismodule.h"
+
+/*
+ * Coalescing of keyspace notifications and TS.READ wake-ups.
+ *
+ * Between Notify_BeginBatch and Notify_EndBatch, keyspace events and ready signals are only
+ * recorded, and each distinct (event, key) pair and each distinct key to signal is emitted once
+ * by Notify_EndBatch, in order of first occurrence. Outside of a batch they are emitted right away.
+ *
+ * With ts-notify-batch-event enabled, the keyspace events of a batch are followed by a message on
+ * the __keyevent@<db>__:ts.batch channel holding the number of events coalesced, as long as
+ * keyevent ('E') notifications are enabled. It is published with sharded pub/sub (SSUBSCRIBE).
+ *
+ * Batches may nest, only the outermost one flushes. Everything runs under the GIL.
+ */
+void Notify_BeginBatch(void);
+void Notify_EndBatch(RedisModuleCtx *ctx);
+
+// Module keyspace event
+void Notify_KeyspaceEvent(RedisModuleCtx *ctx, const char *event, RedisModuleString *key);
+
+// Wakes TS.READ clients blocked on the key.
+void Notify_KeyReady(RedisModuleCtx *ctx, RedisModuleString *key);
+
+#endif // NOTIFY_H
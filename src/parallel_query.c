@@ -0,0 +1,408 @@
+/*
+ * Copyright (c) 2006-Present, Redis Ltd.
+ * All rights reserved.
+ *
+ * Licensed under your choice of (a) the Redis Source Available License 2.0
+ * (RSALv2); or (b) the Server Side Public License v1 (SSPLv1); or (c) the
+ * GNU Affero General Public License v3 (AGPLv3).
+ */
+#include "parallel_query.h"
+
+#include "abstract_iterator.h"
+#include "common.h"
+#include "config.h"
+#include "consts.h"
+#include "enriched_chunk.h"
+#include "module.h"
+#include "reply.h"
+#include "tsdb.h"
+#include "utils/blocked_client.h"
+#include "utils/thread_pool.h"
+
+#include <string.h>
+#include "rmutil/alloc.h"
+
+static ThreadPool *queryPool = NULL;
+// Reported by INFO, only used on the main thread
+static uint64_t numRun = 0;
+static uint64_t numKeptInline = 0;
+
+uint64_t ParallelQuery_NumRun(void) {
+    return numRun;
+}
+
+uint64_t ParallelQuery_NumKeptInline(void) {
+    return numKeptInline;
+}
+
+void ParallelQuery_KeepInline(void) {
+    if (TSGlobalConfig.queryThreads > 0) {
+        ++numKeptInline;
+    }
+}
+
+// Returns the number of workers available for a query, 0 if queries must run inline
+static size_t availableWorkers(void) {
+    if (TSGlobalConfig.queryThreads == 0) {
+        return 0;
+    }
+    if (queryPool == NULL) {
+        queryPool = ThreadPool_New();
+    }
+    const size_t started = ThreadPool_EnsureThreads(queryPool, TSGlobalConfig.queryThreads);
+    return min(started, (size_t)TSGlobalConfig.queryThreads);
+}
+
+static bool canBlock(RedisModuleCtx *ctx) {
+    const int flags = RedisModule_GetContextFlags(ctx);
+    return !(flags & (REDISMODULE_CTX_FLAGS_LUA | REDISMODULE_CTX_FLAGS_MULTI |
+                      REDISMODULE_CTX_FLAGS_DENY_BLOCKING));
+}
+
+/* Query results are materialized by the workers into EnrichedChunks, one per series or per part
+ * of a series, which are then replayed in order to the reply functions by a ReplayIterator. */
+typedef struct ReplayIterator
+{
+    AbstractIterator base;
+    EnrichedChunk **chunks;
+    size_t count;
+    size_t next;
+    bool reverse; // replay the chunks from the last one
+} ReplayIterator;
+
+static EnrichedChunk *ReplayIterator_GetNext(AbstractIterator *base) {
+    ReplayIterator *iter = (ReplayIterator *)base;
+    if (iter->next == iter->count) {
+        return NULL;
+    }
+    const size_t i = iter->reverse ? iter->count - 1 - iter->next : iter->next;
+    iter->next++;
+    return iter->chunks[i];
+}
+
+static void ReplayIterator_Close(AbstractIterator *base) {
+    free(base);
+}
+
+static AbstractIterator *ReplayIterator_New(EnrichedChunk **chunks, size_t count, bool reverse) {
+    ReplayIterator *iter = malloc(sizeof(*iter));
+    iter->base.GetNext = ReplayIterator_GetNext;
+    iter->base.Close = ReplayIterator_Close;
+    iter->base.input = NULL;
+    iter->chunks = chunks;
+    iter->count = count;
+    iter->next = 0;
+    iter->reverse = reverse;
+    return &iter->base;
+}
+
+/*********************
+ *  TS.MRANGE        *
+ *********************/
+typedef struct ParallelMRange
+{
+    MRangeArgs args;
+    Series **series;         // snapshots, in key order
+    EnrichedChunk **results; // materialized query of each snapshot
+    size_t count;
+    size_t next;         // next series to query, shared by the workers
+    size_t pendingTasks; // workers still running
+    RedisModuleBlockedClient *bc;
+    RedisModuleCtx *replyCtx;
+} ParallelMRange;
+
+static void ParallelMRange_Free(RedisModuleCtx *ctx, void *privdata) {
+    ParallelMRange *query = privdata;
+    for (size_t i = 0; i < query->count; i++) {
+        FreeSeries(query->series[i]);
+        if (query->results[i]) {
+            FreeEnrichedChunk(query->results[i]);
+        }
+    }
+    free(query->series);
+    free(query->results);
+    MRangeArgs_Free(&query->args);
+    if (query->replyCtx) {
+        RedisModule_FreeThreadSafeContext(query->replyCtx);
+    }
+    free(query);
+}
+
+static void ParallelMRange_Reply(ParallelMRange *query) {
+    RedisModuleCtx *ctx = RedisModule_GetThreadSafeContext(query->bc);
+    const MRangeArgs *args = &query->args;
+    long long replylen = 0;
+
+    ReplyWithMapOrArray(ctx, REDISMODULE_POSTPONED_ARRAY_LEN, false);
+    for (size_t i = 0; i < query->count; i++) {
+        if (args->excludeEmpty && query->results[i]->samples.num_samples == 0) {
+            continue;
+        }
+        ReplySeriesArrayPos(ctx,
+                            query->series[i],
+                            args->withLabels,
+                            (RedisModuleString **)args->limitLabels,
+                            args->numLimitLabels,
+                            &args->rangeArgs,
+                            args->reverse,
+                            false,
+                            ReplayIterator_New(&query->results[i], 1, false),
+                            NULL);
+        replylen++;
+    }
+    ReplySetMapOrArrayLength(ctx, replylen, false);
+
+    query->replyCtx = ctx;
+    RTS_UnblockClient(query->bc, query);
+}
+
+static void ParallelMRange_Task(void *arg) {
+    ParallelMRange *query = arg;
+    size_t i;
+    while ((i = __atomic_fetch_add(&query->next, 1, __ATOMIC_RELAXED)) < query->count) {
+        query->results[i] =
+            SeriesQueryMaterialize(query->series[i], &query->args.rangeArgs, query->args.reverse);
+    }
+
+    // the last worker replies, after every result was written
+    if (__atomic_sub_fetch(&query->pendingTasks, 1, __ATOMIC_ACQ_REL) == 0) {
+        ParallelMRange_Reply(query);
+    }
+}
+
+bool ParallelQuery_MRange(RedisModuleCtx *ctx, RedisModuleDict *keys, MRangeArgs *args) {
+    const size_t numKeys = RedisModule_DictSize(keys);
+    if (numKeys < PARALLEL_MRANGE_MIN_SERIES || !canBlock(ctx)) {
+        return false;
+    }
+    const size_t workers = availableWorkers();
+    if (workers == 0) {
+        return false;
+    }
+
+    if (CheckDictSeriesPermissions(
+            ctx, keys, GetSeriesFlags_CheckForAcls | GetSeriesFlags_SilentOperation) ==
+        GetSeriesResult_PermissionError) {
+        RTS_ReplyKeyPermissionsError(ctx);
+        MRangeArgs_Free(args);
+        return true;
+    }
+
+    ParallelMRange *query = calloc(1, sizeof(*query));
+    query->args = *args;
+    query->series = calloc(numKeys, sizeof(*query->series));
+    query->results = calloc(numKeys, sizeof(*query->results));
+
+    RedisModuleDictIter *iter = RedisModule_DictIteratorStartC(keys, "^", NULL, 0);
+    char *currentKey;
+    size_t currentKeyLen;
+    while ((currentKey = RedisModule_DictNextC(iter, &currentKeyLen, NULL)) != NULL) {
+        RedisModuleKey *key;
+        Series *series;
+        // ACL permissions were already validated by CheckDictSeriesPermissions above.
+        const GetSeriesResult status =
+            GetSeries(ctx,
+                      RedisModule_CreateString(ctx, currentKey, currentKeyLen),
+                      &key,
+                      &series,
+                      REDISMODULE_READ,
+                      GetSeriesFlags_SilentOperation);
+        if (status != GetSeriesResult_Success) {
+            // The iterator may have been invalidated, stop and restart from after the current key.
+            RedisModule_DictIteratorStop(iter);
+            iter = RedisModule_DictIteratorStartC(keys, ">", currentKey, currentKeyLen);
+            continue;
+        }
+
+        query->series[query->count++] = SeriesSnapshot(series, &args->rangeArgs);
+        RedisModule_CloseKey(key);
+    }
+    RedisModule_DictIteratorStop(iter);
+
+    const size_t numTasks = max(min(workers, query->count), 1);
+    query->pendingTasks = numTasks;
+    query->bc = RTS_BlockClient(ctx, ParallelMRange_Free);
+    for (size_t i = 0; i < numTasks; i++) {
+        ThreadPool_Submit(queryPool, ParallelMRange_Task, query);
+    }
+    ++numRun;
+
+    return true;
+}
+
+/*********************
+ *  TS.RANGE         *
+ *********************/
+typedef struct ParallelRange
+{
+    RangeArgs args;
+    RangeArgs *parts;        // the query of each part, contiguous and in ascending order
+    EnrichedChunk **results; // materialized query of each part
+    size_t count;
+    size_t next;
+    size_t pendingTasks;
+    Series *series; // snapshot
+    bool reverse;
+    RedisModuleBlockedClient *bc;
+    RedisModuleCtx *replyCtx;
+} ParallelRange;
+
+static void ParallelRange_Free(RedisModuleCtx *ctx, void *privdata) {
+    ParallelRange *query = privdata;
+    for (size_t i = 0; i < query->count; i++) {
+        if (query->results[i]) {
+            FreeEnrichedChunk(query->results[i]);
+        }
+    }
+    FreeSeries(query->series);
+    free(query->parts);
+    free(query->results);
+    free(query->args.aggregationArgs.classes);
+    if (query->replyCtx) {
+        RedisModule_FreeThreadSafeContext(query->replyCtx);
+    }
+    free(query);
+}
+
+static void ParallelRange_Task(void *arg) {
+    ParallelRange *query = arg;
+    size_t i;
+    while ((i = __atomic_fetch_add(&query->next, 1, __ATOMIC_RELAXED)) < query->count) {
+        query->results[i] = SeriesQueryMaterialize(query->series, &query->parts[i], query->reverse);
+    }
+
+    if (__atomic_sub_fetch(&query->pendingTasks, 1, __ATOMIC_ACQ_REL) == 0) {
+        RedisModuleCtx *ctx = RedisModule_GetThreadSafeContext(query->bc);
+        AbstractIterator *iter = ReplayIterator_New(query->results, query->count, query->reverse);
+        ReplySeriesRangeFromIter(ctx, iter, NULL, &query->args);
+        query->replyCtx = ctx;
+        RTS_UnblockClient(query->bc, query);
+    }
+}
+
+// Counts the chunks of the series overlapping the range, up to limit
+static size_t countRangeChunks(Series *series, const RangeArgs *args, size_t limit) {
+    timestamp_t rax_key;
+    seriesEncodeTimestamp(&rax_key, args->startTimestamp);
+    // the first chunk is keyed 0, so the seek always finds the chunk holding the range start
+    RedisModuleDictIter *iter =
+        RedisModule_DictIteratorStartC(series->chunks, "<=", &rax_key, sizeof(rax_key));
+
+    size_t count = 0;
+    Chunk_t *chunk;
+    while (count < limit && RedisModule_DictNextC(iter, NULL, (void **)&chunk)) {
+        if (series->funcs->GetFirstTimestamp(chunk) > args->endTimestamp) {
+            break;
+        }
+        count++;
+    }
+    RedisModule_DictIteratorStop(iter);
+    return count;
+}
+
+static bool canSplitRange(const RangeArgs *args) {
+    // EMPTY, TWA and counter buckets depend on the samples around them and on the range edges, so
+    // they cannot be computed from a part of the range alone
+    if (args->aggregationArgs.empty) {
+        return false;
+    }
+    // the buckets of lttb and m4 span the whole range
+    if (args->downsample.type != DOWNSAMPLE_NONE) {
+        return false;
+    }
+    // the windows reach back into the previous part
+    if (args->window.type != WINDOW_NONE) {
+        return false;
+    }
+    for (size_t i = 0; i < args->aggregationArgs.numClasses; i++) {
+        if (AggTypeUsesBucketEdges(args->aggregationArgs.classes[i]->type)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Splits the range of the snapshot into up to maxParts contiguous parts holding about the same
+ * number of chunks. When aggregating, the parts are cut on bucket boundaries so every bucket is
+ * computed whole by a single part and the results of the parts only need to be concatenated. */
+static size_t splitRange(const Series *snapshot,
+                         const RangeArgs *args,
+                         size_t maxParts,
+                         RangeArgs *parts) {
+    const size_t numChunks = RedisModule_DictSize(snapshot->chunks);
+    const bool aggregated = args->aggregationArgs.numClasses > 0 && !args->skipAggregation;
+    const timestamp_t alignment = RangeArgs_Alignment(args);
+
+    size_t count = 0;
+    parts[0] = *args;
+    if (aggregated) {
+        // the parts are not aligned to their own start or end
+        parts[0].alignment = TimestampAlignment;
+        parts[0].timestampAlignment = alignment;
+    }
+
+    RedisModuleDictIter *iter = RedisModule_DictIteratorStartC(snapshot->chunks, "^", NULL, 0);
+    Chunk_t *chunk;
+    size_t chunkIndex = 0;
+    while (count + 1 < maxParts && RedisModule_DictNextC(iter, NULL, (void **)&chunk)) {
+        if (chunkIndex++ < (count + 1) * numChunks / maxParts) {
+            continue;
+        }
+        timestamp_t split = snapshot->funcs->GetFirstTimestamp(chunk);
+        if (aggregated) {
+            split = CalcBucketStart(split, args->aggregationArgs.timeDelta, alignment);
+        }
+        if (split <= parts[count].startTimestamp || split > args->endTimestamp) {
+            continue;
+        }
+        parts[count].endTimestamp = split - 1;
+        parts[count + 1] = parts[count];
+        parts[count + 1].startTimestamp = split;
+        parts[count + 1].endTimestamp = args->endTimestamp;
+        count++;
+    }
+    RedisModule_DictIteratorStop(iter);
+
+    return count + 1;
+}
+
+bool ParallelQuery_Range(RedisModuleCtx *ctx,
+                         Series *series,
+                         const RangeArgs *args,
+                         bool reverse) {
+    if (!canBlock(ctx) || !canSplitRange(args)) {
+        return false;
+    }
+    const size_t workers = availableWorkers();
+    if (workers < 2) {
+        return false;
+    }
+    const size_t numChunks =
+        countRangeChunks(series, args, workers * PARALLEL_RANGE_MIN_PART_CHUNKS);
+    const size_t maxParts = numChunks / PARALLEL_RANGE_MIN_PART_CHUNKS;
+    if (maxParts < 2) {
+        return false;
+    }
+
+    ParallelRange *query = calloc(1, sizeof(*query));
+    query->args = *args;
+    if (args->aggregationArgs.numClasses > 0) {
+        const size_t size = args->aggregationArgs.numClasses * sizeof(AggregationClass *);
+        query->args.aggregationArgs.classes = malloc(size);
+        memcpy(query->args.aggregationArgs.classes, args->aggregationArgs.classes, size);
+    }
+    query->reverse = reverse;
+    query->series = SeriesSnapshot(series, args);
+    query->parts = calloc(maxParts, sizeof(*query->parts));
+    query->count = splitRange(query->series, &query->args, maxParts, query->parts);
+    query->results = calloc(query->count, sizeof(*query->results));
+
+    query->pendingTasks = query->count;
+    query->bc = RTS_BlockClient(ctx, ParallelRange_Free);
+    for (size_t i = 0; i < query->count; i++) {
+        ThreadPool_Submit(queryPool, ParallelRange_Task, query);
+    }
+    ++numRun;
+
+    return true;
+}
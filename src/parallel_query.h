@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2006-Present, Redis Ltd.
+ * All rights reserved.
+ *
+ * Licensed under your choice of (a) the Redis Source Available License 2.0
+ * (RSALv2); or (b) the Server Side Public License v1 (SSPLv1); or (c) the
+ * GNU Affero General Public License v3 (AGPLv3).
+ */
+#ifndef PARALLEL_QUERY_H
+#define PARALLEL_QUERY_H
+
+#include "query_language.h"
+#include "tsdb.h"
+
+#include "RedisModulesSDK/redismodule.h"
+
+#include <stdbool.h>
+
+/*
+ * Queries on the query worker pool (ts-query-threads).
+ *
+ * On the main thread the queried series are snapshotted (SeriesSnapshot) and the client is
+ * blocked. The workers then run the query pipelines - decoding, filters and aggregation - on the
+ * snapshots without the GIL, and the last one to finish replies in order and unblocks the client.
+ * A multi-series query is split by series, a long single-series query by contiguous groups of
+ * chunks.
+ *
+ * The workers read the raw samples only. An aggregated query that ts-rollup-routing or the query
+ * cache (ts-query-cache-max-memory) may answer runs inline instead: a TS.RANGE once a compaction
+ * or the cache holds its buckets, a TS.MRANGE as soon as its arguments qualify for either of
+ * them, since they are looked up per series. INFO reports these queries under
+ * parallel_queries_kept_inline, next to parallel_queries.
+ */
+
+// Queries with fewer matched series run inline
+#define PARALLEL_MRANGE_MIN_SERIES 32
+// A single-series query is split into parts of at least this many chunks
+#define PARALLEL_RANGE_MIN_PART_CHUNKS 32
+
+// Runs an ungrouped TS.MRANGE/TS.MREVRANGE over the keys of the dict on the worker pool. Returns
+// false, leaving args untouched, when the query should run inline instead. Otherwise the query is
+// answered (or an error replied) and args is owned and freed by it.
+bool ParallelQuery_MRange(RedisModuleCtx *ctx, RedisModuleDict *keys, MRangeArgs *args);
+
+// Runs a TS.RANGE/TS.REVRANGE over the series on the worker pool. Returns false when the query
+// should run inline instead: the range is too short, or it aggregates with EMPTY or TWA, whose
+// buckets depend on samples outside them. args is copied and remains owned by the caller.
+bool ParallelQuery_Range(RedisModuleCtx *ctx,
+                         Series *series,
+                         const RangeArgs *args,
+                         bool reverse);
+
+// Counts a query run inline for the rollup routing or the query cache, when workers are set
+void ParallelQuery_KeepInline(void);
+// The queries run on the worker pool, and the ones counted by ParallelQuery_KeepInline
+uint64_t ParallelQuery_NumRun(void);
+uint64_t ParallelQuery_NumKeptInline(void);
+
+#endif // PARALLEL_QUERY_H
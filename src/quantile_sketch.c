@@ -0,0 +1,282 @@
+/*
+ * Copyright (c) 2006-Present, Redis Ltd.
+ * All rights reserved.
+ *
+ * Licensed under your choice of (a) the Redis Source Available License 2.0
+ * (RSALv2); or (b) the Server Side Public License v1 (SSPLv1); or (c) the
+ * GNU Affero General Public License v3 (AGPLv3).
+ */
+#include "quantile_sketch.h"
+
+#include "endianconv.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "rmutil/alloc.h"
+
+// gamma = (1 + accuracy) / (1 - accuracy), the ratio between the bounds of a bin
+#define QUANTILE_SKETCH_GAMMA                                                                      \
+    ((1 + QUANTILE_SKETCH_RELATIVE_ACCURACY) / (1 - QUANTILE_SKETCH_RELATIVE_ACCURACY))
+// Enough for DBL_MIN..DBL_MAX, infinities fall into the last bin
+#define QUANTILE_SKETCH_MAX_KEY (1 << 16)
+// Bins added past the one needed when a store grows, so that it doesn't grow on every new bin
+#define QUANTILE_SKETCH_STORE_SLACK 32
+
+#define QUANTILE_SKETCH_HEADER_LEN (4 + 4 * 8)
+
+// The bin of value > 0, holding the values in (gamma^(key-1), gamma^key]
+static int32_t keyOf(double value) {
+    const double key = ceil(log(value) / log(QUANTILE_SKETCH_GAMMA));
+    if (key > QUANTILE_SKETCH_MAX_KEY) {
+        return QUANTILE_SKETCH_MAX_KEY;
+    }
+    if (key < -QUANTILE_SKETCH_MAX_KEY) {
+        return -QUANTILE_SKETCH_MAX_KEY;
+    }
+    return (int32_t)key;
+}
+
+// The value of a bin, within the relative accuracy of all of its values
+static double valueOf(int32_t key) {
+    return 2 * pow(QUANTILE_SKETCH_GAMMA, key) / (QUANTILE_SKETCH_GAMMA + 1);
+}
+
+// Makes room for the bin key and returns where it is counted, which is the lowest bin when the
+// lower bins are collapsed
+static int32_t storeExtend(QuantileSketchStore *store, int32_t key) {
+    if (store->len > 0 && key >= store->offset && (int64_t)key < store->offset + store->len) {
+        return key;
+    }
+
+    int64_t lo = store->len > 0 ? store->offset : key;
+    int64_t hi = store->len > 0 ? store->offset + (int64_t)store->len - 1 : key;
+    if (key < lo) {
+        lo = (int64_t)key - QUANTILE_SKETCH_STORE_SLACK;
+    }
+    if (key > hi) {
+        hi = (int64_t)key + QUANTILE_SKETCH_STORE_SLACK;
+    }
+    if (hi - lo + 1 > QUANTILE_SKETCH_MAX_BINS) {
+        lo = hi - QUANTILE_SKETCH_MAX_BINS + 1;
+    }
+
+    uint64_t *counts = calloc(hi - lo + 1, sizeof(*counts));
+    for (uint32_t i = 0; i < store->len; i++) {
+        const int64_t bin = (int64_t)store->offset + i;
+        counts[(bin < lo ? lo : bin) - lo] += store->counts[i];
+    }
+    free(store->counts);
+    store->counts = counts;
+    store->offset = (int32_t)lo;
+    store->len = (uint32_t)(hi - lo + 1);
+    return key < lo ? (int32_t)lo : key;
+}
+
+static void storeAdd(QuantileSketchStore *store, int32_t key, uint64_t n) {
+    key = storeExtend(store, key);
+    store->counts[key - store->offset] += n;
+}
+
+static void storeFree(QuantileSketchStore *store) {
+    free(store->counts);
+    store->counts = NULL;
+    store->offset = 0;
+    store->len = 0;
+}
+
+void QuantileSketch_Init(QuantileSketch *sketch) {
+    memset(sketch, 0, sizeof(*sketch));
+}
+
+void QuantileSketch_Reset(QuantileSketch *sketch) {
+    storeFree(&sketch->positive);
+    storeFree(&sketch->negative);
+    QuantileSketch_Init(sketch);
+}
+
+void QuantileSketch_Add(QuantileSketch *sketch, double value) {
+    if (isnan(value)) {
+        return;
+    }
+    if (value > 0) {
+        storeAdd(&sketch->positive, keyOf(value), 1);
+    } else if (value < 0) {
+        storeAdd(&sketch->negative, keyOf(-value), 1);
+    } else {
+        sketch->zeroCount++;
+    }
+    sketch->min = sketch->count == 0 ? value : fmin(sketch->min, value);
+    sketch->max = sketch->count == 0 ? value : fmax(sketch->max, value);
+    sketch->count++;
+}
+
+void QuantileSketch_Merge(QuantileSketch *dest, const QuantileSketch *src) {
+    if (src->count == 0) {
+        return;
+    }
+    for (uint32_t i = 0; i < src->positive.len; i++) {
+        if (src->positive.counts[i] > 0) {
+            storeAdd(&dest->positive, src->positive.offset + i, src->positive.counts[i]);
+        }
+    }
+    for (uint32_t i = 0; i < src->negative.len; i++) {
+        if (src->negative.counts[i] > 0) {
+            storeAdd(&dest->negative, src->negative.offset + i, src->negative.counts[i]);
+        }
+    }
+    dest->zeroCount += src->zeroCount;
+    dest->min = dest->count == 0 ? src->min : fmin(dest->min, src->min);
+    dest->max = dest->count == 0 ? src->max : fmax(dest->max, src->max);
+    dest->count += src->count;
+}
+
+double QuantileSketch_Quantile(const QuantileSketch *sketch, double q) {
+    if (sketch->count == 0) {
+        return NAN;
+    }
+
+    // the value of the lowest rank above q * (count - 1), the negative values coming first
+    const double rank = q * (sketch->count - 1);
+    double result = sketch->max;
+    uint64_t seen = 0;
+    const QuantileSketchStore *negative = &sketch->negative;
+    for (uint32_t i = negative->len; i-- > 0;) {
+        seen += negative->counts[i];
+        if (seen > rank) {
+            result = -valueOf(negative->offset + i);
+            goto out;
+        }
+    }
+    seen += sketch->zeroCount;
+    if (seen > rank) {
+        result = 0;
+        goto out;
+    }
+    const QuantileSketchStore *positive = &sketch->positive;
+    for (uint32_t i = 0; i < positive->len; i++) {
+        seen += positive->counts[i];
+        if (seen > rank) {
+            result = valueOf(positive->offset + i);
+            goto out;
+        }
+    }
+
+out:
+    // the extremes are exact
+    return fmin(fmax(result, sketch->min), sketch->max);
+}
+
+static char *put64(char *p, uint64_t v) {
+    memrev64ifbe(&v);
+    memcpy(p, &v, sizeof(v));
+    return p + sizeof(v);
+}
+
+static char *putDouble(char *p, double d) {
+    uint64_t v;
+    memcpy(&v, &d, sizeof(v));
+    return put64(p, v);
+}
+
+static char *putStore(char *p, const QuantileSketchStore *store) {
+    uint32_t header[2] = { (uint32_t)store->offset, store->len };
+    memrev32ifbe(&header[0]);
+    memrev32ifbe(&header[1]);
+    memcpy(p, header, sizeof(header));
+    p += sizeof(header);
+    for (uint32_t i = 0; i < store->len; i++) {
+        p = put64(p, store->counts[i]);
+    }
+    return p;
+}
+
+char *QuantileSketch_Encode(const QuantileSketch *sketch, size_t *len) {
+    *len = QUANTILE_SKETCH_HEADER_LEN + 2 * 2 * sizeof(uint32_t) +
+           (sketch->positive.len + sketch->negative.len) * sizeof(uint64_t);
+    char *buf = malloc(*len);
+    char *p = buf;
+    memcpy(p, QUANTILE_SKETCH_MAGIC, 4);
+    p += 4;
+    p = put64(p, sketch->count);
+    p = put64(p, sketch->zeroCount);
+    p = putDouble(p, sketch->min);
+    p = putDouble(p, sketch->max);
+    p = putStore(p, &sketch->positive);
+    putStore(p, &sketch->negative);
+    return buf;
+}
+
+typedef struct SketchReader
+{
+    const char *p;
+    const char *end;
+    bool error;
+} SketchReader;
+
+static uint64_t get64(SketchReader *reader) {
+    uint64_t v = 0;
+    if (reader->end - reader->p < (ptrdiff_t)sizeof(v)) {
+        reader->error = true;
+        return 0;
+    }
+    memcpy(&v, reader->p, sizeof(v));
+    memrev64ifbe(&v);
+    reader->p += sizeof(v);
+    return v;
+}
+
+static uint32_t get32(SketchReader *reader) {
+    uint32_t v = 0;
+    if (reader->end - reader->p < (ptrdiff_t)sizeof(v)) {
+        reader->error = true;
+        return 0;
+    }
+    memcpy(&v, reader->p, sizeof(v));
+    memrev32ifbe(&v);
+    reader->p += sizeof(v);
+    return v;
+}
+
+static double getDouble(SketchReader *reader) {
+    const uint64_t v = get64(reader);
+    double d;
+    memcpy(&d, &v, sizeof(d));
+    return d;
+}
+
+static void getStore(SketchReader *reader, QuantileSketchStore *store) {
+    const int32_t offset = (int32_t)get32(reader);
+    const uint32_t len = get32(reader);
+    if (reader->error || len > QUANTILE_SKETCH_MAX_BINS ||
+        (size_t)(reader->end - reader->p) < len * sizeof(uint64_t)) {
+        reader->error = true;
+        return;
+    }
+    store->offset = offset;
+    store->len = len;
+    store->counts = len > 0 ? malloc(len * sizeof(*store->counts)) : NULL;
+    for (uint32_t i = 0; i < len; i++) {
+        store->counts[i] = get64(reader);
+    }
+}
+
+bool QuantileSketch_Decode(QuantileSketch *sketch, const char *buf, size_t len) {
+    QuantileSketch_Init(sketch);
+    if (len < QUANTILE_SKETCH_HEADER_LEN || memcmp(buf, QUANTILE_SKETCH_MAGIC, 4) != 0) {
+        return false;
+    }
+
+    SketchReader reader = { .p = buf + 4, .end = buf + len, .error = false };
+    sketch->count = get64(&reader);
+    sketch->zeroCount = get64(&reader);
+    sketch->min = getDouble(&reader);
+    sketch->max = getDouble(&reader);
+    getStore(&reader, &sketch->positive);
+    getStore(&reader, &sketch->negative);
+    if (reader.error || reader.p != reader.end) {
+        QuantileSketch_Reset(sketch);
+        return false;
+    }
+    return true;
+}
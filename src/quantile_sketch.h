@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2006-Present, Redis Ltd.
+ * All rights reserved.
+ *
+ * Licensed under your choice of (a) the Redis Source Available License 2.0
+ * (RSALv2); or (b) the Server Side Public License v1 (SSPLv1); or (c) the
+ * GNU Affero General Public License v3 (AGPLv3).
+ */
+#ifndef QUANTILE_SKETCH_H
+#define QUANTILE_SKETCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * A DDSketch, the state of the p50, p90, p95, p99 and p999 aggregations.
+ *
+ * Values are counted in logarithmic bins, so that any quantile is answered with a relative error of
+ * at most QUANTILE_SKETCH_RELATIVE_ACCURACY, whatever the number of values. Two sketches merge by
+ * adding their bins, which is how compaction buckets and the shards of a clustered GROUPBY are
+ * combined. Beyond QUANTILE_SKETCH_MAX_BINS bins per sign, the bins of the values closest to zero
+ * are collapsed into one.
+ *
+ * The encoding is little endian:
+ *   "QSK1" count(8) zeroCount(8) min(8) max(8) positive negative
+ *   store := offset(4) len(4) counts(8 * len)
+ */
+
+#define QUANTILE_SKETCH_RELATIVE_ACCURACY 0.01
+#define QUANTILE_SKETCH_MAX_BINS 2048
+#define QUANTILE_SKETCH_MAGIC "QSK1"
+
+typedef struct QuantileSketchStore
+{
+    uint64_t *counts; // counts[i] is the count of the bin offset + i
+    int32_t offset;
+    uint32_t len;
+} QuantileSketchStore;
+
+typedef struct QuantileSketch
+{
+    QuantileSketchStore positive;
+    QuantileSketchStore negative; // bins of -value
+    uint64_t zeroCount;
+    uint64_t count;
+    double min;
+    double max;
+} QuantileSketch;
+
+void QuantileSketch_Init(QuantileSketch *sketch);
+// Releases the bins, the sketch is empty afterwards
+void QuantileSketch_Reset(QuantileSketch *sketch);
+// NaN values are ignored
+void QuantileSketch_Add(QuantileSketch *sketch, double value);
+void QuantileSketch_Merge(QuantileSketch *dest, const QuantileSketch *src);
+// NaN when the sketch is empty
+double QuantileSketch_Quantile(const QuantileSketch *sketch, double q);
+
+// Returns the encoding, to be freed by the caller
+char *QuantileSketch_Encode(const QuantileSketch *sketch, size_t *len);
+// Initializes sketch from an encoding, false if it is malformed
+bool QuantileSketch_Decode(QuantileSketch *sketch, const char *buf, size_t len);
+
+#endif // QUANTILE_SKETCH_H
@@ -0,0 +1,411 @@
+/*
+ * Copyright (c) 2006-Present, Redis Ltd.
+ * All rights reserved.
+ *
+ * Licensed under your choice of (a) the Redis Source Available License 2.0
+ * (RSALv2); or (b) the Server Side Public License v1 (SSPLv1); or (c) the
+ * GNU Affero General Public License v3 (AGPLv3).
+ */
+#include "query_cache.h"
+
+#include "compaction.h"
+#include "config.h"
+#include "enriched_chunk.h"
+#include "filter_iterator.h"
+#include "window_iterator.h"
+
+#include <string.h>
+#include "rmutil/alloc.h"
+
+#define QUERY_CACHE_CHUNK_SIZE 256
+
+// Follows the key name of the series in the key of an entry
+typedef struct QueryCacheKey
+{
+    int dbId;
+    TS_AGG_TYPES_T aggType;
+    timestamp_t bucketDuration;
+    timestamp_t alignment; // modulo bucketDuration
+} QueryCacheKey;
+
+typedef struct QueryCacheEntry
+{
+    char *key;
+    size_t keyLen;
+    uint64_t version; // of the series
+    timestamp_t from; // the buckets of [from, until) are cached
+    timestamp_t until;
+    timestamp_t *timestamps;
+    double *values;
+    size_t len;
+    size_t cap;
+    struct QueryCacheEntry *prev; // used more recently
+    struct QueryCacheEntry *next;
+} QueryCacheEntry;
+
+static RedisModuleDict *entries = NULL;
+static QueryCacheEntry *mostRecent = NULL;
+static QueryCacheEntry *leastRecent = NULL;
+static size_t usedMemory = 0;
+
+static size_t entryMemory(const QueryCacheEntry *entry) {
+    return sizeof(*entry) + entry->keyLen + entry->cap * (sizeof(timestamp_t) + sizeof(double));
+}
+
+static void unlinkEntry(QueryCacheEntry *entry) {
+    if (entry->prev) {
+        entry->prev->next = entry->next;
+    } else {
+        mostRecent = entry->next;
+    }
+    if (entry->next) {
+        entry->next->prev = entry->prev;
+    } else {
+        leastRecent = entry->prev;
+    }
+}
+
+static void linkEntry(QueryCacheEntry *entry) {
+    entry->prev = NULL;
+    entry->next = mostRecent;
+    if (mostRecent) {
+        mostRecent->prev = entry;
+    } else {
+        leastRecent = entry;
+    }
+    mostRecent = entry;
+}
+
+static void freeEntry(QueryCacheEntry *entry) {
+    unlinkEntry(entry);
+    RedisModule_DictDelC(entries, entry->key, entry->keyLen, NULL);
+    usedMemory -= entryMemory(entry);
+    free(entry->key);
+    free(entry->timestamps);
+    free(entry->values);
+    free(entry);
+}
+
+void QueryCache_Evict(void) {
+    while (leastRecent && usedMemory > (size_t)TSGlobalConfig.queryCacheMaxMemory) {
+        freeEntry(leastRecent);
+    }
+}
+
+static QueryCacheEntry *getEntry(RedisModuleCtx *ctx,
+                                 Series *series,
+                                 TS_AGG_TYPES_T aggType,
+                                 timestamp_t bucketDuration,
+                                 timestamp_t alignment) {
+    QueryCacheKey suffix;
+    memset(&suffix, 0, sizeof(suffix)); // the padding is part of the key
+    suffix.dbId = RedisModule_GetSelectedDb(ctx);
+    suffix.aggType = aggType;
+    suffix.bucketDuration = bucketDuration;
+    suffix.alignment = modulo(alignment, bucketDuration);
+
+    size_t nameLen;
+    const char *name = RedisModule_StringPtrLen(series->keyName, &nameLen);
+    const size_t keyLen = nameLen + sizeof(suffix);
+    char *key = malloc(keyLen);
+    memcpy(key, name, nameLen);
+    memcpy(key + nameLen, &suffix, sizeof(suffix));
+
+    if (!entries) {
+        entries = RedisModule_CreateDict(NULL);
+    }
+    QueryCacheEntry *entry = RedisModule_DictGetC(entries, key, keyLen, NULL);
+    if (entry) {
+        free(key);
+        unlinkEntry(entry);
+        linkEntry(entry);
+        return entry;
+    }
+
+    entry = calloc(1, sizeof(QueryCacheEntry));
+    entry->key = key;
+    entry->keyLen = keyLen;
+    RedisModule_DictSetC(entries, key, keyLen, entry);
+    linkEntry(entry);
+    usedMemory += entryMemory(entry);
+    return entry;
+}
+
+// The first cached bucket at or after ts
+static size_t lowerBound(const QueryCacheEntry *entry, timestamp_t ts) {
+    size_t lo = 0;
+    size_t hi = entry->len;
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo) / 2;
+        if (entry->timestamps[mid] < ts) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// Drops the buckets before ts, which the queries no longer read
+static void dropBefore(QueryCacheEntry *entry, timestamp_t ts) {
+    const size_t n = lowerBound(entry, ts);
+    memmove(entry->timestamps, entry->timestamps + n, (entry->len - n) * sizeof(timestamp_t));
+    memmove(entry->values, entry->values + n, (entry->len - n) * sizeof(double));
+    entry->len -= n;
+    entry->from = ts;
+}
+
+static void appendBuckets(QueryCacheEntry *entry,
+                          const timestamp_t *timestamps,
+                          const double *values,
+                          size_t n) {
+    if (entry->len + n > entry->cap) {
+        usedMemory -= entryMemory(entry);
+        entry->cap = max(entry->cap * 2, entry->len + n);
+        entry->timestamps = realloc(entry->timestamps, entry->cap * sizeof(timestamp_t));
+        entry->values = realloc(entry->values, entry->cap * sizeof(double));
+        usedMemory += entryMemory(entry);
+    }
+    memcpy(entry->timestamps + entry->len, timestamps, n * sizeof(timestamp_t));
+    memcpy(entry->values + entry->len, values, n * sizeof(double));
+    entry->len += n;
+}
+
+// The buckets [begin, end) of an entry, which doesn't change until the query is closed
+typedef struct CachedBucketsIterator
+{
+    AbstractIterator base;
+    const timestamp_t *timestamps;
+    const double *values;
+    size_t begin;
+    size_t end;
+    bool reverse;
+    EnrichedChunk *out;
+} CachedBucketsIterator;
+
+static EnrichedChunk *CachedBucketsIterator_GetNextChunk(AbstractIterator *iter) {
+    CachedBucketsIterator *self = (CachedBucketsIterator *)iter;
+    if (self->begin == self->end) {
+        return NULL;
+    }
+    Samples *out = &self->out->samples;
+    ResetEnrichedChunk(self->out);
+    const size_t n = min(self->end - self->begin, (size_t)QUERY_CACHE_CHUNK_SIZE);
+    for (size_t i = 0; i < n; i++) {
+        const size_t index = self->reverse ? self->end - 1 - i : self->begin + i;
+        out->timestamps[i] = self->timestamps[index];
+        Samples_value_at(out, i, 0) = self->values[index];
+    }
+    out->num_samples = n;
+    if (self->reverse) {
+        self->end -= n;
+    } else {
+        self->begin += n;
+    }
+    return self->out;
+}
+
+static void CachedBucketsIterator_Close(AbstractIterator *iter) {
+    CachedBucketsIterator *self = (CachedBucketsIterator *)iter;
+    FreeEnrichedChunk(self->out);
+    free(self);
+}
+
+static AbstractIterator *CachedBucketsIterator_New(const QueryCacheEntry *entry,
+                                                   timestamp_t start,
+                                                   timestamp_t end,
+                                                   bool reverse) {
+    CachedBucketsIterator *iter = malloc(sizeof(CachedBucketsIterator));
+    iter->base.GetNext = CachedBucketsIterator_GetNextChunk;
+    iter->base.Close = CachedBucketsIterator_Close;
+    iter->base.input = NULL;
+    iter->timestamps = entry->timestamps;
+    iter->values = entry->values;
+    iter->begin = lowerBound(entry, start);
+    iter->end = lowerBound(entry, end);
+    iter->reverse = reverse;
+    iter->out = NewEnrichedChunk();
+    ReallocSamplesArray(&iter->out->samples, QUERY_CACHE_CHUNK_SIZE);
+    return (AbstractIterator *)iter;
+}
+
+// Passes the buckets of the series on, and adds the closed ones to the entry once they were all
+// read
+typedef struct RecordingIterator
+{
+    AbstractIterator base;
+    QueryCacheEntry *entry;
+    uint64_t version;
+    timestamp_t from;  // the entry ends at from
+    timestamp_t until; // the buckets before until are closed
+    timestamp_t *timestamps;
+    double *values;
+    size_t len;
+    size_t cap;
+    bool done;
+    bool reverse;
+} RecordingIterator;
+
+static EnrichedChunk *RecordingIterator_GetNextChunk(AbstractIterator *iter) {
+    RecordingIterator *self = (RecordingIterator *)iter;
+    EnrichedChunk *chunk = self->base.input->GetNext(self->base.input);
+    if (!chunk) {
+        self->done = true;
+        return NULL;
+    }
+    const Samples *samples = &chunk->samples;
+    if (self->len + samples->num_samples > self->cap) {
+        self->cap = max(self->cap * 2, self->len + samples->num_samples);
+        self->timestamps = realloc(self->timestamps, self->cap * sizeof(timestamp_t));
+        self->values = realloc(self->values, self->cap * sizeof(double));
+    }
+    for (size_t i = 0; i < samples->num_samples; i++) {
+        if (samples->timestamps[i] < self->until) {
+            self->timestamps[self->len] = samples->timestamps[i];
+            self->values[self->len++] = Samples_value_at(samples, i, 0);
+        }
+    }
+    return chunk;
+}
+
+static void RecordingIterator_Close(AbstractIterator *iter) {
+    RecordingIterator *self = (RecordingIterator *)iter;
+    QueryCacheEntry *entry = self->entry;
+    if (self->done && entry->version == self->version && entry->until == self->from) {
+        if (self->reverse) {
+            for (size_t i = 0, j = self->len; i + 1 < j; i++, j--) {
+                const timestamp_t ts = self->timestamps[i];
+                self->timestamps[i] = self->timestamps[j - 1];
+                self->timestamps[j - 1] = ts;
+                const double value = self->values[i];
+                self->values[i] = self->values[j - 1];
+                self->values[j - 1] = value;
+            }
+        }
+        appendBuckets(entry, self->timestamps, self->values, self->len);
+        entry->until = self->until;
+        QueryCache_Evict();
+    }
+    self->base.input->Close(self->base.input);
+    free(self->timestamps);
+    free(self->values);
+    free(self);
+}
+
+static AbstractIterator *RecordingIterator_New(AbstractIterator *input,
+                                               QueryCacheEntry *entry,
+                                               timestamp_t until,
+                                               bool reverse) {
+    RecordingIterator *iter = malloc(sizeof(RecordingIterator));
+    iter->base.GetNext = RecordingIterator_GetNextChunk;
+    iter->base.Close = RecordingIterator_Close;
+    iter->base.input = input;
+    iter->entry = entry;
+    iter->version = entry->version;
+    iter->from = entry->until;
+    iter->until = until;
+    iter->timestamps = NULL;
+    iter->values = NULL;
+    iter->len = 0;
+    iter->cap = 0;
+    iter->done = false;
+    iter->reverse = reverse;
+    return (AbstractIterator *)iter;
+}
+
+// The start of the bucket of ts, 0 when it starts before 0
+static timestamp_t bucketFloor(timestamp_t ts, timestamp_t duration, timestamp_t alignment) {
+    const timestamp_t bucketStart = CalcBucketStart(ts, duration, alignment);
+    return bucketStart > ts ? 0 : bucketStart;
+}
+
+// The first bucket starting at or after ts
+static timestamp_t bucketCeil(timestamp_t ts, timestamp_t duration, timestamp_t alignment) {
+    const timestamp_t bucketStart = CalcBucketStart(ts, duration, alignment);
+    return bucketStart == ts ? ts : bucketStart + duration;
+}
+
+static AbstractIterator *rawSegment(Series *series,
+                                    const RangeArgs *args,
+                                    timestamp_t start,
+                                    timestamp_t end,
+                                    bool reverse) {
+    RangeArgs segmentArgs = *args;
+    segmentArgs.startTimestamp = start;
+    segmentArgs.endTimestamp = end;
+    return SeriesQuery(series, &segmentArgs, reverse, true);
+}
+
+bool QueryCache_MayApply(const RangeArgs *args) {
+    return TSGlobalConfig.queryCacheMaxMemory > 0 && args->aggregationArgs.numClasses == 1 &&
+           !args->aggregationArgs.empty &&
+           args->aggregationArgs.bucketTS == BucketStartTimestamp && !args->skipAggregation &&
+           !args->filterByValueArgs.hasValue && !args->filterByTSArgs.hasValue &&
+           !AggTypeUsesBucketEdges(args->aggregationArgs.classes[0]->type);
+}
+
+AbstractIterator *QueryCache_Query(RedisModuleCtx *ctx,
+                                   Series *series,
+                                   const RangeArgs *args,
+                                   bool reverse) {
+    if (!QueryCache_MayApply(args) || series->totalSamples == 0 ||
+        args->startTimestamp > series->lastTimestamp) {
+        return NULL;
+    }
+    const TS_AGG_TYPES_T aggType = args->aggregationArgs.classes[0]->type;
+
+    const timestamp_t duration = args->aggregationArgs.timeDelta;
+    const timestamp_t alignment = RangeArgs_Alignment(args);
+    // The bucket of the last sample is still open, and the one of the end of the query partial
+    const timestamp_t closedUntil = min(bucketFloor(series->lastTimestamp, duration, alignment),
+                                        bucketFloor(args->endTimestamp, duration, alignment));
+    timestamp_t expiredUntil = 0;
+    if (series->retentionTime > 0 && series->lastTimestamp > series->retentionTime) {
+        expiredUntil = bucketCeil(
+            series->lastTimestamp - series->retentionTime, duration, alignment);
+    }
+    const timestamp_t start =
+        max(bucketCeil(args->startTimestamp, duration, alignment), expiredUntil);
+    if (start >= closedUntil) {
+        return NULL;
+    }
+
+    QueryCacheEntry *entry = getEntry(ctx, series, aggType, duration, alignment);
+    if (entry->version != series->version || start < entry->from || start > entry->until) {
+        entry->version = series->version;
+        entry->len = 0;
+        entry->from = entry->until = start;
+    } else if (entry->from < expiredUntil) {
+        dropBefore(entry, min(expiredUntil, entry->until));
+    }
+
+    // The buckets of the query are the ones of the series before start, the ones of the entry
+    // and the ones of the series after it
+    RangeArgs segmentArgs = *args;
+    segmentArgs.alignment = TimestampAlignment;
+    segmentArgs.timestampAlignment = alignment;
+    segmentArgs.window.type = WINDOW_NONE;
+    const timestamp_t cachedUntil = min(entry->until, closedUntil);
+
+    AbstractIterator *head = NULL;
+    if (args->startTimestamp < start) {
+        segmentArgs.latest = false;
+        head = rawSegment(series, &segmentArgs, args->startTimestamp, start - 1, reverse);
+        segmentArgs.latest = args->latest;
+    }
+    AbstractIterator *cached = NULL;
+    if (start < cachedUntil) {
+        cached = CachedBucketsIterator_New(entry, start, cachedUntil, reverse);
+    }
+    AbstractIterator *tail =
+        rawSegment(series, &segmentArgs, cachedUntil, args->endTimestamp, reverse);
+    if (cachedUntil == entry->until && cachedUntil < closedUntil) {
+        tail = RecordingIterator_New(tail, entry, closedUntil, reverse);
+    }
+
+    AbstractIterator *iter = (AbstractIterator *)ConcatIterator_New(head, cached, tail, reverse);
+    if (args->window.type != WINDOW_NONE) {
+        iter = (AbstractIterator *)WindowIterator_New(iter, &args->window);
+    }
+    return iter;
+}
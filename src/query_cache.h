@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2006-Present, Redis Ltd.
+ * All rights reserved.
+ *
+ * Licensed under your choice of (a) the Redis Source Available License 2.0
+ * (RSALv2); or (b) the Server Side Public License v1 (SSPLv1); or (c) the
+ * GNU Affero General Public License v3 (AGPLv3).
+ */
+#ifndef QUERY_CACHE_H
+#define QUERY_CACHE_H
+
+#include "abstract_iterator.h"
+#include "query_language.h"
+#include "tsdb.h"
+
+#include "RedisModulesSDK/redismodule.h"
+
+/*
+ * Query cache (ts-query-cache-max-memory)
+ *
+ * Keeps the buckets of aggregated TS.RANGE/TS.REVRANGE and ungrouped TS.MRANGE/TS.MREVRANGE
+ * queries, so that a query repeated over the same series only aggregates the buckets added since.
+ * An entry is kept per series, aggregator, bucket duration and alignment, whatever the range of
+ * the query, and holds the buckets of a range of whole buckets closed before the last sample of
+ * the series. A query reads the buckets it shares with the entry from it, the others from the
+ * series, and the entry grows with the closed buckets that follow it.
+ *
+ * Appending samples doesn't touch the closed buckets, and expired samples are left out of the
+ * query by its start. Any other change of the samples, an update, an out of order sample or a
+ * deletion, gives the series a new version, which drops its entries when they're next read.
+ *
+ * The entries are evicted least recently used first, once their memory exceeds
+ * ts-query-cache-max-memory, and 0 disables the cache. Queries with EMPTY, FILTER_BY_TS,
+ * FILTER_BY_VALUE, BUCKETTIMESTAMP other than start, multiple aggregators, twa or the counter
+ * aggregators aren't cached.
+ */
+
+// Returns false when args aren't cached for any series
+bool QueryCache_MayApply(const RangeArgs *args);
+// Returns NULL when args aren't cached
+AbstractIterator *QueryCache_Query(RedisModuleCtx *ctx,
+                                   Series *series,
+                                   const RangeArgs *args,
+                                   bool reverse);
+// Evicts entries until they fit in ts-query-cache-max-memory
+void QueryCache_Evict(void);
+
+#endif // QUERY_CACHE_H
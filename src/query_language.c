@@ -193,6 +193,22 @@ int parseIgnoreArgs(RedisModuleCtx *ctx,
     return TSDB_OK;
 }
 
+// CHUNK_SIZE is either a size in bytes or AUTO. An AUTO series starts from the default chunk
+// size and adapts it to its ingest rate, see SeriesAddSample.
+static int parseChunkSizeArgs(RedisModuleCtx *ctx,
+                              RedisModuleString **argv,
+                              int argc,
+                              CreateCtx *cCtx) {
+    const int idx = RMUtil_ArgIndex("CHUNK_SIZE", argv, argc);
+    if (idx >= 0 && idx + 1 < argc &&
+        RMUtil_StringEqualsCaseC(argv[idx + 1], CHUNK_SIZE_AUTO_ARG_STR)) {
+        cCtx->options |= SERIES_OPT_CHUNK_SIZE_AUTO;
+        return TSDB_OK;
+    }
+
+    return ParseChunkSize(ctx, argv, argc, "CHUNK_SIZE", &cCtx->chunkSizeBytes, NULL);
+}
+
 int parseCreateArgs(RedisModuleCtx *ctx, RedisModuleString **argv, int argc, CreateCtx *cCtx) {
     cCtx->retentionTime = TSGlobalConfig.retentionPolicy;
     cCtx->chunkSizeBytes = TSGlobalConfig.chunkSizeBytes;
@@ -216,7 +232,7 @@ int parseCreateArgs(RedisModuleCtx *ctx, RedisModuleString **argv, int argc, Cre
         goto err_exit;
     }
 
-    if (ParseChunkSize(ctx, argv, argc, "CHUNK_SIZE", &cCtx->chunkSizeBytes, NULL) != TSDB_OK) {
+    if (parseChunkSizeArgs(ctx, argv, argc, cCtx) != TSDB_OK) {
         goto err_exit;
     }
 
@@ -485,6 +501,103 @@ int parseAggregationArgs(RedisModuleCtx *ctx,
     }
 }
 
+// AGGREGATION lttb|m4 points, TSDB_NOTEXISTS for any other aggregation
+static int parseDownsampleArgs(RedisModuleCtx *ctx,
+                               RedisModuleString **argv,
+                               int argc,
+                               DownsampleArgs *out) {
+    out->type = DOWNSAMPLE_NONE;
+    out->points = 0;
+    const int offset = RMUtil_ArgIndex("AGGREGATION", argv, argc);
+    if (offset < 0 || offset + 1 >= argc) {
+        return TSDB_NOTEXISTS;
+    }
+
+    long long minPoints;
+    if (RMUtil_StringEqualsCaseC(argv[offset + 1], "lttb")) {
+        out->type = DOWNSAMPLE_LTTB;
+        minPoints = DOWNSAMPLE_LTTB_MIN_POINTS;
+    } else if (RMUtil_StringEqualsCaseC(argv[offset + 1], "m4")) {
+        out->type = DOWNSAMPLE_M4;
+        minPoints = DOWNSAMPLE_M4_MIN_POINTS;
+    } else {
+        return TSDB_NOTEXISTS;
+    }
+
+    long long points;
+    if (offset + 2 >= argc ||
+        RedisModule_StringToLongLong(argv[offset + 2], &points) != REDISMODULE_OK) {
+        RTS_ReplyGeneralError(ctx, "TSDB: Couldn't parse AGGREGATION");
+        return TSDB_ERROR;
+    }
+    if (points < minPoints) {
+        RTS_ReplyGeneralError(ctx,
+                              out->type == DOWNSAMPLE_LTTB
+                                  ? "TSDB: lttb needs at least 3 points"
+                                  : "TSDB: m4 needs at least 4 points");
+        return TSDB_ERROR;
+    }
+    if (RMUtil_ArgIndex("EMPTY", argv, argc) > 0 ||
+        RMUtil_ArgIndex("BUCKETTIMESTAMP", argv, argc) > 0) {
+        RTS_ReplyGeneralError(ctx,
+                              "TSDB: EMPTY and BUCKETTIMESTAMP are not supported by lttb and m4");
+        return TSDB_ERROR;
+    }
+    out->points = (size_t)points;
+    return TSDB_OK;
+}
+
+static int parseWindowArgs(RedisModuleCtx *ctx,
+                           RedisModuleString **argv,
+                           int argc,
+                           WindowArgs *out) {
+    out->type = WINDOW_NONE;
+    out->size = 0;
+    out->alpha = 0;
+    const int offset = RMUtil_ArgIndex("WINDOW", argv, argc);
+    if (offset < 0) {
+        return TSDB_OK;
+    }
+    if (offset + 2 >= argc) {
+        RTS_ReplyGeneralError(ctx, "TSDB: WINDOW needs a function and a size");
+        return TSDB_ERROR;
+    }
+
+    if (RMUtil_StringEqualsCaseC(argv[offset + 1], "ewma")) {
+        double alpha;
+        if (RedisModule_StringToDouble(argv[offset + 2], &alpha) != REDISMODULE_OK ||
+            !(alpha > 0 && alpha <= 1)) {
+            RTS_ReplyGeneralError(ctx, "TSDB: ewma alpha must be greater than 0 and at most 1");
+            return TSDB_ERROR;
+        }
+        out->type = WINDOW_EWMA;
+        out->alpha = alpha;
+        return TSDB_OK;
+    }
+
+    if (RMUtil_StringEqualsCaseC(argv[offset + 1], "sma")) {
+        out->type = WINDOW_SMA;
+    } else if (RMUtil_StringEqualsCaseC(argv[offset + 1], "std")) {
+        out->type = WINDOW_STD;
+    } else if (RMUtil_StringEqualsCaseC(argv[offset + 1], "min")) {
+        out->type = WINDOW_MIN;
+    } else if (RMUtil_StringEqualsCaseC(argv[offset + 1], "max")) {
+        out->type = WINDOW_MAX;
+    } else {
+        RTS_ReplyGeneralError(ctx, "TSDB: unknown WINDOW, expected sma, ewma, std, min or max");
+        return TSDB_ERROR;
+    }
+    long long size;
+    if (RedisModule_StringToLongLong(argv[offset + 2], &size) != REDISMODULE_OK || size < 1 ||
+        size > WINDOW_MAX_SIZE) {
+        out->type = WINDOW_NONE;
+        RTS_ReplyGeneralError(ctx, "TSDB: WINDOW size must be between 1 and 1048576");
+        return TSDB_ERROR;
+    }
+    out->size = (size_t)size;
+    return TSDB_OK;
+}
+
 static int parseCountArgument(RedisModuleCtx *ctx,
                               RedisModuleString **argv,
                               int argc,
@@ -643,6 +756,29 @@ static int parseFilterByTimestamp(RedisModuleCtx *ctx,
     return TSDB_OK;
 }
 
+static int parseFormatArgument(RedisModuleCtx *ctx,
+                               RedisModuleString **argv,
+                               int argc,
+                               bool *binaryFormat) {
+    *binaryFormat = false;
+    int offset = RMUtil_ArgIndex("FORMAT", argv, argc);
+    if (offset < 0) {
+        return TSDB_OK;
+    }
+    if (offset + 1 == argc) {
+        RTS_ReplyGeneralError(ctx, "TSDB: FORMAT argument is missing");
+        return TSDB_ERROR;
+    }
+    const char *format = RedisModule_StringPtrLen(argv[offset + 1], NULL);
+    if (strcasecmp(format, "BINARY") == 0) {
+        *binaryFormat = true;
+    } else if (strcasecmp(format, "RESP") != 0) {
+        RTS_ReplyGeneralError(ctx, "TSDB: unknown FORMAT, expected RESP or BINARY");
+        return TSDB_ERROR;
+    }
+    return TSDB_OK;
+}
+
 int parseLatestArg(RedisModuleCtx *ctx, RedisModuleString **argv, int argc, bool *latest) {
     int offset = RMUtil_ArgIndex("LATEST", argv, argc);
     if (offset > 0) {
@@ -706,7 +842,12 @@ int parseRangeArguments(RedisModuleCtx *ctx,
         return REDISMODULE_ERR;
     }
 
-    if (parseAggregationArgs(ctx, opts_argv, opts_argc, &args.aggregationArgs) == TSDB_ERROR) {
+    const int downsample = parseDownsampleArgs(ctx, opts_argv, opts_argc, &args.downsample);
+    if (downsample == TSDB_ERROR) {
+        return REDISMODULE_ERR;
+    }
+    if (downsample == TSDB_NOTEXISTS &&
+        parseAggregationArgs(ctx, opts_argv, opts_argc, &args.aggregationArgs) == TSDB_ERROR) {
         return REDISMODULE_ERR;
     }
 
@@ -743,6 +884,19 @@ int parseRangeArguments(RedisModuleCtx *ctx,
         goto error_free_classes;
     }
 
+    if (parseFormatArgument(ctx, opts_argv, opts_argc, &args.binaryFormat) == TSDB_ERROR) {
+        goto error_free_classes;
+    }
+
+    if (parseWindowArgs(ctx, opts_argv, opts_argc, &args.window) == TSDB_ERROR) {
+        goto error_free_classes;
+    }
+    if (args.window.type != WINDOW_NONE && args.downsample.type != DOWNSAMPLE_NONE) {
+        // the samples kept by lttb and m4 are not evenly spaced
+        RTS_ReplyGeneralError(ctx, "TSDB: WINDOW is not allowed with lttb and m4");
+        goto error_free_classes;
+    }
+
     *out = args;
 
     return REDISMODULE_OK;
@@ -826,7 +980,8 @@ int parseMultiSeriesReduceArgs(RedisModuleCtx *ctx,
                                RedisModuleString *reducerstr,
                                ReducerArgs *reducerArgs) {
     TS_AGG_TYPES_T agg_type = RMStringLenAggTypeToEnum(reducerstr);
-    if (agg_type == TS_AGG_FIRST || agg_type == TS_AGG_LAST || agg_type == TS_AGG_TWA ||
+    // the values reduced at a timestamp come from different series, they have no order in time
+    if (agg_type == TS_AGG_FIRST || agg_type == TS_AGG_LAST || AggTypeUsesBucketEdges(agg_type) ||
         agg_type == TS_AGG_INVALID || agg_type == TS_AGG_NONE) {
         RTS_ReplyGeneralError(ctx, "TSDB: Invalid reducer type");
         return TSDB_ERROR;
@@ -953,6 +1108,7 @@ int parseMRangeCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc,
     args.groupByLabel = NULL;
     args.queryPredicates = NULL;
     args.numLimitLabels = 0;
+    args.cursor = NULL;
 
     if (parseRangeArguments(ctx, 1, argv, argc, &args.rangeArgs) != REDISMODULE_OK) {
         return REDISMODULE_ERR;
@@ -1006,6 +1162,19 @@ int parseMRangeCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc,
         goto error_free_all;
     }
 
+    const int cursor_location = RMUtil_ArgIndex("CURSOR", argv, argc);
+    if (cursor_location > 0 && cursor_location < filter_location) {
+        if (cursor_location + 1 == filter_location) {
+            RTS_ReplyGeneralError(ctx, "TSDB: CURSOR argument is missing");
+            goto error_free_all;
+        }
+        if (groupby_location > 0) {
+            RTS_ReplyGeneralError(ctx, "TSDB: CURSOR is not allowed with GROUPBY");
+            goto error_free_all;
+        }
+        args.cursor = argv[cursor_location + 1];
+    }
+
     if (groupby_location > 0) {
         if (groupby_label_location >= argc) {
             // GROUP BY without any argument
@@ -1031,6 +1200,11 @@ int parseMRangeCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc,
                 ctx, "TSDB: GROUPBY is not allowed when multiple aggregators are specified");
             goto error_free_all;
         }
+
+        if (args.rangeArgs.downsample.type != DOWNSAMPLE_NONE) {
+            RTS_ReplyGeneralError(ctx, "TSDB: GROUPBY is not allowed with lttb and m4");
+            goto error_free_all;
+        }
     }
 
     if (args.groupByLabel) {
@@ -1050,6 +1224,105 @@ error_free_classes:
     return REDISMODULE_ERR;
 }
 
+// TS.MTOPK k fromTimestamp toTimestamp AGGREGATION aggregator [BOTTOM] [LATEST]
+//   [FILTER_BY_TS ts...] [FILTER_BY_VALUE min max] [WITHLABELS | SELECTED_LABELS label...]
+//   FILTER filterExpr...
+int parseMTopKCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc, MTopKArgs *out) {
+    if (argc < 7) {
+        RedisModule_WrongArity(ctx);
+        return REDISMODULE_ERR;
+    }
+
+    long long k;
+    if (RedisModule_StringToLongLong(argv[1], &k) != REDISMODULE_OK || k < 1 || k > MTOPK_MAX_K) {
+        RTS_ReplyGeneralError(ctx, "TSDB: k must be between 1 and 10000");
+        return REDISMODULE_ERR;
+    }
+
+    // The aggregator, which has no bucket duration, and BOTTOM are taken out, the rest is parsed
+    // as the arguments of TS.MRANGE
+    const int filter_location = RMUtil_ArgIndex("FILTER", argv, argc);
+    RedisModuleString **mrangeArgv = malloc(argc * sizeof(*mrangeArgv));
+    int mrangeArgc = 0;
+    int aggType = TS_AGG_NONE;
+    bool bottom = false;
+    mrangeArgv[mrangeArgc++] = argv[0];
+    for (int i = 2; i < argc; ++i) {
+        if (i >= 4 && (filter_location < 0 || i < filter_location)) {
+            if (RMUtil_StringEqualsCaseC(argv[i], "AGGREGATION") && i + 1 < argc) {
+                aggType = RMStringLenAggTypeToEnum(argv[++i]);
+                continue;
+            }
+            if (RMUtil_StringEqualsCaseC(argv[i], "BOTTOM")) {
+                bottom = true;
+                continue;
+            }
+        }
+        mrangeArgv[mrangeArgc++] = argv[i];
+    }
+
+    if (aggType == TS_AGG_NONE) {
+        free(mrangeArgv);
+        RTS_ReplyGeneralError(ctx, "TSDB: TS.MTOPK needs AGGREGATION aggregator");
+        return REDISMODULE_ERR;
+    }
+    if (aggType == TS_AGG_INVALID) {
+        free(mrangeArgv);
+        RTS_ReplyGeneralError(ctx, "TSDB: Unknown aggregation type");
+        return REDISMODULE_ERR;
+    }
+
+    MTopKArgs args = { .k = (size_t)k, .bottom = bottom };
+    const int result = parseMRangeCommand(ctx, mrangeArgv, mrangeArgc, &args.mrange);
+    free(mrangeArgv);
+    if (result != REDISMODULE_OK) {
+        return REDISMODULE_ERR;
+    }
+
+    const RangeArgs *rangeArgs = &args.mrange.rangeArgs;
+    if (args.mrange.groupByLabel || args.mrange.cursor || args.mrange.excludeEmpty ||
+        rangeArgs->count != -1 || rangeArgs->aggregationArgs.numClasses > 0 ||
+        rangeArgs->downsample.type != DOWNSAMPLE_NONE || rangeArgs->window.type != WINDOW_NONE ||
+        rangeArgs->binaryFormat) {
+        MRangeArgs_Free(&args.mrange);
+        RTS_ReplyGeneralError(
+            ctx, "TSDB: COUNT, GROUPBY, CURSOR, EXCLUDEEMPTY, WINDOW and FORMAT are not allowed "
+                 "with TS.MTOPK");
+        return REDISMODULE_ERR;
+    }
+
+    // a single bucket, its duration and alignment are set for each series
+    AggregationArgs *aggregationArgs = &args.mrange.rangeArgs.aggregationArgs;
+    aggregationArgs->numClasses = 1;
+    aggregationArgs->classes = malloc(sizeof(*aggregationArgs->classes));
+    aggregationArgs->classes[0] = GetAggClass(aggType);
+    aggregationArgs->timeDelta = 0;
+    aggregationArgs->bucketTS = BucketStartTimestamp;
+    aggregationArgs->empty = false;
+    args.mrange.reverse = false;
+
+    *out = args;
+    return REDISMODULE_OK;
+}
+
+void MTopKArgs_Free(MTopKArgs *args) {
+    MRangeArgs_Free(&args->mrange);
+}
+
+timestamp_t RangeArgs_Alignment(const RangeArgs *args) {
+    switch (args->alignment) {
+        case StartAlignment:
+            // args-startTimestamp can hold an older timestamp than what we currently have or just 0
+            return args->startTimestamp;
+        case EndAlignment:
+            return args->endTimestamp;
+        case TimestampAlignment:
+            return args->timestampAlignment;
+        default:
+            return 0;
+    }
+}
+
 void MRangeArgs_Free(MRangeArgs *args) {
     QueryPredicateList_Free(args->queryPredicates);
     free(args->rangeArgs.aggregationArgs.classes);
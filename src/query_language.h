@@ -59,6 +59,43 @@ typedef struct FilterByTSArgs
     timestamp_t values[MAX_TS_VALUES_FILTER];
 } FilterByTSArgs;
 
+// AGGREGATION lttb|m4 points, see downsample_iterator.h
+typedef enum DownsampleType
+{
+    DOWNSAMPLE_NONE = 0,
+    DOWNSAMPLE_LTTB,
+    DOWNSAMPLE_M4
+} DownsampleType;
+
+#define DOWNSAMPLE_LTTB_MIN_POINTS 3
+#define DOWNSAMPLE_M4_MIN_POINTS 4
+
+typedef struct DownsampleArgs
+{
+    DownsampleType type;
+    size_t points; // the number of samples the series is downsampled to
+} DownsampleArgs;
+
+// WINDOW sma|std|min|max size, WINDOW ewma alpha, see window_iterator.h
+typedef enum WindowType
+{
+    WINDOW_NONE = 0,
+    WINDOW_SMA,
+    WINDOW_STD,
+    WINDOW_MIN,
+    WINDOW_MAX,
+    WINDOW_EWMA
+} WindowType;
+
+#define WINDOW_MAX_SIZE (1 << 20)
+
+typedef struct WindowArgs
+{
+    WindowType type;
+    size_t size;  // the number of samples in the window, but for ewma
+    double alpha; // ewma only, in (0, 1]
+} WindowArgs;
+
 typedef enum RangeAlignment
 {
     DefaultAlignment,
@@ -74,11 +111,14 @@ typedef struct RangeArgs
     bool latest;     // get also the latest unfinalized bucket from the src series
     long long count; // AKA limit
     AggregationArgs aggregationArgs;
+    DownsampleArgs downsample; // instead of aggregationArgs, see downsample_iterator.h
+    WindowArgs window;         // after the aggregation, see window_iterator.h
     FilterByValueArgs filterByValueArgs;
     FilterByTSArgs filterByTSArgs;
     RangeAlignment alignment;
     timestamp_t timestampAlignment;
     bool skipAggregation; // data is already aggregated; keep agg info for RESP3 but skip re-agg
+    bool binaryFormat;    // FORMAT BINARY, see ReplySeriesRangeBinary
 } RangeArgs;
 
 #define LIMIT_LABELS_SIZE 50
@@ -93,8 +133,17 @@ typedef struct MRangeArgs
     ReducerArgs groupByReducerArgs;
     bool reverse;
     bool excludeEmpty;
+    RedisModuleString *cursor; // CURSOR, NULL without it, see mrange_cursor.h
 } MRangeArgs;
 
+#define MTOPK_MAX_K 10000
+typedef struct MTopKArgs
+{
+    MRangeArgs mrange; // the aggregator is its single aggregation class, see topk.h
+    size_t k;
+    bool bottom;
+} MTopKArgs;
+
 typedef struct MGetArgs
 {
     bool withLabels;
@@ -172,6 +221,9 @@ int parseAggregationArgs(RedisModuleCtx *ctx,
                          int argc,
                          AggregationArgs *out);
 
+// The timestamp the aggregation buckets of the range are aligned to
+timestamp_t RangeArgs_Alignment(const RangeArgs *args);
+
 int parseRangeArguments(RedisModuleCtx *ctx,
                         int start_index,
                         RedisModuleString **argv,
@@ -187,6 +239,9 @@ QueryPredicateList *parseLabelListFromArgs(RedisModuleCtx *ctx,
 int parseMRangeCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc, MRangeArgs *out);
 void MRangeArgs_Free(MRangeArgs *args);
 
+int parseMTopKCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc, MTopKArgs *out);
+void MTopKArgs_Free(MTopKArgs *args);
+
 int parseMGetCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc, MGetArgs *out);
 void MGetArgs_Free(MGetArgs *args);
 bool ValidateChunkSize(RedisModuleCtx *ctx, long long chunkSizeBytes, RedisModuleString **err);
@@ -202,6 +257,8 @@ static inline RangeArgs RangeArgs_ZeroProcessing(const RangeArgs *src) {
     r.aggregationArgs.numClasses = 0;
     r.aggregationArgs.classes = NULL;
     r.aggregationArgs.timeDelta = 0;
+    r.downsample.type = DOWNSAMPLE_NONE;
+    r.window.type = WINDOW_NONE;
     r.filterByTSArgs.hasValue = false;
     r.filterByValueArgs.hasValue = false;
     r.latest = false;
@@ -107,6 +107,13 @@ void *series_rdb_load(RedisModuleIO *io, int encver) {
 
         rule->validSamplesInBucket =
             Load_IOError_OrDefault(io, err, NULL, encver >= TS_NAN_SUPPORT_VER, true);
+        // older rules are taken as created at load time
+        rule->watermark =
+            Load_IOError_OrDefault(io,
+                                   err,
+                                   NULL,
+                                   encver >= TS_RULE_WATERMARK_VER,
+                                   totalSamples > 0 ? RuleWatermarkAfter(rule, lastTimestamp) : 0);
 
         rule->nextRule = series->rules;
         series->rules = rule;
@@ -205,6 +212,7 @@ void series_rdb_save(RedisModuleIO *io, void *value) {
             RedisModule_SaveUnsigned(io, rule->aggType);
             RedisModule_SaveUnsigned(io, rule->startCurrentTimeBucket);
             RedisModule_SaveUnsigned(io, rule->validSamplesInBucket);
+            RedisModule_SaveUnsigned(io, rule->watermark);
             rule->aggClass->writeContext(rule->aggContext, io);
             rule = rule->nextRule;
         }
@@ -9,6 +9,7 @@
 
 #include "reply.h"
 
+#include "endianconv.h"
 #include "enriched_chunk.h"
 #include "query_language.h"
 #include "sample_iterator.h"
@@ -21,6 +22,7 @@
 #include "rmutil/alloc.h"
 
 #include <math.h> // NAN
+#include <string.h>
 
 // MRANGE reply structure element counts
 #define MRANGE_RESP2_ENTRY_ELEMENTS 3   // [name, labels, samples]
@@ -160,7 +162,10 @@ AbstractIterator *SeriesQueryIfNonEmpty(Series *series,
                                         const RangeArgs *args,
                                         bool reverse,
                                         EnrichedChunk **first_chunk_out) {
-    AbstractIterator *iter = SeriesQuery(series, args, reverse, true);
+    return IteratorIfNonEmpty(SeriesQuery(series, args, reverse, true), first_chunk_out);
+}
+
+AbstractIterator *IteratorIfNonEmpty(AbstractIterator *iter, EnrichedChunk **first_chunk_out) {
     EnrichedChunk *chunk;
     while ((chunk = iter->GetNext(iter)) != NULL) {
         if (chunk->samples.num_samples > 0) {
@@ -172,10 +177,108 @@ AbstractIterator *SeriesQueryIfNonEmpty(Series *series,
     return NULL;
 }
 
+// FORMAT BINARY: the samples of a series as one bulk string of packed little-endian uint64
+// timestamps and one bulk string of packed little-endian float64 values per aggregator
+typedef struct BinaryColumns
+{
+    uint64_t *timestamps;
+    double *values[TS_AGG_TYPES_MAX];
+    size_t numColumns; // 0 until the first sample
+    size_t len;
+    size_t cap;
+} BinaryColumns;
+
+static void BinaryColumns_Reserve(BinaryColumns *cols, size_t numColumns, size_t n) {
+    if (cols->numColumns == 0) {
+        cols->numColumns = numColumns;
+    }
+    RedisModule_Assert(cols->numColumns == numColumns && numColumns <= TS_AGG_TYPES_MAX);
+    if (cols->len + n <= cols->cap) {
+        return;
+    }
+    cols->cap = max(cols->cap * 2, cols->len + n);
+    cols->timestamps = realloc(cols->timestamps, cols->cap * sizeof(*cols->timestamps));
+    for (size_t a = 0; a < cols->numColumns; a++) {
+        cols->values[a] = realloc(cols->values[a], cols->cap * sizeof(*cols->values[a]));
+    }
+}
+
+static void BinaryColumns_AppendSamples(BinaryColumns *cols, const Samples *samples, size_t n) {
+    const size_t vps = samples->values_per_sample;
+    BinaryColumns_Reserve(cols, vps, n);
+    memcpy(cols->timestamps + cols->len, samples->timestamps, n * sizeof(*cols->timestamps));
+    if (vps == 1) {
+        memcpy(cols->values[0] + cols->len, samples->_values, n * sizeof(*cols->values[0]));
+    } else {
+        for (size_t i = 0; i < n; i++) {
+            for (size_t a = 0; a < vps; a++) {
+                cols->values[a][cols->len + i] = Samples_value_at(samples, i, a);
+            }
+        }
+    }
+    cols->len += n;
+}
+
+static void BinaryColumns_AppendRow(BinaryColumns *cols,
+                                    timestamp_t timestamp,
+                                    const double *row,
+                                    size_t numColumns) {
+    BinaryColumns_Reserve(cols, numColumns, 1);
+    cols->timestamps[cols->len] = timestamp;
+    for (size_t a = 0; a < numColumns; a++) {
+        cols->values[a][cols->len] = row[a];
+    }
+    cols->len++;
+}
+
+// Replies with the columns and frees them. defaultColumns is the number of value columns of a
+// series without samples.
+static void BinaryColumns_Reply(RedisModuleCtx *ctx, BinaryColumns *cols, size_t defaultColumns) {
+    const size_t numColumns = cols->numColumns ?: defaultColumns;
+    RedisModule_ReplyWithArray(ctx, 1 + numColumns);
+    for (size_t i = 0; i < cols->len; i++) {
+        memrev64ifbe(&cols->timestamps[i]);
+    }
+    RedisModule_ReplyWithStringBuffer(
+        ctx, (const char *)cols->timestamps, cols->len * sizeof(*cols->timestamps));
+    for (size_t a = 0; a < numColumns; a++) {
+        for (size_t i = 0; i < cols->len; i++) {
+            memrev64ifbe(&cols->values[a][i]);
+        }
+        RedisModule_ReplyWithStringBuffer(
+            ctx, (const char *)cols->values[a], cols->len * sizeof(*cols->values[a]));
+        free(cols->values[a]);
+    }
+    free(cols->timestamps);
+    *cols = (BinaryColumns){ 0 };
+}
+
+// The samples of a single aggregator are the packed columns already on a little-endian host
+static bool BinaryColumns_IsWireFormat(const Samples *samples) {
+#if (BYTE_ORDER == LITTLE_ENDIAN)
+    return samples->values_per_sample == 1;
+#else
+    REDISMODULE_NOT_USED(samples);
+    return false;
+#endif
+}
+
+// Replies with the first n samples straight from their arrays, see BinaryColumns_IsWireFormat
+static void BinaryColumns_ReplySamples(RedisModuleCtx *ctx, const Samples *samples, size_t n) {
+    RedisModule_ReplyWithArray(ctx, 2);
+    RedisModule_ReplyWithStringBuffer(
+        ctx, (const char *)samples->timestamps, n * sizeof(*samples->timestamps));
+    RedisModule_ReplyWithStringBuffer(
+        ctx, (const char *)samples->_values, n * sizeof(*samples->_values));
+}
+
 int ReplySeriesRangeFromIter(RedisModuleCtx *ctx,
                              AbstractIterator *iter,
                              EnrichedChunk *first_chunk,
                              const RangeArgs *args) {
+    if (args->binaryFormat) {
+        return ReplySeriesRangeBinary(ctx, iter, first_chunk, args);
+    }
     long long arraylen = 0;
     long long _count = (args->count != -1) ? args->count : LLONG_MAX;
     unsigned int n;
@@ -212,6 +315,31 @@ int ReplySeriesRangeFromIter(RedisModuleCtx *ctx,
     return REDISMODULE_OK;
 }
 
+int ReplySeriesRangeBinary(RedisModuleCtx *ctx,
+                           AbstractIterator *iter,
+                           EnrichedChunk *first_chunk,
+                           const RangeArgs *args) {
+    size_t _count = (args->count != -1) ? args->count : SIZE_MAX;
+    BinaryColumns cols = { 0 };
+    EnrichedChunk *enrichedChunk = first_chunk ?: iter->GetNext(iter);
+    for (; enrichedChunk && cols.len < _count; enrichedChunk = iter->GetNext(iter)) {
+        const size_t n = min(_count - cols.len, enrichedChunk->samples.num_samples);
+        if (cols.len == 0 && n == _count && BinaryColumns_IsWireFormat(&enrichedChunk->samples)) {
+            // the whole reply is in this chunk, which the next GetNext may overwrite
+            BinaryColumns_ReplySamples(ctx, &enrichedChunk->samples, n);
+            iter->Close(iter);
+            return REDISMODULE_OK;
+        }
+        if (n > 0) {
+            BinaryColumns_AppendSamples(&cols, &enrichedChunk->samples, n);
+        }
+    }
+    iter->Close(iter);
+
+    BinaryColumns_Reply(ctx, &cols, max(args->aggregationArgs.numClasses, 1));
+    return REDISMODULE_OK;
+}
+
 int ReplySeriesRange(RedisModuleCtx *ctx, Series *series, const RangeArgs *args, bool reverse) {
     return ReplySeriesRangeFromIter(ctx, SeriesQuery(series, args, reverse, true), NULL, args);
 }
@@ -335,7 +463,10 @@ int ReplyMultiAggSeriesGroup(RedisModuleCtx *ctx,
             SeriesQuery(group[aggIdx], &rawArgs, rev, true));
 
     long long limit = (args->count != -1) ? args->count : LLONG_MAX;
-    RedisModule_ReplyWithArray(ctx, REDISMODULE_POSTPONED_ARRAY_LEN);
+    BinaryColumns cols = { 0 };
+    if (!args->binaryFormat) {
+        RedisModule_ReplyWithArray(ctx, REDISMODULE_POSTPONED_ARRAY_LEN);
+    }
     long long emitted = 0;
     Sample lead;
     double row[TS_AGG_TYPES_MAX];
@@ -346,10 +477,18 @@ int ReplyMultiAggSeriesGroup(RedisModuleCtx *ctx,
             iters[aggIdx]->GetNext(iters[aggIdx], &s);
             row[aggIdx] = s.value;
         }
-        ReplyWithMultiAggSample(ctx, lead.timestamp, row, numAggTypes);
+        if (args->binaryFormat) {
+            BinaryColumns_AppendRow(&cols, lead.timestamp, row, numAggTypes);
+        } else {
+            ReplyWithMultiAggSample(ctx, lead.timestamp, row, numAggTypes);
+        }
         emitted++;
     }
-    RedisModule_ReplySetArrayLength(ctx, emitted);
+    if (args->binaryFormat) {
+        BinaryColumns_Reply(ctx, &cols, numAggTypes);
+    } else {
+        RedisModule_ReplySetArrayLength(ctx, emitted);
+    }
 
     for (size_t aggIdx = 0; aggIdx < numAggTypes; aggIdx++)
         iters[aggIdx]->Close(iters[aggIdx]);
@@ -383,7 +522,8 @@ int ReplySeriesNRange(RedisModuleCtx *ctx,
                       size_t num_keys,
                       const size_t *aggs_per_key,
                       long long count,
-                      bool reverse) {
+                      bool reverse,
+                      const Expr *expr) {
     const long long limit = (count < 0) ? LLONG_MAX : count;
 
     // Per-key chunk state for the k-way merge.
@@ -400,7 +540,19 @@ int ReplySeriesNRange(RedisModuleCtx *ctx,
         key_row_offset[i] = row_width;
         row_width += aggs_per_key[i];
     }
-    double *row_buf = malloc(row_width * sizeof(*row_buf)); // scratch buffer for one output row
+    double *row_buf = NULL; // scratch buffer for one output row
+    // With EXPR the rows are gathered by columns, and the expression evaluated once per batch
+    timestamp_t *batch_ts = NULL;
+    double *batch = NULL;
+    double *stack = NULL;
+    size_t batch_len = 0;
+    if (expr) {
+        batch_ts = malloc(EXPR_BATCH_SIZE * sizeof(*batch_ts));
+        batch = malloc(row_width * EXPR_BATCH_SIZE * sizeof(*batch));
+        stack = malloc(expr->stackDepth * EXPR_BATCH_SIZE * sizeof(*stack));
+    } else {
+        row_buf = malloc(row_width * sizeof(*row_buf));
+    }
 
     size_t active_count = 0;
     for (size_t i = 0; i < num_keys; i++) {
@@ -432,11 +584,13 @@ int ReplySeriesNRange(RedisModuleCtx *ctx,
         // Build the pivoted row. A missing sample for a key at this timestamp is reported as
         // NaN -- indistinguishable from a key that has a real NaN sample. This conflation is
         // intended (see TS.NRANGE/TS.NREVRANGE docs); disambiguating needs a separate null cell.
+        double *row = expr ? batch + batch_len : row_buf;
+        const size_t stride = expr ? EXPR_BATCH_SIZE : 1;
         for (size_t i = 0; i < num_keys; i++) {
-            double *slot = row_buf + key_row_offset[i];
+            double *slot = row + key_row_offset[i] * stride;
             if (key_active[i] && key_chunks[i]->samples.timestamps[chunk_pos[i]] == target) {
                 for (size_t j = 0; j < aggs_per_key[i]; j++) {
-                    slot[j] = Samples_value_at(&key_chunks[i]->samples, chunk_pos[i], j);
+                    slot[j * stride] = Samples_value_at(&key_chunks[i]->samples, chunk_pos[i], j);
                 }
                 chunk_pos[i]++;
                 if (chunk_pos[i] >= key_chunks[i]->samples.num_samples) {
@@ -450,13 +604,24 @@ int ReplySeriesNRange(RedisModuleCtx *ctx,
                 }
             } else {
                 for (size_t j = 0; j < aggs_per_key[i]; j++) {
-                    slot[j] = NAN;
+                    slot[j * stride] = NAN;
                 }
             }
         }
-
-        ReplyWithPivotSample(ctx, target, row_buf, row_width);
         emitted++;
+
+        if (!expr) {
+            ReplyWithPivotSample(ctx, target, row_buf, row_width);
+            continue;
+        }
+        batch_ts[batch_len++] = target;
+        if (batch_len == EXPR_BATCH_SIZE || active_count == 0 || emitted == limit) {
+            Expr_Eval(expr, batch, batch_len, stack);
+            for (size_t r = 0; r < batch_len; r++) {
+                ReplyWithSample(ctx, batch_ts[r], stack[r]);
+            }
+            batch_len = 0;
+        }
     }
 
     RedisModule_ReplySetArrayLength(ctx, emitted);
@@ -469,6 +634,9 @@ int ReplySeriesNRange(RedisModuleCtx *ctx,
     free(key_active);
     free(key_row_offset);
     free(row_buf);
+    free(batch_ts);
+    free(batch);
+    free(stack);
     return REDISMODULE_OK;
 }
 
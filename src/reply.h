@@ -10,6 +10,7 @@
 #ifndef REDISTIMESERIES_REPLY_H
 #define REDISTIMESERIES_REPLY_H
 
+#include "expr.h"
 #include "generic_chunk.h"
 #include "query_language.h"
 #include "tsdb.h"
@@ -50,12 +51,20 @@ AbstractIterator *SeriesQueryIfNonEmpty(Series *series,
                                         const RangeArgs *args,
                                         bool reverse,
                                         EnrichedChunk **first_chunk_out);
+// Closes iter and returns NULL when it has no samples, like SeriesQueryIfNonEmpty
+AbstractIterator *IteratorIfNonEmpty(AbstractIterator *iter, EnrichedChunk **first_chunk_out);
 
 int ReplySeriesRange(RedisModuleCtx *ctx, Series *series, const RangeArgs *args, bool rev);
 int ReplySeriesRangeFromIter(RedisModuleCtx *ctx,
                              AbstractIterator *iter,
                              EnrichedChunk *first_chunk,
                              const RangeArgs *args);
+// FORMAT BINARY: [timestamps, values...] as bulk strings of packed little-endian uint64 and
+// float64, one values column per aggregator
+int ReplySeriesRangeBinary(RedisModuleCtx *ctx,
+                           AbstractIterator *iter,
+                           EnrichedChunk *first_chunk,
+                           const RangeArgs *args);
 
 // Reply one pivoted row: [timestamp, [value_0, value_1, ..., value_{num_values-1}]].
 void ReplyWithPivotSample(RedisModuleCtx *ctx,
@@ -65,14 +74,16 @@ void ReplyWithPivotSample(RedisModuleCtx *ctx,
 
 // Merge num_keys time-ordered per-key chunk iterators into a timestamp-major reply (one row per
 // distinct timestamp, NaN where a key has no sample). aggs_per_key[i] is the number of aggregation
-// values key i contributes per row. Each row is flat: [ts, [v0, v1, ...]].
+// values key i contributes per row. Each row is flat: [ts, [v0, v1, ...]], or [ts, value] with
+// the value of expr over the row when it is not NULL.
 // Consumes and closes each iterator.
 int ReplySeriesNRange(RedisModuleCtx *ctx,
                       AbstractIterator **iters,
                       size_t num_keys,
                       const size_t *aggs_per_key,
                       long long count,
-                      bool reverse);
+                      bool reverse,
+                      const Expr *expr);
 
 void ReplyWithSeriesLabels(RedisModuleCtx *ctx, const Series *series);
 void ReplyWithSeriesLabelsWithLimit(RedisModuleCtx *ctx,
@@ -84,6 +95,7 @@ void ReplyWithSeriesLabelsWithLimitC(RedisModuleCtx *ctx,
                                      const char **limitLabels,
                                      uint16_t limitLabelsSize);
 
+int ReplyWithDoubleOrString(RedisModuleCtx *ctx, double d);
 void ReplyWithSample(RedisModuleCtx *ctx, uint64_t timestamp, double value);
 void ReplyWithMultiAggSample(RedisModuleCtx *ctx,
                              uint64_t timestamp,
@@ -9,6 +9,7 @@
 
 #include "resultset.h"
 
+#include "compaction.h"
 #include "indexer.h"
 #include "reply.h"
 #include "series_iterator.h"
@@ -18,6 +19,7 @@
 
 #include "RedisModulesSDK/redismodule.h"
 #include "utils/arr.h"
+#include <math.h>
 #include "rmutil/alloc.h"
 
 struct TS_ResultSet
@@ -31,6 +33,7 @@ typedef struct TS_GroupList
     char *labelValue;
     size_t count;
     Series **list;
+    PartialGroup *partial; // the partial states of the shards, instead of the list (cluster only)
 } TS_GroupList;
 
 TS_GroupList *GroupList_Create();
@@ -78,6 +81,7 @@ TS_GroupList *GroupList_Create() {
     g->count = 0;
     g->labelValue = NULL;
     g->list = NULL;
+    g->partial = NULL;
     return g;
 }
 
@@ -88,6 +92,7 @@ void GroupList_Free(TS_GroupList *groupList) {
     free(groupList->labelValue);
     if (groupList->list)
         free(groupList->list);
+    PartialGroup_Free(groupList->partial);
     free(groupList);
 }
 
@@ -142,6 +147,206 @@ Label *createReducedSeriesLabels(RedisModuleCtx *ctx,
     return labels;
 }
 
+size_t ReducerPartial_NumValues(TS_AGG_TYPES_T type) {
+    switch (type) {
+        case TS_AGG_SUM:
+        case TS_AGG_AVG:
+        case TS_AGG_MIN:
+        case TS_AGG_MAX:
+            return 1;
+        case TS_AGG_RANGE:
+        case TS_AGG_STD_P:
+        case TS_AGG_STD_S:
+        case TS_AGG_VAR_P:
+        case TS_AGG_VAR_S:
+            return 2;
+        default:
+            // the count reducers
+            return 0;
+    }
+}
+
+static void ReducerPartial_Add(TS_AGG_TYPES_T type, ReducerPartial *partial, double value) {
+    // the first value initializes min and max
+    const bool first = partial->count++ == 0;
+    double *values = partial->values;
+    if (AggTypeQuantile(type) > 0) {
+        if (first) {
+            partial->sketch = malloc(sizeof(*partial->sketch));
+            QuantileSketch_Init(partial->sketch);
+        }
+        QuantileSketch_Add(partial->sketch, value);
+        return;
+    }
+    switch (type) {
+        case TS_AGG_SUM:
+        case TS_AGG_AVG:
+            values[0] += value;
+            break;
+        case TS_AGG_STD_P:
+        case TS_AGG_STD_S:
+        case TS_AGG_VAR_P:
+        case TS_AGG_VAR_S:
+            values[0] += value;
+            values[1] += value * value;
+            break;
+        case TS_AGG_MIN:
+            values[0] = first ? value : min(values[0], value);
+            break;
+        case TS_AGG_MAX:
+            values[0] = first ? value : max(values[0], value);
+            break;
+        case TS_AGG_RANGE:
+            values[0] = first ? value : min(values[0], value);
+            values[1] = first ? value : max(values[1], value);
+            break;
+        default:
+            break;
+    }
+}
+
+static void ReducerPartial_Free(ReducerPartial *partial) {
+    if (partial->sketch) {
+        QuantileSketch_Reset(partial->sketch);
+        free(partial->sketch);
+        partial->sketch = NULL;
+    }
+}
+
+// Merges src into dest, taking the ownership of the sketch of src
+static void ReducerPartial_Merge(TS_AGG_TYPES_T type, ReducerPartial *dest, ReducerPartial *src) {
+    if (src->count == 0) {
+        ReducerPartial_Free(src);
+        return;
+    }
+    if (dest->count == 0) {
+        ReducerPartial_Free(dest);
+        *dest = *src;
+        return;
+    }
+    dest->count += src->count;
+    if (dest->sketch && src->sketch) {
+        QuantileSketch_Merge(dest->sketch, src->sketch);
+        ReducerPartial_Free(src);
+        return;
+    }
+    switch (type) {
+        case TS_AGG_SUM:
+        case TS_AGG_AVG:
+        case TS_AGG_STD_P:
+        case TS_AGG_STD_S:
+        case TS_AGG_VAR_P:
+        case TS_AGG_VAR_S:
+            dest->values[0] += src->values[0];
+            dest->values[1] += src->values[1];
+            break;
+        case TS_AGG_MIN:
+            dest->values[0] = min(dest->values[0], src->values[0]);
+            break;
+        case TS_AGG_MAX:
+            dest->values[0] = max(dest->values[0], src->values[0]);
+            break;
+        case TS_AGG_RANGE:
+            dest->values[0] = min(dest->values[0], src->values[0]);
+            dest->values[1] = max(dest->values[1], src->values[1]);
+            break;
+        default:
+            break;
+    }
+}
+
+static double ReducerPartial_Finalize(TS_AGG_TYPES_T type, const ReducerPartial *partial) {
+    const double count = partial->count;
+    const double *values = partial->values;
+    if (type == TS_AGG_COUNT || type == TS_AGG_COUNT_NAN || type == TS_AGG_COUNT_ALL) {
+        return count;
+    }
+    if (count == 0) {
+        // no valid input, see MultiSeriesAggDupSampleIterator_GetNext
+        return NAN;
+    }
+    if (partial->sketch) {
+        return QuantileSketch_Quantile(partial->sketch, AggTypeQuantile(type));
+    }
+    switch (type) {
+        case TS_AGG_AVG:
+            return values[0] / count;
+        case TS_AGG_RANGE:
+            return values[1] - values[0];
+        case TS_AGG_VAR_P:
+            return VarianceFromSums(values[0], values[1], count);
+        case TS_AGG_STD_P:
+            return sqrt(VarianceFromSums(values[0], values[1], count));
+        case TS_AGG_VAR_S:
+        case TS_AGG_STD_S: {
+            const double var = count == 1 ? 0
+                                          : VarianceFromSums(values[0], values[1], count) *
+                                                count / (count - 1);
+            return type == TS_AGG_VAR_S ? var : sqrt(var);
+        }
+        default:
+            // sum, min, max
+            return values[0];
+    }
+}
+
+void PartialGroup_Free(PartialGroup *group) {
+    if (!group)
+        return;
+    for (size_t i = 0; i < group->keysCount; i++) {
+        RedisModule_FreeString(NULL, group->keys[i]);
+    }
+    free(group->keys);
+    for (size_t i = 0; i < group->count; i++) {
+        ReducerPartial_Free(&group->partials[i]);
+    }
+    free(group->timestamps);
+    free(group->partials);
+    free(group->labelValue);
+    free(group);
+}
+
+// Merges src into dest, both sorted by timestamp, moving the keys and the partials of src to dest
+static void PartialGroup_Merge(PartialGroup *dest, PartialGroup *src, TS_AGG_TYPES_T reducer) {
+    dest->keys = realloc(dest->keys, (dest->keysCount + src->keysCount) * sizeof(*dest->keys));
+    memcpy(dest->keys + dest->keysCount, src->keys, src->keysCount * sizeof(*src->keys));
+    dest->keysCount += src->keysCount;
+    src->keysCount = 0;
+
+    const size_t capacity = max(dest->count + src->count, 1);
+    timestamp_t *timestamps = malloc(capacity * sizeof(*timestamps));
+    ReducerPartial *partials = malloc(capacity * sizeof(*partials));
+    size_t i = 0, j = 0, n = 0;
+    while (i < dest->count || j < src->count) {
+        if (j == src->count || (i < dest->count && dest->timestamps[i] < src->timestamps[j])) {
+            timestamps[n] = dest->timestamps[i];
+            partials[n++] = dest->partials[i++];
+        } else if (i == dest->count || src->timestamps[j] < dest->timestamps[i]) {
+            timestamps[n] = src->timestamps[j];
+            partials[n++] = src->partials[j++];
+        } else {
+            timestamps[n] = dest->timestamps[i];
+            partials[n] = dest->partials[i++];
+            ReducerPartial_Merge(reducer, &partials[n++], &src->partials[j++]);
+        }
+    }
+    free(dest->timestamps);
+    free(dest->partials);
+    dest->timestamps = timestamps;
+    dest->partials = partials;
+    dest->count = n;
+    src->count = 0;
+}
+
+static void PartialGroup_Finalize(Series *dest,
+                                  const PartialGroup *group,
+                                  TS_AGG_TYPES_T reducer) {
+    for (size_t i = 0; i < group->count; i++) {
+        SeriesAddSample(
+            dest, group->timestamps[i], ReducerPartial_Finalize(reducer, &group->partials[i]));
+    }
+}
+
 TS_ResultSet *ResultSet_Create() {
     TS_ResultSet *r = malloc(sizeof(TS_ResultSet));
     r->groups = RedisModule_CreateDict(NULL);
@@ -191,29 +396,33 @@ void GroupList_ApplyReducer(RedisModuleCtx *ctx,
         // abuse srckey to store the source keys
         reduced->srcKey = (RedisModuleString *)array_new(RedisModuleString *, 1);
     }
-    Series *source = NULL;
-
-    MultiSeriesReduce(reduced, group->list, group->count, groupByReducerArgs, args);
+    const PartialGroup *partial = group->partial;
+    if (partial) {
+        PartialGroup_Finalize(reduced, partial, groupByReducerArgs->agg_type);
+    } else {
+        MultiSeriesReduce(reduced, group->list, group->count, groupByReducerArgs, args);
+    }
 
     // prepare labels
-    for (int i = 0; i < group->count; i++) {
-        source = group->list[i];
+    const size_t n_sources = partial ? partial->keysCount : group->count;
+    for (int i = 0; i < n_sources; i++) {
+        RedisModuleString *source = partial ? partial->keys[i] : group->list[i]->keyName;
 
         size_t keyLen = 0;
-        const char *keyname = RedisModule_StringPtrLen(source->keyName, &keyLen);
+        const char *keyname = RedisModule_StringPtrLen(source, &keyLen);
         RedisModule_StringAppendBuffer(NULL, labels[2].value, keyname, keyLen);
         // check if its the last item in the group, if not append a comma
-        if (i < group->count - 1) {
+        if (i < n_sources - 1) {
             RedisModule_StringAppendBuffer(NULL, labels[2].value, ",", 1);
         }
         if (_ReplyMap(ctx)) {
             RedisModuleString **keys_array = (RedisModuleString **)reduced->srcKey;
-            array_append(keys_array, source->keyName);
+            array_append(keys_array, source);
             reduced->srcKey = (RedisModuleString *)keys_array;
         }
     }
-    group->list[0] = reduced;
-    group->count = 1;
+    group->count = 0;
+    GroupList_AddSeries(group, reduced, NULL);
 
     // replace labels
     FreeLabels(reduced->labels, reduced->labelsCount);
@@ -241,6 +450,83 @@ bool ResultSet_AddSeries(TS_ResultSet *r, Series *series, const char *name) {
     return true;
 }
 
+void ResultSet_AddPartialGroup(TS_ResultSet *r, PartialGroup *group, TS_AGG_TYPES_T reducer) {
+    const size_t labelLen = strlen(group->labelValue);
+    int nokey;
+    TS_GroupList *labelGroup =
+        RedisModule_DictGetC(r->groups, group->labelValue, labelLen, &nokey);
+    if (nokey) {
+        labelGroup = GroupList_Create();
+        GroupList_SetLabelValue(labelGroup, group->labelValue);
+        RedisModule_DictSetC(r->groups, group->labelValue, labelLen, labelGroup);
+    }
+
+    if (!labelGroup->partial) {
+        labelGroup->partial = group;
+        return;
+    }
+    PartialGroup_Merge(labelGroup->partial, group, reducer);
+    PartialGroup_Free(group);
+}
+
+void ResultSet_ReplyPartialReduce(RedisModuleCtx *ctx,
+                                  TS_ResultSet *r,
+                                  const RangeArgs *args,
+                                  const ReducerArgs *groupByReducerArgs) {
+    const TS_AGG_TYPES_T reducer = groupByReducerArgs->agg_type;
+    const AggregationClass *aggregation = groupByReducerArgs->aggregationClass;
+    const size_t numValues = ReducerPartial_NumValues(reducer);
+
+    RedisModuleDictIter *iter = RedisModule_DictIteratorStartC(r->groups, "^", NULL, 0);
+    RedisModule_ReplyWithArray(ctx, RedisModule_DictSize(r->groups));
+    TS_GroupList *group;
+    while (RedisModule_DictNextC(iter, NULL, (void **)&group) != NULL) {
+        RedisModule_ReplyWithArray(ctx, 3);
+        RedisModule_ReplyWithStringBuffer(ctx, group->labelValue, strlen(group->labelValue));
+        RedisModule_ReplyWithArray(ctx, group->count);
+        for (size_t i = 0; i < group->count; i++) {
+            RedisModule_ReplyWithString(ctx, group->list[i]->keyName);
+        }
+
+        double *values = malloc(group->count * sizeof(*values));
+        AbstractMultiSeriesSampleIterator *iterator =
+            MultiSeriesCreateSampleIterator(group->list, group->count, args, false, true);
+        RedisModule_ReplyWithArray(ctx, REDISMODULE_POSTPONED_ARRAY_LEN);
+        long long rows = 0;
+        timestamp_t timestamp;
+        size_t n;
+        while ((n = iterator->GetNextRun(iterator, &timestamp, values)) > 0) {
+            ReducerPartial partial = { 0 };
+            for (size_t i = 0; i < n; i++) {
+                if (aggregation->isValueValid(values[i])) {
+                    ReducerPartial_Add(reducer, &partial, values[i]);
+                }
+            }
+            RedisModule_ReplyWithArray(ctx, 2 + numValues + (partial.sketch ? 1 : 0));
+            RedisModule_ReplyWithLongLong(ctx, timestamp);
+            RedisModule_ReplyWithLongLong(ctx, partial.count);
+            for (size_t v = 0; v < numValues; v++) {
+                ReplyWithDoubleOrString(ctx, partial.values[v]);
+            }
+            if (partial.sketch) {
+                size_t len;
+                char *encoded = QuantileSketch_Encode(partial.sketch, &len);
+                RedisModule_ReplyWithStringBuffer(ctx, encoded, len);
+                free(encoded);
+                ReducerPartial_Free(&partial);
+            }
+            rows++;
+        }
+        RedisModule_ReplySetArrayLength(ctx, rows);
+        iterator->Close(iterator);
+        free(values);
+
+        // the members are the series themselves, not temporary copies
+        group->count = 0;
+    }
+    RedisModule_DictIteratorStop(iter);
+}
+
 void replyResultSet(RedisModuleCtx *ctx,
                     TS_ResultSet *r,
                     bool withlabels,
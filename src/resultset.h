@@ -7,6 +7,7 @@
  * GNU Affero General Public License v3 (AGPLv3).
  */
 #include "consts.h"
+#include "quantile_sketch.h"
 #include "query_language.h"
 #include "tsdb.h"
 
@@ -41,6 +42,51 @@ void replyResultSet(RedisModuleCtx *ctx,
 
 void ResultSet_Free(TS_ResultSet *r);
 
+/*
+ * Clustered GROUPBY/REDUCE.
+ *
+ * Every shard reduces its own members of a group to one partial state per timestamp, and the
+ * coordinator merges the partial states of all the shards before finalizing the reducer. The
+ * traffic and the work of the coordinator then depend on the number of groups, not of series.
+ */
+
+#define REDUCER_PARTIAL_MAX_VALUES 2
+
+typedef struct ReducerPartial
+{
+    uint64_t count; // number of values valid for the reducer
+    // sum for sum/avg, sum and sum of squares for std/var, min and/or max for min/max/range
+    double values[REDUCER_PARTIAL_MAX_VALUES];
+    // the values of a quantile reducer, replied by the shards as an encoded sketch
+    QuantileSketch *sketch;
+} ReducerPartial;
+
+typedef struct PartialGroup
+{
+    char *labelValue;
+    RedisModuleString **keys; // the members of the group
+    size_t keysCount;
+    timestamp_t *timestamps;
+    ReducerPartial *partials; // a partial state per timestamp
+    size_t count;
+} PartialGroup;
+
+// The number of ReducerPartial.values used by the reducer
+size_t ReducerPartial_NumValues(TS_AGG_TYPES_T type);
+
+void PartialGroup_Free(PartialGroup *group);
+
+// Shard side: replies with an array of [label value, [keys], [[timestamp, count, values...]]],
+// where the values of a quantile reducer are a single encoded sketch
+void ResultSet_ReplyPartialReduce(RedisModuleCtx *ctx,
+                                  TS_ResultSet *r,
+                                  const RangeArgs *args,
+                                  const ReducerArgs *groupByReducerArgs);
+
+// Coordinator side: merges the group into the result set, taking its ownership. The groups are
+// then finalized by ResultSet_ApplyReducer.
+void ResultSet_AddPartialGroup(TS_ResultSet *r, PartialGroup *group, TS_AGG_TYPES_T reducer);
+
 void MultiSeriesReduce(Series *dest,
                        Series **series,
                        size_t n_series,
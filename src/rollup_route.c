@@ -0,0 +1,329 @@
+/*
+ * Copyright (c) 2006-Present, Redis Ltd.
+ * All rights reserved.
+ *
+ * Licensed under your choice of (a) the Redis Source Available License 2.0
+ * (RSALv2); or (b) the Server Side Public License v1 (SSPLv1); or (c) the
+ * GNU Affero General Public License v3 (AGPLv3).
+ */
+#include "rollup_route.h"
+
+#include "async_compaction.h"
+#include "backfill.h"
+#include "compaction.h"
+#include "config.h"
+#include "enriched_chunk.h"
+#include "filter_iterator.h"
+#include "window_iterator.h"
+
+#include "rmutil/alloc.h"
+
+#define ROLLUP_AVG_CHUNK_SIZE 256
+
+// The rules read for a query, and how their buckets are rolled up
+typedef struct RollupRules
+{
+    CompactionRule *rules[2];
+    size_t numRules;
+    TS_AGG_TYPES_T rollupType;
+} RollupRules;
+
+// The aggregators whose buckets depend on their own samples only
+static bool aggTypeIsLocal(TS_AGG_TYPES_T aggType) {
+    return !AggTypeUsesBucketEdges(aggType);
+}
+
+// The buckets of the query are made of whole buckets of rule
+static bool ruleFits(const CompactionRule *rule, timestamp_t duration, timestamp_t alignment) {
+    return duration % rule->bucketDuration == 0 &&
+           modulo(alignment - rule->timestampAlignment, rule->bucketDuration) == 0;
+}
+
+static CompactionRule *findRule(Series *series,
+                                TS_AGG_TYPES_T aggType,
+                                timestamp_t bucketDuration,
+                                timestamp_t timestampAlignment) {
+    for (CompactionRule *rule = series->rules; rule != NULL; rule = rule->nextRule) {
+        if (rule->aggType == aggType && rule->bucketDuration == bucketDuration &&
+            modulo(rule->timestampAlignment - timestampAlignment, bucketDuration) == 0) {
+            return rule;
+        }
+    }
+    return NULL;
+}
+
+// How the buckets of the query are rolled up from the ones of rule, false when they can't be
+static bool ruleRollupType(const CompactionRule *rule,
+                           TS_AGG_TYPES_T aggType,
+                           timestamp_t duration,
+                           TS_AGG_TYPES_T *rollupType) {
+    if (rule->aggType == aggType && rule->bucketDuration == duration && aggTypeIsLocal(aggType)) {
+        // a bucket of the rule per bucket of the query
+        *rollupType = TS_AGG_LAST;
+        return true;
+    }
+    switch (aggType) {
+        case TS_AGG_MIN:
+        case TS_AGG_MAX:
+        case TS_AGG_SUM:
+        case TS_AGG_FIRST:
+        case TS_AGG_LAST:
+            *rollupType = aggType;
+            return rule->aggType == aggType;
+        case TS_AGG_COUNT:
+        case TS_AGG_COUNT_NAN:
+        case TS_AGG_COUNT_ALL:
+            *rollupType = TS_AGG_SUM;
+            return rule->aggType == aggType;
+        case TS_AGG_AVG:
+            // along with a count rule of the same buckets
+            *rollupType = TS_AGG_SUM;
+            return rule->aggType == TS_AGG_SUM;
+        default:
+            return false;
+    }
+}
+
+// The rules with the largest buckets the query can be rolled up from
+static bool pickRules(Series *series,
+                      TS_AGG_TYPES_T aggType,
+                      timestamp_t duration,
+                      timestamp_t alignment,
+                      RollupRules *picked) {
+    picked->numRules = 0;
+    for (CompactionRule *rule = series->rules; rule != NULL; rule = rule->nextRule) {
+        TS_AGG_TYPES_T rollupType;
+        if (!ruleFits(rule, duration, alignment) ||
+            (picked->numRules > 0 && rule->bucketDuration <= picked->rules[0]->bucketDuration) ||
+            !ruleRollupType(rule, aggType, duration, &rollupType)) {
+            continue;
+        }
+        CompactionRule *countRule = NULL;
+        if (aggType == TS_AGG_AVG && rule->aggType == TS_AGG_SUM) {
+            countRule =
+                findRule(series, TS_AGG_COUNT, rule->bucketDuration, rule->timestampAlignment);
+            if (countRule == NULL) {
+                continue;
+            }
+        }
+        picked->rules[0] = rule;
+        picked->rules[1] = countRule;
+        picked->numRules = countRule ? 2 : 1;
+        picked->rollupType = rollupType;
+    }
+    return picked->numRules > 0;
+}
+
+// The first bucket of the query, starting at or after ts
+static timestamp_t bucketCeil(timestamp_t ts, timestamp_t duration, timestamp_t alignment) {
+    const timestamp_t bucketStart = CalcBucketStart(ts, duration, alignment);
+    return bucketStart == ts ? ts : bucketStart + duration;
+}
+
+bool RollupRoute_MayApply(const RangeArgs *args) {
+    return TSGlobalConfig.rollupRouting && args->aggregationArgs.numClasses == 1 &&
+           !args->aggregationArgs.empty && !args->skipAggregation &&
+           !args->filterByValueArgs.hasValue && !args->filterByTSArgs.hasValue &&
+           aggTypeIsLocal(args->aggregationArgs.classes[0]->type);
+}
+
+bool RollupRoute_Plan(RedisModuleCtx *ctx,
+                      Series *series,
+                      const RangeArgs *args,
+                      RollupRoute *route) {
+    if (!RollupRoute_MayApply(args) || series->rules == NULL || series->totalSamples == 0 ||
+        (args->latest && series->srcKey) || AsyncCompaction_HasPending(series)) {
+        return false;
+    }
+
+    const TS_AGG_TYPES_T aggType = args->aggregationArgs.classes[0]->type;
+    const timestamp_t duration = args->aggregationArgs.timeDelta;
+    const timestamp_t alignment = RangeArgs_Alignment(args);
+    RollupRules picked;
+    if (!pickRules(series, aggType, duration, alignment, &picked)) {
+        return false;
+    }
+
+    // The buckets of the query before the compaction holds every bucket are read from the
+    // series, as is the one of its last sample
+    timestamp_t effStart = args->startTimestamp;
+    if (series->retentionTime > 0 && series->lastTimestamp > series->retentionTime) {
+        effStart = max(effStart, series->lastTimestamp - series->retentionTime);
+    }
+    timestamp_t start = bucketCeil(effStart, duration, alignment);
+    const timestamp_t tailFrom = min((timestamp_t)args->endTimestamp, series->lastTimestamp);
+    const timestamp_t end = CalcBucketStart(tailFrom, duration, alignment);
+    if (end > tailFrom || start >= end) {
+        return false;
+    }
+
+    route->numRollups = 0;
+    for (size_t i = 0; i < picked.numRules; i++) {
+        const CompactionRule *rule = picked.rules[i];
+        const BackfillJob *job = Backfill_GetJob(ctx, rule->destKey);
+        RedisModuleKey *key;
+        Series *dest;
+        if ((job && job->status == BackfillJob_Running) ||
+            GetSeries(ctx,
+                      rule->destKey,
+                      &key,
+                      &dest,
+                      REDISMODULE_READ,
+                      GetSeriesFlags_CheckForAcls | GetSeriesFlags_SilentOperation) !=
+                GetSeriesResult_Success) {
+            RollupRoute_Close(route);
+            return false;
+        }
+        route->keys[route->numRollups] = key;
+        route->rollups[route->numRollups++] = dest;
+        if (dest->totalSamples == 0) {
+            RollupRoute_Close(route);
+            return false;
+        }
+        // The buckets before the watermark of the rule may be partial or missing, when the rule
+        // was created after the samples, even if an older bucket was written since by an upsert.
+        // Those before the first one of the compaction were lost to its retention.
+        const timestamp_t destFirst = getFirstValidTimestamp(dest, NULL);
+        start = max(start, bucketCeil(rule->watermark, duration, alignment));
+        start = max(start, bucketCeil(destFirst, duration, alignment));
+    }
+    if (start >= end) {
+        RollupRoute_Close(route);
+        return false;
+    }
+
+    route->series = series;
+    route->args = *args;
+    route->args.latest = false;
+    route->args.alignment = TimestampAlignment;
+    route->args.timestampAlignment = alignment;
+    route->window = args->window;
+    route->args.window.type = WINDOW_NONE;
+    route->start = start;
+    route->end = end - 1;
+    route->rollupClass = GetAggClass(picked.rollupType);
+    return true;
+}
+
+void RollupRoute_Close(RollupRoute *route) {
+    for (size_t i = 0; i < route->numRollups; i++) {
+        RedisModule_CloseKey(route->keys[i]);
+    }
+    route->numRollups = 0;
+}
+
+// avg, the buckets of the sum compaction divided by the ones of the count compaction
+typedef struct RollupAvgIterator
+{
+    AbstractIterator base;
+    AbstractIterator *count;
+    EnrichedChunk *sumChunk;
+    EnrichedChunk *countChunk;
+    size_t sumIndex;
+    size_t countIndex;
+    bool reverse;
+    EnrichedChunk *out;
+} RollupAvgIterator;
+
+// Returns false when iter has no more samples
+static bool nextSample(AbstractIterator *iter, EnrichedChunk **chunk, size_t *index) {
+    while (*chunk == NULL || *index >= (*chunk)->samples.num_samples) {
+        if ((*chunk = iter->GetNext(iter)) == NULL) {
+            return false;
+        }
+        *index = 0;
+    }
+    return true;
+}
+
+static EnrichedChunk *RollupAvgIterator_GetNextChunk(AbstractIterator *iter) {
+    RollupAvgIterator *self = (RollupAvgIterator *)iter;
+    Samples *out = &self->out->samples;
+    ResetEnrichedChunk(self->out);
+    while (out->num_samples < out->size &&
+           nextSample(self->base.input, &self->sumChunk, &self->sumIndex) &&
+           nextSample(self->count, &self->countChunk, &self->countIndex)) {
+        const timestamp_t sumTS = self->sumChunk->samples.timestamps[self->sumIndex];
+        const timestamp_t countTS = self->countChunk->samples.timestamps[self->countIndex];
+        // a bucket missing from one of the compactions is skipped
+        if (sumTS != countTS) {
+            if ((sumTS < countTS) != self->reverse) {
+                self->sumIndex++;
+            } else {
+                self->countIndex++;
+            }
+            continue;
+        }
+        out->timestamps[out->num_samples] = sumTS;
+        Samples_value_at(out, out->num_samples, 0) =
+            Samples_value_at(&self->sumChunk->samples, self->sumIndex, 0) /
+            Samples_value_at(&self->countChunk->samples, self->countIndex, 0);
+        out->num_samples++;
+        self->sumIndex++;
+        self->countIndex++;
+    }
+    return out->num_samples > 0 ? self->out : NULL;
+}
+
+static void RollupAvgIterator_Close(AbstractIterator *iter) {
+    RollupAvgIterator *self = (RollupAvgIterator *)iter;
+    self->base.input->Close(self->base.input);
+    self->count->Close(self->count);
+    FreeEnrichedChunk(self->out);
+    free(self);
+}
+
+static AbstractIterator *RollupAvgIterator_New(AbstractIterator *sum,
+                                               AbstractIterator *count,
+                                               bool reverse) {
+    RollupAvgIterator *iter = malloc(sizeof(RollupAvgIterator));
+    iter->base.GetNext = RollupAvgIterator_GetNextChunk;
+    iter->base.Close = RollupAvgIterator_Close;
+    iter->base.input = sum;
+    iter->count = count;
+    iter->sumChunk = NULL;
+    iter->countChunk = NULL;
+    iter->sumIndex = 0;
+    iter->countIndex = 0;
+    iter->reverse = reverse;
+    iter->out = NewEnrichedChunk();
+    ReallocSamplesArray(&iter->out->samples, ROLLUP_AVG_CHUNK_SIZE);
+    return (AbstractIterator *)iter;
+}
+
+static AbstractIterator *rawSegment(RollupRoute *route,
+                                    timestamp_t start,
+                                    timestamp_t end,
+                                    bool reverse) {
+    RangeArgs args = route->args;
+    args.startTimestamp = start;
+    args.endTimestamp = end;
+    return SeriesQuery(route->series, &args, reverse, true);
+}
+
+static AbstractIterator *rollupSegment(RollupRoute *route, bool reverse) {
+    RangeArgs args = route->args;
+    args.startTimestamp = route->start;
+    args.endTimestamp = route->end;
+    args.aggregationArgs.classes = &route->rollupClass;
+    AbstractIterator *iters[2];
+    for (size_t i = 0; i < route->numRollups; i++) {
+        iters[i] = SeriesQuery(route->rollups[i], &args, reverse, true);
+    }
+    return route->numRollups == 2 ? RollupAvgIterator_New(iters[0], iters[1], reverse) : iters[0];
+}
+
+AbstractIterator *RollupRoute_Query(RollupRoute *route, bool reverse) {
+    // the raw first buckets, the compactions and the raw last bucket
+    AbstractIterator *head = NULL;
+    if (route->args.startTimestamp < route->start) {
+        head = rawSegment(route, route->args.startTimestamp, route->start - 1, reverse);
+    }
+    AbstractIterator *tail = rawSegment(route, route->end + 1, route->args.endTimestamp, reverse);
+    ConcatIterator *iter = ConcatIterator_New(head, rollupSegment(route, reverse), tail, reverse);
+
+    if (route->window.type != WINDOW_NONE) {
+        return (AbstractIterator *)WindowIterator_New((AbstractIterator *)iter, &route->window);
+    }
+    return (AbstractIterator *)iter;
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2006-Present, Redis Ltd.
+ * All rights reserved.
+ *
+ * Licensed under your choice of (a) the Redis Source Available License 2.0
+ * (RSALv2); or (b) the Server Side Public License v1 (SSPLv1); or (c) the
+ * GNU Affero General Public License v3 (AGPLv3).
+ */
+#ifndef ROLLUP_ROUTE_H
+#define ROLLUP_ROUTE_H
+
+#include "abstract_iterator.h"
+#include "query_language.h"
+#include "tsdb.h"
+
+#include "RedisModulesSDK/redismodule.h"
+
+/*
+ * Rollup routing (ts-rollup-routing)
+ *
+ * An aggregated TS.RANGE/TS.REVRANGE, or ungrouped TS.MRANGE/TS.MREVRANGE, of a series with
+ * compaction rules reads the destination of a rule instead of the raw samples when the buckets of
+ * the query are made of whole buckets of the rule, and the aggregation can be rolled up from them:
+ *
+ * the same aggregator        when the buckets are the same
+ * min, max, sum, first, last from a rule of the same aggregator
+ * count, countNaN, countAll  from a rule of the same aggregator, summed
+ * avg                        from a sum and a count rule
+ *
+ * The rule with the largest buckets is used. The query is split at bucket boundaries of the query:
+ * the buckets before the watermark of the rule (the bucket following the last sample of the source
+ * when the rule was created, or the first sample once a backfill is done), the buckets lost to the
+ * retention of the compaction, and the last bucket, which holds the still open bucket of the rule,
+ * are read from the raw samples.
+ *
+ * FILTER_BY_TS, FILTER_BY_VALUE, EMPTY, multiple aggregators, twa and the counter aggregators
+ * always read the raw samples, as do series with pending asynchronous compactions or a running
+ * backfill, and compactions the user isn't allowed to read.
+ */
+
+typedef struct RollupRoute
+{
+    Series *series;                  // the raw series, for the first and the last buckets
+    RangeArgs args;                  // the query, with its alignment as a timestamp
+    WindowArgs window;               // applied over all the buckets
+    timestamp_t start;               // [start, end] is read from the compactions
+    timestamp_t end;
+    size_t numRollups;               // 2 for avg, from the sum and the count compactions
+    Series *rollups[2];
+    RedisModuleKey *keys[2];
+    AggregationClass *rollupClass;   // rolls the buckets of the compactions up
+} RollupRoute;
+
+// Returns false when args can't be read from the compactions of any series
+bool RollupRoute_MayApply(const RangeArgs *args);
+// Returns true, with the compactions opened, when args can be read from the compactions of series
+bool RollupRoute_Plan(RedisModuleCtx *ctx,
+                      Series *series,
+                      const RangeArgs *args,
+                      RollupRoute *route);
+AbstractIterator *RollupRoute_Query(RollupRoute *route, bool reverse);
+// Closes the compactions, after the iterator of the route was closed
+void RollupRoute_Close(RollupRoute *route);
+
+#endif // ROLLUP_ROUTE_H
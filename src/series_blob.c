@@ -0,0 +1,378 @@
+/*
+ * Copyright (c) 2006-Present, Redis Ltd.
+ * All rights reserved.
+ *
+ * Licensed under your choice of (a) the Redis Source Available License 2.0
+ * (RSALv2); or (b) the Server Side Public License v1 (SSPLv1); or (c) the
+ * GNU Affero General Public License v3 (AGPLv3).
+ */
+#include "series_blob.h"
+
+#include "compressed_chunk.h"
+#include "config.h"
+#include "enriched_chunk.h"
+#include "gorilla.h"
+
+#include <string.h>
+#include <strings.h>
+#include "rmutil/alloc.h"
+
+#define SERIES_BLOB_TAG_END 0
+#define SERIES_BLOB_TAG_SERIES 1
+
+static void blobReserve(SeriesBlob *blob, size_t n) {
+    if (blob->len + n <= blob->cap) {
+        return;
+    }
+    blob->cap = max(blob->cap * 2, blob->len + n);
+    blob->buf = realloc(blob->buf, blob->cap);
+}
+
+static void blobWriteBytes(SeriesBlob *blob, const void *bytes, size_t n) {
+    blobReserve(blob, n);
+    memcpy(blob->buf + blob->len, bytes, n);
+    blob->len += n;
+}
+
+static void blobWriteVarint(SeriesBlob *blob, uint64_t value) {
+    blobReserve(blob, 10);
+    do {
+        uint8_t byte = value & 0x7f;
+        value >>= 7;
+        blob->buf[blob->len++] = byte | (value ? 0x80 : 0);
+    } while (value);
+}
+
+static void blobWriteString(SeriesBlob *blob, const RedisModuleString *str) {
+    size_t len;
+    const char *ptr = RedisModule_StringPtrLen(str, &len);
+    blobWriteVarint(blob, len);
+    blobWriteBytes(blob, ptr, len);
+}
+
+static void blobWriteInterned(SeriesBlob *blob, const RedisModuleString *str) {
+    if (!str) {
+        blobWriteVarint(blob, 0);
+        return;
+    }
+    size_t len;
+    const char *ptr = RedisModule_StringPtrLen(str, &len);
+    int nokey;
+    const uint64_t ref = (uintptr_t)RedisModule_DictGetC(blob->strings, (void *)ptr, len, &nokey);
+    if (!nokey) {
+        blobWriteVarint(blob, ref);
+        return;
+    }
+    blob->numStrings++;
+    RedisModule_DictSetC(blob->strings, (void *)ptr, len, (void *)(uintptr_t)blob->numStrings);
+    blobWriteVarint(blob, blob->numStrings);
+    blobWriteVarint(blob, len);
+    blobWriteBytes(blob, ptr, len);
+}
+
+static void blobWriteChunk(SeriesBlob *blob, CompressedChunk *chunk) {
+    // only the bytes written so far
+    Compressed_ResizeChunk(chunk, 0);
+    blobWriteVarint(blob, chunk->count);
+    blobWriteVarint(blob, chunk->idx);
+    blobWriteBytes(blob, &chunk->baseValue.u, sizeof(chunk->baseValue.u));
+    blobWriteVarint(blob, chunk->baseTimestamp);
+    blobWriteVarint(blob, chunk->prevTimestamp);
+    blobWriteVarint(blob, (uint64_t)chunk->prevTimestampDelta);
+    blobWriteBytes(blob, &chunk->prevValue.u, sizeof(chunk->prevValue.u));
+    blobWriteVarint(blob, chunk->prevLeading);
+    blobWriteVarint(blob, chunk->prevTrailing);
+    blobWriteVarint(blob, chunk->size);
+    blobWriteBytes(blob, chunk->data, chunk->size);
+}
+
+void SeriesBlob_Init(SeriesBlob *blob, size_t numAgg) {
+    *blob = (SeriesBlob){ .numAgg = numAgg, .strings = RedisModule_CreateDict(NULL) };
+    blobWriteBytes(blob, SERIES_BLOB_MAGIC, strlen(SERIES_BLOB_MAGIC));
+    blobWriteVarint(blob, numAgg);
+}
+
+static void blobWriteLabels(SeriesBlob *blob,
+                            const Series *series,
+                            bool withLabels,
+                            RedisModuleString **limitLabels,
+                            uint16_t limitLabelsSize) {
+    if (withLabels) {
+        blobWriteVarint(blob, series->labelsCount);
+        for (size_t i = 0; i < series->labelsCount; i++) {
+            blobWriteInterned(blob, series->labels[i].key);
+            blobWriteInterned(blob, series->labels[i].value);
+        }
+        return;
+    }
+
+    // same as ReplyWithSeriesLabelsWithLimitC
+    blobWriteVarint(blob, limitLabelsSize);
+    for (size_t i = 0; i < limitLabelsSize; i++) {
+        const char *name = RedisModule_StringPtrLen(limitLabels[i], NULL);
+        const Label *label = NULL;
+        for (size_t j = 0; j < series->labelsCount && !label; j++) {
+            if (strcasecmp(RedisModule_StringPtrLen(series->labels[j].key, NULL), name) == 0) {
+                label = &series->labels[j];
+            }
+        }
+        blobWriteInterned(blob, label ? label->key : limitLabels[i]);
+        blobWriteInterned(blob, label ? label->value : NULL);
+    }
+}
+
+void SeriesBlob_AddSeries(SeriesBlob *blob,
+                          const Series *series,
+                          bool withLabels,
+                          RedisModuleString **limitLabels,
+                          uint16_t limitLabelsSize,
+                          AbstractIterator *iter,
+                          EnrichedChunk *first_chunk) {
+    blobWriteVarint(blob, SERIES_BLOB_TAG_SERIES);
+    blobWriteString(blob, series->keyName);
+    blobWriteLabels(blob, series, withLabels, limitLabels, limitLabelsSize);
+
+    const size_t numAgg = blob->numAgg;
+    CompressedChunk **columns[numAgg];
+    size_t numChunks[numAgg];
+    for (size_t a = 0; a < numAgg; a++) {
+        columns[a] = malloc(sizeof(*columns[a]));
+        columns[a][0] = Compressed_NewChunk(SERIES_BLOB_CHUNK_SIZE);
+        numChunks[a] = 1;
+    }
+
+    EnrichedChunk *enrichedChunk = first_chunk ?: iter->GetNext(iter);
+    for (; enrichedChunk; enrichedChunk = iter->GetNext(iter)) {
+        const Samples *samples = &enrichedChunk->samples;
+        RedisModule_Assert(samples->num_samples == 0 || samples->values_per_sample == numAgg);
+        for (size_t i = 0; i < samples->num_samples; i++) {
+            for (size_t a = 0; a < numAgg; a++) {
+                Sample sample = { .timestamp = samples->timestamps[i],
+                                  .value = Samples_value_at(samples, i, a) };
+                CompressedChunk *chunk = columns[a][numChunks[a] - 1];
+                if (Compressed_AddSample(chunk, &sample) == CR_END) {
+                    chunk = Compressed_NewChunk(SERIES_BLOB_CHUNK_SIZE);
+                    columns[a] = realloc(columns[a], (numChunks[a] + 1) * sizeof(*columns[a]));
+                    columns[a][numChunks[a]++] = chunk;
+                    Compressed_AddSample(chunk, &sample);
+                }
+            }
+        }
+    }
+    iter->Close(iter);
+
+    for (size_t a = 0; a < numAgg; a++) {
+        // an empty column has no chunks
+        const size_t n = columns[a][0]->count > 0 ? numChunks[a] : 0;
+        blobWriteVarint(blob, n);
+        for (size_t c = 0; c < n; c++) {
+            blobWriteChunk(blob, columns[a][c]);
+        }
+        for (size_t c = 0; c < numChunks[a]; c++) {
+            Compressed_FreeChunk(columns[a][c]);
+        }
+        free(columns[a]);
+    }
+}
+
+void SeriesBlob_Finish(SeriesBlob *blob, bool more) {
+    blobWriteVarint(blob, SERIES_BLOB_TAG_END);
+    blobWriteVarint(blob, more);
+}
+
+void SeriesBlob_Free(SeriesBlob *blob) {
+    free(blob->buf);
+    RedisModule_FreeDict(NULL, blob->strings);
+    *blob = (SeriesBlob){ 0 };
+}
+
+typedef struct BlobReader
+{
+    const char *buf;
+    size_t len;
+    size_t pos;
+    bool error;
+    RedisModuleString **strings; // the interned strings, a ref k is strings[k - 1]
+    size_t numStrings;
+} BlobReader;
+
+static uint64_t readVarint(BlobReader *reader) {
+    uint64_t value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        if (reader->pos >= reader->len) {
+            break;
+        }
+        const uint8_t byte = reader->buf[reader->pos++];
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return value;
+        }
+    }
+    reader->error = true;
+    return 0;
+}
+
+static const char *readBytes(BlobReader *reader, size_t n) {
+    if (reader->error || n > reader->len - reader->pos) {
+        reader->error = true;
+        return NULL;
+    }
+    const char *bytes = reader->buf + reader->pos;
+    reader->pos += n;
+    return bytes;
+}
+
+static uint64_t readRaw64(BlobReader *reader) {
+    uint64_t value = 0;
+    const char *bytes = readBytes(reader, sizeof(value));
+    if (bytes) {
+        memcpy(&value, bytes, sizeof(value));
+    }
+    return value;
+}
+
+static RedisModuleString *readString(BlobReader *reader) {
+    const size_t len = readVarint(reader);
+    const char *bytes = readBytes(reader, len);
+    return bytes ? RedisModule_CreateString(NULL, bytes, len) : NULL;
+}
+
+// Returns a new reference to the interned string, NULL for a NULL ref or on error
+static RedisModuleString *readInterned(BlobReader *reader) {
+    const uint64_t ref = readVarint(reader);
+    if (reader->error || ref == 0) {
+        return NULL;
+    }
+    if (ref == reader->numStrings + 1) {
+        RedisModuleString *str = readString(reader);
+        if (!str) {
+            return NULL;
+        }
+        reader->strings =
+            realloc(reader->strings, (reader->numStrings + 1) * sizeof(*reader->strings));
+        reader->strings[reader->numStrings++] = str;
+    } else if (ref > reader->numStrings) {
+        reader->error = true;
+        return NULL;
+    }
+    RedisModuleString *str = reader->strings[ref - 1];
+    RedisModule_RetainString(NULL, str);
+    return str;
+}
+
+static CompressedChunk *readChunk(BlobReader *reader) {
+    CompressedChunk chunk = { .refCount = 1 };
+    chunk.count = readVarint(reader);
+    chunk.idx = readVarint(reader);
+    chunk.baseValue.u = readRaw64(reader);
+    chunk.baseTimestamp = readVarint(reader);
+    chunk.prevTimestamp = readVarint(reader);
+    chunk.prevTimestampDelta = (int64_t)readVarint(reader);
+    chunk.prevValue.u = readRaw64(reader);
+    chunk.prevLeading = readVarint(reader);
+    chunk.prevTrailing = readVarint(reader);
+    chunk.size = readVarint(reader);
+    const char *data = readBytes(reader, chunk.size);
+    if (!data || chunk.count == 0 || chunk.size == 0 || chunk.size % sizeof(binary_t) != 0 ||
+        chunk.idx > chunk.size * 8) {
+        reader->error = true;
+        return NULL;
+    }
+
+    CompressedChunk *result = malloc(sizeof(*result));
+    *result = chunk;
+    result->data = malloc(chunk.size);
+    memcpy(result->data, data, chunk.size);
+    return result;
+}
+
+static Series *readColumn(BlobReader *reader, RedisModuleString *name, Label *labels, size_t n) {
+    const uint64_t numChunks = readVarint(reader);
+    CreateCtx cCtx = { .chunkSizeBytes = TSGlobalConfig.chunkSizeBytes,
+                       .options = SERIES_OPT_COMPRESSED_GORILLA,
+                       .duplicatePolicy = DP_NONE,
+                       .labels = labels,
+                       .labelsCount = n,
+                       .skipChunkCreation = !reader->error && numChunks > 0 };
+    Series *series = NewSeries(name, &cCtx);
+
+    for (uint64_t c = 0; c < numChunks && !reader->error; c++) {
+        CompressedChunk *chunk = readChunk(reader);
+        if (!chunk) {
+            break;
+        }
+        dictOperator(series->chunks, chunk, chunk->baseTimestamp, DICT_OP_SET);
+        series->lastChunk = chunk;
+        series->totalSamples += chunk->count;
+    }
+    if (series->lastChunk && series->totalSamples > 0) {
+        series->lastTimestamp = Compressed_GetLastTimestamp(series->lastChunk);
+        series->lastValue = Compressed_GetLastValue(series->lastChunk);
+    }
+    return series;
+}
+
+Series **SeriesBlob_Decode(const char *buf,
+                           size_t len,
+                           size_t *numSeries,
+                           size_t *numAgg,
+                           bool *more) {
+    BlobReader reader = { .buf = buf, .len = len };
+    const size_t magicLen = strlen(SERIES_BLOB_MAGIC);
+    const char *magic = readBytes(&reader, magicLen);
+    if (!magic || memcmp(magic, SERIES_BLOB_MAGIC, magicLen) != 0) {
+        return NULL;
+    }
+    *numAgg = readVarint(&reader);
+    if (reader.error || *numAgg == 0 || *numAgg > TS_AGG_TYPES_MAX) {
+        return NULL;
+    }
+
+    Series **result = NULL;
+    size_t count = 0;
+    while (!reader.error) {
+        const uint64_t tag = readVarint(&reader);
+        if (tag != SERIES_BLOB_TAG_SERIES) {
+            reader.error = reader.error || tag != SERIES_BLOB_TAG_END;
+            break;
+        }
+        RedisModuleString *name = readString(&reader);
+        const uint64_t labelsCount = readVarint(&reader);
+        if (!name || reader.error || labelsCount > reader.len - reader.pos) {
+            if (name) {
+                RedisModule_FreeString(NULL, name);
+            }
+            reader.error = true;
+            break;
+        }
+        Label *labels = calloc(labelsCount, sizeof(*labels));
+        for (size_t i = 0; i < labelsCount; i++) {
+            labels[i].key = readInterned(&reader);
+            labels[i].value = readInterned(&reader);
+        }
+        reader.error = reader.error || (labelsCount > 0 && !labels[0].key);
+
+        result = realloc(result, (count + *numAgg) * sizeof(*result));
+        result[count++] = readColumn(&reader, name, labels, labelsCount);
+        for (size_t a = 1; a < *numAgg; a++) {
+            RedisModuleString *columnName = RedisModule_CreateStringFromString(NULL, name);
+            result[count++] = readColumn(&reader, columnName, NULL, 0);
+        }
+    }
+    *more = readVarint(&reader);
+
+    for (size_t i = 0; i < reader.numStrings; i++) {
+        RedisModule_FreeString(NULL, reader.strings[i]);
+    }
+    free(reader.strings);
+
+    if (reader.error) {
+        for (size_t i = 0; i < count; i++) {
+            FreeSeries(result[i]);
+        }
+        free(result);
+        return NULL;
+    }
+    *numSeries = count / *numAgg;
+    return result;
+}
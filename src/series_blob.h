@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2006-Present, Redis Ltd.
+ * All rights reserved.
+ *
+ * Licensed under your choice of (a) the Redis Source Available License 2.0
+ * (RSALv2); or (b) the Server Side Public License v1 (SSPLv1); or (c) the
+ * GNU Affero General Public License v3 (AGPLv3).
+ */
+#ifndef SERIES_BLOB_H
+#define SERIES_BLOB_H
+
+#include "abstract_iterator.h"
+#include "indexer.h"
+#include "tsdb.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Binary shard reply of TS.INTERNAL_MRANGE.
+ *
+ * Instead of an array of [ts, value] pairs formatted as strings, the shard replies with a single
+ * bulk string holding the samples of every series in Gorilla compressed chunks, which the
+ * coordinator adopts as is. Integers are LEB128 varints:
+ *
+ *   blob    := "TSB1" numAgg series* 0 more
+ *   series  := 1 name labelsCount (labelName labelValue)* column{numAgg}
+ *   name    := len bytes
+ *   label   := ref [len bytes]  ref 0 is a NULL value, ref k <= interned is the k-th string seen
+ *                               so far, ref interned + 1 is a new string that follows
+ *   column  := numChunks chunk*
+ *   chunk   := count idx baseValue(8 bytes) baseTimestamp prevTimestamp prevTimestampDelta
+ *              prevValue(8 bytes) prevLeading prevTrailing size data(size bytes)
+ *
+ * A column holds the samples of one of the aggregators of the query, in ascending order.
+ */
+
+#define SERIES_BLOB_MAGIC "TSB1"
+#define SERIES_BLOB_CHUNK_SIZE 4096
+
+typedef struct SeriesBlob
+{
+    char *buf;
+    size_t len;
+    size_t cap;
+    size_t numAgg;
+    RedisModuleDict *strings; // the interned label names and values -> their ref
+    uint64_t numStrings;
+} SeriesBlob;
+
+void SeriesBlob_Init(SeriesBlob *blob, size_t numAgg);
+// Adds the series with its labels, as ReplySeriesArrayPos does, and the samples of iter, which is
+// closed. first_chunk is a chunk already taken from iter, or NULL.
+void SeriesBlob_AddSeries(SeriesBlob *blob,
+                          const Series *series,
+                          bool withLabels,
+                          RedisModuleString **limitLabels,
+                          uint16_t limitLabelsSize,
+                          AbstractIterator *iter,
+                          EnrichedChunk *first_chunk);
+// Ends the blob, more marks that the shard has more series after the last one
+void SeriesBlob_Finish(SeriesBlob *blob, bool more);
+void SeriesBlob_Free(SeriesBlob *blob);
+
+// Returns numSeries * numAgg series, the columns of every series one after another, or NULL if
+// the blob is malformed. Only the first column of a series carries its labels.
+Series **SeriesBlob_Decode(const char *buf,
+                           size_t len,
+                           size_t *numSeries,
+                           size_t *numAgg,
+                           bool *more);
+
+#endif // SERIES_BLOB_H
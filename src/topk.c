@@ -0,0 +1,272 @@
+/*
+ * Copyright (c) 2006-Present, Redis Ltd.
+ * All rights reserved.
+ *
+ * Licensed under your choice of (a) the Redis Source Available License 2.0
+ * (RSALv2); or (b) the Server Side Public License v1 (SSPLv1); or (c) the
+ * GNU Affero General Public License v3 (AGPLv3).
+ */
+#include "topk.h"
+
+#include "enriched_chunk.h"
+#include "reply.h"
+
+#include <limits.h>
+#include <math.h>
+#include "rmutil/alloc.h"
+
+// a ranks before b
+static bool ranksBefore(const TopKHeap *heap, const TopKEntry *a, const TopKEntry *b) {
+    if (a->value != b->value) {
+        return heap->bottom ? a->value < b->value : a->value > b->value;
+    }
+    return RedisModule_StringCompare(a->series->keyName, b->series->keyName) < 0;
+}
+
+static void swapEntries(TopKEntry *a, TopKEntry *b) {
+    const TopKEntry tmp = *a;
+    *a = *b;
+    *b = tmp;
+}
+
+// The entries rank before their children, from the last
+static void siftDown(TopKHeap *heap, size_t i) {
+    while (true) {
+        size_t last = i;
+        const size_t left = 2 * i + 1;
+        const size_t right = 2 * i + 2;
+        if (left < heap->len && ranksBefore(heap, &heap->entries[last], &heap->entries[left])) {
+            last = left;
+        }
+        if (right < heap->len && ranksBefore(heap, &heap->entries[last], &heap->entries[right])) {
+            last = right;
+        }
+        if (last == i) {
+            return;
+        }
+        swapEntries(&heap->entries[i], &heap->entries[last]);
+        i = last;
+    }
+}
+
+static void siftUp(TopKHeap *heap, size_t i) {
+    while (i > 0) {
+        const size_t parent = (i - 1) / 2;
+        if (!ranksBefore(heap, &heap->entries[parent], &heap->entries[i])) {
+            return;
+        }
+        swapEntries(&heap->entries[i], &heap->entries[parent]);
+        i = parent;
+    }
+}
+
+void TopKHeap_Init(TopKHeap *heap, size_t k, bool bottom) {
+    heap->entries = malloc(k * sizeof(*heap->entries));
+    heap->len = 0;
+    heap->k = k;
+    heap->bottom = bottom;
+}
+
+void TopKHeap_Free(TopKHeap *heap) {
+    free(heap->entries);
+    heap->entries = NULL;
+    heap->len = 0;
+}
+
+bool TopKHeap_Offer(TopKHeap *heap, Series *series, timestamp_t timestamp, double value) {
+    const TopKEntry entry = { .series = series, .timestamp = timestamp, .value = value };
+    if (heap->len < heap->k) {
+        heap->entries[heap->len++] = entry;
+        siftUp(heap, heap->len - 1);
+        return true;
+    }
+    if (!ranksBefore(heap, &entry, &heap->entries[0])) {
+        return false;
+    }
+    heap->entries[0] = entry;
+    siftDown(heap, 0);
+    return true;
+}
+
+void TopKHeap_Sort(TopKHeap *heap) {
+    // the last entry is moved behind the remaining ones until they are all sorted
+    const size_t len = heap->len;
+    while (heap->len > 1) {
+        swapEntries(&heap->entries[0], &heap->entries[heap->len - 1]);
+        heap->len--;
+        siftDown(heap, 0);
+    }
+    heap->len = len;
+}
+
+// False when a value of at most bound can't enter the heap
+static bool boundMayEnter(const TopKHeap *heap, double bound) {
+    return heap->len < heap->k || heap->bottom || bound >= heap->entries[0].value;
+}
+
+// The samples of the chunks overlapping [start, end], a bound of the count of the range. NaN
+// samples are counted as well, while the count aggregator skips them.
+static uint64_t chunksNumSamples(Series *series, timestamp_t start, timestamp_t end) {
+    timestamp_t rax_key;
+    seriesEncodeTimestamp(&rax_key, start);
+    RedisModuleDictIter *iter =
+        RedisModule_DictIteratorStartC(series->chunks, "<=", &rax_key, sizeof(rax_key));
+    Chunk_t *chunk;
+    if (!RedisModule_DictNextC(iter, NULL, (void **)&chunk)) {
+        RedisModule_DictIteratorReseekC(iter, "^", NULL, 0);
+        if (!RedisModule_DictNextC(iter, NULL, (void **)&chunk)) {
+            chunk = NULL;
+        }
+    }
+
+    uint64_t count = 0;
+    for (bool more = chunk != NULL; more;
+         more = RedisModule_DictNextC(iter, NULL, (void **)&chunk) != NULL) {
+        const uint64_t numSamples = series->funcs->GetNumOfSample(chunk);
+        if (numSamples == 0) {
+            continue;
+        }
+        const timestamp_t first = series->funcs->GetFirstTimestamp(chunk);
+        const timestamp_t last = series->funcs->GetLastTimestamp(chunk);
+        if (first > end) {
+            break;
+        }
+        if (last < start) {
+            continue;
+        }
+        count += numSamples;
+    }
+    RedisModule_DictIteratorStop(iter);
+    return count;
+}
+
+static timestamp_t seriesFirstTimestamp(Series *series) {
+    RedisModuleDictIter *iter = RedisModule_DictIteratorStartC(series->chunks, "^", NULL, 0);
+    Chunk_t *chunk = NULL;
+    if (!RedisModule_DictNextC(iter, NULL, (void **)&chunk)) {
+        chunk = NULL;
+    }
+    RedisModule_DictIteratorStop(iter);
+    return chunk ? series->funcs->GetFirstTimestamp(chunk) : 0;
+}
+
+// Aggregates series over the range of args and offers it to the heap
+static void offerSeries(TopKHeap *heap, Series *series, const MTopKArgs *args) {
+    const RangeArgs *rangeArgs = &args->mrange.rangeArgs;
+    // LATEST adds the open bucket of a compaction, after its last sample
+    const bool latest = rangeArgs->latest && series->srcKey;
+    if (series->totalSamples == 0 && !latest) {
+        return;
+    }
+
+    timestamp_t start = max(rangeArgs->startTimestamp, seriesFirstTimestamp(series));
+    if (series->retentionTime > 0 && series->lastTimestamp > series->retentionTime) {
+        start = max(start, series->lastTimestamp - series->retentionTime);
+    }
+    const timestamp_t end =
+        latest ? rangeArgs->endTimestamp : min(rangeArgs->endTimestamp, series->lastTimestamp);
+    if (start > end) {
+        return;
+    }
+
+    const TS_AGG_TYPES_T aggType = rangeArgs->aggregationArgs.classes[0]->type;
+    const bool filtered =
+        rangeArgs->filterByValueArgs.hasValue || rangeArgs->filterByTSArgs.hasValue;
+    if (!filtered && !latest) {
+        // a NaN last sample is skipped by the aggregator, the query finds the last one before it
+        if (aggType == TS_AGG_LAST && end == series->lastTimestamp && !isnan(series->lastValue)) {
+            TopKHeap_Offer(heap, series, start, series->lastValue);
+            return;
+        }
+        // the bound only prunes, the query skips the NaN samples for the exact count
+        if (aggType == TS_AGG_COUNT) {
+            const uint64_t numSamples = chunksNumSamples(series, start, end);
+            if (numSamples == 0 || !boundMayEnter(heap, numSamples)) {
+                return;
+            }
+        }
+    }
+
+    RangeArgs queryArgs = *rangeArgs;
+    queryArgs.startTimestamp = start;
+    queryArgs.endTimestamp = end;
+    queryArgs.aggregationArgs.timeDelta = min(end - start, (timestamp_t)LLONG_MAX - 1) + 1;
+    queryArgs.alignment = TimestampAlignment;
+    queryArgs.timestampAlignment = start;
+    AbstractIterator *iter = SeriesQuery(series, &queryArgs, false, true);
+    EnrichedChunk *chunk;
+    while ((chunk = iter->GetNext(iter)) != NULL) {
+        if (chunk->samples.num_samples > 0) {
+            const double value = Samples_value_at(&chunk->samples, 0, 0);
+            if (!isnan(value)) {
+                TopKHeap_Offer(heap, series, start, value);
+            }
+            break;
+        }
+    }
+    iter->Close(iter);
+}
+
+void MTopK_AddSeries(RedisModuleCtx *ctx,
+                     TopKHeap *heap,
+                     RedisModuleDict *keys,
+                     const MTopKArgs *args) {
+    RedisModuleDictIter *iter = RedisModule_DictIteratorStartC(keys, "^", NULL, 0);
+    char *currentKey;
+    size_t currentKeyLen;
+    while ((currentKey = RedisModule_DictNextC(iter, &currentKeyLen, NULL)) != NULL) {
+        RedisModuleKey *key;
+        Series *series;
+        // Freed right away, shards run this without auto memory
+        RedisModuleString *keyName = RedisModule_CreateString(ctx, currentKey, currentKeyLen);
+        // ACL permissions were already validated by the caller
+        const GetSeriesResult status = GetSeries(
+            ctx, keyName, &key, &series, REDISMODULE_READ, GetSeriesFlags_SilentOperation);
+        RedisModule_FreeString(ctx, keyName);
+        if (status != GetSeriesResult_Success) {
+            // The iterator may have been invalidated, stop and restart from after the current
+            // key.
+            RedisModule_DictIteratorStop(iter);
+            iter = RedisModule_DictIteratorStartC(keys, ">", currentKey, currentKeyLen);
+            continue;
+        }
+        offerSeries(heap, series, args);
+        RedisModule_CloseKey(key);
+    }
+    RedisModule_DictIteratorStop(iter);
+}
+
+void MTopK_Reply(RedisModuleCtx *ctx, TopKHeap *heap, const MTopKArgs *args) {
+    TopKHeap_Sort(heap);
+    RedisModule_ReplyWithArray(ctx, heap->len);
+    for (size_t i = 0; i < heap->len; i++) {
+        const TopKEntry *entry = &heap->entries[i];
+        RedisModule_ReplyWithArray(ctx, 3);
+        RedisModule_ReplyWithString(ctx, entry->series->keyName);
+        if (args->mrange.withLabels) {
+            ReplyWithSeriesLabels(ctx, entry->series);
+        } else if (args->mrange.numLimitLabels > 0) {
+            ReplyWithSeriesLabelsWithLimit(ctx,
+                                           entry->series,
+                                           (RedisModuleString **)args->mrange.limitLabels,
+                                           args->mrange.numLimitLabels);
+        } else {
+            ReplyWithMapOrArray(ctx, 0, false);
+        }
+        ReplyWithSample(ctx, entry->timestamp, entry->value);
+    }
+}
+
+void MTopK_ReplyShard(RedisModuleCtx *ctx, TopKHeap *heap) {
+    TopKHeap_Sort(heap);
+    RedisModule_ReplyWithArray(ctx, heap->len);
+    for (size_t i = 0; i < heap->len; i++) {
+        const TopKEntry *entry = &heap->entries[i];
+        RedisModule_ReplyWithArray(ctx, 3);
+        RedisModule_ReplyWithString(ctx, entry->series->keyName);
+        // all the labels, the coordinator picks the requested ones
+        ReplyWithSeriesLabels(ctx, entry->series);
+        RedisModule_ReplyWithArray(ctx, 1);
+        ReplyWithSample(ctx, entry->timestamp, entry->value);
+    }
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2006-Present, Redis Ltd.
+ * All rights reserved.
+ *
+ * Licensed under your choice of (a) the Redis Source Available License 2.0
+ * (RSALv2); or (b) the Server Side Public License v1 (SSPLv1); or (c) the
+ * GNU Affero General Public License v3 (AGPLv3).
+ */
+#ifndef TOPK_H
+#define TOPK_H
+
+#include "query_language.h"
+#include "tsdb.h"
+
+#include "RedisModulesSDK/redismodule.h"
+
+/*
+ * TS.MTOPK k fromTimestamp toTimestamp AGGREGATION aggregator [BOTTOM] ... FILTER filterExpr...
+ *
+ * Aggregates every matching series over the range as a single bucket and replies the k series
+ * with the highest values, or the lowest with BOTTOM, best first:
+ *
+ *   [[key, labels, [timestamp, value]], ...]
+ *
+ * where timestamp is the start of the bucket, the first sample of the series when the range
+ * starts before it. Series without samples in the range, or whose aggregation is NaN, are left
+ * out, and ties are broken by key name.
+ *
+ * The series are kept in a heap of k entries. The chunks don't summarize their values, but what
+ * they do hold is used before any sample is decoded: series without samples in the range are
+ * skipped, count is taken from the sample counts of the chunks that lie within the range, and a
+ * series whose chunks hold too few samples to enter the heap isn't counted at all.
+ *
+ * In cluster mode every shard replies its own k series (TS.INTERNAL_MTOPK), which the coordinator
+ * merges into the final k.
+ */
+
+typedef struct TopKEntry
+{
+    Series *series;
+    timestamp_t timestamp;
+    double value;
+} TopKEntry;
+
+typedef struct TopKHeap
+{
+    TopKEntry *entries; // the entry closest to leaving the heap first
+    size_t len;
+    size_t k;
+    bool bottom;
+} TopKHeap;
+
+void TopKHeap_Init(TopKHeap *heap, size_t k, bool bottom);
+void TopKHeap_Free(TopKHeap *heap);
+// Returns false when the entry doesn't rank among the k best ones
+bool TopKHeap_Offer(TopKHeap *heap, Series *series, timestamp_t timestamp, double value);
+// Orders the entries best first, the heap can't be offered entries afterwards
+void TopKHeap_Sort(TopKHeap *heap);
+
+// Offers every series of keys, the heap must be replied before the series can change
+void MTopK_AddSeries(RedisModuleCtx *ctx,
+                     TopKHeap *heap,
+                     RedisModuleDict *keys,
+                     const MTopKArgs *args);
+void MTopK_Reply(RedisModuleCtx *ctx, TopKHeap *heap, const MTopKArgs *args);
+// The reply of TS.INTERNAL_MTOPK, in the form of TS.INTERNAL_MRANGE:
+// [[key, labels, [[timestamp, value]]], ...]
+void MTopK_ReplyShard(RedisModuleCtx *ctx, TopKHeap *heap);
+
+#endif // TOPK_H
@@ -7,21 +7,27 @@
  * GNU Affero General Public License v3 (AGPLv3).
  */
 #include "tsdb.h"
+#include "async_compaction.h"
+#include "columnar_reduce.h"
 #include "common.h"
 #include "config.h"
 #include "consts.h"
+#include "downsample_iterator.h"
 #include "endianconv.h"
 #include "filter_iterator.h"
 #include "indexer.h"
 #include "module.h"
+#include "notify.h"
 #include "series_iterator.h"
 #include "sample_iterator.h"
 #include "multiseries_sample_iterator.h"
 #include "multiseries_agg_dup_sample_iterator.h"
 #include "rdb.h"
 #include "libmr_integration.h"
+#include "window_iterator.h"
 
 #include <inttypes.h>
+#include <limits.h>
 #include <math.h>
 #include <stdlib.h>
 #include <assert.h> // assert
@@ -74,12 +80,14 @@ CompactionRule *GetRule(CompactionRule *rules, RedisModuleString *keyName) {
     return NULL;
 }
 
-GetSeriesResult GetSeries(RedisModuleCtx *ctx,
-                          RedisModuleString *keyName,
-                          RedisModuleKey **key,
-                          Series **series,
-                          int mode,
-                          const GetSeriesFlags flags) {
+// GetSeries, also opening a wide series into *wide when wide isn't NULL
+static GetSeriesResult getSeries(RedisModuleCtx *ctx,
+                                 RedisModuleString *keyName,
+                                 RedisModuleKey **key,
+                                 Series **series,
+                                 WideSeries **wide,
+                                 int mode,
+                                 const GetSeriesFlags flags) {
     const bool shouldDeleteRefs = flags & GetSeriesFlags_DeleteReferences;
 
     if (shouldDeleteRefs) {
@@ -128,6 +136,12 @@ GetSeriesResult GetSeries(RedisModuleCtx *ctx,
         }
         return GetSeriesResult_GenericError;
     }
+    if (wide && RedisModule_ModuleTypeGetType(new_key) == WideSeriesType) {
+        *wide = RedisModule_ModuleTypeGetValue(new_key);
+        *series = NULL;
+        *key = new_key;
+        return GetSeriesResult_Success;
+    }
     if (RedisModule_ModuleTypeGetType(new_key) != SeriesType) {
         RedisModule_CloseKey(new_key);
         if (!isSilent) {
@@ -138,6 +152,9 @@ GetSeriesResult GetSeries(RedisModuleCtx *ctx,
 
     *series = RedisModule_ModuleTypeGetValue(new_key);
     *key = new_key;
+    if (wide) {
+        *wide = NULL;
+    }
 
     if (shouldDeleteRefs) {
         // deleteReferenceToDeletedSeries calls GetSeries with the flags it was provided. avoid
@@ -151,6 +168,25 @@ GetSeriesResult GetSeries(RedisModuleCtx *ctx,
     return GetSeriesResult_Success;
 }
 
+GetSeriesResult GetSeries(RedisModuleCtx *ctx,
+                          RedisModuleString *keyName,
+                          RedisModuleKey **key,
+                          Series **series,
+                          int mode,
+                          const GetSeriesFlags flags) {
+    return getSeries(ctx, keyName, key, series, NULL, mode, flags);
+}
+
+GetSeriesResult GetSeriesOrWideSeries(RedisModuleCtx *ctx,
+                                      RedisModuleString *keyName,
+                                      RedisModuleKey **key,
+                                      Series **series,
+                                      WideSeries **wide,
+                                      int mode,
+                                      const GetSeriesFlags flags) {
+    return getSeries(ctx, keyName, key, series, wide, mode, flags);
+}
+
 int dictOperator(RedisModuleDict *d, void *chunk, timestamp_t ts, DictOp op) {
     timestamp_t rax_key = htonu64(ts);
     switch (op) {
@@ -165,6 +201,14 @@ int dictOperator(RedisModuleDict *d, void *chunk, timestamp_t ts, DictOp op) {
     return REDISMODULE_OK; // silence compiler
 }
 
+// The last version given to a series
+static uint64_t lastSeriesVersion = 0;
+
+// Appending samples keeps the version, they can only change the bucket of the last sample
+static void SeriesNewVersion(Series *series) {
+    series->version = ++lastSeriesVersion;
+}
+
 Series *NewSeries(RedisModuleString *keyName, const CreateCtx *cCtx) {
     lazyModuleInitialize(rts_staticCtx);
     Series *newSeries = (Series *)calloc(1, sizeof(Series));
@@ -184,6 +228,7 @@ Series *NewSeries(RedisModuleString *keyName, const CreateCtx *cCtx) {
     newSeries->ignoreMaxTimeDiff = cCtx->ignoreMaxTimeDiff;
     newSeries->ignoreMaxValDiff = cCtx->ignoreMaxValDiff;
     newSeries->in_ram = true;
+    SeriesNewVersion(newSeries);
 
     if (newSeries->options & SERIES_OPT_UNCOMPRESSED) {
         newSeries->options |= SERIES_OPT_UNCOMPRESSED;
@@ -194,7 +239,7 @@ Series *NewSeries(RedisModuleString *keyName, const CreateCtx *cCtx) {
     }
 
     if (!cCtx->skipChunkCreation) {
-        Chunk_t *newChunk = newSeries->funcs->NewChunk(newSeries->chunkSizeBytes);
+        Chunk_t *newChunk = newSeries->funcs->NewChunk(SeriesNewChunkSize(newSeries));
         dictOperator(newSeries->chunks, newChunk, 0, DICT_OP_SET);
         newSeries->lastChunk = newChunk;
     } else {
@@ -389,6 +434,7 @@ void RenameSeriesTo(RedisModuleCtx *ctx, RedisModuleString *keyTo) {
     RedisModule_FreeString(NULL, series->keyName);
     RedisModule_RetainString(NULL, keyTo);
     series->keyName = keyTo;
+    AsyncCompaction_Relink(series, RedisModule_GetSelectedDb(ctx));
 
 cleanup:
     if (key) {
@@ -432,6 +478,7 @@ void *CopySeries(RedisModuleString *fromkey, RedisModuleString *tokey, const voi
 
     dst->srcKey = NULL;
     dst->rules = NULL;
+    dst->compactionQueue = NULL;
 
     RemoveIndexedMetric(tokey); // in case of replace
     if (dst->labelsCount > 0) {
@@ -439,6 +486,7 @@ void *CopySeries(RedisModuleString *fromkey, RedisModuleString *tokey, const voi
     }
 
     dst->in_ram = src->in_ram;
+    SeriesNewVersion(dst);
     return dst;
 }
 
@@ -461,6 +509,8 @@ void FreeSeries(void *value) {
 
     RedisModule_FreeDict(NULL, series->chunks);
 
+    AsyncCompaction_Discard(series);
+
     for (CompactionRule *rule = series->rules; rule != NULL;) {
         CompactionRule *nextRule = rule->nextRule;
         FreeCompactionRule(rule);
@@ -477,6 +527,26 @@ void FreeSeries(void *value) {
     free(series);
 }
 
+// Called while the key is deleted, renamed or moved, when the keyspace can't be written. The
+// pending compactions are held back until the series is relinked, or freed.
+void UnlinkSeries(RedisModuleString *key, const void *value) {
+    REDISMODULE_NOT_USED(key);
+    AsyncCompaction_Unlink((Series *)value);
+}
+
+void MoveSeriesTo(RedisModuleCtx *ctx, RedisModuleString *key) {
+    Series *series;
+    RedisModuleKey *rkey = NULL;
+    const GetSeriesResult status =
+        GetSeries(ctx, key, &rkey, &series, REDISMODULE_READ, GetSeriesFlags_SilentOperation);
+    if (status != GetSeriesResult_Success) {
+        return;
+    }
+
+    AsyncCompaction_Relink(series, RedisModule_GetSelectedDb(ctx));
+    RedisModule_CloseKey(rkey);
+}
+
 int DefragSeries(RedisModuleDefragCtx *ctx, RedisModuleString *key, void **value) {
     static RedisModuleString *seekTo = NULL;
     Series *series = (Series *)*value;
@@ -497,6 +567,9 @@ int DefragSeries(RedisModuleDefragCtx *ctx, RedisModuleString *key, void **value
 
         series->srcKey = defragString(ctx, series->srcKey);
         series->keyName = defragString(ctx, series->keyName);
+        if (series->compactionQueue) {
+            series->compactionQueue->series = series;
+        }
     }
 
     series->chunks = defragDict(ctx, series->chunks, series->funcs->DefragChunk, &seekTo);
@@ -562,7 +635,8 @@ size_t SeriesMemUsage(const void *value) {
     const Series *series = (const Series *)value;
     size_t keyNameSize = series->keyName ? RedisModule_MallocSizeString(series->keyName) : 0;
     return RedisModule_MallocSize((void *)series) + keyNameSize + SeriesRulesSize(series) +
-           SeriesLabelsSize(series) + SeriesChunksSize(series) + IndexMemUsage(series->keyName);
+           SeriesLabelsSize(series) + SeriesChunksSize(series) + IndexMemUsage(series->keyName) +
+           AsyncCompaction_MemUsage(series);
 }
 
 size_t SeriesGetNumSamples(const Series *series) {
@@ -577,7 +651,11 @@ void MultiSeriesReduce(Series *dest,
                        Series **series,
                        size_t n_series,
                        const ReducerArgs *groupByReducerArgs,
-                       RangeArgs *args) {
+                       const RangeArgs *args) {
+    if (ColumnarReduce(dest, series, n_series, groupByReducerArgs, args)) {
+        return;
+    }
+
     Sample sample;
     AbstractSampleIterator *iterator = MultiSeriesCreateAggDupSampleIterator(
         series, n_series, args, false, true, groupByReducerArgs);
@@ -612,7 +690,7 @@ static bool RuleSeriesUpsertSample(RedisModuleCtx *ctx,
     // Wake any TS.READ waiters parked on the destination key, so a
     // compaction-rule bucket landing here triggers them just like a direct
     // write would.
-    RedisModule_SignalKeyAsReady(ctx, rule->destKey);
+    Notify_KeyReady(ctx, rule->destKey);
     RedisModule_CloseKey(key);
 
     return true;
@@ -678,6 +756,39 @@ static inline void update_chunk_in_dict(RedisModuleDict *chunks,
     dictOperator(chunks, chunk, chunkFirstTSAfterOp, DICT_OP_SET);
 }
 
+// Replaces a chunk shared with a snapshot by a private clone before the series modifies it
+static Chunk_t *SeriesUnshareChunk(Series *series, Chunk_t *chunk) {
+    const ChunkFuncs *funcs = series->funcs;
+    if (likely(!funcs->IsChunkShared(chunk))) {
+        return chunk;
+    }
+
+    // the chunk is keyed by its first timestamp, or by 0 for the first chunk
+    timestamp_t rax_key;
+    seriesEncodeTimestamp(&rax_key, funcs->GetFirstTimestamp(chunk));
+    RedisModuleDictIter *iter =
+        RedisModule_DictIteratorStartC(series->chunks, "<=", &rax_key, sizeof(rax_key));
+    Chunk_t *cur = NULL;
+    size_t keyLen;
+    void *key = RedisModule_DictNextC(iter, &keyLen, (void **)&cur);
+    if (cur != chunk) {
+        RedisModule_DictIteratorReseekC(iter, "^", NULL, 0);
+        while ((key = RedisModule_DictNextC(iter, &keyLen, (void **)&cur)) && cur != chunk) {
+        }
+    }
+    RedisModule_Assert(key != NULL && keyLen == sizeof(rax_key));
+    memcpy(&rax_key, key, sizeof(rax_key));
+    RedisModule_DictIteratorStop(iter);
+
+    Chunk_t *copy = funcs->CloneChunk(chunk);
+    RedisModule_DictReplaceC(series->chunks, &rax_key, sizeof(rax_key), copy);
+    if (series->lastChunk == chunk) {
+        series->lastChunk = copy;
+    }
+    funcs->FreeChunk(chunk); // drops the reference of the series
+    return copy;
+}
+
 int SeriesUpsertSample(Series *series,
                        api_timestamp_t timestamp,
                        double value,
@@ -706,6 +817,7 @@ int SeriesUpsertSample(Series *series,
         }
         chunkFirstTS = funcs->GetFirstTimestamp(chunk);
     }
+    chunk = SeriesUnshareChunk(series, chunk);
 
     // Split chunks
     if (funcs->GetChunkSize(chunk, false) > series->chunkSizeBytes * SPLIT_FACTOR) {
@@ -733,6 +845,7 @@ int SeriesUpsertSample(Series *series,
 
     ChunkResult rv = funcs->UpsertSample(&uCtx, &size, dp_policy);
     if (rv == CR_OK) {
+        SeriesNewVersion(series);
         series->totalSamples += size;
         if (timestamp == series->lastTimestamp) {
             series->lastValue = uCtx.sample.value;
@@ -747,19 +860,80 @@ int SeriesUpsertSample(Series *series,
     return rv;
 }
 
+size_t SeriesNewChunkSize(const Series *series) {
+    if ((series->options & SERIES_OPT_CHUNK_SIZE_AUTO) &&
+        series->chunkSizeBytes > CHUNK_SIZE_AUTO_INITIAL_BYTES) {
+        return CHUNK_SIZE_AUTO_INITIAL_BYTES;
+    }
+    return series->chunkSizeBytes;
+}
+
+// CHUNK_SIZE AUTO: the last chunk is grown up to chunkSizeBytes before a new one is started
+static ChunkResult growLastChunk(Series *series, Sample *sample) {
+    const ChunkFuncs *funcs = series->funcs;
+    ChunkResult ret = CR_END;
+    size_t size = funcs->GetChunkSize(series->lastChunk, false);
+    while (ret == CR_END && size < (size_t)series->chunkSizeBytes) {
+        size = min(size * 2, (size_t)series->chunkSizeBytes);
+        funcs->ResizeChunk(series->lastChunk, size);
+        ret = funcs->AddSample(series->lastChunk, sample);
+    }
+    return ret;
+}
+
+// CHUNK_SIZE AUTO: shrinks the full last chunk to fit and derives the size of the next chunks
+// from its sample rate and bytes per sample, so a chunk holds about ts-chunk-auto-target-span
+// milliseconds of samples, or ts-chunk-auto-target-samples samples if no span is set.
+static void closeLastChunk(Series *series) {
+    const ChunkFuncs *funcs = series->funcs;
+    Chunk_t *chunk = series->lastChunk;
+    funcs->ResizeChunk(chunk, 0);
+
+    const uint64_t numSamples = funcs->GetNumOfSample(chunk);
+    if (numSamples < 2) {
+        return;
+    }
+
+    const timestamp_t span = funcs->GetLastTimestamp(chunk) - funcs->GetFirstTimestamp(chunk);
+    double targetSamples = TSGlobalConfig.chunkAutoTargetSamples;
+    if (TSGlobalConfig.chunkAutoTargetSpan > 0 && span > 0) {
+        targetSamples = (double)(numSamples - 1) * TSGlobalConfig.chunkAutoTargetSpan / span;
+    }
+
+    const double bytesPerSample = (double)funcs->GetChunkSize(chunk, false) / numSamples;
+    const double targetSize = targetSamples * bytesPerSample;
+    long long size = CHUNK_SIZE_BYTES_MAX;
+    if (targetSize < CHUNK_SIZE_BYTES_MIN) {
+        size = CHUNK_SIZE_BYTES_MIN;
+    } else if (targetSize < CHUNK_SIZE_BYTES_MAX) {
+        size = ((long long)targetSize + 7) & ~7LL;
+    }
+    series->chunkSizeBytes = size;
+}
+
 void SeriesAddSample(Series *series, api_timestamp_t timestamp, double value) {
     // backfilling or update
     Sample sample = {
         .timestamp = timestamp,
         .value = value,
     };
+    SeriesUnshareChunk(series, series->lastChunk);
     ChunkResult ret = series->funcs->AddSample(series->lastChunk, &sample);
 
+    const bool autoSize = series->options & SERIES_OPT_CHUNK_SIZE_AUTO;
+    if (ret == CR_END && autoSize) {
+        ret = growLastChunk(series, &sample);
+    }
+
     if (ret == CR_END) {
+        if (autoSize) {
+            closeLastChunk(series);
+        }
+
         // When a new chunk is created trim the series
         SeriesTrim(series, 0, 0);
 
-        Chunk_t *newChunk = series->funcs->NewChunk(series->chunkSizeBytes);
+        Chunk_t *newChunk = series->funcs->NewChunk(SeriesNewChunkSize(series));
         dictOperator(series->chunks, newChunk, timestamp, DICT_OP_SET);
         ret = series->funcs->AddSample(newChunk, &sample);
         series->lastChunk = newChunk;
@@ -1024,6 +1198,8 @@ size_t SeriesDelRange(Series *series, timestamp_t start_ts, timestamp_t end_ts)
             (!is_only_chunk); // We assume at least one allocated chunk in the series
 
         if (!ts_delCondition) {
+            // replacing the value of the current key doesn't invalidate the iterator
+            currentChunk = SeriesUnshareChunk(series, currentChunk);
             timestamp_t chunkFirstTS = funcs->GetFirstTimestamp(currentChunk);
             deletedSamples += funcs->DelRange(currentChunk, start_ts, end_ts);
             timestamp_t chunkFirstTSAfterOp = funcs->GetFirstTimestamp(currentChunk);
@@ -1058,6 +1234,9 @@ size_t SeriesDelRange(Series *series, timestamp_t start_ts, timestamp_t end_ts)
         RedisModule_DictIteratorReseekC(iter, ">", currentKey, keyLen);
     }
     series->totalSamples -= deletedSamples;
+    if (deletedSamples > 0) {
+        SeriesNewVersion(series);
+    }
 
     RedisModule_DictIteratorStop(iter);
 
@@ -1095,6 +1274,9 @@ CompactionRule *SeriesAddRule(RedisModuleCtx *ctx,
         return NULL;
     }
     RedisModule_RetainString(ctx, destSeries->keyName);
+    if (series->totalSamples > 0) {
+        rule->watermark = RuleWatermarkAfter(rule, series->lastTimestamp);
+    }
     if (series->rules == NULL) {
         series->rules = rule;
     } else {
@@ -1211,6 +1393,7 @@ CompactionRule *NewRule(RedisModuleString *destKey,
     rule->startCurrentTimeBucket = -1LL;
     rule->nextRule = NULL;
     rule->validSamplesInBucket = false;
+    rule->watermark = 0;
 
     return rule;
 }
@@ -1273,11 +1456,11 @@ int SeriesCalcRange(Series *series,
         .filterByTSArgs = { 0 },
     };
 
-    if (aggObject->type == TS_AGG_TWA) {
+    if (AggTypeUsesBucketEdges(aggObject->type)) {
         aggObject->addBucketParams(context, start_ts, end_ts + 1);
     }
 
-    if (aggObject->type == TS_AGG_TWA && start_ts > 0) {
+    if (AggTypeUsesBucketEdges(aggObject->type) && start_ts > 0) {
         args.startTimestamp = 0, args.endTimestamp = start_ts - 1,
         iterator = SeriesCreateSampleIterator(series, &args, true, true);
         if (iterator->GetNext(iterator, &sample) == CR_OK) {
@@ -1296,7 +1479,7 @@ int SeriesCalcRange(Series *series,
     }
     iterator->Close(iterator);
 
-    if (aggObject->type == TS_AGG_TWA) {
+    if (AggTypeUsesBucketEdges(aggObject->type)) {
         args.startTimestamp = end_ts + 1, args.endTimestamp = UINT64_MAX,
         iterator = SeriesCreateSampleIterator(series, &args, false, true);
         if (iterator->GetNext(iterator, &sample) == CR_OK) {
@@ -1389,22 +1572,7 @@ AbstractIterator *SeriesQuery(Series *series,
         chain = (AbstractIterator *)SeriesFilterValIterator_New(chain, args->filterByValueArgs);
     }
 
-    timestamp_t timestampAlignment;
-    switch (args->alignment) {
-        case StartAlignment:
-            // args-startTimestamp can hold an older timestamp than what we currently have or just 0
-            timestampAlignment = args->startTimestamp;
-            break;
-        case EndAlignment:
-            timestampAlignment = args->endTimestamp;
-            break;
-        case TimestampAlignment:
-            timestampAlignment = args->timestampAlignment;
-            break;
-        default:
-            timestampAlignment = 0;
-            break;
-    }
+    const timestamp_t timestampAlignment = RangeArgs_Alignment(args);
 
     if (args->aggregationArgs.numClasses > 0 && !args->skipAggregation) {
         chain = (AbstractIterator *)AggregationIterator_New(chain,
@@ -1420,11 +1588,51 @@ AbstractIterator *SeriesQuery(Series *series,
                                                             args->endTimestamp,
                                                             args->filterByValueArgs,
                                                             args->filterByTSArgs);
+    } else if (args->downsample.type != DOWNSAMPLE_NONE && !args->skipAggregation) {
+        chain = (AbstractIterator *)DownsampleIterator_New(
+            chain, &args->downsample, series, startTimestamp, args->endTimestamp, reverse);
+    }
+
+    // also on the coordinator, when it is left to it, see MRangeQueryArg
+    if (args->window.type != WINDOW_NONE) {
+        chain = (AbstractIterator *)WindowIterator_New(chain, &args->window);
     }
 
     return chain;
 }
 
+EnrichedChunk *SeriesQueryMaterialize(Series *series, const RangeArgs *args, bool reverse) {
+    const unsigned long long limit =
+        args->count != -1 ? (unsigned long long)args->count : ULLONG_MAX;
+    EnrichedChunk *out = NewEnrichedChunk();
+    Samples *samples = &out->samples;
+
+    AbstractIterator *iter = SeriesQuery(series, args, reverse, true);
+    EnrichedChunk *chunk;
+    while (samples->num_samples < limit && (chunk = iter->GetNext(iter)) != NULL) {
+        const size_t n = min(chunk->samples.num_samples, limit - samples->num_samples);
+        if (n == 0) {
+            continue;
+        }
+
+        const size_t vps = chunk->samples.values_per_sample;
+        if (samples->num_samples + n > samples->size) {
+            samples->values_per_sample = vps;
+            ReallocSamplesArray(samples, max(samples->size * 2, samples->num_samples + n));
+        }
+        memcpy(samples->timestamps + samples->num_samples,
+               chunk->samples.timestamps,
+               n * sizeof(timestamp_t));
+        memcpy(Samples_values_row_ptr(samples, samples->num_samples),
+               Samples_values_row_ptr(&chunk->samples, 0),
+               n * vps * sizeof(double));
+        samples->num_samples += n;
+    }
+    iter->Close(iter);
+
+    return out;
+}
+
 AbstractSampleIterator *SeriesCreateSampleIterator(Series *series,
                                                    const RangeArgs *args,
                                                    bool reverse,
@@ -1440,9 +1648,9 @@ AbstractMultiSeriesSampleIterator *MultiSeriesCreateSampleIterator(Series **seri
                                                                    bool reverse,
                                                                    bool check_retention) {
     size_t i;
-    AbstractSampleIterator **iters = malloc(n_series * sizeof(AbstractSampleIterator *));
+    AbstractIterator **iters = malloc(n_series * sizeof(AbstractIterator *));
     for (i = 0; i < n_series; ++i) {
-        iters[i] = SeriesCreateSampleIterator(series[i], args, reverse, check_retention);
+        iters[i] = SeriesQuery(series[i], args, reverse, check_retention);
     }
 
     AbstractMultiSeriesSampleIterator *res =
@@ -1462,7 +1670,8 @@ AbstractSampleIterator *MultiSeriesCreateAggDupSampleIterator(Series **series,
                                                               const ReducerArgs *reducerArgs) {
     AbstractMultiSeriesSampleIterator *chain =
         MultiSeriesCreateSampleIterator(series, n_series, args, reverse, check_retention);
-    return (AbstractSampleIterator *)MultiSeriesAggDupSampleIterator_New(chain, reducerArgs);
+    return (AbstractSampleIterator *)MultiSeriesAggDupSampleIterator_New(
+        chain, n_series, reducerArgs);
 }
 
 void calculate_latest_sample(Sample **sample, const Series *series) {
@@ -1491,7 +1700,7 @@ void calculate_latest_sample(Sample **sample, const Series *series) {
         (*sample)->timestamp = rule->startCurrentTimeBucket;
         (*sample)->value = aggVal;
 
-        free(clonedContext);
+        rule->aggClass->freeContext(clonedContext);
     }
 
 __out:
@@ -1499,3 +1708,90 @@ __out:
         RedisModule_CloseKey(srcKey);
     }
 }
+
+// The closed chunks are shared with the snapshot, only the open last chunk, which every new sample
+// is appended to, is copied
+static void snapshotAddChunk(Series *snapshot,
+                             const Series *series,
+                             void *key,
+                             size_t keyLen,
+                             Chunk_t *chunk) {
+    const ChunkFuncs *funcs = snapshot->funcs;
+    Chunk_t *shared = chunk == series->lastChunk ? funcs->CloneChunk(chunk)
+                                                 : funcs->RetainChunk(chunk);
+    RedisModule_DictSetC(snapshot->chunks, key, keyLen, shared);
+    snapshot->totalSamples += funcs->GetNumOfSample(chunk);
+}
+
+Series *SeriesSnapshot(Series *series, const RangeArgs *args) {
+    Label *labels = calloc(series->labelsCount, sizeof(Label));
+    for (size_t i = 0; i < series->labelsCount; i++) {
+        labels[i].key = RedisModule_CreateStringFromString(NULL, series->labels[i].key);
+        labels[i].value = RedisModule_CreateStringFromString(NULL, series->labels[i].value);
+    }
+    CreateCtx cCtx = {
+        .retentionTime = series->retentionTime,
+        .chunkSizeBytes = series->chunkSizeBytes,
+        .labels = labels,
+        .labelsCount = series->labelsCount,
+        .options = series->options,
+        .skipChunkCreation = true,
+    };
+    Series *snapshot = NewSeries(RedisModule_CreateStringFromString(NULL, series->keyName), &cCtx);
+    snapshot->lastTimestamp = series->lastTimestamp;
+    snapshot->lastValue = series->lastValue;
+
+    const ChunkFuncs *funcs = series->funcs;
+    // Aggregations (TWA, EMPTY) also read the two samples before and after the range
+    const uint64_t margin = args->aggregationArgs.numClasses > 0 ? 2 : 0;
+    void *key;
+    size_t keyLen;
+    Chunk_t *chunk;
+
+    // from the chunk holding the range start backwards
+    timestamp_t rax_key;
+    seriesEncodeTimestamp(&rax_key, args->startTimestamp);
+    RedisModuleDictIter *iter =
+        RedisModule_DictIteratorStartC(series->chunks, "<=", &rax_key, sizeof(rax_key));
+    uint64_t samplesBefore = 0;
+    bool first = true;
+    while ((key = RedisModule_DictPrevC(iter, &keyLen, (void **)&chunk))) {
+        snapshotAddChunk(snapshot, series, key, keyLen, chunk);
+        if (!first) {
+            samplesBefore += funcs->GetNumOfSample(chunk);
+        }
+        first = false;
+        if (samplesBefore >= margin) {
+            break;
+        }
+    }
+
+    // then forward up to the range end
+    RedisModule_DictIteratorReseekC(iter, ">", &rax_key, sizeof(rax_key));
+    uint64_t samplesAfter = 0;
+    while ((key = RedisModule_DictNextC(iter, &keyLen, (void **)&chunk))) {
+        if (funcs->GetFirstTimestamp(chunk) > args->endTimestamp) {
+            if (samplesAfter >= margin) {
+                break;
+            }
+            samplesAfter += funcs->GetNumOfSample(chunk);
+        }
+        snapshotAddChunk(snapshot, series, key, keyLen, chunk);
+    }
+    RedisModule_DictIteratorStop(iter);
+
+    // LATEST is ignored for a series that is not a compaction.
+    if (args->latest && series->srcKey && args->endTimestamp > series->lastTimestamp) {
+        Sample sample;
+        Sample *sample_ptr = &sample;
+        calculate_latest_sample(&sample_ptr, series);
+        if (sample_ptr && sample.timestamp <= args->endTimestamp) {
+            Chunk_t *latestChunk = funcs->NewChunk(128);
+            funcs->AddSample(latestChunk, &sample);
+            dictOperator(snapshot->chunks, latestChunk, sample.timestamp, DICT_OP_SET);
+            snapshot->totalSamples++;
+        }
+    }
+
+    return snapshot;
+}
@@ -56,6 +56,8 @@ typedef struct CompactionRule
     timestamp_t startCurrentTimeBucket; // Beware that the first bucket is alway starting in 0 no
                                         // matter the alignment
     bool validSamplesInBucket;          // Are there any valid samples in current bucket
+    timestamp_t watermark; // the buckets starting at or after it hold all the samples of the
+                           // source, those before may have been created before the rule
 } CompactionRule;
 
 typedef struct Series
@@ -78,6 +80,10 @@ typedef struct Series
     long long ignoreMaxTimeDiff;
     double ignoreMaxValDiff;
     bool in_ram; // false if the key is on flash (relevant only for RoF)
+    // Samples not yet applied to the rules, see async_compaction.h (ts-compaction-async)
+    struct CompactionQueue *compactionQueue;
+    // Changes whenever samples before the last one do, unique among the series, see query_cache.h
+    uint64_t version;
 } Series;
 
 // process C's modulo result to translate from a negative modulo to a positive
@@ -98,13 +104,24 @@ static inline timestamp_t BucketStartNormalize(timestamp_t bucketTS) {
     return max(0, (int64_t)bucketTS);
 }
 
+// The watermark of a rule created over a source whose last sample is at lastTimestamp: the
+// bucket of that sample only gets the samples that follow, the next one is whole
+static inline timestamp_t RuleWatermarkAfter(const CompactionRule *rule,
+                                             timestamp_t lastTimestamp) {
+    return CalcBucketStart(lastTimestamp, rule->bucketDuration, rule->timestampAlignment) +
+           rule->bucketDuration;
+}
+
 Series *NewSeries(RedisModuleString *keyName, const CreateCtx *cCtx);
 void FreeSeries(void *value);
+void UnlinkSeries(RedisModuleString *key, const void *value);
 int DefragSeries(RedisModuleDefragCtx *ctx, RedisModuleString *key, void **value);
 void *CopySeries(RedisModuleString *fromkey, RedisModuleString *tokey, const void *value);
 void RenameSeriesFrom(RedisModuleCtx *ctx, RedisModuleString *key);
 void IndexMetricFromName(RedisModuleCtx *ctx, RedisModuleString *keyname);
 void RenameSeriesTo(RedisModuleCtx *ctx, RedisModuleString *key);
+// The key of a series was moved to the selected db of ctx
+void MoveSeriesTo(RedisModuleCtx *ctx, RedisModuleString *key);
 void RestoreKey(RedisModuleCtx *ctx, RedisModuleString *keyname);
 
 CompactionRule *GetRule(CompactionRule *rules, RedisModuleString *keyName);
@@ -119,11 +136,22 @@ GetSeriesResult GetSeries(RedisModuleCtx *ctx,
                           Series **series,
                           int mode,
                           const GetSeriesFlags flags);
+// Like GetSeries, but a wide series is opened into *wide, with *series set to NULL
+typedef struct WideSeries WideSeries;
+GetSeriesResult GetSeriesOrWideSeries(RedisModuleCtx *ctx,
+                                      RedisModuleString *keyName,
+                                      RedisModuleKey **key,
+                                      Series **series,
+                                      WideSeries **wide,
+                                      int mode,
+                                      const GetSeriesFlags flags);
 
 AbstractIterator *SeriesQuery(Series *series,
                               const RangeArgs *args,
                               bool reserve,
                               bool check_retention);
+// Runs SeriesQuery to the end (or to args->count samples) into a single EnrichedChunk
+EnrichedChunk *SeriesQueryMaterialize(Series *series, const RangeArgs *args, bool reverse);
 AbstractSampleIterator *SeriesCreateSampleIterator(Series *series,
                                                    const RangeArgs *args,
                                                    bool reverse,
@@ -145,6 +173,8 @@ AbstractSampleIterator *MultiSeriesCreateAggDupSampleIterator(Series **series,
 void FreeCompactionRule(void *value);
 size_t SeriesMemUsage(const void *value);
 
+// Size of a new chunk of the series, CHUNK_SIZE AUTO chunks start small and grow on demand
+size_t SeriesNewChunkSize(const Series *series);
 void SeriesAddSample(Series *series, api_timestamp_t timestamp, double value);
 int SeriesUpsertSample(Series *series,
                        api_timestamp_t timestamp,
@@ -202,4 +232,8 @@ void seriesEncodeTimestamp(void *buf, timestamp_t timestamp);
 
 void calculate_latest_sample(Sample **sample, const Series *series);
 
+// Returns a private copy of the chunks, labels and metadata of the series that a query with args
+// reads, so that the query can run on it without the GIL. LATEST is resolved here.
+Series *SeriesSnapshot(Series *series, const RangeArgs *args);
+
 #endif /* TSDB_H */
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2006-Present, Redis Ltd.
+ * All rights reserved.
+ *
+ * Licensed under your choice of (a) the Redis Source Available License 2.0
+ * (RSALv2); or (b) the Server Side Public License v1 (SSPLv1); or (c) the
+ * GNU Affero General Public License v3 (AGPLv3).
+ */
+#include "thread_pool.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "rmutil/alloc.h"
+
+typedef struct ThreadPoolJob
+{
+    ThreadPoolTask task;
+    void *arg;
+    struct ThreadPoolJob *next;
+} ThreadPoolJob;
+
+struct ThreadPool
+{
+    pthread_mutex_t lock;
+    pthread_cond_t hasJobs;
+    ThreadPoolJob *head;
+    ThreadPoolJob *tail;
+    size_t numThreads;
+};
+
+static void *ThreadPool_WorkerMain(void *arg) {
+    ThreadPool *pool = arg;
+
+    while (true) {
+        pthread_mutex_lock(&pool->lock);
+        while (pool->head == NULL) {
+            pthread_cond_wait(&pool->hasJobs, &pool->lock);
+        }
+        ThreadPoolJob *job = pool->head;
+        pool->head = job->next;
+        if (pool->head == NULL) {
+            pool->tail = NULL;
+        }
+        pthread_mutex_unlock(&pool->lock);
+
+        job->task(job->arg);
+        free(job);
+    }
+
+    return NULL;
+}
+
+ThreadPool *ThreadPool_New(void) {
+    ThreadPool *pool = calloc(1, sizeof(*pool));
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->hasJobs, NULL);
+    return pool;
+}
+
+size_t ThreadPool_EnsureThreads(ThreadPool *pool, size_t numThreads) {
+    pthread_mutex_lock(&pool->lock);
+    if (pool->numThreads < numThreads) {
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        while (pool->numThreads < numThreads) {
+            pthread_t thread;
+            if (pthread_create(&thread, &attr, ThreadPool_WorkerMain, pool) != 0) {
+                break;
+            }
+            ++pool->numThreads;
+        }
+        pthread_attr_destroy(&attr);
+    }
+    const size_t started = pool->numThreads;
+    pthread_mutex_unlock(&pool->lock);
+    return started;
+}
+
+void ThreadPool_Submit(ThreadPool *pool, ThreadPoolTask task, void *arg) {
+    ThreadPoolJob *job = malloc(sizeof(*job));
+    job->task = task;
+    job->arg = arg;
+    job->next = NULL;
+
+    pthread_mutex_lock(&pool->lock);
+    if (pool->tail) {
+        pool->tail->next = job;
+    } else {
+        pool->head = job;
+    }
+    pool->tail = job;
+    pthread_cond_signal(&pool->hasJobs);
+    pthread_mutex_unlock(&pool->lock);
+}
@@ -0,0 +1,29 @@
+/*
+ * Copyright (c) 2006-Present, Redis Ltd.
+ * All rights reserved.
+ *
+ * Licensed under your choice of (a) the Redis Source Available License 2.0
+ * (RSALv2); or (b) the Server Side Public License v1 (SSPLv1); or (c) the
+ * GNU Affero General Public License v3 (AGPLv3).
+ */
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <stddef.h>
+
+/*
+ * A minimal FIFO pool of detached worker threads. Tasks run without the GIL and must only touch
+ * data they own.
+ */
+typedef struct ThreadPool ThreadPool;
+typedef void (*ThreadPoolTask)(void *arg);
+
+ThreadPool *ThreadPool_New(void);
+
+// Starts threads until the pool has numThreads of them. Threads are never stopped, so the pool
+// only grows. Returns the number of threads of the pool.
+size_t ThreadPool_EnsureThreads(ThreadPool *pool, size_t numThreads);
+
+void ThreadPool_Submit(ThreadPool *pool, ThreadPoolTask task, void *arg);
+
+#endif // THREAD_POOL_H
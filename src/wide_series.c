@@ -0,0 +1,494 @@
+/*
+ * Copyright (c) 2006-Present, Redis Ltd.
+ * All rights reserved.
+ *
+ * Licensed under your choice of (a) the Redis Source Available License 2.0
+ * (RSALv2); or (b) the Server Side Public License v1 (SSPLv1); or (c) the
+ * GNU Affero General Public License v3 (AGPLv3).
+ */
+#include "wide_series.h"
+
+#include "chunk.h"
+#include "common.h"
+#include "compressed_chunk.h"
+#include "enriched_chunk.h"
+#include "load_io_error_macros.h"
+
+#include <string.h>
+#include "rmutil/alloc.h"
+
+// Worst case size of one sample in a stream: 6 control bits + 64 bits for a timestamp,
+// 2 control bits + 5 + 6 + 64 bits for a value
+#define WIDE_STREAM_MAX_SAMPLE_BITS 80
+
+/************************
+ *  Field chunk views   *
+ ************************/
+static void WideField_ProcessChunk(const Chunk_t *chunk,
+                                   uint64_t start,
+                                   uint64_t end,
+                                   EnrichedChunk *enrichedChunk,
+                                   bool reverse) {
+    const WideFieldChunk *fieldChunk = chunk;
+    const WideChunk *wideChunk = fieldChunk->chunk;
+    const CompressedChunk *timestamps = wideChunk->timestamps;
+    const uint64_t numSamples = timestamps->count;
+
+    ResetEnrichedChunk(enrichedChunk);
+    if (unlikely(numSamples == 0 || end < start || timestamps->baseTimestamp > end ||
+                 timestamps->prevTimestamp < start)) {
+        return;
+    }
+
+    Samples *samples = &enrichedChunk->samples;
+    Compressed_DecodeTimestamps(timestamps, samples->timestamps);
+    Compressed_DecodeValues(wideChunk->values[fieldChunk->field], samples->_values);
+
+    size_t first = 0;
+    while (first < numSamples && samples->timestamps[first] < start) {
+        ++first;
+    }
+    size_t last = numSamples;
+    while (last > first && samples->timestamps[last - 1] > end) {
+        --last;
+    }
+    samples->timestamps += first;
+    samples->_values += first;
+    samples->num_samples = last - first;
+
+    if (unlikely(reverse)) {
+        reverseEnrichedChunk(enrichedChunk);
+    }
+}
+
+static uint64_t WideField_GetNumOfSample(Chunk_t *chunk) {
+    return ((WideFieldChunk *)chunk)->chunk->timestamps->count;
+}
+
+static uint64_t WideField_GetFirstTimestamp(Chunk_t *chunk) {
+    return ((WideFieldChunk *)chunk)->chunk->timestamps->baseTimestamp;
+}
+
+static uint64_t WideField_GetLastTimestamp(Chunk_t *chunk) {
+    return ((WideFieldChunk *)chunk)->chunk->timestamps->prevTimestamp;
+}
+
+static double WideField_GetLastValue(Chunk_t *chunk) {
+    const WideFieldChunk *fieldChunk = chunk;
+    return fieldChunk->chunk->values[fieldChunk->field]->prevValue.d;
+}
+
+static size_t WideField_GetChunkSize(const Chunk_t *chunk, bool includeStruct) {
+    const WideFieldChunk *fieldChunk = chunk;
+    return Compressed_GetChunkSize(fieldChunk->chunk->values[fieldChunk->field], includeStruct);
+}
+
+// Field views are only read through SeriesQuery, the write paths are left unset
+static const ChunkFuncs wideFieldChunkFuncs = {
+    .ProcessChunk = WideField_ProcessChunk,
+    .GetChunkSize = WideField_GetChunkSize,
+    .GetNumOfSample = WideField_GetNumOfSample,
+    .GetLastTimestamp = WideField_GetLastTimestamp,
+    .GetLastValue = WideField_GetLastValue,
+    .GetFirstTimestamp = WideField_GetFirstTimestamp,
+};
+
+/************************
+ *     Wide chunks      *
+ ************************/
+static WideChunk *allocWideChunk(size_t numFields) {
+    WideChunk *chunk = calloc(1, sizeof(*chunk));
+    chunk->numFields = numFields;
+    chunk->values = calloc(numFields, sizeof(*chunk->values));
+    chunk->fieldChunks = malloc(numFields * sizeof(*chunk->fieldChunks));
+    for (size_t i = 0; i < numFields; ++i) {
+        chunk->fieldChunks[i] = (WideFieldChunk){ .chunk = chunk, .field = i };
+    }
+    return chunk;
+}
+
+static WideChunk *newWideChunk(size_t numFields, size_t chunkSizeBytes) {
+    WideChunk *chunk = allocWideChunk(numFields);
+    chunk->timestamps = Compressed_NewChunk(chunkSizeBytes);
+    for (size_t i = 0; i < numFields; ++i) {
+        chunk->values[i] = Compressed_NewChunk(chunkSizeBytes);
+    }
+    return chunk;
+}
+
+static void freeWideChunk(WideChunk *chunk) {
+    if (chunk->timestamps) {
+        Compressed_FreeChunk(chunk->timestamps);
+    }
+    for (size_t i = 0; i < chunk->numFields; ++i) {
+        if (chunk->values[i]) {
+            Compressed_FreeChunk(chunk->values[i]);
+        }
+    }
+    free(chunk->values);
+    free(chunk->fieldChunks);
+    free(chunk);
+}
+
+static size_t wideChunkMemUsage(const WideChunk *chunk) {
+    size_t size = RedisModule_MallocSize((void *)chunk) + RedisModule_MallocSize(chunk->values) +
+                  RedisModule_MallocSize(chunk->fieldChunks) +
+                  Compressed_GetChunkSize(chunk->timestamps, true);
+    for (size_t i = 0; i < chunk->numFields; ++i) {
+        size += Compressed_GetChunkSize(chunk->values[i], true);
+    }
+    return size;
+}
+
+static bool streamHasRoom(const CompressedChunk *stream) {
+    return stream->size * 8 - stream->idx >= WIDE_STREAM_MAX_SAMPLE_BITS;
+}
+
+// Whether a row is guaranteed to fit, so that a row is never split between two chunks
+static bool rowFits(const WideChunk *chunk) {
+    if (!streamHasRoom(chunk->timestamps)) {
+        return false;
+    }
+    for (size_t i = 0; i < chunk->numFields; ++i) {
+        if (!streamHasRoom(chunk->values[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/************************
+ *     Wide series      *
+ ************************/
+WideSeries *NewWideSeries(RedisModuleString **fieldNames,
+                          size_t numFields,
+                          uint64_t retentionTime,
+                          long long chunkSizeBytes) {
+    WideSeries *series = calloc(1, sizeof(*series));
+    series->chunks = RedisModule_CreateDict(NULL);
+    series->numFields = numFields;
+    series->fieldNames = fieldNames;
+    series->retentionTime = retentionTime;
+    series->chunkSizeBytes = chunkSizeBytes;
+
+    series->fields = calloc(numFields, sizeof(*series->fields));
+    for (size_t i = 0; i < numFields; ++i) {
+        Series *field = &series->fields[i];
+        field->chunks = RedisModule_CreateDict(NULL);
+        field->funcs = &wideFieldChunkFuncs;
+        field->retentionTime = retentionTime;
+        field->chunkSizeBytes = chunkSizeBytes;
+        field->in_ram = true;
+    }
+    return series;
+}
+
+void FreeWideSeries(void *value) {
+    WideSeries *series = value;
+
+    RedisModuleDictIter *iter = RedisModule_DictIteratorStartC(series->chunks, "^", NULL, 0);
+    WideChunk *chunk;
+    while (RedisModule_DictNextC(iter, NULL, (void **)&chunk)) {
+        freeWideChunk(chunk);
+    }
+    RedisModule_DictIteratorStop(iter);
+    RedisModule_FreeDict(NULL, series->chunks);
+
+    for (size_t i = 0; i < series->numFields; ++i) {
+        RedisModule_FreeDict(NULL, series->fields[i].chunks);
+        if (series->fieldNames[i]) {
+            RedisModule_FreeString(NULL, series->fieldNames[i]);
+        }
+    }
+    free(series->fields);
+    free(series->fieldNames);
+    free(series);
+}
+
+size_t WideSeriesMemUsage(const void *value) {
+    const WideSeries *series = value;
+    size_t size = RedisModule_MallocSize((void *)series) +
+                  RedisModule_MallocSize(series->fields) +
+                  RedisModule_MallocSize(series->fieldNames);
+    for (size_t i = 0; i < series->numFields; ++i) {
+        size += RedisModule_MallocSizeString(series->fieldNames[i]);
+    }
+
+    RedisModuleDictIter *iter = RedisModule_DictIteratorStartC(series->chunks, "^", NULL, 0);
+    WideChunk *chunk;
+    while (RedisModule_DictNextC(iter, NULL, (void **)&chunk)) {
+        size += wideChunkMemUsage(chunk);
+    }
+    RedisModule_DictIteratorStop(iter);
+    return size;
+}
+
+int WideSeriesFieldIndex(const WideSeries *series, RedisModuleString *name) {
+    for (size_t i = 0; i < series->numFields; ++i) {
+        if (RedisModule_StringCompare(series->fieldNames[i], name) == 0) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+// Registers a chunk in the series and in every field view, keyed by its first timestamp
+static void attachChunk(WideSeries *series, WideChunk *chunk, timestamp_t firstTimestamp) {
+    dictOperator(series->chunks, chunk, firstTimestamp, DICT_OP_SET);
+    for (size_t i = 0; i < series->numFields; ++i) {
+        dictOperator(series->fields[i].chunks, &chunk->fieldChunks[i], firstTimestamp, DICT_OP_SET);
+    }
+    series->lastChunk = chunk;
+}
+
+// Appends a full chunk, newer than the last row, e.g. loaded or copied
+static void appendChunk(WideSeries *series, WideChunk *chunk) {
+    const uint64_t count = chunk->timestamps->count;
+    attachChunk(series, chunk, chunk->timestamps->baseTimestamp);
+    series->lastTimestamp = chunk->timestamps->prevTimestamp;
+    series->totalSamples += count;
+    for (size_t i = 0; i < series->numFields; ++i) {
+        Series *field = &series->fields[i];
+        field->lastTimestamp = series->lastTimestamp;
+        field->lastValue = chunk->values[i]->prevValue.d;
+        field->totalSamples += count;
+    }
+}
+
+static void detachChunk(WideSeries *series, WideChunk *chunk) {
+    const timestamp_t firstTimestamp = chunk->timestamps->baseTimestamp;
+    const uint64_t count = chunk->timestamps->count;
+    dictOperator(series->chunks, NULL, firstTimestamp, DICT_OP_DEL);
+    series->totalSamples -= count;
+    for (size_t i = 0; i < series->numFields; ++i) {
+        dictOperator(series->fields[i].chunks, NULL, firstTimestamp, DICT_OP_DEL);
+        series->fields[i].totalSamples -= count;
+    }
+}
+
+// Drops the chunks that are entirely out of the retention window, same as SeriesTrim
+static void trimWideSeries(WideSeries *series) {
+    if (series->retentionTime == 0 || series->lastTimestamp <= series->retentionTime) {
+        return;
+    }
+    const timestamp_t minTimestamp = series->lastTimestamp - series->retentionTime;
+
+    while (true) {
+        RedisModuleDictIter *iter = RedisModule_DictIteratorStartC(series->chunks, "^", NULL, 0);
+        WideChunk *chunk = NULL;
+        RedisModule_DictNextC(iter, NULL, (void **)&chunk);
+        RedisModule_DictIteratorStop(iter);
+
+        if (chunk == NULL || chunk == series->lastChunk ||
+            chunk->timestamps->prevTimestamp >= minTimestamp) {
+            break;
+        }
+        detachChunk(series, chunk);
+        freeWideChunk(chunk);
+    }
+}
+
+int WideSeriesAddRow(WideSeries *series, timestamp_t timestamp, const double *values) {
+    if (series->totalSamples > 0 && timestamp <= series->lastTimestamp) {
+        return TSDB_ERROR;
+    }
+
+    if (series->lastChunk == NULL || !rowFits(series->lastChunk)) {
+        attachChunk(series,
+                    newWideChunk(series->numFields, series->chunkSizeBytes),
+                    timestamp);
+    }
+
+    // rowFits guarantees room in every stream, the appends below can't fail
+    WideChunk *chunk = series->lastChunk;
+    Compressed_AppendTimestamp(chunk->timestamps, timestamp);
+    for (size_t i = 0; i < series->numFields; ++i) {
+        Compressed_AppendValue(chunk->values[i], values[i]);
+
+        Series *field = &series->fields[i];
+        field->lastTimestamp = timestamp;
+        field->lastValue = values[i];
+        field->totalSamples++;
+    }
+    series->lastTimestamp = timestamp;
+    series->totalSamples++;
+
+    trimWideSeries(series);
+    return TSDB_OK;
+}
+
+void *CopyWideSeries(RedisModuleString *fromkey, RedisModuleString *tokey, const void *value) {
+    const WideSeries *src = value;
+
+    RedisModuleString **fieldNames = malloc(src->numFields * sizeof(*fieldNames));
+    for (size_t i = 0; i < src->numFields; ++i) {
+        fieldNames[i] = RedisModule_CreateStringFromString(NULL, src->fieldNames[i]);
+    }
+    WideSeries *dst =
+        NewWideSeries(fieldNames, src->numFields, src->retentionTime, src->chunkSizeBytes);
+
+    RedisModuleDictIter *iter = RedisModule_DictIteratorStartC(src->chunks, "^", NULL, 0);
+    WideChunk *chunk;
+    while (RedisModule_DictNextC(iter, NULL, (void **)&chunk)) {
+        WideChunk *newChunk = allocWideChunk(src->numFields);
+        newChunk->timestamps = Compressed_CloneChunk(chunk->timestamps);
+        for (size_t i = 0; i < src->numFields; ++i) {
+            newChunk->values[i] = Compressed_CloneChunk(chunk->values[i]);
+        }
+        appendChunk(dst, newChunk);
+    }
+    RedisModule_DictIteratorStop(iter);
+    return dst;
+}
+
+// Moves the chunk and its streams. The field views point into fieldChunks, which stays in place.
+static int defragWideChunk(RedisModuleDefragCtx *ctx,
+                           void *data,
+                           __unused unsigned char *key,
+                           __unused size_t keylen,
+                           void **newptr) {
+    WideChunk *chunk = defragPtr(ctx, data);
+    for (size_t i = 0; i < chunk->numFields; ++i) {
+        chunk->fieldChunks[i].chunk = chunk;
+    }
+    void *stream;
+    Compressed_DefragChunk(ctx, chunk->timestamps, NULL, 0, &stream);
+    chunk->timestamps = stream;
+    chunk->values = defragPtr(ctx, chunk->values);
+    for (size_t i = 0; i < chunk->numFields; ++i) {
+        Compressed_DefragChunk(ctx, chunk->values[i], NULL, 0, &stream);
+        chunk->values[i] = stream;
+    }
+    *newptr = chunk;
+    return DefragStatus_Finished;
+}
+
+int DefragWideSeries(RedisModuleDefragCtx *ctx, RedisModuleString *key, void **value) {
+    static RedisModuleString *seekTo = NULL;
+    WideSeries *series = *value;
+
+    // first defrag of this key
+    if (seekTo == NULL) {
+        series = defragPtr(ctx, series);
+        series->fields = defragPtr(ctx, series->fields);
+        series->fieldNames = defragPtr(ctx, series->fieldNames);
+        for (size_t i = 0; i < series->numFields; ++i) {
+            series->fieldNames[i] = defragString(ctx, series->fieldNames[i]);
+        }
+    }
+
+    series->chunks = defragDict(ctx, series->chunks, defragWideChunk, &seekTo);
+    *value = series;
+    if (seekTo != NULL) {
+        return DefragStatus_Paused;
+    }
+    // defrag finished, lastChunk must be updated to the new address
+    RedisModuleDictIter *iter = RedisModule_DictIteratorStartC(series->chunks, "$", NULL, 0);
+    RedisModule_DictNextC(iter, NULL, (void **)&series->lastChunk);
+    RedisModule_DictIteratorStop(iter);
+    return DefragStatus_Finished;
+}
+
+// The number of allocations freed, for Redis to free large series in the background
+size_t WideSeriesFreeEffort(RedisModuleString *key, const void *value) {
+    const WideSeries *series = value;
+    return RedisModule_DictSize(series->chunks) * (series->numFields + 1);
+}
+
+/************************
+ *         RDB          *
+ ************************/
+void wide_series_rdb_save(RedisModuleIO *io, void *value) {
+    const WideSeries *series = value;
+
+    RedisModule_SaveUnsigned(io, series->numFields);
+    for (size_t i = 0; i < series->numFields; ++i) {
+        RedisModule_SaveString(io, series->fieldNames[i]);
+    }
+    RedisModule_SaveUnsigned(io, series->retentionTime);
+    RedisModule_SaveUnsigned(io, series->chunkSizeBytes);
+
+    RedisModule_SaveUnsigned(io, RedisModule_DictSize(series->chunks));
+    RedisModuleDictIter *iter = RedisModule_DictIteratorStartC(series->chunks, "^", NULL, 0);
+    WideChunk *chunk;
+    while (RedisModule_DictNextC(iter, NULL, (void **)&chunk)) {
+        Compressed_SaveToRDB(chunk->timestamps, io);
+        for (size_t i = 0; i < series->numFields; ++i) {
+            Compressed_SaveToRDB(chunk->values[i], io);
+        }
+    }
+    RedisModule_DictIteratorStop(iter);
+}
+
+void *wide_series_rdb_load(RedisModuleIO *io, int encver) {
+    if (encver != WIDE_SERIES_ENC_VER) {
+        RedisModule_LogIOError(io, "error", "data is not in the correct encoding");
+        return NULL;
+    }
+
+    bool err = false;
+    __blocked WideSeries *series = NULL;
+
+    const uint64_t numFields = LoadUnsigned_IOError(io, err, NULL);
+    if (numFields == 0 || numFields > WIDE_SERIES_MAX_FIELDS) {
+        RedisModule_LogIOError(io, "error", "invalid number of fields in a wide series");
+        return NULL;
+    }
+    __blocked RedisModuleString **fieldNames = calloc(numFields, sizeof(*fieldNames));
+    errdefer(err, if (!series) {
+        for (size_t i = 0; i < numFields; ++i) {
+            if (fieldNames[i]) {
+                RedisModule_FreeString(NULL, fieldNames[i]);
+            }
+        }
+        free(fieldNames);
+    });
+    for (size_t i = 0; i < numFields; ++i) {
+        fieldNames[i] = LoadString_IOError(io, err, NULL);
+    }
+
+    const uint64_t retentionTime = LoadUnsigned_IOError(io, err, NULL);
+    const uint64_t chunkSizeBytes = LoadUnsigned_IOError(io, err, NULL);
+    if (chunkSizeBytes == 0 || chunkSizeBytes % 8 != 0) {
+        RedisModule_LogIOError(io, "error", "chunkSizeBytes must be a non-zero multiple of 8");
+        err = true;
+        return NULL;
+    }
+
+    series = NewWideSeries(fieldNames, numFields, retentionTime, chunkSizeBytes);
+    errdefer(err, FreeWideSeries(series));
+
+    const uint64_t numChunks = LoadUnsigned_IOError(io, err, NULL);
+    for (uint64_t c = 0; c < numChunks; ++c) {
+        __blocked WideChunk *chunk = allocWideChunk(numFields);
+        errdefer(err, if (chunk) freeWideChunk(chunk));
+
+        if (Compressed_LoadStreamFromRDB(&chunk->timestamps, io) != TSDB_OK) {
+            err = true;
+            return NULL;
+        }
+        const uint64_t count = chunk->timestamps->count;
+        for (size_t i = 0; i < numFields; ++i) {
+            if (Compressed_LoadStreamFromRDB(&chunk->values[i], io) != TSDB_OK) {
+                err = true;
+                return NULL;
+            }
+            if (chunk->values[i]->count != count) {
+                RedisModule_LogIOError(io, "error", "wide series streams are not aligned");
+                err = true;
+                return NULL;
+            }
+        }
+        if (count == 0 ||
+            (series->totalSamples > 0 && chunk->timestamps->baseTimestamp <= series->lastTimestamp)) {
+            RedisModule_LogIOError(io, "error", "invalid wide series chunk");
+            err = true;
+            return NULL;
+        }
+
+        appendChunk(series, chunk);
+        chunk = NULL; // owned by the series
+    }
+
+    return series;
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2006-Present, Redis Ltd.
+ * All rights reserved.
+ *
+ * Licensed under your choice of (a) the Redis Source Available License 2.0
+ * (RSALv2); or (b) the Server Side Public License v1 (SSPLv1); or (c) the
+ * GNU Affero General Public License v3 (AGPLv3).
+ */
+#ifndef WIDE_SERIES_H
+#define WIDE_SERIES_H
+
+#include "consts.h"
+#include "gorilla.h"
+#include "tsdb.h"
+
+#include "RedisModulesSDK/redismodule.h"
+
+#include <stddef.h>
+
+/*
+ * Wide series (TS.WCREATE / TS.WADD): a key holding a fixed list of fields that are always
+ * sampled together, e.g. cpu user/system/idle/iowait or open/high/low/close.
+ *
+ * A chunk holds a single Gorilla timestamp stream shared by all the fields and one Gorilla value
+ * stream per field, so a timestamp is stored once per row and a row is written with a single
+ * key open. Each stream has chunkSizeBytes of capacity and a new chunk is started as soon as one
+ * of them may not fit another sample.
+ *
+ * Every field is also exposed as a read-only Series (WideSeries.fields) whose chunks are views
+ * on the wide chunks, so SeriesQuery - with its filters and aggregations - runs on a field as
+ * on any other series. Wide series are append-only and have no labels or compaction rules.
+ */
+
+#define WIDE_SERIES_ENC_VER 0
+#define WIDE_SERIES_MAX_FIELDS 1024
+
+typedef struct WideChunk WideChunk;
+
+// A single field of a wide chunk, held by the chunks dict of the field's Series
+typedef struct WideFieldChunk
+{
+    WideChunk *chunk;
+    size_t field;
+} WideFieldChunk;
+
+struct WideChunk
+{
+    CompressedChunk *timestamps;
+    CompressedChunk **values; // one stream per field
+    WideFieldChunk *fieldChunks;
+    size_t numFields;
+};
+
+typedef struct WideSeries
+{
+    RedisModuleDict *chunks; // first timestamp -> WideChunk
+    WideChunk *lastChunk;
+    size_t numFields;
+    RedisModuleString **fieldNames;
+    Series *fields; // read-only per-field views, see above
+    uint64_t retentionTime;
+    long long chunkSizeBytes; // capacity of each stream of a chunk
+    timestamp_t lastTimestamp;
+    size_t totalSamples; // number of rows
+} WideSeries;
+
+// Takes ownership of fieldNames and of the strings it holds
+WideSeries *NewWideSeries(RedisModuleString **fieldNames,
+                          size_t numFields,
+                          uint64_t retentionTime,
+                          long long chunkSizeBytes);
+void FreeWideSeries(void *value);
+void *CopyWideSeries(RedisModuleString *fromkey, RedisModuleString *tokey, const void *value);
+int DefragWideSeries(RedisModuleDefragCtx *ctx, RedisModuleString *key, void **value);
+size_t WideSeriesFreeEffort(RedisModuleString *key, const void *value);
+size_t WideSeriesMemUsage(const void *value);
+
+// Appends a row of numFields values. Fails if timestamp isn't newer than the last row.
+int WideSeriesAddRow(WideSeries *series, timestamp_t timestamp, const double *values);
+
+// Returns the index of the field, or -1
+int WideSeriesFieldIndex(const WideSeries *series, RedisModuleString *name);
+
+void *wide_series_rdb_load(RedisModuleIO *io, int encver);
+void wide_series_rdb_save(RedisModuleIO *io, void *value);
+
+#endif // WIDE_SERIES_H
@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2006-Present, Redis Ltd.
+ * All rights reserved.
+ *
+ * Licensed under your choice of (a) the Redis Source Available License 2.0
+ * (RSALv2); or (b) the Server Side Public License v1 (SSPLv1); or (c) the
+ * GNU Affero General Public License v3 (AGPLv3).
+ */
+#include "window_iterator.h"
+
+#include "compaction.h"
+#include "enriched_chunk.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include "rmutil/alloc.h"
+
+// Adds value to the last size values, returning their average
+static double windowSum(WindowColumn *column, size_t size, double value) {
+    if (column->len == size) {
+        const double oldest = column->values[column->head];
+        column->sum -= oldest;
+        column->sum_2 -= oldest * oldest;
+        column->values[column->head] = value;
+        column->head = (column->head + 1) % size;
+    } else {
+        column->values[(column->head + column->len) % size] = value;
+        column->len++;
+    }
+    column->sum += value;
+    column->sum_2 += value * value;
+
+    // subtracting the old values accumulates rounding errors, they are dropped once per window
+    if (++column->sinceResum == size) {
+        column->sinceResum = 0;
+        column->sum = 0;
+        column->sum_2 = 0;
+        for (size_t i = 0; i < column->len; ++i) {
+            column->sum += column->values[i];
+            column->sum_2 += column->values[i] * column->values[i];
+        }
+    }
+    return column->sum / column->len;
+}
+
+// Adds value to the deque of the last size values, returning their minimum or maximum
+static double windowExtreme(WindowColumn *column, size_t size, double value, bool isMax) {
+    const uint64_t seq = column->seq++;
+    if (column->dequeLen > 0 && column->dequeSeqs[column->dequeHead] + size <= seq) {
+        // out of the window, at most one value per added value
+        column->dequeHead = (column->dequeHead + 1) % size;
+        column->dequeLen--;
+    }
+    while (column->dequeLen > 0) {
+        const double back = column->dequeValues[(column->dequeHead + column->dequeLen - 1) % size];
+        if (isMax ? back > value : back < value) {
+            break;
+        }
+        column->dequeLen--;
+    }
+    const size_t tail = (column->dequeHead + column->dequeLen) % size;
+    column->dequeSeqs[tail] = seq;
+    column->dequeValues[tail] = value;
+    column->dequeLen++;
+    return column->dequeValues[column->dequeHead];
+}
+
+static double windowApply(const WindowArgs *args, WindowColumn *column, double value) {
+    switch (args->type) {
+        case WINDOW_SMA:
+            return windowSum(column, args->size, value);
+        case WINDOW_STD:
+            windowSum(column, args->size, value);
+            return sqrt(max(VarianceFromSums(column->sum, column->sum_2, column->len), 0));
+        case WINDOW_MIN:
+            return windowExtreme(column, args->size, value, false);
+        case WINDOW_MAX:
+            return windowExtreme(column, args->size, value, true);
+        case WINDOW_EWMA:
+            column->ewma = column->seq++ == 0
+                               ? value
+                               : args->alpha * value + (1 - args->alpha) * column->ewma;
+            return column->ewma;
+        case WINDOW_NONE:
+            break;
+    }
+    return value;
+}
+
+static void allocColumns(WindowIterator *self, size_t numColumns) {
+    self->numColumns = numColumns;
+    self->columns = calloc(numColumns, sizeof(*self->columns));
+    const size_t size = self->args.size;
+    for (size_t c = 0; c < numColumns; ++c) {
+        WindowColumn *column = &self->columns[c];
+        if (self->args.type == WINDOW_SMA || self->args.type == WINDOW_STD) {
+            column->values = malloc(size * sizeof(*column->values));
+        } else if (self->args.type == WINDOW_MIN || self->args.type == WINDOW_MAX) {
+            column->dequeSeqs = malloc(size * sizeof(*column->dequeSeqs));
+            column->dequeValues = malloc(size * sizeof(*column->dequeValues));
+        }
+    }
+}
+
+EnrichedChunk *WindowIterator_GetNextChunk(struct AbstractIterator *iter) {
+    WindowIterator *self = (WindowIterator *)iter;
+    EnrichedChunk *chunk = self->base.input->GetNext(self->base.input);
+    if (!chunk) {
+        return NULL;
+    }
+
+    Samples *samples = &chunk->samples;
+    if (!self->columns) {
+        allocColumns(self, samples->values_per_sample);
+    }
+    // the values are replaced in place, the timestamps are kept
+    for (size_t i = 0; i < samples->num_samples; ++i) {
+        for (size_t c = 0; c < self->numColumns; ++c) {
+            const double value = Samples_value_at(samples, i, c);
+            if (!isnan(value)) {
+                Samples_value_at(samples, i, c) =
+                    windowApply(&self->args, &self->columns[c], value);
+            }
+        }
+    }
+    return chunk;
+}
+
+WindowIterator *WindowIterator_New(AbstractIterator *input, const WindowArgs *args) {
+    WindowIterator *iter = calloc(1, sizeof(*iter));
+    iter->base.GetNext = WindowIterator_GetNextChunk;
+    iter->base.Close = WindowIterator_Close;
+    iter->base.input = input;
+    iter->args = *args;
+    return iter;
+}
+
+void WindowIterator_Close(struct AbstractIterator *iterator) {
+    WindowIterator *self = (WindowIterator *)iterator;
+    iterator->input->Close(iterator->input);
+    for (size_t c = 0; c < self->numColumns; ++c) {
+        free(self->columns[c].values);
+        free(self->columns[c].dequeSeqs);
+        free(self->columns[c].dequeValues);
+    }
+    free(self->columns);
+    free(self);
+}
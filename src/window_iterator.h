@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2006-Present, Redis Ltd.
+ * All rights reserved.
+ *
+ * Licensed under your choice of (a) the Redis Source Available License 2.0
+ * (RSALv2); or (b) the Server Side Public License v1 (SSPLv1); or (c) the
+ * GNU Affero General Public License v3 (AGPLv3).
+ */
+#ifndef WINDOW_ITERATOR_H
+#define WINDOW_ITERATOR_H
+
+#include "abstract_iterator.h"
+#include "query_language.h"
+
+/*
+ * TS.RANGE/TS.MRANGE/TS.NRANGE ... WINDOW sma|std|min|max size
+ *                                  WINDOW ewma alpha
+ *
+ * Replaces every sample by a function of the samples before it, after the aggregation if any:
+ *
+ * sma  the average of the last size samples
+ * std  the population standard deviation of the last size samples
+ * min  the minimum of the last size samples, kept in a monotonic deque
+ * max  the maximum of the last size samples, kept in a monotonic deque
+ * ewma alpha * value + (1 - alpha) * the ewma of the previous sample, starting with the first value
+ *
+ * The windows hold the samples in the order of the reply, which goes back in time for the
+ * REVRANGE commands, and are shorter than size for the first samples. NaN samples are replied as
+ * they are and left out of the windows. The state is carried from a chunk to the next, so every
+ * sample costs O(1) amortized.
+ */
+
+// The state of the window of a value column
+typedef struct WindowColumn
+{
+    // sma and std: the last size values and their sums
+    double *values;
+    size_t head; // the oldest value
+    size_t len;
+    double sum;
+    double sum_2;
+    size_t sinceResum; // values added since the sums were recomputed
+    // min and max: the values that can still become the extreme of the window, in order
+    uint64_t *dequeSeqs;
+    double *dequeValues;
+    size_t dequeHead;
+    size_t dequeLen;
+    uint64_t seq; // the number of values added
+    // ewma
+    double ewma;
+} WindowColumn;
+
+typedef struct WindowIterator
+{
+    AbstractIterator base;
+    WindowArgs args;
+    WindowColumn *columns; // allocated on the first chunk, for each of its values per sample
+    size_t numColumns;
+} WindowIterator;
+
+WindowIterator *WindowIterator_New(AbstractIterator *input, const WindowArgs *args);
+EnrichedChunk *WindowIterator_GetNextChunk(struct AbstractIterator *iter);
+void WindowIterator_Close(struct AbstractIterator *iterator);
+
+#endif // WINDOW_ITERATOR_H
@@ -46,6 +46,8 @@ class testCommandDocsAndHelp():
         with env.getClusterConnectionIfNeeded() as r:
             res = r.execute_command('COMMAND', 'INFO', 'TS.CREATERULE')
             assert res
+            # BACKFILL schedules work over the existing samples, neither the flag nor @fast is set
+            assert 'fast' not in str(res)
             assert_docs(env, 'TS.CREATERULE', summary='Create a compaction rule', complexity='O(1)', arity='-6', since='1.0.0', group='module')
 
     def test_command_info_ts_range(self):
@@ -0,0 +1,97 @@
+from includes import *
+
+
+def _skip_without_module_config(env):
+    if is_redis_version_lower_than(env, '8.0') or env.isCluster():
+        env.skip()
+    skip_on_rlec()
+
+
+def _value(ts):
+    # enough entropy for a few bytes per compressed sample
+    return (ts * 7919) % 1000 + ts / 7
+
+
+def _info(r, key):
+    return dict(zip(*[iter(r.execute_command('TS.INFO', key))] * 2))
+
+
+def test_chunk_size_auto_matches_fixed():
+    env = Env()
+    with env.getClusterConnectionIfNeeded() as r:
+        r.execute_command('TS.CREATE', '{a}auto', 'CHUNK_SIZE', 'AUTO')
+        r.execute_command('TS.CREATE', '{a}fixed', 'CHUNK_SIZE', 128)
+        r.execute_command('TS.CREATE', '{a}auto_raw', 'CHUNK_SIZE', 'auto',
+                          'ENCODING', 'UNCOMPRESSED')
+        for ts in range(1, 5001):
+            value = _value(ts)
+            for key in ['{a}auto', '{a}fixed', '{a}auto_raw']:
+                r.execute_command('TS.ADD', key, ts * 10, value)
+
+        expected = r.execute_command('TS.RANGE', '{a}fixed', '-', '+')
+        for key in ['{a}auto', '{a}auto_raw']:
+            env.assertEqual(r.execute_command('TS.RANGE', key, '-', '+'), expected)
+            info = _info(r, key)
+            env.assertEqual(info[b'chunkSizeMode'], b'auto')
+            # chunks grow past the small initial allocation
+            env.assertLess(info[b'chunkCount'], _info(r, '{a}fixed')[b'chunkCount'])
+        env.assertFalse(b'chunkSizeMode' in _info(r, '{a}fixed'))
+
+        env.dumpAndReload()
+        for key in ['{a}auto', '{a}auto_raw']:
+            env.assertEqual(r.execute_command('TS.RANGE', key, '-', '+'), expected)
+            env.assertEqual(_info(r, key)[b'chunkSizeMode'], b'auto')
+
+        # out of order samples and deletions work on auto sized chunks
+        for key in ['{a}auto', '{a}fixed']:
+            r.execute_command('TS.ADD', key, 15, 1.5)
+            r.execute_command('TS.DEL', key, 1000, 2000)
+        env.assertEqual(r.execute_command('TS.RANGE', '{a}auto', '-', '+'),
+                        r.execute_command('TS.RANGE', '{a}fixed', '-', '+'))
+
+        r.execute_command('TS.ALTER', '{a}auto', 'CHUNK_SIZE', 256)
+        info = _info(r, '{a}auto')
+        env.assertEqual(info[b'chunkSize'], 256)
+        env.assertFalse(b'chunkSizeMode' in info)
+        r.execute_command('TS.ALTER', '{a}fixed', 'CHUNK_SIZE', 'AUTO')
+        env.assertEqual(_info(r, '{a}fixed')[b'chunkSizeMode'], b'auto')
+
+        with pytest.raises(redis.ResponseError):
+            r.execute_command('TS.CREATE', '{a}bad', 'CHUNK_SIZE', 'AUTOMATIC')
+
+
+def test_chunk_size_auto_target():
+    env = Env()
+    _skip_without_module_config(env)
+
+    with env.getConnection() as r:
+        r.execute_command('CONFIG', 'SET', 'ts-chunk-auto-target-samples', 64)
+        r.execute_command('TS.CREATE', 'few', 'CHUNK_SIZE', 'AUTO')
+        for ts in range(1, 1001):
+            r.execute_command('TS.ADD', 'few', ts, _value(ts))
+        few = _info(r, 'few')
+
+        r.execute_command('CONFIG', 'SET', 'ts-chunk-auto-target-samples', 1024)
+        r.execute_command('TS.CREATE', 'many', 'CHUNK_SIZE', 'AUTO')
+        for ts in range(1, 1001):
+            r.execute_command('TS.ADD', 'many', ts, _value(ts))
+        many = _info(r, 'many')
+
+        env.assertGreater(few[b'chunkCount'], many[b'chunkCount'])
+        env.assertLess(few[b'chunkSize'], many[b'chunkSize'])
+
+        # a slow series targeting a time span gets small chunks
+        r.execute_command('CONFIG', 'SET', 'ts-chunk-auto-target-span', 60000)
+        try:
+            r.execute_command('TS.CREATE', 'slow', 'CHUNK_SIZE', 'AUTO')
+            r.execute_command('TS.CREATE', 'slow_fixed')
+            for ts in range(1, 2001):
+                r.execute_command('TS.ADD', 'slow', ts * 10000, _value(ts))
+                r.execute_command('TS.ADD', 'slow_fixed', ts * 10000, _value(ts))
+            slow = _info(r, 'slow')
+            env.assertEqual(r.execute_command('TS.RANGE', 'slow', '-', '+'),
+                            r.execute_command('TS.RANGE', 'slow_fixed', '-', '+'))
+            env.assertLess(slow[b'chunkSize'], _info(r, 'slow_fixed')[b'chunkSize'])
+            env.assertGreater(slow[b'chunkCount'], _info(r, 'slow_fixed')[b'chunkCount'])
+        finally:
+            r.execute_command('CONFIG', 'SET', 'ts-chunk-auto-target-span', 0)
@@ -0,0 +1,174 @@
+import time
+
+from includes import *
+
+
+def _skip_without_module_config(env):
+    if is_redis_version_lower_than(env, '8.0') or env.isCluster():
+        env.skip()
+    skip_on_rlec()
+
+
+def _wait_for_lag(r, key, lag=0, timeout=5):
+    deadline = time.time() + timeout
+    while time.time() < deadline:
+        info = dict(zip(*[iter(r.execute_command('TS.INFO', key))] * 2))
+        if info[b'compactionLag'] == lag:
+            return True
+        time.sleep(0.01)
+    return False
+
+
+def test_async_compaction_matches_sync():
+    env = Env()
+    _skip_without_module_config(env)
+
+    with env.getConnection() as r:
+        r.execute_command('CONFIG', 'SET', 'ts-compaction-async', 'yes')
+        try:
+            for prefix in ['sync', 'async']:
+                r.execute_command('TS.CREATE', f'{prefix}_src')
+                for agg in ['avg', 'max', 'twa', 'std.p']:
+                    dest = f'{prefix}_{agg}'
+                    r.execute_command('TS.CREATE', dest)
+                    r.execute_command('TS.CREATERULE', f'{prefix}_src', dest, 'AGGREGATION', agg, 10)
+
+            r.execute_command('CONFIG', 'SET', 'ts-compaction-async', 'no')
+            for ts in range(1, 1000):
+                r.execute_command('TS.ADD', 'sync_src', ts, ts % 17)
+
+            r.execute_command('CONFIG', 'SET', 'ts-compaction-async', 'yes')
+            for ts in range(1, 1000):
+                r.execute_command('TS.ADD', 'async_src', ts, ts % 17)
+
+            env.assertTrue(_wait_for_lag(r, 'async_src'))
+            for agg in ['avg', 'max', 'twa', 'std.p']:
+                env.assertEqual(r.execute_command('TS.RANGE', f'sync_{agg}', '-', '+'),
+                                r.execute_command('TS.RANGE', f'async_{agg}', '-', '+'))
+        finally:
+            r.execute_command('CONFIG', 'SET', 'ts-compaction-async', 'no')
+
+
+def test_async_compaction_lag_in_info():
+    env = Env()
+    _skip_without_module_config(env)
+
+    with env.getConnection() as r:
+        r.execute_command('TS.CREATE', 'src')
+        r.execute_command('TS.CREATE', 'dest')
+        r.execute_command('TS.CREATERULE', 'src', 'dest', 'AGGREGATION', 'sum', 10)
+
+        # the field is only reported once async compaction is in use
+        info = dict(zip(*[iter(r.execute_command('TS.INFO', 'src'))] * 2))
+        env.assertFalse(b'compactionLag' in info)
+
+        r.execute_command('CONFIG', 'SET', 'ts-compaction-async', 'yes')
+        r.execute_command('CONFIG', 'SET', 'ts-compaction-async-max-lag', 5)
+        try:
+            # a MULTI keeps the worker out, so the lag is bounded by the max-lag config
+            pipe = r.pipeline(transaction=True)
+            for ts in range(1, 101):
+                pipe.execute_command('TS.ADD', 'src', ts, 1)
+            pipe.execute_command('TS.INFO', 'src')
+            info = dict(zip(*[iter(pipe.execute()[-1])] * 2))
+            env.assertGreater(info[b'compactionLag'], 0)
+            env.assertLessEqual(info[b'compactionLag'], 5)
+
+            env.assertTrue(_wait_for_lag(r, 'src'))
+            env.assertEqual(len(r.execute_command('TS.RANGE', 'dest', '-', '+')), 10)
+        finally:
+            r.execute_command('CONFIG', 'SET', 'ts-compaction-async', 'no')
+            r.execute_command('CONFIG', 'SET', 'ts-compaction-async-max-lag', 1024)
+
+
+def test_async_compaction_flushed_before_rule_changes():
+    env = Env()
+    _skip_without_module_config(env)
+
+    with env.getConnection() as r:
+        r.execute_command('TS.CREATE', 'src')
+        r.execute_command('TS.CREATE', 'dest')
+        r.execute_command('TS.CREATERULE', 'src', 'dest', 'AGGREGATION', 'count', 10)
+        r.execute_command('CONFIG', 'SET', 'ts-compaction-async', 'yes')
+        try:
+            pipe = r.pipeline(transaction=True)
+            for ts in range(1, 51):
+                pipe.execute_command('TS.ADD', 'src', ts, 1)
+            pipe.execute_command('TS.DELETERULE', 'src', 'dest')
+            pipe.execute()
+            # every bucket closed before the rule was removed reached the destination
+            env.assertEqual(r.execute_command('TS.RANGE', 'dest', '-', '+'),
+                            [[0, b'9'], [10, b'10'], [20, b'10'], [30, b'10'], [40, b'10']])
+
+            # samples are flushed before persistence so the saved rule state is complete
+            r.execute_command('TS.CREATERULE', 'src', 'dest', 'AGGREGATION', 'count', 10)
+            for ts in range(51, 80):
+                r.execute_command('TS.ADD', 'src', ts, 1)
+            env.dumpAndReload()
+            r.execute_command('TS.ADD', 'src', 100, 1)
+            env.assertTrue(_wait_for_lag(r, 'src'))
+            env.assertEqual(r.execute_command('TS.RANGE', 'dest', 60, '+'),
+                            [[60, b'10'], [70, b'10']])
+        finally:
+            r.execute_command('CONFIG', 'SET', 'ts-compaction-async', 'no')
+
+
+def test_async_compaction_delete_and_move():
+    """The pending samples of a moved series are replayed in its new db, those of a deleted one
+    are dropped with it."""
+    env = Env()
+    _skip_without_module_config(env)
+
+    with env.getConnection() as r:
+        r.execute_command('CONFIG', 'SET', 'ts-compaction-async', 'yes')
+        moved = [[0, b'9'], [10, b'10'], [20, b'10'], [30, b'10'], [40, b'10']]
+        try:
+            for last, args, expected in [('DEL', [], []), ('MOVE', [1], moved),
+                                         ('RENAME', ['src2'], moved)]:
+                r.execute_command('TS.CREATE', 'src')
+                r.execute_command('TS.CREATE', 'dest')
+                r.execute_command('TS.CREATERULE', 'src', 'dest', 'AGGREGATION', 'count', 10)
+                # a MULTI keeps the worker out, the samples are still queued when src leaves
+                pipe = r.pipeline(transaction=True)
+                for ts in range(1, 51):
+                    pipe.execute_command('TS.ADD', 'src', ts, 1)
+                pipe.execute_command(last, 'src', *args)
+                pipe.execute()
+                deadline = time.time() + 5
+                while (r.execute_command('TS.RANGE', 'dest', '-', '+') != expected and
+                       time.time() < deadline):
+                    time.sleep(0.01)
+                env.assertEqual(r.execute_command('TS.RANGE', 'dest', '-', '+'), expected,
+                                message=last)
+                r.execute_command('FLUSHALL')
+        finally:
+            r.execute_command('CONFIG', 'SET', 'ts-compaction-async', 'no')
+
+
+def test_async_compaction_acl_of_writer():
+    env = Env()
+    _skip_without_module_config(env)
+
+    with env.getConnection() as r, env.getConnection() as writer:
+        for prefix in ['sync', 'async']:
+            r.execute_command('TS.CREATE', f'{prefix}_src')
+            r.execute_command('TS.CREATE', f'{prefix}_dest')
+            r.execute_command('TS.CREATERULE', f'{prefix}_src', f'{prefix}_dest',
+                              'AGGREGATION', 'sum', 10)
+        # the writer may write the sources only
+        r.execute_command('ACL', 'SETUSER', 'writer', 'on', '>pw', 'resetkeys',
+                          '~sync_src', '~async_src', '+@timeseries')
+        writer.execute_command('AUTH', 'writer', 'pw')
+        try:
+            for prefix in ['sync', 'async']:
+                r.execute_command('CONFIG', 'SET', 'ts-compaction-async',
+                                  'yes' if prefix == 'async' else 'no')
+                for ts in range(1, 51):
+                    writer.execute_command('TS.ADD', f'{prefix}_src', ts, 1)
+            env.assertTrue(_wait_for_lag(r, 'async_src'))
+            env.assertEqual(r.execute_command('TS.RANGE', 'async_dest', '-', '+'), [])
+            env.assertEqual(r.execute_command('TS.RANGE', 'async_dest', '-', '+'),
+                            r.execute_command('TS.RANGE', 'sync_dest', '-', '+'))
+        finally:
+            r.execute_command('CONFIG', 'SET', 'ts-compaction-async', 'no')
+            r.execute_command('ACL', 'DELUSER', 'writer')
@@ -1,6 +1,7 @@
 import math
 import random
 import statistics
+import time
 
 import pytest
 import redis
@@ -505,3 +506,82 @@ def test_compaction_rules_nan_only_bucket():
             
             r.execute_command('DEL', key)
             r.execute_command('DEL', agg_key)
+
+
+def _wait_for_backfill(r, dest, timeout=10):
+    deadline = time.time() + timeout
+    while time.time() < deadline:
+        status = dict(zip(*[iter(r.execute_command('TS.BACKFILLSTATUS', dest))] * 2))
+        if status[b'status'] != b'running':
+            return status
+        time.sleep(0.05)
+    return status
+
+
+def test_create_rule_backfill():
+    env = Env()
+    src = 'src{backfill}'
+    with env.getClusterConnectionIfNeeded() as r:
+        r.execute_command('TS.CREATE', src)
+        aggs = ['avg', 'max', 'count', 'twa']
+        for agg in aggs:
+            r.execute_command('TS.CREATE', f'live_{agg}{{backfill}}')
+            r.execute_command('TS.CREATERULE', src, f'live_{agg}{{backfill}}', 'AGGREGATION', agg, 100)
+
+        # spans several slices of the backfill job
+        for start in range(0, 40000, 1000):
+            args = []
+            for ts in range(start, start + 1000):
+                args += [src, ts, ts % 23]
+            r.execute_command('TS.MADD', *args)
+
+        for agg in aggs:
+            r.execute_command('TS.CREATE', f'backfill_{agg}{{backfill}}')
+            r.execute_command('TS.CREATERULE', src, f'backfill_{agg}{{backfill}}', 'AGGREGATION', agg, 100,
+                              'BACKFILL')
+        # the bucket that was open when the rule was created is completed by new samples
+        for ts in range(40000, 40150):
+            r.execute_command('TS.ADD', src, ts, ts % 23)
+
+        for agg in aggs:
+            status = _wait_for_backfill(r, f'backfill_{agg}{{backfill}}')
+            env.assertEqual(status[b'status'], b'done')
+            env.assertEqual(status[b'fromTimestamp'], 0)
+            env.assertEqual(status[b'toTimestamp'], 39899)
+            env.assertEqual(status[b'bucketsWritten'], 399)
+
+            expected = r.execute_command('TS.RANGE', f'live_{agg}{{backfill}}', '-', '+')
+            actual = r.execute_command('TS.RANGE', f'backfill_{agg}{{backfill}}', '-', '+')
+            env.assertEqual(len(expected), 401)
+            env.assertEqual(len(actual), len(expected))
+            for (exp_ts, exp_val), (act_ts, act_val) in zip(expected, actual):
+                env.assertEqual(exp_ts, act_ts)
+                env.assertAlmostEqual(float(exp_val), float(act_val), 1e-9)
+
+
+def test_create_rule_backfill_args():
+    env = Env()
+    src = 'src{backfill}'
+    dest = 'dest{backfill}'
+    with env.getClusterConnectionIfNeeded() as r:
+        r.execute_command('TS.CREATE', src)
+        r.execute_command('TS.CREATE', dest)
+        with pytest.raises(redis.ResponseError):
+            r.execute_command('TS.BACKFILLSTATUS', dest)
+
+        for ts in range(1, 100):
+            r.execute_command('TS.ADD', src, ts, 1)
+        # alignment and BACKFILL together
+        r.execute_command('TS.CREATERULE', src, dest, 'AGGREGATION', 'sum', 10, 5, 'backfill')
+        status = _wait_for_backfill(r, dest)
+        env.assertEqual(status[b'status'], b'done')
+        env.assertEqual(r.execute_command('TS.RANGE', dest, '-', '+'),
+                        [[0, b'4'], [5, b'10'], [15, b'10'], [25, b'10'], [35, b'10'], [45, b'10'],
+                         [55, b'10'], [65, b'10'], [75, b'10'], [85, b'10']])
+        info = _get_ts_info(r, src)
+        env.assertEqual(info.rules, [[dest.encode('ascii'), 10, b'SUM', 5]])
+
+        # BACKFILL is the only token accepted after the alignment
+        r.execute_command('TS.DELETERULE', src, dest)
+        with pytest.raises(redis.ResponseError):
+            r.execute_command('TS.CREATERULE', src, dest, 'AGGREGATION', 'sum', 10, 5, 'NOBACKFILL')
@@ -148,3 +148,98 @@ def test_keyspace_rules_send():
 
         assert_msg(env, pubsub.get_message(timeout=1), 'pmessage', b'ts.incrby')
         assert_msg(env, pubsub.get_message(timeout=1), 'pmessage', b'tester_src{2}')
+
+
+def test_keyspace_madd_coalesced():
+    Env().skipOnCluster()
+    Env().skipOnVersionSmaller("6.2.0")
+    skip_on_rlec()
+    env = Env()
+    with env.getClusterConnectionIfNeeded() as r:
+        r.execute_command('TS.CREATE', 'tester_src{2}')
+        r.execute_command('TS.CREATE', 'tester_dest{2}')
+        r.execute_command('TS.CREATERULE', 'tester_src{2}', 'tester_dest{2}', 'AGGREGATION', 'MAX', 1)
+        r.execute_command('config', 'set', 'notify-keyspace-events', 'KEA')
+
+        pubsub = r.pubsub()
+        pubsub.psubscribe('__keyevent*')
+
+        time.sleep(1)
+        env.assertEqual('psubscribe', pubsub.get_message(timeout=1)['type'])
+
+        # every sample closes a bucket, yet each key is notified once per command
+        r.execute_command('TS.MADD', 'tester_src{2}', 1, 1, 'tester_src{2}', 2, 2,
+                          'tester_src{2}', 3, 3, 'tester_src{2}', 4, 4)
+        msg = pubsub.get_message(timeout=1)
+        env.assertEqual(b'__keyevent@0__:ts.add:dest', msg['channel'])
+        env.assertEqual(b'tester_dest{2}', msg['data'])
+        msg = pubsub.get_message(timeout=1)
+        env.assertEqual(b'__keyevent@0__:ts.add', msg['channel'])
+        env.assertEqual(b'tester_src{2}', msg['data'])
+        env.assertEqual(None, pubsub.get_message(timeout=0.5))
+
+
+def test_keyspace_batch_event():
+    env = Env()
+    if is_redis_version_lower_than(env, '8.0') or env.isCluster():
+        env.skip()
+    skip_on_rlec()
+    with env.getClusterConnectionIfNeeded() as r:
+        for key in ['a{2}', 'b{2}', 'c{2}']:
+            r.execute_command('TS.CREATE', key)
+        r.execute_command('config', 'set', 'notify-keyspace-events', 'KEA')
+        r.execute_command('config', 'set', 'ts-notify-batch-event', 'yes')
+        try:
+            pubsub = r.pubsub()
+            pubsub.psubscribe('__keyevent*')
+            pubsub.ssubscribe('__keyevent@0__:ts.batch')
+
+            time.sleep(1)
+            env.assertEqual('psubscribe', pubsub.get_message(timeout=1)['type'])
+            env.assertEqual('ssubscribe', pubsub.get_message(timeout=1)['type'])
+
+            r.execute_command('TS.MADD', 'a{2}', 1, 1, 'b{2}', 1, 1, 'a{2}', 2, 2, 'c{2}', 1, 1)
+            # the distinct events, followed by one sharded message holding their number
+            for key in [b'a{2}', b'b{2}', b'c{2}']:
+                msg = pubsub.get_message(timeout=1)
+                env.assertEqual(b'__keyevent@0__:ts.add', msg['channel'])
+                env.assertEqual(key, msg['data'])
+            msg = pubsub.get_message(timeout=1)
+            env.assertEqual('smessage', msg['type'])
+            env.assertEqual(b'__keyevent@0__:ts.batch', msg['channel'])
+            env.assertEqual(b'3', msg['data'])
+            env.assertEqual(None, pubsub.get_message(timeout=0.5))
+        finally:
+            r.execute_command('config', 'set', 'ts-notify-batch-event', 'no')
+
+
+def test_keyspace_batch_event_keyspace_only():
+    env = Env()
+    if is_redis_version_lower_than(env, '8.0') or env.isCluster():
+        env.skip()
+    skip_on_rlec()
+    with env.getClusterConnectionIfNeeded() as r:
+        for key in ['a{2}', 'b{2}']:
+            r.execute_command('TS.CREATE', key)
+        # keyspace ('K') notifications only, no keyevent channel
+        r.execute_command('config', 'set', 'notify-keyspace-events', 'KA')
+        r.execute_command('config', 'set', 'ts-notify-batch-event', 'yes')
+        try:
+            pubsub = r.pubsub()
+            pubsub.psubscribe('__key*')
+
+            time.sleep(1)
+            env.assertEqual('psubscribe', pubsub.get_message(timeout=1)['type'])
+
+            # no ts.batch message, the events are published on the keyspace channels
+            r.execute_command('TS.MADD', 'a{2}', 1, 1, 'b{2}', 1, 1, 'a{2}', 2, 2)
+            msg = pubsub.get_message(timeout=1)
+            env.assertEqual(b'__keyspace@0__:a{2}', msg['channel'])
+            env.assertEqual(b'ts.add', msg['data'])
+            msg = pubsub.get_message(timeout=1)
+            env.assertEqual(b'__keyspace@0__:b{2}', msg['channel'])
+            env.assertEqual(b'ts.add', msg['data'])
+            env.assertEqual(None, pubsub.get_message(timeout=0.5))
+        finally:
+            r.execute_command('config', 'set', 'ts-notify-batch-event', 'no')
+            r.execute_command('config', 'set', 'notify-keyspace-events', '')
@@ -897,6 +897,30 @@ def test_groupby_agg_min():
         assert vals == [(0, 10.0)]
 
 
+def test_groupby_count_reverse():
+    """COUNT keeps the newest reduced buckets with MREVRANGE, whatever the members hold."""
+    env = Env()
+    with env.getClusterConnectionIfNeeded() as r, env.getConnection(1) as r1:
+        r.execute_command('TS.CREATE', 'gc1', 'LABELS', 'grp', 'C')
+        r.execute_command('TS.CREATE', 'gc2', 'LABELS', 'grp', 'C')
+        for ts in range(0, 100, 10):
+            r.execute_command('TS.ADD', 'gc1', ts, 1)
+        # the buckets of gc2 don't line up with the oldest ones of gc1
+        for ts in range(50, 150, 10):
+            r.execute_command('TS.ADD', 'gc2', ts, 2)
+        for reducer, expected in [('sum', [(140, 2), (130, 2), (120, 2)]),
+                                  ('max', [(140, 2), (130, 2), (120, 2)]),
+                                  ('count', [(140, 1), (130, 1), (120, 1)])]:
+            res = r1.execute_command(
+                'TS.MREVRANGE', '-', '+', 'COUNT', 3, 'AGGREGATION', 'sum', 10,
+                'FILTER', 'grp=C', 'GROUPBY', 'grp', 'REDUCE', reducer)
+            assert [(int(ts), float(v)) for ts, v in res[0][2]] == expected
+        res = r1.execute_command(
+            'TS.MRANGE', 40, '+', 'COUNT', 3, 'AGGREGATION', 'sum', 10,
+            'FILTER', 'grp=C', 'GROUPBY', 'grp', 'REDUCE', 'sum')
+        assert [(int(ts), float(v)) for ts, v in res[0][2]] == [(40, 1), (50, 3), (60, 3)]
+
+
 def test_groupby_agg_multiple_buckets():
     """GROUPBY REDUCE avg across multiple buckets to verify per-bucket correctness."""
     env = Env()
@@ -1355,3 +1379,263 @@ def test_excludeempty_resp3(env):
         res = r1.execute_command('TS.MRANGE', 1, 100, 'EXCLUDEEMPTY', 'FILTER', 'g=xr3')
         assert isinstance(res, dict)
         assert _excl_keys(res) == ['xr3a']
+
+
+def test_mrange_batched_rounds():
+    """With ts-mrange-batch-size the shards send their series over several rounds; the reply
+    holds the same series as a single round."""
+    env = Env()
+    if not env.isCluster() or is_redis_version_lower_than(env, '8.0', True):
+        env.skip()
+    skip_on_rlec()
+
+    def set_batch_size(size):
+        for conn in shardsConnections(env):
+            conn.execute_command('CONFIG', 'SET', 'ts-mrange-batch-size', size)
+
+    def by_name(res):
+        return sorted(res, key=lambda s: s[0])
+
+    with env.getClusterConnectionIfNeeded() as r, env.getConnection(1) as r1:
+        for i in range(40):
+            key = f'batched{i}'
+            r.execute_command('TS.CREATE', key, 'LABELS', 'name', 'batched', 'idx', i)
+            # every fifth series has no samples in [100, 200]
+            start = 1000 if i % 5 == 0 else 1
+            for ts in range(start, start + 300, 7):
+                r.execute_command('TS.ADD', key, ts, (ts * (i + 1)) % 53)
+
+        queries = [
+            ['-', '+'],
+            [100, 200, 'EXCLUDEEMPTY'],
+            ['-', '+', 'WITHLABELS', 'COUNT', 5],
+            ['-', '+', 'AGGREGATION', 'avg', 50],
+            ['-', '+', 'AGGREGATION', 'min,max', 50],
+            ['-', '+', 'FILTER_BY_VALUE', 10, 20],
+        ]
+        try:
+            for cmd in ['TS.MRANGE', 'TS.MREVRANGE']:
+                for query in queries:
+                    args = [cmd, *query, 'FILTER', 'name=batched']
+                    set_batch_size(0)
+                    expected = r1.execute_command(*args)
+                    for size in [1, 3, 40]:
+                        set_batch_size(size)
+                        res = r1.execute_command(*args)
+                        env.assertEqual(by_name(res), by_name(expected),
+                                        message=str(args + [size]))
+        finally:
+            set_batch_size(0)
+
+
+def test_mrange_binary_shard_reply():
+    """The shards send their series as compressed chunks; the samples, values and labels decoded by
+    the coordinator are the same as the ones of TS.RANGE on every key."""
+    env = Env()
+    if not env.isCluster() or is_redis_version_lower_than(env, '8.0', True):
+        env.skip()
+    skip_on_rlec()
+
+    with env.getClusterConnectionIfNeeded() as r, env.getConnection(1) as r1:
+        for i in range(20):
+            key = f'blob{i}'
+            labels = ['name', 'blob', 'idx', i, 'parity', i % 2]
+            if i % 3 == 0:
+                labels += ['rare', 'x' * (i + 1)]
+            r.execute_command('TS.CREATE', key, 'LABELS', *labels)
+            # more samples than fit in one chunk of the blob
+            for ts in range(1, 3000, 3):
+                r.execute_command('TS.ADD', key, ts, (ts * (i + 1)) % 997 / 7 - 50 + 1e-9 * ts)
+
+        for query in [['-', '+'], [100, 2000, 'AGGREGATION', 'avg', 30],
+                      ['-', '+', 'AGGREGATION', 'min,max,last', 100]]:
+            res = r1.execute_command('TS.MRANGE', *query, 'WITHLABELS', 'FILTER', 'name=blob')
+            env.assertEqual(len(res), 20)
+            for name, labels, samples in res:
+                key = name.decode()
+                i = int(key[len('blob'):])
+                env.assertEqual(dict(labels)[b'idx'], str(i).encode())
+                env.assertEqual(samples, r.execute_command('TS.RANGE', key, *query), message=key)
+
+        res = r1.execute_command('TS.MRANGE', '-', '+', 'SELECTED_LABELS', 'rare', 'parity',
+                                 'FILTER', 'name=blob')
+        for name, labels, _ in res:
+            i = int(name.decode()[len('blob'):])
+            rare = ('x' * (i + 1)).encode() if i % 3 == 0 else None
+            env.assertEqual(labels, [[b'rare', rare], [b'parity', str(i % 2).encode()]])
+
+
+def test_mrange_cursor():
+    """Paging with CURSOR replies the same series and samples as a single MRANGE, a series being
+    split across pages when its raw samples don't fit in one."""
+    env = Env(decodeResponses=True)
+    if env.isCluster() or is_redis_version_lower_than(env, '8.0'):
+        env.skip()
+    skip_on_rlec()
+
+    def read_pages(r, cmd, query):
+        cursor, pages, merged = '0', 0, {}
+        while True:
+            page, cursor = r.execute_command(cmd, *query[:2], 'CURSOR', cursor, *query[2:])
+            if 'AGGREGATION' not in query:
+                env.assertLessEqual(sum(max(len(s[2]), 1) for s in page), 50)
+            for name, labels, samples in page:
+                merged.setdefault(name, [name, labels, []])[2].extend(samples)
+            pages += 1
+            if cursor == '0':
+                return sorted(merged.values()), pages
+
+    with env.getConnection() as r:
+        for i in range(30):
+            key = f'cursor{i}'
+            r.execute_command('TS.CREATE', key, 'LABELS', 'name', 'cursor', 'idx', i)
+            # every third series has no samples in [1000, 2000]
+            start = 5000 if i % 3 == 0 else 1
+            for ts in range(start, start + 3000, 7):
+                r.execute_command('TS.ADD', key, ts, (ts * (i + 1)) % 53)
+
+        r.execute_command('CONFIG', 'SET', 'ts-cursor-page-size', 50)
+        try:
+            for cmd in ['TS.MRANGE', 'TS.MREVRANGE']:
+                for query in [['-', '+'],
+                              [1000, 2000, 'EXCLUDEEMPTY'],
+                              ['-', '+', 'WITHLABELS', 'COUNT', 120],
+                              ['-', '+', 'AGGREGATION', 'avg', 1000]]:
+                    query = query + ['FILTER', 'name=cursor']
+                    expected = sorted(r.execute_command(cmd, *query))
+                    for ttl in [60000, 0]:
+                        r.execute_command('CONFIG', 'SET', 'ts-cursor-ttl', ttl)
+                        res, pages = read_pages(r, cmd, query)
+                        env.assertEqual(res, expected, message=str([cmd] + query))
+                        env.assertGreater(pages, 1)
+        finally:
+            r.execute_command('CONFIG', 'SET', 'ts-cursor-page-size', 10000)
+            r.execute_command('CONFIG', 'SET', 'ts-cursor-ttl', 60000)
+
+        with pytest.raises(redis.ResponseError) as excinfo:
+            r.execute_command('TS.MRANGE', '-', '+', 'CURSOR', 'bogus', 'FILTER', 'name=cursor')
+        assert 'invalid cursor' in str(excinfo.value)
+        with pytest.raises(redis.ResponseError) as excinfo:
+            r.execute_command('TS.MRANGE', '-', '+', 'CURSOR', '0', 'FILTER', 'name=cursor',
+                              'GROUPBY', 'name', 'REDUCE', 'max')
+        assert 'not allowed with GROUPBY' in str(excinfo.value)
+
+
+def test_mrange_cursor_expiry():
+    """The series kept for a cursor are reported by INFO, and dropped once ts-cursor-ttl is over
+    even when no other page is asked for."""
+    env = Env(decodeResponses=True)
+    if env.isCluster() or is_redis_version_lower_than(env, '8.0'):
+        env.skip()
+    skip_on_rlec()
+
+    with env.getConnection() as r:
+        for i in range(10):
+            r.execute_command('TS.ADD', f'expiry{i}', 1, i, 'LABELS', 'name', 'expiry')
+
+        r.execute_command('CONFIG', 'SET', 'ts-cursor-page-size', 3)
+        r.execute_command('CONFIG', 'SET', 'ts-cursor-ttl', 500)
+        try:
+            _, cursor = r.execute_command('TS.MRANGE', '-', '+', 'CURSOR', '0',
+                                          'FILTER', 'name=expiry')
+            env.assertNotEqual(cursor, '0')
+            info = r.execute_command('INFO', 'timeseries')
+            env.assertEqual(info['timeseries_cursors_cached'], 1)
+            env.assertGreater(info['timeseries_cursors_cached_memory'], 0)
+
+            time.sleep(1.5)
+            info = r.execute_command('INFO', 'timeseries')
+            env.assertEqual(info['timeseries_cursors_cached'], 0)
+            env.assertEqual(info['timeseries_cursors_cached_memory'], 0)
+
+            # the page after the expiry runs the index again
+            page, _ = r.execute_command('TS.MRANGE', '-', '+', 'CURSOR', cursor,
+                                        'FILTER', 'name=expiry')
+            env.assertEqual(len(page), 3)
+        finally:
+            r.execute_command('CONFIG', 'SET', 'ts-cursor-page-size', 10000)
+            r.execute_command('CONFIG', 'SET', 'ts-cursor-ttl', 60000)
+
+
+def test_mtopk(env):
+    def expected_topk(series, agg, fr, to, k, bottom=False):
+        ranked = []
+        for key, samples in series.items():
+            values = [v for ts, v in samples if fr <= ts <= to]
+            if not values:
+                continue
+            first = min(ts for ts, v in samples if fr <= ts <= to)
+            value = {'sum': sum(values), 'max': max(values), 'min': min(values),
+                     'count': len(values), 'avg': sum(values) / len(values)}[agg]
+            ranked.append((value if bottom else -value, key, max(fr, first)))
+        return [[key.encode(), ts, abs(value)] for value, key, ts in sorted(ranked)[:k]]
+
+    def compare(res, expected):
+        env.assertEqual([[key, ts] for key, _, (ts, _) in res],
+                        [[key, ts] for key, ts, _ in expected])
+        for (_, _, (_, value)), (_, _, expected_value) in zip(res, expected):
+            env.assertAlmostEqual(float(value), expected_value, 0.0001)
+
+    with env.getClusterConnectionIfNeeded() as r, env.getConnection(1) as r1:
+        series = {}
+        for i in range(20):
+            key = f'topk{i}'
+            r.execute_command('TS.CREATE', key, 'CHUNK_SIZE', 128, 'LABELS', 'name', 'topk', 'idx', i)
+            # every fifth series only has samples after the queried ranges
+            start = 5000 if i % 5 == 0 else 1 + i
+            series[key] = [(ts, (ts * (i + 3)) % 101) for ts in range(start, start + 2000, 3)]
+            for ts, value in series[key]:
+                r.execute_command('TS.ADD', key, ts, value)
+
+        for agg, fr, to, k, bottom in [('sum', 0, 3000, 3, False),
+                                       ('max', 100, 900, 4, True),
+                                       ('count', 0, 10000, 5, False),
+                                       ('count', 500, 700, 30, True),
+                                       ('avg', 10, 1500, 6, False),
+                                       ('min', 0, 4, 2, False)]:
+            query = ['TS.MTOPK', k, fr, to, 'AGGREGATION', agg] + (['BOTTOM'] if bottom else [])
+            res = r1.execute_command(*query, 'FILTER', 'name=topk')
+            compare(res, expected_topk(series, agg, fr, to, k, bottom))
+
+        res = r1.execute_command('TS.MTOPK', 2, '-', '+', 'AGGREGATION', 'last', 'SELECTED_LABELS', 'idx',
+                                 'FILTER', 'name=topk')
+        for key, labels, _ in res:
+            env.assertEqual(labels, [[b'idx', key[len('topk'):]]])
+        env.assertEqual(r1.execute_command('TS.MTOPK', 2, 0, 10, 'AGGREGATION', 'sum', 'FILTER', 'name=none'), [])
+
+        for query in [[0, 0, 10, 'AGGREGATION', 'sum', 'FILTER', 'name=topk'],
+                      [5, 0, 10, 'FILTER', 'name=topk'],
+                      [5, 0, 10, 'AGGREGATION', 'bogus', 'FILTER', 'name=topk'],
+                      [5, 0, 10, 'AGGREGATION', 'sum', 'COUNT', 3, 'FILTER', 'name=topk'],
+                      [5, 0, 10, 'AGGREGATION', 'sum', 'FILTER', 'name=topk', 'GROUPBY', 'idx',
+                       'REDUCE', 'max']]:
+            with pytest.raises(redis.ResponseError):
+                r1.execute_command('TS.MTOPK', *query)
+
+
+def test_mtopk_last_nan(env):
+    with env.getClusterConnectionIfNeeded() as r, env.getConnection(1) as r1:
+        r.execute_command('TS.CREATE', 'topknan1', 'LABELS', 'name', 'topknan')
+        r.execute_command('TS.CREATE', 'topknan2', 'LABELS', 'name', 'topknan')
+        r.execute_command('TS.ADD', 'topknan1', 10, 100)
+        r.execute_command('TS.ADD', 'topknan1', 20, 'nan')
+        r.execute_command('TS.ADD', 'topknan2', 10, 50)
+        # the NaN last sample of topknan1 is skipped, its last value is the one before it
+        res = r1.execute_command('TS.MTOPK', 2, '-', '+', 'AGGREGATION', 'last', 'FILTER', 'name=topknan')
+        env.assertEqual([[key, ts, float(value)] for key, _, (ts, value) in res],
+                        [[b'topknan1', 10, 100], [b'topknan2', 10, 50]])
+
+
+def test_mtopk_count_nan(env):
+    with env.getClusterConnectionIfNeeded() as r, env.getConnection(1) as r1:
+        r.execute_command('TS.CREATE', 'topkcount1', 'LABELS', 'name', 'topkcount')
+        r.execute_command('TS.CREATE', 'topkcount2', 'LABELS', 'name', 'topkcount')
+        for key, ts, value in [('topkcount1', 10, 1), ('topkcount1', 20, 'nan'),
+                               ('topkcount1', 30, 'nan'), ('topkcount2', 10, 1),
+                               ('topkcount2', 20, 2)]:
+            r.execute_command('TS.ADD', key, ts, value)
+        # the NaN samples of topkcount1 are not counted
+        res = r1.execute_command('TS.MTOPK', 2, '-', '+', 'AGGREGATION', 'count',
+                                 'FILTER', 'name=topkcount')
+        env.assertEqual([[key, ts, float(value)] for key, _, (ts, value) in res],
+                        [[b'topkcount2', 10, 2], [b'topkcount1', 10, 1]])
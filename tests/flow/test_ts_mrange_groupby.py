@@ -1,4 +1,5 @@
 from collections import defaultdict
+import math
 
 # from utils import Env
 import pytest
@@ -367,3 +368,183 @@ def test_groupby_reduce_count_with_nan():
         assert sample_map[1010] == '2', f"countall at ts=1010 expected 2, got {sample_map[1010]}"
         assert sample_map[1020] == '2', f"countall at ts=1020 expected 2, got {sample_map[1020]}"
         assert sample_map[1030] == '2', f"countall at ts=1030 expected 2, got {sample_map[1030]}"
+
+
+def test_groupby_reduce_aggregated_series():
+    # aggregated members share a bucket grid and are reduced column by column; the result must
+    # match reducing the members' own aggregated ranges sample by sample
+    env = Env()
+    with env.getClusterConnectionIfNeeded() as r, env.getConnection(1) as r1:
+        for i in range(12):
+            key = f'grid{i}'
+            r.execute_command('TS.CREATE', key, 'LABELS', 'kind', 'grid', 'host', f'h{i % 3}')
+            for ts in range(i * 7, 2000, 3 + i % 4):
+                if (ts // 100) % 5 == i % 5:
+                    continue  # leave gaps of whole buckets
+                value = 'NaN' if ts % 97 == 0 else (ts * (i + 1)) % 53
+                r.execute_command('TS.ADD', key, ts, value)
+
+        def reduce(values, reducer):
+            valid = [v for v in values if not math.isnan(v)]
+            if not valid:
+                return 0 if reducer == 'count' else math.nan
+            return {'sum': sum, 'min': min, 'max': max, 'count': len,
+                    'avg': lambda v: sum(v) / len(v)}[reducer](valid)
+
+        for agg in [['AGGREGATION', 'sum', 100],
+                    ['AGGREGATION', 'max', 70, 'BUCKETTIMESTAMP', 'mid'],
+                    ['ALIGN', 33, 'AGGREGATION', 'avg', 100],
+                    ['AGGREGATION', 'last', 100, 'EMPTY']]:
+            members = decode_if_needed(r1.execute_command('TS.MRANGE', 50, 1900, 'WITHLABELS', *agg,
+                                                          'FILTER', 'kind=grid'))
+            for reducer in ['sum', 'min', 'max', 'avg', 'count']:
+                buckets = defaultdict(lambda: defaultdict(list))
+                for _, labels, samples in members:
+                    host = dict(labels)['host']
+                    for ts, value in samples:
+                        buckets[host][ts].append(float(value))
+
+                res = decode_if_needed(r1.execute_command('TS.MRANGE', 50, 1900, *agg, 'FILTER', 'kind=grid',
+                                                          'GROUPBY', 'host', 'REDUCE', reducer))
+                env.assertEqual(len(res), 3)
+                for name, _, samples in res:
+                    host = name.split('=')[1]
+                    expected = [[ts, round(reduce(values, reducer), 6)]
+                                for ts, values in sorted(buckets[host].items())]
+                    actual = [[ts, round(float(value), 6)] for ts, value in samples]
+                    env.assertEqual(str(actual), str(expected), message=f'{agg} {reducer}')
+
+
+def test_groupby_reduce_many_series():
+    # raw samples of many series merged by timestamp, with runs of equal timestamps of any length
+    env = Env()
+    with env.getClusterConnectionIfNeeded() as r, env.getConnection(1) as r1:
+        expected = defaultdict(list)
+        for i in range(37):
+            key = f'many{i}'
+            r.execute_command('TS.CREATE', key, 'CHUNK_SIZE', 48, 'LABELS', 'kind', 'many')
+            for ts in range(i % 5, 600, 1 + i % 7):
+                r.execute_command('TS.ADD', key, ts, i)
+                expected[ts].append(i)
+
+        for reducer, fn in [('max', max), ('min', min), ('count', len), ('sum', sum)]:
+            exp = [[ts, str(fn(values))] for ts, values in sorted(expected.items())]
+            res = decode_if_needed(r1.execute_command('TS.MRANGE', '-', '+', 'FILTER', 'kind=many',
+                                                      'GROUPBY', 'kind', 'REDUCE', reducer))
+            env.assertEqual(res[0][2], exp)
+            res = decode_if_needed(r1.execute_command('TS.MREVRANGE', 100, 400, 'COUNT', 50, 'FILTER', 'kind=many',
+                                                      'GROUPBY', 'kind', 'REDUCE', reducer))
+            env.assertEqual(res[0][2], [s for s in reversed(exp) if 100 <= s[0] <= 400][:50])
+
+
+def test_groupby_reduce_partial_states():
+    # in a cluster every shard ships one partial state per group and timestamp, which are merged
+    # by the coordinator; the result must match reducing all the members at once
+    env = Env()
+    with env.getClusterConnectionIfNeeded() as r, env.getConnection(1) as r1:
+        for i in range(24):
+            key = f'part{i}'
+            r.execute_command('TS.CREATE', key, 'LABELS', 'kind', 'part', 'host', f'h{i % 4}')
+            for ts in range(i % 3, 500, 2 + i % 3):
+                value = 'NaN' if (ts + i) % 41 == 0 else (ts * (i + 3)) % 29 - 7.5
+                r.execute_command('TS.ADD', key, ts, value)
+
+        def reduce(values, reducer):
+            if reducer == 'countnan':
+                return len([v for v in values if math.isnan(v)])
+            if reducer == 'countall':
+                return len(values)
+            valid = [v for v in values if not math.isnan(v)]
+            if not valid:
+                return 0 if reducer == 'count' else math.nan
+            if len(valid) == 1 and reducer in ['std.s', 'var.s']:
+                return 0
+            return {'sum': sum, 'min': min, 'max': max, 'count': len,
+                    'avg': statistics.mean, 'range': lambda v: max(v) - min(v),
+                    'std.p': statistics.pstdev, 'std.s': statistics.stdev,
+                    'var.p': statistics.pvariance, 'var.s': statistics.variance}[reducer](valid)
+
+        reducers = ['sum', 'min', 'max', 'avg', 'count', 'range', 'std.p', 'std.s', 'var.p', 'var.s',
+                    'countnan', 'countall']
+        for query in [[20, 450], ['-', '+', 'AGGREGATION', 'max', 25]]:
+            members = decode_if_needed(r1.execute_command('TS.MRANGE', *query, 'WITHLABELS',
+                                                          'FILTER', 'kind=part'))
+            groups = defaultdict(lambda: defaultdict(list))
+            sources = defaultdict(list)
+            for key, labels, samples in members:
+                host = dict(labels)['host']
+                sources[host].append(key)
+                for ts, value in samples:
+                    groups[host][ts].append(float(value))
+
+            for reducer in reducers:
+                res = decode_if_needed(r1.execute_command('TS.MRANGE', *query, 'WITHLABELS', 'FILTER', 'kind=part',
+                                                          'GROUPBY', 'host', 'REDUCE', reducer))
+                env.assertEqual([name for name, _, _ in res], [f'host=h{i}' for i in range(4)])
+                for name, labels, samples in res:
+                    host = name.split('=')[1]
+                    labels = dict(labels)
+                    env.assertEqual(labels['__reducer__'], reducer)
+                    env.assertEqual(sorted(labels['__source__'].split(',')), sorted(sources[host]))
+                    expected = [[ts, reduce(values, reducer)] for ts, values in sorted(groups[host].items())]
+                    env.assertEqual([ts for ts, _ in samples], [ts for ts, _ in expected])
+                    for (ts, value), (_, exp) in zip(samples, expected):
+                        value = float(value)
+                        env.assertTrue(math.isclose(value, exp, abs_tol=1e-6) or (math.isnan(value) and math.isnan(exp)),
+                                       message=f'{query} {reducer} {ts}: {value} != {exp}')
+
+
+def test_quantile_aggregations():
+    # p50..p999 are answered from a sketch within 1% of the exact value, and the sketches of the
+    # buckets of a rule and of the shards of a GROUPBY are merged instead of the samples
+    env = Env()
+    quantiles = {'p50': 0.5, 'p90': 0.9, 'p95': 0.95, 'p99': 0.99, 'p999': 0.999}
+
+    def exact(values, q):
+        values = sorted(values)
+        return values[int(q * (len(values) - 1))]
+
+    def assert_close(value, expected, message=''):
+        env.assertTrue(math.isclose(float(value), expected, rel_tol=0.01),
+                       message=f'{message}: {value} != {expected}')
+
+    with env.getClusterConnectionIfNeeded() as r, env.getConnection(1) as r1:
+        values = {}
+        for i in range(8):
+            key = f'lat{i}'
+            r.execute_command('TS.CREATE', key, 'LABELS', 'kind', 'latency', 'dc', f'dc{i % 2}')
+            values[key] = [((ts * 7919 + i * 104729) % 5000) / 10 + 0.5 for ts in range(2000)]
+            for ts, value in enumerate(values[key]):
+                r.execute_command('TS.ADD', key, ts, value)
+
+        for agg, q in quantiles.items():
+            res = r.execute_command('TS.RANGE', 'lat0', '-', '+', 'AGGREGATION', agg, 1000)
+            env.assertEqual([int(ts) for ts, _ in res], [0, 1000])
+            for ts, value in res:
+                assert_close(value, exact(values['lat0'][int(ts):int(ts) + 1000], q), agg)
+
+        # the rule persists the sketch of the open bucket
+        r.execute_command('TS.CREATE', '{lat}src')
+        r.execute_command('TS.CREATE', '{lat}p99')
+        r.execute_command('TS.CREATERULE', '{lat}src', '{lat}p99', 'AGGREGATION', 'p99', 1000)
+        for ts, value in enumerate(values['lat0'][:1500]):
+            r.execute_command('TS.ADD', '{lat}src', ts, value)
+        env.dumpAndReload()
+        for ts in range(1500, 2000):
+            r.execute_command('TS.ADD', '{lat}src', ts, values['lat0'][ts])
+        r.execute_command('TS.ADD', '{lat}src', 2000, 1)
+        res = r.execute_command('TS.RANGE', '{lat}p99', '-', '+')
+        env.assertEqual([int(ts) for ts, _ in res], [0, 1000])
+        for ts, value in res:
+            assert_close(value, exact(values['lat0'][int(ts):int(ts) + 1000], 0.99), 'rule')
+
+        res = decode_if_needed(r1.execute_command('TS.MRANGE', '-', '+', 'AGGREGATION', 'max', 100,
+                                                  'FILTER', 'kind=latency',
+                                                  'GROUPBY', 'dc', 'REDUCE', 'p50'))
+        env.assertEqual([name for name, _, _ in res], ['dc=dc0', 'dc=dc1'])
+        for name, _, samples in res:
+            dc = int(name[-1])
+            env.assertEqual(len(samples), 20)
+            for ts, value in samples:
+                maxima = [max(values[f'lat{i}'][int(ts):int(ts) + 100]) for i in range(dc, 8, 2)]
+                assert_close(value, exact(maxima, 0.5), name)
@@ -0,0 +1,122 @@
+from includes import *
+
+
+def _skip_without_module_config(env):
+    if is_redis_version_lower_than(env, '8.0') or env.isCluster():
+        env.skip()
+    skip_on_rlec()
+
+
+def _fill(r, num_series, samples):
+    for i in range(num_series):
+        key = f'series{i:03}'
+        r.execute_command('TS.CREATE', key, 'CHUNK_SIZE', 128,
+                          'LABELS', 'name', 'cpu', 'idx', i, 'mod', i % 3)
+        for ts in range(1, samples + 1):
+            r.execute_command('TS.ADD', key, ts * 10, (ts * (i + 1)) % 97 + ts / 4)
+    # a compaction to exercise LATEST
+    r.execute_command('TS.CREATE', 'series_agg', 'LABELS', 'name', 'cpu', 'idx', 'agg')
+    r.execute_command('TS.CREATERULE', 'series000', 'series_agg', 'AGGREGATION', 'sum', 700)
+    for ts in range(samples + 1, samples + 50):
+        r.execute_command('TS.ADD', 'series000', ts * 10, ts)
+    # an empty series for EXCLUDEEMPTY
+    r.execute_command('TS.CREATE', 'series_empty', 'LABELS', 'name', 'cpu')
+
+
+QUERIES = [
+    ['-', '+'],
+    [1000, 3000],
+    ['-', '+', 'COUNT', 13],
+    ['-', '+', 'WITHLABELS'],
+    ['-', '+', 'SELECTED_LABELS', 'mod', 'missing'],
+    ['-', '+', 'FILTER_BY_VALUE', 10, 50],
+    ['-', '+', 'FILTER_BY_TS', 20, 500, 9000, 40000],
+    ['-', '+', 'AGGREGATION', 'avg', 330],
+    [500, 7000, 'AGGREGATION', 'twa', 250, 'EMPTY'],
+    [500, 7000, 'ALIGN', 'start', 'AGGREGATION', 'max', 1000, 'BUCKETTIMESTAMP', 'mid'],
+    ['-', '+', 'COUNT', 5, 'AGGREGATION', 'min', 100],
+    ['-', '+', 'LATEST', 'AGGREGATION', 'count', 200],
+    [2000, 2100, 'EXCLUDEEMPTY'],
+]
+
+
+def test_mrange_threads_match_inline():
+    env = Env()
+    _skip_without_module_config(env)
+
+    with env.getConnection() as r:
+        _fill(r, 40, 500)
+        for cmd in ['TS.MRANGE', 'TS.MREVRANGE']:
+            for query in QUERIES:
+                args = [cmd, *query, 'FILTER', 'name=cpu']
+                r.execute_command('CONFIG', 'SET', 'ts-query-threads', 0)
+                inline = r.execute_command(*args)
+                r.execute_command('CONFIG', 'SET', 'ts-query-threads', 4)
+                threaded = r.execute_command(*args)
+                env.assertEqual(threaded, inline, message=str(args))
+        r.execute_command('CONFIG', 'SET', 'ts-query-threads', 0)
+
+
+def test_mrange_threads_consistent_with_writes():
+    env = Env()
+    _skip_without_module_config(env)
+
+    with env.getConnection() as r:
+        _fill(r, 40, 100)
+        r.execute_command('CONFIG', 'SET', 'ts-query-threads', 2)
+        try:
+            # results reflect the data at the time of the query, not later writes or deletions
+            before = r.execute_command('TS.MRANGE', '-', '+', 'FILTER', 'name=cpu')
+            with r.pipeline(transaction=False) as p:
+                p.execute_command('TS.MRANGE', '-', '+', 'FILTER', 'name=cpu')
+                p.execute_command('DEL', 'series001')
+                p.execute_command('TS.ADD', 'series002', 100000, 1)
+                p.execute_command('TS.MRANGE', '-', '+', 'FILTER', 'name=cpu')
+                replies = p.execute()
+            env.assertEqual(replies[0], before)
+            env.assertEqual(len(replies[3]), len(before) - 1)
+
+            # not blocking inside MULTI, the query runs inline
+            with r.pipeline(transaction=True) as p:
+                p.execute_command('TS.MRANGE', '-', '+', 'FILTER', 'name=cpu')
+                env.assertEqual(p.execute()[0], replies[3])
+        finally:
+            r.execute_command('CONFIG', 'SET', 'ts-query-threads', 0)
+
+
+def test_mrange_threads_with_rollup_routing_and_cache():
+    env = Env()
+    _skip_without_module_config(env)
+
+    with env.getConnection() as r:
+        _fill(r, 40, 100)
+        r.execute_command('CONFIG', 'SET', 'ts-query-threads', 2)
+        r.execute_command('CONFIG', 'SET', 'ts-rollup-routing', 'yes')
+        r.execute_command('CONFIG', 'SET', 'ts-query-cache-max-memory', 1000000)
+        try:
+            info = r.execute_command('INFO', 'timeseries')
+            run = info['timeseries_parallel_queries']
+            kept_inline = info['timeseries_parallel_queries_kept_inline']
+
+            # raw queries still use the workers
+            r.execute_command('TS.MRANGE', '-', '+', 'FILTER', 'name=cpu')
+            info = r.execute_command('INFO', 'timeseries')
+            env.assertEqual(info['timeseries_parallel_queries'], run + 1)
+            env.assertEqual(info['timeseries_parallel_queries_kept_inline'], kept_inline)
+
+            # aggregations the compactions or the cache may answer run inline
+            r.execute_command('TS.MRANGE', '-', '+', 'AGGREGATION', 'sum', 700,
+                              'FILTER', 'name=cpu')
+            info = r.execute_command('INFO', 'timeseries')
+            env.assertEqual(info['timeseries_parallel_queries'], run + 1)
+            env.assertEqual(info['timeseries_parallel_queries_kept_inline'], kept_inline + 1)
+
+            # ones neither can answer still use the workers
+            r.execute_command('TS.MRANGE', '-', '+', 'AGGREGATION', 'twa', 700,
+                              'FILTER', 'name=cpu')
+            info = r.execute_command('INFO', 'timeseries')
+            env.assertEqual(info['timeseries_parallel_queries'], run + 2)
+        finally:
+            r.execute_command('CONFIG', 'SET', 'ts-query-cache-max-memory', 0)
+            r.execute_command('CONFIG', 'SET', 'ts-rollup-routing', 'no')
+            r.execute_command('CONFIG', 'SET', 'ts-query-threads', 0)
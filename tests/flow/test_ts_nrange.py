@@ -1,4 +1,5 @@
 import math
+import re
 import pytest
 import redis
 from includes import *
@@ -626,6 +627,60 @@ def test_nrange_all_single_agg_stays_flat():
         _assert_pivot(res, _pivot_ref(r, keys, '-', '+', aggs=aggs, bucket=2))
 
 
+def test_nrange_expr():
+    """EXPR replies [ts, value] rows, the expression over the pivoted columns, across batches."""
+    e = Env()
+    e.skipOnCluster()
+    with e.getClusterConnectionIfNeeded() as r:
+        keys = ['{rx_expr}:errors', '{rx_expr}:requests', '{rx_expr}:total']
+        for k in keys:
+            r.execute_command('TS.CREATE', k)
+        n = 700
+        for ts in range(n):
+            args = [keys[1], ts, ts % 7 + 1, keys[2], ts, 2]
+            if ts % 50:  # errors missing every 50 samples -> NaN
+                args += [keys[0], ts, ts % 3]
+            r.execute_command('TS.MADD', *args)
+
+        def expected(ts):
+            if ts % 50 == 0:
+                return 'NAN'
+            return (ts % 3 - (ts % 7 + 1)) / 2 * 100
+
+        res = r.execute_command('TS.NRANGE', 3, *keys, '-', '+', 'EXPR', '($0 - $1) / $2 * 100')
+        assert [row[0] for row in res] == list(range(n))
+        for ts, v in res:
+            assert _norm(v) == expected(ts), f"ts {ts}: {v!r}"
+
+        # COUNT stops in the middle of a batch
+        res = r.execute_command('TS.NREVRANGE', 3, *keys, '-', '+', 'COUNT', 300,
+                                'EXPR', '-$1 + 2 * (3 - 1)')
+        assert [row[0] for row in res] == list(range(n - 1, n - 301, -1))
+        for ts, v in res:
+            assert _norm(v) == -(ts % 7 + 1) + 4
+
+        # the columns count every aggregator of every key
+        res = r.execute_command('TS.NRANGE', 3, *keys, '-', '+',
+                                'AGGREGATION', 'sum', 'min,max', 'count', 100, 'EXPR', '$2 - $1')
+        ref = _pivot_ref_multi(r, keys, '-', '+', ['sum', 'min,max', 'count'], 100)
+        assert [row[0] for row in res] == [row[0] for row in ref]
+        for (_, v), (_, vals) in zip(res, ref):
+            assert _norm(v) == _norm(vals[2]) - _norm(vals[1])
+
+        for expr, error in [
+            ('$3', 'EXPR uses a column beyond the values of the keys'),
+            ('($0', 'invalid EXPR, missing )'),
+            ('$0 +', 'invalid EXPR, expected a column, a number or ('),
+            ('$0 $1', 'invalid EXPR, unexpected character'),
+            ('$x', 'invalid EXPR, expected a column number after $'),
+            ('-' * 100 + '1', 'invalid EXPR, nested too deeply'),
+        ]:
+            with pytest.raises(redis.ResponseError, match=re.escape(error)):
+                r.execute_command('TS.NRANGE', 3, *keys, '-', '+', 'EXPR', expr)
+        with pytest.raises(redis.ResponseError, match='EXPR needs a single expression'):
+            r.execute_command('TS.NRANGE', 3, *keys, '-', '+', 'EXPR', '$0', 'EXPR', '$1')
+
+
 # ---------------------------------------------------------------------------
 # cluster: keys must share a slot -> cross-slot keys are rejected
 # ---------------------------------------------------------------------------
@@ -59,3 +59,58 @@ def test_large_key_value_pairs():
         for kv_label in kv_labels:
             res = r1.execute_command('TS.QUERYINDEX', kv_label1)
             assert len(res) == number_series
+
+
+def test_label_summary_pruning():
+    """With ts-label-summary-ttl the shards whose summary rules a filter out skip the query; the
+    results stay the same."""
+    env = Env()
+    if not env.isCluster() or is_redis_version_lower_than(env, '8.0', True):
+        env.skip()
+    skip_on_rlec()
+
+    def set_ttl(ttl):
+        for conn in shardsConnections(env):
+            conn.execute_command('CONFIG', 'SET', 'ts-label-summary-ttl', ttl)
+
+    with env.getClusterConnectionIfNeeded() as r, env.getConnection(1) as r1:
+        for i in range(30):
+            r.execute_command('TS.CREATE', f'summary{i}',
+                              'LABELS', 'service', f'svc{i % 3}', 'idx', i)
+            r.execute_command('TS.ADD', f'summary{i}', 100, i)
+
+        filters = [
+            ['service=svc1'],
+            ['service=(svc0,svc2)'],
+            ['service=svc1', 'idx!='],
+            ['service=payments'],
+            ['service=(payments,billing)'],
+            ['service=svc1', 'region!='],
+        ]
+        queries = [
+            lambda f: sorted(r1.execute_command('TS.QUERYINDEX', *f)),
+            lambda f: sorted(r1.execute_command('TS.MGET', 'FILTER', *f)),
+            lambda f: sorted(r1.execute_command('TS.MRANGE', '-', '+', 'FILTER', *f)),
+        ]
+        expected = [[query(f) for f in filters] for query in queries]
+        env.assertEqual(expected[0][3], [])
+        env.assertEqual(expected[0][5], [])
+
+        try:
+            set_ttl(60000)
+            # the first queries fetch the shards' summaries in the background
+            for query in queries:
+                query(filters[0])
+            time.sleep(1)
+            for query, results in zip(queries, expected):
+                for f, result in zip(filters, results):
+                    env.assertEqual(query(f), result, message=str(f))
+
+            # a series created since the summaries were fetched is found right away
+            r.execute_command('TS.CREATE', 'summary_new', 'LABELS', 'service', 'payments')
+            r.execute_command('TS.ADD', 'summary_new', 100, 1)
+            env.assertEqual(len(queries[0](filters[3])), 1)
+            env.assertEqual(len(queries[1](filters[3])), 1)
+            env.assertEqual(len(queries[2](filters[4])), 1)
+        finally:
+            set_ttl(0)
@@ -3363,3 +3363,410 @@ def test_empty_gap_fill_interior_no_edge_scan():
             'TS.revrange', 'c', 0, 69, 'ALIGN', '0', 'AGGREGATION', 'twa', 10, 'EMPTY'))
         assert twa_fwd == twa_const, f'twa interior fwd: {twa_fwd!r} != {twa_const!r}'
         assert twa_rev == list(reversed(twa_const)), f'twa interior rev: {twa_rev!r}'
+
+
+def test_range_format_binary():
+    import struct
+
+    def columns(reply):
+        n = len(reply[0]) // 8
+        ts = list(struct.unpack(f'<{n}Q', reply[0]))
+        return ts, [list(struct.unpack(f'<{n}d', col)) for col in reply[1:]]
+
+    env = Env(decodeResponses=False)
+    with env.getClusterConnectionIfNeeded() as r:
+        r.execute_command('TS.CREATE', 'bin', 'CHUNK_SIZE', 128)
+        for ts in range(1, 2000, 3):
+            r.execute_command('TS.ADD', 'bin', ts, ts * 1.25 - 300)
+
+        for cmd in ['TS.RANGE', 'TS.REVRANGE']:
+            for query in [['-', '+'], [100, 1500, 'COUNT', 77], [100, 1500, 'COUNT', 5],
+                          ['-', '+', 'COUNT', 3, 'AGGREGATION', 'sum', 50],
+                          ['-', '+', 'AGGREGATION', 'avg', 50],
+                          ['-', '+', 'AGGREGATION', 'min,max,count', 50]]:
+                expected = r.execute_command(cmd, 'bin', *query)
+                ts, values = columns(r.execute_command(cmd, 'bin', *query, 'FORMAT', 'BINARY'))
+                env.assertEqual(ts, [s[0] for s in expected])
+                for a, col in enumerate(values):
+                    env.assertEqual(col, [float(s[1 + a]) for s in expected])
+
+        # a series without samples in the range still has its columns
+        env.assertEqual(r.execute_command('TS.RANGE', 'bin', 5000, 6000, 'FORMAT', 'BINARY'),
+                        [b'', b''])
+        env.assertEqual(r.execute_command('TS.RANGE', 'bin', '-', '+', 'FORMAT', 'RESP'),
+                        r.execute_command('TS.RANGE', 'bin', '-', '+'))
+        with pytest.raises(redis.ResponseError) as excinfo:
+            r.execute_command('TS.RANGE', 'bin', '-', '+', 'FORMAT', 'JSON')
+        assert 'unknown FORMAT' in str(excinfo.value)
+        with pytest.raises(redis.ResponseError) as excinfo:
+            r.execute_command('TS.RANGE', 'bin', '-', '+', 'FORMAT')
+        assert 'FORMAT argument is missing' in str(excinfo.value)
+
+        r.execute_command('TS.CREATE', 'bin2', 'LABELS', 'fmt', 'bin')
+        r.execute_command('TS.ADD', 'bin2', 10, 1.5)
+        res = r.execute_command('TS.MRANGE', '-', '+', 'FORMAT', 'BINARY', 'FILTER', 'fmt=bin')
+        env.assertEqual(columns(res[0][2]), ([10], [[1.5]]))
+
+
+def test_range_downsample():
+    with Env(decodeResponses=True).getClusterConnectionIfNeeded() as r:
+        r.execute_command('TS.CREATE', 'plot{1}', 'CHUNK_SIZE', 256, 'LABELS', 'plot', 'lttb')
+        for ts in range(1, 3001):
+            value = 1000 if ts == 1234 else math.sin(ts / 40)
+            r.execute_command('TS.ADD', 'plot{1}', ts * 10, value)
+        raw = {ts: float(v) for ts, v in r.execute_command('TS.RANGE', 'plot{1}', '-', '+')}
+
+        for cmd in ['TS.RANGE', 'TS.REVRANGE']:
+            for agg in ['lttb', 'm4']:
+                res = r.execute_command(cmd, 'plot{1}', '-', '+', 'AGGREGATION', agg, 200)
+                assert 50 < len(res) <= 200
+                # the samples are kept as they are, in the order of the query
+                for ts, v in res:
+                    assert float(v) == raw[ts]
+                timestamps = [ts for ts, _ in res]
+                assert timestamps == sorted(timestamps, reverse=cmd == 'TS.REVRANGE')
+                # the spike and the edges are never dropped
+                assert 12340 in timestamps
+                assert {10, 30000} <= set(timestamps)
+
+        res = r.execute_command('TS.RANGE', 'plot{1}', 5000, 6000, 'AGGREGATION', 'M4', 4)
+        values = [float(v) for _, v in res]
+        in_range = [v for ts, v in raw.items() if 5000 <= ts <= 6000]
+        assert min(values) == min(in_range) and max(values) == max(in_range)
+        res = r.execute_command('TS.RANGE', 'plot{1}', '-', '+', 'AGGREGATION', 'lttb', 3)
+        assert [ts for ts, _ in res] == [10, 12340, 30000]
+        res = r.execute_command('TS.RANGE', 'plot{1}', '-', '+', 'AGGREGATION', 'lttb', 10000)
+        assert len(res) == len(raw)
+
+        res = r.execute_command('TS.MRANGE', '-', '+', 'AGGREGATION', 'lttb', 200,
+                                'FILTER', 'plot=lttb')
+        assert res[0][2] == r.execute_command('TS.RANGE', 'plot{1}', '-', '+',
+                                              'AGGREGATION', 'lttb', 200)
+
+        with pytest.raises(redis.ResponseError) as excinfo:
+            r.execute_command('TS.RANGE', 'plot{1}', '-', '+', 'AGGREGATION', 'lttb', 2)
+        assert 'lttb needs at least 3 points' in str(excinfo.value)
+        with pytest.raises(redis.ResponseError) as excinfo:
+            r.execute_command('TS.RANGE', 'plot{1}', '-', '+', 'AGGREGATION', 'm4', 100, 'EMPTY')
+        assert 'not supported by lttb and m4' in str(excinfo.value)
+        with pytest.raises(redis.ResponseError) as excinfo:
+            r.execute_command('TS.MRANGE', '-', '+', 'AGGREGATION', 'm4', 100,
+                              'FILTER', 'plot=lttb', 'GROUPBY', 'plot', 'REDUCE', 'max')
+        assert 'GROUPBY is not allowed with lttb and m4' in str(excinfo.value)
+
+
+def test_range_counter_aggregations():
+    # a counter growing by 5 every second, reset to 2 at 50s
+    env = Env(decodeResponses=True)
+    counter = [(i * 1000, 5 * i if i < 50 else 2 + 5 * (i - 50)) for i in range(120)]
+    with env.getClusterConnectionIfNeeded() as r:
+        r.execute_command('TS.CREATE', '{c}requests', 'LABELS', 'kind', 'requests', 'host', 'a')
+        r.execute_command('TS.CREATE', '{c}increase')
+        r.execute_command('TS.CREATE', '{c}rate')
+        r.execute_command('TS.CREATERULE', '{c}requests', '{c}increase',
+                          'AGGREGATION', 'increase', 30000)
+        r.execute_command('TS.CREATERULE', '{c}requests', '{c}rate', 'AGGREGATION', 'rate', 30000)
+        for ts, value in counter[:75]:
+            r.execute_command('TS.ADD', '{c}requests', ts, value)
+        env.dumpAndReload()
+        for ts, value in counter[75:]:
+            r.execute_command('TS.ADD', '{c}requests', ts, value)
+
+        # the deltas across bucket edges are split between the buckets, so the increases add up
+        # to the 592 of the whole range
+        increases = [[0, 150], [30000, 147], [60000, 150], [90000, 145]]
+        res = r.execute_command('TS.RANGE', '{c}requests', '-', '+', 'AGGREGATION', 'increase', 30000)
+        env.assertEqual([[int(ts), float(v)] for ts, v in res], increases)
+        res = r.execute_command('TS.REVRANGE', '{c}requests', '-', '+',
+                                'AGGREGATION', 'increase', 30000)
+        env.assertEqual([[int(ts), float(v)] for ts, v in res], increases[::-1])
+        res = r.execute_command('TS.RANGE', '{c}requests', '-', '+', 'AGGREGATION', 'rate', 30000)
+        env.assertEqual([[int(ts), float(v)] for ts, v in res],
+                        [[0, 5], [30000, 4.9], [60000, 5], [90000, 5]])
+        res = r.execute_command('TS.RANGE', '{c}requests', '-', '+', 'AGGREGATION', 'irate', 30000)
+        env.assertEqual([float(v) for _, v in res], [5, 5, 5, 5])
+        # a single sample is compared to the one before the bucket, here across the reset
+        res = r.execute_command('TS.RANGE', '{c}requests', 50000, 50999, 'AGGREGATION', 'irate', 1000)
+        env.assertEqual([[int(ts), float(v)] for ts, v in res], [[50000, 2]])
+
+        # the rules only write the closed buckets
+        res = r.execute_command('TS.RANGE', '{c}increase', '-', '+')
+        env.assertEqual([[int(ts), float(v)] for ts, v in res], increases[:3])
+        res = r.execute_command('TS.RANGE', '{c}rate', '-', '+')
+        env.assertEqual([[int(ts), float(v)] for ts, v in res], [[0, 5], [30000, 4.9], [60000, 5]])
+
+        r.execute_command('TS.CREATE', '{c}requests2', 'LABELS', 'kind', 'requests', 'host', 'b')
+        for ts, value in counter:
+            r.execute_command('TS.ADD', '{c}requests2', ts, value * 2)
+        res = r.execute_command('TS.MRANGE', '-', '+', 'AGGREGATION', 'increase', 30000,
+                                'FILTER', 'kind=requests', 'GROUPBY', 'kind', 'REDUCE', 'sum')
+        env.assertEqual([[int(ts), float(v)] for ts, v in res[0][2]],
+                        [[ts, v * 3] for ts, v in increases])
+
+        with pytest.raises(redis.ResponseError) as excinfo:
+            r.execute_command('TS.MRANGE', '-', '+', 'FILTER', 'kind=requests',
+                              'GROUPBY', 'kind', 'REDUCE', 'rate')
+        assert 'Invalid reducer type' in str(excinfo.value)
+
+
+def test_range_window():
+    env = Env(decodeResponses=True)
+    random.seed(46)
+    values = [random.uniform(-100, 100) for _ in range(500)]
+
+    def windows(vals, fn, size):
+        return [fn(vals[max(0, i - size + 1):i + 1]) for i in range(len(vals))]
+
+    def std(window):
+        mean = sum(window) / len(window)
+        return math.sqrt(sum((v - mean) ** 2 for v in window) / len(window))
+
+    def ewma(vals, alpha):
+        out = []
+        for v in vals:
+            out.append(v if not out else alpha * v + (1 - alpha) * out[-1])
+        return out
+
+    with env.getClusterConnectionIfNeeded() as r:
+        # small chunks, so that the windows span many of them
+        r.execute_command('TS.CREATE', 'w1', 'CHUNK_SIZE', 128, 'LABELS', 'name', 'w')
+        for i, v in enumerate(values):
+            r.execute_command('TS.ADD', 'w1', i * 10, v)
+
+        expected = {
+            ('sma', 7): windows(values, lambda w: sum(w) / len(w), 7),
+            ('std', 7): windows(values, std, 7),
+            ('min', 5): windows(values, min, 5),
+            ('max', 5): windows(values, max, 5),
+            ('ewma', 0.3): ewma(values, 0.3),
+            ('sma', 1): values,
+        }
+        for (fn, arg), exp in expected.items():
+            res = r.execute_command('TS.RANGE', 'w1', '-', '+', 'WINDOW', fn, arg)
+            env.assertEqual([int(ts) for ts, _ in res], [i * 10 for i in range(len(values))])
+            for (_, v), e in zip(res, exp):
+                env.assertAlmostEqual(float(v), e, 1e-6)
+
+        # the windows follow the reply, back in time for REVRANGE
+        res = r.execute_command('TS.REVRANGE', 'w1', '-', '+', 'WINDOW', 'max', 5)
+        for (_, v), e in zip(res, windows(values[::-1], max, 5)):
+            env.assertAlmostEqual(float(v), e, 1e-6)
+
+        # after the aggregation and the COUNT
+        buckets = [sum(values[i:i + 10]) for i in range(0, len(values), 10)]
+        res = r.execute_command('TS.RANGE', 'w1', '-', '+', 'COUNT', 20,
+                                'AGGREGATION', 'sum', 100, 'WINDOW', 'sma', 3)
+        env.assertEqual(len(res), 20)
+        for (_, v), e in zip(res, windows(buckets[:20], lambda w: sum(w) / len(w), 3)):
+            env.assertAlmostEqual(float(v), e, 1e-6)
+
+        res = r.execute_command('TS.MRANGE', '-', '+', 'WINDOW', 'min', 4, 'FILTER', 'name=w')
+        env.assertEqual(len(res), 1)
+        for (_, v), e in zip(res[0][2], windows(values, min, 4)):
+            env.assertAlmostEqual(float(v), e, 1e-6)
+
+        # back in time for MREVRANGE as well, also when the series come from several shards
+        r.execute_command('TS.CREATE', 'w2', 'LABELS', 'name', 'w')
+        for i, v in enumerate(values):
+            r.execute_command('TS.ADD', 'w2', i * 10, v)
+        res = r.execute_command('TS.MREVRANGE', '-', '+', 'WINDOW', 'sma', 4, 'FILTER', 'name=w')
+        env.assertEqual(len(res), 2)
+        for series in res:
+            env.assertEqual(int(series[2][0][0]), (len(values) - 1) * 10)
+            for (_, v), e in zip(series[2], windows(values[::-1], lambda w: sum(w) / len(w), 4)):
+                env.assertAlmostEqual(float(v), e, 1e-6)
+        res = r.execute_command('TS.MREVRANGE', '-', '+', 'COUNT', 10, 'AGGREGATION', 'sum', 100,
+                                'WINDOW', 'max', 3, 'FILTER', 'name=w')
+        for series in res:
+            env.assertEqual(len(series[2]), 10)
+            for (_, v), e in zip(series[2], windows(buckets[::-1][:10], max, 3)):
+                env.assertAlmostEqual(float(v), e, 1e-6)
+
+        for args, error in [
+            (['WINDOW', 'sma'], 'WINDOW needs a function and a size'),
+            (['WINDOW', 'median', 3], 'unknown WINDOW'),
+            (['WINDOW', 'sma', 0], 'WINDOW size must be between'),
+            (['WINDOW', 'max', 2.5], 'WINDOW size must be between'),
+            (['WINDOW', 'ewma', 0], 'ewma alpha must be greater than 0'),
+            (['WINDOW', 'ewma', 1.5], 'ewma alpha must be greater than 0'),
+            (['AGGREGATION', 'lttb', 10, 'WINDOW', 'sma', 3], 'not allowed with lttb and m4'),
+        ]:
+            with pytest.raises(redis.ResponseError) as excinfo:
+                r.execute_command('TS.RANGE', 'w1', '-', '+', *args)
+            assert error in str(excinfo.value)
+
+
+def test_range_rollup_routing():
+    env = Env(decodeResponses=True)
+    if is_redis_version_lower_than(env, '8.0') or env.isCluster():
+        env.skip()
+    skip_on_rlec()
+    random.seed(49)
+    with env.getClusterConnectionIfNeeded() as r:
+        r.execute_command('TS.CREATE', 'rr{1}', 'LABELS', 'name', 'rr')
+        for agg, bucket in [('sum', 10), ('count', 10), ('min', 10), ('max', 10), ('avg', 100)]:
+            dest = 'rr_{}_{}{{1}}'.format(agg, bucket)
+            r.execute_command('TS.CREATE', dest)
+            r.execute_command('TS.CREATERULE', 'rr{1}', dest, 'AGGREGATION', agg, bucket)
+        # integer values, so that the sums are exact whatever their order
+        for ts in range(0, 1500, 3):
+            r.execute_command('TS.ADD', 'rr{1}', ts, random.randint(-100, 100))
+        # created after the samples, its first bucket is partial
+        r.execute_command('TS.CREATE', 'rr_sum_50{1}')
+        r.execute_command('TS.CREATERULE', 'rr{1}', 'rr_sum_50{1}', 'AGGREGATION', 'sum', 50)
+        for ts in range(1500, 3001, 3):
+            r.execute_command('TS.ADD', 'rr{1}', ts, random.randint(-100, 100))
+
+        queries = []
+        for agg in ['sum', 'count', 'min', 'max', 'avg', 'first']:
+            for bucket in [10, 50, 100, 150]:
+                for start, end in [('-', '+'), (5, 2995), (37, 1234), (1480, '+')]:
+                    queries.append([start, end, 'AGGREGATION', agg, bucket])
+        queries += [
+            [0, '+', 'ALIGN', 7, 'AGGREGATION', 'sum', 50],
+            [13, 2000, 'ALIGN', 'start', 'AGGREGATION', 'sum', 20],
+            [0, 2000, 'ALIGN', 'end', 'AGGREGATION', 'max', 100],
+            [0, '+', 'AGGREGATION', 'sum', 100, 'BUCKETTIMESTAMP', 'mid'],
+            [0, '+', 'COUNT', 5, 'AGGREGATION', 'avg', 200],
+            [0, '+', 'AGGREGATION', 'sum', 100, 'WINDOW', 'sma', 3],
+            [0, '+', 'AGGREGATION', 'sum', 100, 'EMPTY'],
+            [0, '+', 'FILTER_BY_VALUE', 0, 100, 'AGGREGATION', 'sum', 100],
+        ]
+
+        def run_all():
+            res = []
+            for q in queries:
+                res.append(r.execute_command('TS.RANGE', 'rr{1}', *q))
+                res.append(r.execute_command('TS.REVRANGE', 'rr{1}', *q))
+                res.append(r.execute_command('TS.MRANGE', *q, 'FILTER', 'name=rr'))
+            return res
+
+        raw = run_all()
+        r.execute_command('CONFIG', 'SET', 'ts-rollup-routing', 'yes')
+        try:
+            env.assertEqual(run_all(), raw)
+
+            # the closed buckets are read from the compaction
+            r.execute_command('TS.ADD', 'rr_sum_10{1}', 500, 1000000, 'ON_DUPLICATE', 'LAST')
+            res = r.execute_command('TS.RANGE', 'rr{1}', 490, 510, 'AGGREGATION', 'sum', 10)
+            env.assertEqual(res[1], [500, '1000000'])
+            # unless the query can't be rolled up from it
+            res = r.execute_command('TS.RANGE', 'rr{1}', 490, 510, 'AGGREGATION', 'sum', 5)
+            env.assertNotEqual(res[2][1], '1000000')
+        finally:
+            r.execute_command('CONFIG', 'SET', 'ts-rollup-routing', 'no')
+
+
+def test_range_rollup_routing_rule_after_data():
+    env = Env(decodeResponses=True)
+    if is_redis_version_lower_than(env, '8.0') or env.isCluster():
+        env.skip()
+    skip_on_rlec()
+    with env.getClusterConnectionIfNeeded() as r:
+        r.execute_command('TS.CREATE', 'rw{1}')
+        for ts in range(0, 1000, 3):
+            r.execute_command('TS.ADD', 'rw{1}', ts, ts % 17)
+        r.execute_command('TS.CREATE', 'rw_sum{1}')
+        r.execute_command('TS.CREATERULE', 'rw{1}', 'rw_sum{1}', 'AGGREGATION', 'sum', 10)
+        for ts in range(1000, 2000, 3):
+            r.execute_command('TS.ADD', 'rw{1}', ts, ts % 17)
+        # an old upsert writes its bucket into the compaction, the ones after it are still missing
+        r.execute_command('TS.ADD', 'rw{1}', 101, 5)
+        env.assertEqual(r.execute_command('TS.RANGE', 'rw_sum{1}', 0, 200), [[100, '14']])
+
+        queries = [[0, '+', 'AGGREGATION', 'sum', 10],
+                   [0, '+', 'AGGREGATION', 'sum', 100],
+                   [95, 1500, 'AGGREGATION', 'sum', 50]]
+
+        def run_all():
+            return [r.execute_command(cmd, 'rw{1}', *q)
+                    for q in queries for cmd in ['TS.RANGE', 'TS.REVRANGE']]
+
+        raw = run_all()
+        r.execute_command('CONFIG', 'SET', 'ts-rollup-routing', 'yes')
+        try:
+            env.assertEqual(run_all(), raw)
+            # the watermark of the rule is kept in the RDB
+            env.dumpAndReload()
+            env.assertEqual(run_all(), raw)
+            # the buckets after it are read from the compaction
+            r.execute_command('TS.ADD', 'rw_sum{1}', 1500, 1000000, 'ON_DUPLICATE', 'LAST')
+            res = r.execute_command('TS.RANGE', 'rw{1}', 1490, 1510, 'AGGREGATION', 'sum', 10)
+            env.assertEqual(res[1], [1500, '1000000'])
+        finally:
+            r.execute_command('CONFIG', 'SET', 'ts-rollup-routing', 'no')
+
+def test_range_query_cache():
+    env = Env(decodeResponses=True)
+    if is_redis_version_lower_than(env, '8.0') or env.isCluster():
+        env.skip()
+    skip_on_rlec()
+    random.seed(50)
+    aggs = {'sum': sum, 'min': min, 'max': max, 'count': len,
+            'avg': lambda vals: sum(vals) / len(vals)}
+    samples = {'qc{1}': {}, 'qr{1}': {}}
+    retention = {'qc{1}': 0, 'qr{1}': 1000}
+
+    def expected(key, agg, bucket, start, end, rev):
+        data = samples[key]
+        last = max(data)
+        if retention[key] and last > retention[key]:
+            start = max(start, last - retention[key])
+        buckets = {}
+        for ts in sorted(data):
+            if start <= ts <= end:
+                buckets.setdefault(ts - ts % bucket, []).append(data[ts])
+        res = [[ts, aggs[agg](vals)] for ts, vals in sorted(buckets.items())]
+        return res[::-1] if rev else res
+
+    def check():
+        for key in samples:
+            for agg in aggs:
+                for bucket in [10, 60]:
+                    for start, end in [(0, 10 ** 9), (37, 1234), (1500, 10 ** 9)]:
+                        for cmd in ['TS.RANGE', 'TS.REVRANGE']:
+                            res = r.execute_command(cmd, key, start, end,
+                                                    'AGGREGATION', agg, bucket)
+                            exp = expected(key, agg, bucket, start, end, cmd == 'TS.REVRANGE')
+                            env.assertEqual([int(ts) for ts, _ in res], [ts for ts, _ in exp])
+                            for (_, v), (_, e) in zip(res, exp):
+                                env.assertAlmostEqual(float(v), e, 1e-9)
+        res = r.execute_command('TS.MRANGE', 0, 10 ** 9, 'AGGREGATION', 'sum', 60,
+                                'FILTER', 'name=qc')
+        exp = expected('qc{1}', 'sum', 60, 0, 10 ** 9, False)
+        env.assertEqual([[int(ts), float(v)] for ts, v in res[0][2]], exp)
+
+    def add(ts, value):
+        for key in samples:
+            r.execute_command('TS.ADD', key, ts, value, 'ON_DUPLICATE', 'LAST')
+            samples[key][ts] = value
+
+    with env.getClusterConnectionIfNeeded() as r:
+        for key in samples:
+            r.execute_command('TS.CREATE', key, 'RETENTION', retention[key],
+                              'LABELS', 'name', key[:2])
+        for ts in range(0, 2000, 7):
+            add(ts, random.randint(-100, 100))
+
+        r.execute_command('CONFIG', 'SET', 'ts-query-cache-max-memory', 1000000)
+        try:
+            check()
+            # the cached buckets are read again, and extended with the ones closed since
+            check()
+            for ts in range(2000, 2500, 7):
+                add(ts, random.randint(-100, 100))
+            check()
+            # the buckets before the last sample change
+            add(2001, 1000)
+            check()
+            add(2497, 5)
+            check()
+            for key in samples:
+                r.execute_command('TS.DEL', key, 300, 400)
+                samples[key] = {ts: v for ts, v in samples[key].items() if not 300 <= ts <= 400}
+            check()
+            # evicted right away
+            r.execute_command('CONFIG', 'SET', 'ts-query-cache-max-memory', 100)
+            check()
+        finally:
+            r.execute_command('CONFIG', 'SET', 'ts-query-cache-max-memory', 0)
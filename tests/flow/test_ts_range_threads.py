@@ -0,0 +1,79 @@
+from includes import *
+
+
+def _skip_without_module_config(env):
+    if is_redis_version_lower_than(env, '8.0') or env.isCluster():
+        env.skip()
+    skip_on_rlec()
+
+
+def _value(ts):
+    return (ts * 7919) % 1009 + ts / 13
+
+
+QUERIES = [
+    ['-', '+'],
+    [1000, 90000],
+    [33333, '+'],
+    ['-', '+', 'COUNT', 777],
+    ['-', '+', 'FILTER_BY_VALUE', 100, 600],
+    ['-', '+', 'FILTER_BY_TS', 20, 500, 9000, 40000, 77770],
+    ['-', '+', 'AGGREGATION', 'avg', 330],
+    ['-', '+', 'AGGREGATION', 'sum', 7],
+    [500, 70000, 'ALIGN', 'start', 'AGGREGATION', 'max', 1000, 'BUCKETTIMESTAMP', 'mid'],
+    [505, 70003, 'ALIGN', 'end', 'AGGREGATION', 'first', 1230],
+    ['-', '+', 'ALIGN', 17, 'AGGREGATION', 'last', 990, 'BUCKETTIMESTAMP', 'end'],
+    ['-', '+', 'COUNT', 50, 'AGGREGATION', 'min', 100],
+    ['-', '+', 'FILTER_BY_VALUE', 100, 600, 'AGGREGATION', 'std.p', 450],
+    ['-', '+', 'AGGREGATION', 'min,max,count', 2000],
+    # run inline, the buckets depend on the samples around them
+    [500, 70000, 'AGGREGATION', 'twa', 250],
+    [500, 70000, 'AGGREGATION', 'avg', 250, 'EMPTY'],
+]
+
+
+def test_range_threads_match_inline():
+    env = Env()
+    _skip_without_module_config(env)
+
+    with env.getConnection() as r:
+        r.execute_command('TS.CREATE', 'long', 'CHUNK_SIZE', 128)
+        with r.pipeline(transaction=False) as p:
+            for ts in range(1, 10001):
+                p.execute_command('TS.ADD', 'long', ts * 10, _value(ts))
+            p.execute()
+        info = dict(zip(*[iter(r.execute_command('TS.INFO', 'long'))]*2))
+        env.assertGreater(info[b'chunkCount'], 256)
+
+        for cmd in ['TS.RANGE', 'TS.REVRANGE']:
+            for query in QUERIES:
+                args = [cmd, 'long', *query]
+                r.execute_command('CONFIG', 'SET', 'ts-query-threads', 0)
+                inline = r.execute_command(*args)
+                r.execute_command('CONFIG', 'SET', 'ts-query-threads', 4)
+                threaded = r.execute_command(*args)
+                env.assertEqual(threaded, inline, message=str(args))
+        r.execute_command('CONFIG', 'SET', 'ts-query-threads', 0)
+
+
+def test_range_threads_consistent_with_writes():
+    env = Env()
+    _skip_without_module_config(env)
+
+    with env.getConnection() as r:
+        r.execute_command('TS.CREATE', 'long', 'CHUNK_SIZE', 128, 'RETENTION', 50000)
+        for ts in range(1, 5001):
+            r.execute_command('TS.ADD', 'long', ts * 10, _value(ts))
+        r.execute_command('CONFIG', 'SET', 'ts-query-threads', 3)
+        try:
+            before = r.execute_command('TS.RANGE', 'long', '-', '+')
+            env.assertEqual(len(before), 5000)
+            with r.pipeline(transaction=False) as p:
+                p.execute_command('TS.RANGE', 'long', '-', '+')
+                p.execute_command('TS.DEL', 'long', 0, 20000)
+                p.execute_command('TS.RANGE', 'long', '-', '+')
+                replies = p.execute()
+            env.assertEqual(replies[0], before)
+            env.assertEqual(replies[2], before[2000:])
+        finally:
+            r.execute_command('CONFIG', 'SET', 'ts-query-threads', 0)
@@ -0,0 +1,131 @@
+from includes import *
+
+FIELDS = ['user', 'system', 'idle', 'iowait']
+
+
+def _fill(r, wide, narrow, rows):
+    r.execute_command('TS.WCREATE', wide, 'FIELDS', len(FIELDS), *FIELDS, 'CHUNK_SIZE', 128)
+    for key in narrow:
+        r.execute_command('TS.CREATE', key)
+    for ts in range(1, rows + 1):
+        values = [ts % 7, (ts * 3) % 11 + 0.5, 100 - ts % 13, ts / 8]
+        r.execute_command('TS.WADD', wide, ts * 10, *values)
+        for key, value in zip(narrow, values):
+            r.execute_command('TS.ADD', key, ts * 10, value)
+
+
+def test_wide_range_matches_narrow():
+    env = Env()
+    with env.getClusterConnectionIfNeeded() as r:
+        narrow = ['{w}' + f for f in FIELDS]
+        _fill(r, '{w}wide', narrow, 2000)
+
+        for cmd in ['TS.RANGE', 'TS.REVRANGE']:
+            for field, key in zip(FIELDS, narrow):
+                for args in [[0, '+'],
+                             [1234, 15678],
+                             [0, '+', 'COUNT', 17],
+                             [0, '+', 'FILTER_BY_VALUE', 3, 50],
+                             [0, '+', 'FILTER_BY_TS', 20, 1230, 19990],
+                             [0, '+', 'AGGREGATION', 'avg', 700],
+                             [5, '+', 'ALIGN', 'start', 'AGGREGATION', 'twa', 333],
+                             [0, 9000, 'AGGREGATION', 'max', 1000, 'EMPTY']]:
+                    env.assertEqual(r.execute_command(cmd, '{w}wide', *args, 'FIELD', field),
+                                    r.execute_command(cmd, key, *args))
+
+            # without FIELD every field is returned, pivoted by timestamp like TS.NRANGE
+            nrange = 'TS.NRANGE' if cmd == 'TS.RANGE' else 'TS.NREVRANGE'
+            env.assertEqual(r.execute_command(cmd, '{w}wide', 100, 5000),
+                            r.execute_command(nrange, len(narrow), *narrow, 100, 5000))
+            env.assertEqual(
+                r.execute_command(cmd, '{w}wide', 0, '+', 'AGGREGATION', 'min', 500),
+                r.execute_command(nrange, len(narrow), *narrow, 0, '+',
+                                  'AGGREGATION', *(['min'] * len(narrow)), 500))
+
+
+def test_wide_persistence_and_retention():
+    env = Env()
+    with env.getClusterConnectionIfNeeded() as r:
+        r.execute_command('TS.WCREATE', 'ohlc', 'FIELDS', 4, 'open', 'high', 'low', 'close',
+                          'RETENTION', 1000, 'CHUNK_SIZE', 64)
+        for ts in range(1, 501):
+            r.execute_command('TS.WADD', 'ohlc', ts * 10, ts, ts + 2, ts - 1, ts + 1)
+        before = r.execute_command('TS.RANGE', 'ohlc', '-', '+')
+
+        # samples older than the retention window are not returned
+        env.assertEqual(len(before), 101)
+        env.assertEqual(before[0][0], 4000)
+        env.assertEqual(r.execute_command('TS.RANGE', 'ohlc', 0, 3999), [])
+        env.assertEqual(r.execute_command('TS.RANGE', 'ohlc', 4000, 4010),
+                        [[4000, [b'400', b'402', b'399', b'401']],
+                         [4010, [b'401', b'403', b'400', b'402']]])
+
+        env.dumpAndReload()
+        env.assertEqual(r.execute_command('TS.RANGE', 'ohlc', '-', '+'), before)
+        env.assertEqual(r.execute_command('TS.WADD', 'ohlc', 5010, 1, 2, 3, 4), 5010)
+        env.assertEqual(r.execute_command('TS.REVRANGE', 'ohlc', '-', '+', 'COUNT', 1,
+                                          'FIELD', 'low'), [[5010, b'3']])
+
+
+def test_wide_errors():
+    env = Env()
+    with env.getClusterConnectionIfNeeded() as r:
+        r.execute_command('TS.WCREATE', 'wide', 'FIELDS', 2, 'a', 'b')
+        r.execute_command('TS.CREATE', 'narrow')
+        r.execute_command('TS.WADD', 'wide', 100, 1, 2)
+
+        with pytest.raises(redis.ResponseError, match='key already exists'):
+            r.execute_command('TS.WCREATE', 'wide', 'FIELDS', 1, 'a')
+        with pytest.raises(redis.ResponseError, match='duplicate field name'):
+            r.execute_command('TS.WCREATE', 'wide2', 'FIELDS', 2, 'a', 'a')
+        with pytest.raises(redis.ResponseError, match='numfields'):
+            r.execute_command('TS.WCREATE', 'wide2', 'FIELDS', 0, 'a')
+        with pytest.raises(redis.ResponseError, match='FIELDS is required'):
+            r.execute_command('TS.WCREATE', 'wide2', 'NOFIELDS', 1, 'a')
+
+        # append only
+        with pytest.raises(redis.ResponseError, match='newer than the last sample'):
+            r.execute_command('TS.WADD', 'wide', 100, 3, 4)
+        with pytest.raises(redis.ResponseError, match='number of values'):
+            r.execute_command('TS.WADD', 'wide', 200, 3)
+        with pytest.raises(redis.ResponseError, match='invalid value'):
+            r.execute_command('TS.WADD', 'wide', 200, 3, 'x')
+        with pytest.raises(redis.ResponseError, match='not a wide series'):
+            r.execute_command('TS.WADD', 'narrow', 200, 3)
+        with pytest.raises(redis.ResponseError, match='does not exist'):
+            r.execute_command('TS.WADD', 'missing', 200, 3)
+        with pytest.raises(redis.ResponseError, match='field does not exist'):
+            r.execute_command('TS.RANGE', 'wide', '-', '+', 'FIELD', 'c')
+        with pytest.raises(redis.ResponseError, match='not a TSDB key'):
+            r.execute_command('TS.ADD', 'wide', 200, 1)
+
+        # options that can't apply to the rows of all the fields
+        with pytest.raises(redis.ResponseError, match='FORMAT BINARY needs a FIELD'):
+            r.execute_command('TS.RANGE', 'wide', '-', '+', 'FORMAT', 'BINARY')
+        with pytest.raises(redis.ResponseError, match='lttb and m4 need a FIELD'):
+            r.execute_command('TS.RANGE', 'wide', '-', '+', 'AGGREGATION', 'lttb', 10)
+        with pytest.raises(redis.ResponseError, match='EXPR is not supported'):
+            r.execute_command('TS.RANGE', 'wide', '-', '+', 'EXPR', '$0+$1')
+        env.assertEqual(r.execute_command('TS.RANGE', 'wide', '-', '+'), [[100, [b'1', b'2']]])
+
+
+def test_wide_copy():
+    env = Env()
+    env.skipOnVersionSmaller("6.2.0")
+    with env.getClusterConnectionIfNeeded() as r:
+        narrow = ['{w}' + f for f in FIELDS]
+        _fill(r, '{w}wide', narrow, 300)
+        before = r.execute_command('TS.RANGE', '{w}wide', '-', '+')
+
+        env.assertTrue(r.execute_command('COPY', '{w}wide', '{w}copy'))
+        env.assertEqual(r.execute_command('TS.RANGE', '{w}copy', '-', '+'), before)
+        # the copy doesn't share its chunks with the source
+        r.execute_command('TS.WADD', '{w}copy', 5000, 1, 2, 3, 4)
+        env.assertEqual(r.execute_command('TS.RANGE', '{w}wide', '-', '+'), before)
+        env.assertEqual(r.execute_command('TS.REVRANGE', '{w}copy', '-', '+', 'COUNT', 1),
+                        [[5000, [b'1', b'2', b'3', b'4']]])
+
+        # WINDOW applies to every field
+        env.assertEqual(
+            r.execute_command('TS.RANGE', '{w}wide', '-', '+', 'WINDOW', 'sma', 5),
+            r.execute_command('TS.NRANGE', len(narrow), *narrow, '-', '+', 'WINDOW', 'sma', 5))
@@ -261,6 +261,33 @@ MU_TEST(test_nan_mixed_compression) {
     Compressed_FreeChunk(chunk_varying);
 }
 
+MU_TEST(test_Compressed_RetainChunk) {
+    const size_t chunk_size = 4096; // 4096 bytes (data) chunck
+    CompressedChunk *chunk = Compressed_NewChunk(chunk_size);
+    for (size_t i = 1; i <= 100; i++) {
+        Sample s = { .timestamp = i, .value = i };
+        Compressed_AddSample(chunk, &s);
+    }
+    mu_assert(!Compressed_IsChunkShared(chunk), "new chunk is exclusive");
+
+    mu_assert(Compressed_RetainChunk(chunk) == chunk, "retain returns the chunk");
+    mu_assert(Compressed_IsChunkShared(chunk), "retained chunk is shared");
+    CompressedChunk *clone = Compressed_CloneChunk(chunk);
+    mu_assert(!Compressed_IsChunkShared(clone), "clone of a shared chunk is exclusive");
+
+    // the split swaps the contents of the chunk, its references must stay
+    CompressedChunk *chunk2 = Compressed_SplitChunk(clone);
+    mu_assert(!Compressed_IsChunkShared(clone), "split chunk stays exclusive");
+    mu_assert_int_eq(100, Compressed_ChunkNumOfSample(clone) + Compressed_ChunkNumOfSample(chunk2));
+
+    Compressed_FreeChunk(chunk);
+    mu_assert(!Compressed_IsChunkShared(chunk), "released chunk is exclusive");
+    mu_assert_int_eq(100, Compressed_ChunkNumOfSample(chunk));
+    Compressed_FreeChunk(chunk);
+    Compressed_FreeChunk(clone);
+    Compressed_FreeChunk(chunk2);
+}
+
 MU_TEST_SUITE(compressed_chunk_test_suite) {
     MU_RUN_TEST(test_compressed_upsert);
     MU_RUN_TEST(test_compressed_fail_appendInteger);
@@ -268,4 +295,5 @@ MU_TEST_SUITE(compressed_chunk_test_suite) {
     MU_RUN_TEST(test_Compressed_SplitChunk_odd);
     MU_RUN_TEST(test_Compressed_SplitChunk_force_realloc);
     MU_RUN_TEST(test_nan_mixed_compression);
+    MU_RUN_TEST(test_Compressed_RetainChunk);
 }